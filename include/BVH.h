@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct AABB {
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 centroid() const { return (min + max) * 0.5f; }
+
+    float surfaceArea() const {
+        const glm::vec3 e = max - min;
+        if (e.x < 0.0f || e.y < 0.0f || e.z < 0.0f) return 0.0f;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+// Matches `BVHNode` in hittable.glsl (std430, 32 bytes).
+// Interior nodes: count == 0, children at leftFirst and leftFirst + 1.
+// Leaves: count > 0, primitives primIndices[leftFirst .. leftFirst + count).
+struct GPUBVHNode {
+    glm::vec3 boundsMin;
+    int leftFirst;
+    glm::vec3 boundsMax;
+    int count;
+};
+
+// Deepest leaf the builder makes, the root being at depth 0. Traversal keeps
+// at most one deferred child per level on its stack, so BVH_STACK_SIZE in
+// hittable.glsl and CpuRenderer.cpp must be at least this.
+constexpr int BVH_MAX_DEPTH = 64;
+
+class BVHBuilder {
+public:
+    // Build a binned SAH hierarchy over primBounds. primIndices receives
+    // indices into primBounds in leaf order; nodes[0] is the root.
+    // threadCount 0 uses every hardware thread; the tree is the same for
+    // any thread count. Ranges that would otherwise end up deeper than
+    // BVH_MAX_DEPTH are split at the median instead.
+    static void build(const std::vector<AABB>& primBounds,
+                      std::vector<GPUBVHNode>& nodes,
+                      std::vector<int>& primIndices,
+                      unsigned threadCount = 0);
+
+    // Expected cost of a ray that enters the root under the SAH model:
+    // every node weighted by its surface area relative to the root
+    static float sahCost(const std::vector<GPUBVHNode>& nodes);
+};
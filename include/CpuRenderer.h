@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+#include "SceneBuilder.h"
+
+// Native reference implementation of shaders/compute/main.glsl.
+// Consumes the same object streams/GPUMaterial arrays as the compute kernel and
+// writes the same accumulation layout (rgb = running sum, a = sample count),
+// so its output can be compared pixel-for-pixel with the GPU path.
+class CpuRenderer {
+public:
+    // threadCount == 0 uses every hardware thread
+    explicit CpuRenderer(const SceneData& scene, unsigned threadCount = 0);
+
+    void resize(int width, int height);
+    void resetAccumulation();
+
+    // Equivalent of one dispatchComputeShader() call, split into 16x16 tiles
+    // that are distributed across the worker threads.
+    void renderFrame(const CameraParams& camera_params, const SkyParams& sky_params,
+                     int samplesPerFrame, int maxTotalSamples, uint32_t maxBounces,
+                     int lightSamples = 1, SamplerParams sampler_params = {0, 0});
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    unsigned getThreadCount() const { return threadCount; }
+    // Rays traced (every hitWorld() query) since the last resetAccumulation()
+    uint64_t getRayCount() const { return rayCount; }
+
+    // Row 0 is the bottom of the image, matching the OpenGL textures
+    const std::vector<glm::vec4>& getOutput() const { return output; }
+    const std::vector<glm::vec4>& getOutputBloom() const { return outputBloom; }
+
+private:
+    const SceneData& scene;
+    unsigned threadCount;
+
+    int width = 0;
+    int height = 0;
+    uint64_t rayCount = 0;
+
+    std::vector<glm::vec4> accum;
+    std::vector<glm::vec4> accumBloom;
+    std::vector<glm::vec4> output;
+    std::vector<glm::vec4> outputBloom;
+};
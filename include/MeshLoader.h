@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Triangles read from a Wavefront OBJ or binary PLY file. Polygons are fan
+// triangulated; normals, texture coordinates and groups are ignored.
+struct MeshData {
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;   // three per triangle, into vertices
+};
+
+class MeshLoader {
+public:
+    // Picks the format from the extension (.obj or .ply). The file is read
+    // in one block and decoded on all hardware threads: OBJ text is split
+    // into line-aligned chunks, PLY vertex records into index ranges.
+    // On failure errorMsg says why.
+    static bool loadFromFile(const std::string& path, MeshData& mesh, std::string& errorMsg);
+
+private:
+    static bool parseObj(const std::vector<char>& text, MeshData& mesh, std::string& errorMsg);
+    static bool parsePly(const std::vector<char>& bytes, MeshData& mesh, std::string& errorMsg);
+};
@@ -7,23 +7,149 @@
 #include "material.h"
 
 struct SceneData {
-    std::vector<GPUObject> objects;
+    std::vector<SceneObject> objects;
     std::vector<GPUMaterial> materials;
     std::vector<int> lightIndices;
+
+    // Objects of every prototype, in prototype space. They follow `objects`
+    // in the per-object streams and transforms below, so stream index
+    // objects.size() + i refers to prototypeObjects[i].
+    std::vector<SceneObject> prototypeObjects;
+    std::vector<ScenePrototype> prototypes;
+    std::vector<SceneInstance> instances;
+    std::vector<GPUInstance> instanceTransforms;
+
+    // Alias table over every emitter (isLight objects and objects with an
+    // emissive material), weighted by emitted power
+    std::vector<GPULight> lightTable;
+
+    // Structure-of-arrays view of `objects` + `prototypeObjects` for the kernels. Intersection
+    // reads only geometry and type; the material index is fetched once for
+    // the closest hit. Geometry holds center + radius for spheres, normal +
+    // distance for planes and scale + bounding radius for everything else.
+    std::vector<glm::vec4> objectGeometry;
+    std::vector<int> objectTypes;
+    std::vector<int> objectMaterials;
+
+    // Two-level acceleration structure. nodes[0] is the root of a BVH over
+    // every non-plane object and every instance (leaf entries -1 - i refer to
+    // instances[i]); each prototype's own BVH follows it in the same arrays.
+    // Infinite planes have no bounds and are tested separately.
+    std::vector<GPUBVHNode> bvhNodes;
+    std::vector<int> bvhPrimIndices;
+    std::vector<int> planeIndices;
+
+    // One entry per stream object (unused for spheres and planes) plus the
+    // polyhedron face planes they reference
+    std::vector<GPUObjectTransform> objectTransforms;
+    std::vector<glm::vec4> convexPlanes;
+
+    // Triangle meshes, one per distinct file, shared by every object that
+    // names it. Vertices and indices of all meshes are concatenated, with
+    // indices already offset to the mesh's first vertex. Each mesh BVH lives
+    // in meshNodes; its leaves cover contiguous triangles, so unlike bvhNodes
+    // it needs no primitive index list.
+    std::vector<SceneMesh> meshes;
+    std::vector<glm::vec3> meshVertices;
+    std::vector<int> meshIndices;
+    std::vector<GPUBVHNode> meshNodes;
+
+    // Mesh file path → meshes index
+    std::map<std::string, int> meshMap;
     
     // Material name → GPU buffer index mapping
     std::map<std::string, int> materialMap;
+
+    // Objects in the per-object streams (scene objects, then prototype objects)
+    size_t streamObjectCount() const { return objects.size() + prototypeObjects.size(); }
+    const SceneObject& streamObject(size_t i) const {
+        return i < objects.size() ? objects[i] : prototypeObjects[i - objects.size()];
+    }
 };
 
 class SceneBuilder {
 public:
     // Convert SceneConfig → GPU-ready data
     static SceneData buildScene(const SceneConfig& config);
+
+    // Parses and builds a scene file in a single streaming pass (see
+    // SceneLoader::streamFromFile): every material and object is converted
+    // as soon as it is read, so neither a JSON DOM nor the ObjectConfig list
+    // exists for the whole scene. config receives the settings only. Applies
+    // the same checks as validate(); on failure errorMsg says why.
+    static bool buildSceneFromFile(const std::string& filepath, SceneConfig& config, SceneData& sceneData,
+                                   std::string& errorMsg);
+
+    // The two halves of buildSceneFromFile. parseSceneFile leaves the
+    // materials, objects, prototypes, instances and light flags as authored,
+    // with mesh files registered but not loaded and no derived arrays;
+    // completeScene loads the meshes and builds the rest.
+    static bool parseSceneFile(const std::string& filepath, SceneConfig& config, SceneData& sceneData,
+                               std::string& errorMsg);
+    static bool completeScene(SceneData& sceneData, std::string& errorMsg);
     
+    // (Re)build objectGeometry/objectTypes/objectMaterials from the stream objects
+    static void packObjects(SceneData& sceneData);
+
+    // (Re)build bvhNodes/bvhPrimIndices/planeIndices and the prototype root
+    // nodes from the stream objects and instanceTransforms
+    static void buildAccelerationStructure(SceneData& sceneData);
+
+    // (Re)build objectTransforms/convexPlanes from the stream objects
+    static void buildObjectTransforms(SceneData& sceneData);
+
+    // Loads every mesh file registered in meshMap that is not loaded yet
+    // and sets the bounding radius of the objects using it. Files are parsed
+    // and their BVHs built one at a time, each on all threads. Meshes that
+    // fail to load stay empty and are never hit; errorMsg names the first
+    // failure.
+    static bool loadMeshes(SceneData& sceneData, std::string& errorMsg);
+
+    // (Re)build instanceTransforms from sceneData.instances
+    static void buildInstanceTransforms(SceneData& sceneData);
+
+    // (Re)build lightTable from objects, instances, materials and lightIndices
+    static void buildLightTable(SceneData& sceneData);
+
+    // World-space bounds of a finite object (not valid for planes); meshes
+    // must be loaded
+    static AABB computeObjectBounds(const SceneObject& obj, const std::vector<SceneMesh>& meshes);
+
+    // Single entries of the arrays above, shared by the full builds and
+    // SceneEditor's in-place edits.
+    // objectGeometry entry of one object
+    static glm::vec4 packGeometry(const SceneObject& obj);
+    // SceneObject::radius implied by type, scale and mesh (spheres keep theirs)
+    static float boundingRadius(const SceneObject& obj, const std::vector<SceneMesh>& meshes);
+    // objectTransforms entry of a non-sphere, non-plane object; polyhedron
+    // face planes are appended to planes
+    static GPUObjectTransform buildObjectTransform(const SceneObject& obj, const std::vector<SceneMesh>& meshes,
+                                                   std::vector<glm::vec4>& planes);
+    // instanceTransforms entry of one instance
+    static GPUInstance buildInstanceTransform(const SceneInstance& inst, int rootNode);
+    // World-space box around a prototype-space box placed by an instance
+    static AABB transformBounds(const AABB& local, const GPUInstance& xf);
+
     // Validate scene (check for missing materials, etc.)
     static bool validate(const SceneConfig& config, std::string& errorMsg);
     
 private:
+    // Converts one object and appends it to sceneData.objects, or to
+    // prototypeObjects; isLight objects also go into lightIndices. Mesh
+    // files are only registered in meshMap here (see loadMeshes).
+    static void appendObject(SceneData& sceneData, const ObjectConfig& objConfig, int matIndex,
+                             bool prototype = false);
+
+    // Adds the prototypes and expands the instance entries (generators) into
+    // sceneData.instances. Must run after every scene object and material
+    // has been added; fails on unknown prototype or material names.
+    static bool buildInstances(const std::vector<PrototypeConfig>& prototypeConfigs,
+                               const std::vector<InstanceConfig>& instanceConfigs,
+                               SceneData& sceneData, std::string& errorMsg);
+
+    // Derived data (streams, transforms, BVH, light table) once objects are in
+    static void finishScene(SceneData& sceneData);
+
     static std::map<std::string, int> buildMaterialMap(
         const std::vector<MaterialConfig>& materialConfigs,
         std::vector<GPUMaterial>& gpuMaterials
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "SceneBuilder.h"
+#include "SceneConfig.h"
+
+// Compiled scenes (.rpscene). Building a scene resolves material names,
+// packs the object streams and builds the BVH, transforms and light table,
+// which dominates startup for generated scenes with many objects. The built
+// SceneData is written next to the JSON and reused for as long as the JSON's
+// bytes, and those of every mesh file it names, hash the same.
+//
+// The file is a 64-byte header, a table of sections and the raw arrays of
+// SceneData (16-byte aligned, host byte order). It is memory mapped and
+// each array copied out in one block. Bump SCENE_CACHE_VERSION whenever
+// SceneBuilder's output or the layout of any cached struct changes.
+
+constexpr uint32_t SCENE_CACHE_VERSION = 4;
+
+// FNV-1a over a file's bytes; 0 if it cannot be read
+uint64_t hashSceneFile(const std::string& path);
+// hashSceneFile() of scenePath combined with that of every mesh file in
+// sceneData.meshMap; the JSON's hash alone when the scene has no meshes
+uint64_t hashSceneSources(const std::string& scenePath, const SceneData& sceneData);
+
+class SceneCache {
+public:
+    // scenes/foo.json -> scenes/foo.rpscene
+    static std::string cachePathFor(const std::string& scenePath);
+
+    // false if the cache is missing, from another version, or was built
+    // from a source or mesh file with a different hash
+    static bool load(const std::string& cachePath, uint64_t sourceHash, SceneData& sceneData);
+
+    static bool save(const std::string& cachePath, uint64_t sourceHash, const SceneData& sceneData);
+
+    // Loads scenePath into config and sceneData. config.materials and
+    // config.objects always stay empty: with a current cache only the
+    // settings are parsed from the JSON, otherwise the scene is streamed
+    // through SceneBuilder::buildSceneFromFile and the cache rewritten.
+    // Prints the reason on failure.
+    static bool loadScene(const std::string& scenePath, SceneConfig& config, SceneData& sceneData);
+};
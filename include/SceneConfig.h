@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <vector>
@@ -18,12 +19,16 @@ struct CameraConfig {
 
     float aperture = 0.0f;
     float focusDist = 10.0f;
+
+    bool operator==(const CameraConfig&) const = default;
 };
 
 // Sky/environment configuration
 struct SkyConfig {
     glm::vec3 colorTop = glm::vec3(0.5f, 0.7f, 1.0f);
     glm::vec3 colorBottom = glm::vec3(0.98f, 0.98f, 0.98f);
+
+    bool operator==(const SkyConfig&) const = default;
 };
 
 // Render settings
@@ -32,17 +37,46 @@ struct BloomConfig {
     float threshold = 1.0f;
     float knee = 0.5f;
     float intensity = 0.3f;
-    int iterations = 4;
-    float downscale = 0.5f;
+    int iterations = 4;       // mip pyramid levels, each doubling the blur radius
+    float downscale = 0.5f;   // size of the first level relative to the render
+
+    bool operator==(const BloomConfig&) const = default;
+};
+
+// Per-pixel early termination once the relative standard error of the
+// luminance mean drops below threshold
+struct AdaptiveConfig {
+    bool enabled = false;
+    float threshold = 0.02f;
+    int minSamples = 64;
+    int maxBoost = 4;        // max samplesPerFrame multiplier for noisy pixels
+
+    bool operator==(const AdaptiveConfig&) const = default;
+};
+
+// Where the kernel's random numbers come from (random.glsl)
+enum class SamplerType {
+    Pcg = 0,       // independent white noise per pixel and frame
+    Sobol = 1,     // Owen-scrambled Sobol, indexed by sample number and dimension
+    BlueNoise = 2  // Sobol shifted per pixel by a blue-noise mask
 };
 
 struct RenderConfig {
     int width = 1600;
     int height = 900;
     int samplesPerFrame = 8;
+    // Viewer: retune samplesPerFrame every frame so path tracing takes about
+    // targetFrameMs of GPU time; samplesPerFrame is where it starts
+    bool autoSamples = false;
+    float targetFrameMs = 16.0f;
     int maxSamples = 5000;
     int maxBounces = 8;
+    int lightSamples = 1;    // NEE light picks per non-specular hit
+    bool wavefront = false;  // split-kernel pipeline (wavefront.h) instead of the megakernel
+    SamplerType sampler = SamplerType::Pcg;
+    uint32_t seed = 0;       // decorrelates renders of the same scene
     BloomConfig bloom;
+    AdaptiveConfig adaptive;
 };
 
 // Material definition from file
@@ -98,6 +132,44 @@ struct ObjectConfig {
     glm::vec3 rotation = glm::vec3(0.0f); // Euler angles
     glm::vec3 size = glm::vec3(1.0f);     // Box extents / dimensions
     float height = 1.0f;                  // Cylinder/Cone/Prism height
+
+    // Mesh only: OBJ or binary PLY file (relative paths are resolved
+    // against the scene file's directory) and its scale
+    std::string file;
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Named group of objects authored around its own origin. Instances place
+// copies of it; its objects are stored and intersected only once.
+struct PrototypeConfig {
+    std::string name;
+    std::vector<ObjectConfig> objects;  // planes are not allowed
+};
+
+// How one "instances" entry expands into placed copies
+enum class InstanceGenerator {
+    Single,   // one instance at position
+    Grid,     // gridCount copies spaced by spacing, centred on position
+    Ring,     // count copies on a circle of radius around the Y axis through position
+    Scatter   // count copies at random in the box position +- extent
+};
+
+struct InstanceConfig {
+    std::string prototype;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);   // Euler angles, applied to every copy
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    InstanceGenerator generator = InstanceGenerator::Single;
+    glm::ivec3 gridCount = glm::ivec3(1);
+    glm::vec3 spacing = glm::vec3(1.0f);
+    int count = 1;
+    float radius = 1.0f;
+    bool orient = true;                     // Ring: turn each copy to face outward
+    glm::vec3 extent = glm::vec3(1.0f);
+    glm::vec3 rotationJitter = glm::vec3(0.0f); // Scatter: +- degrees added per axis
+    glm::vec2 scaleRange = glm::vec2(1.0f);     // Scatter: uniform scale factor range
+    uint32_t seed = 1;                          // Scatter
 };
 
 // Top-level scene structure
@@ -108,4 +180,6 @@ struct SceneConfig {
     RenderConfig render;
     std::vector<MaterialConfig> materials;
     std::vector<ObjectConfig> objects;
+    std::vector<PrototypeConfig> prototypes;
+    std::vector<InstanceConfig> instances;
 };
\ No newline at end of file
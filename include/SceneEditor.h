@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "SceneBuilder.h"
+
+// Span of array entries touched since the last upload; empty when last < first
+struct DirtyRange {
+    int first = 0;
+    int last = -1;
+
+    void add(const int index) {
+        if (empty()) first = last = index;
+        else {
+            first = std::min(first, index);
+            last = std::max(last, index);
+        }
+    }
+    bool empty() const { return last < first; }
+    size_t count() const { return empty() ? 0 : static_cast<size_t>(last - first + 1); }
+};
+
+// Everything SceneEditor::commit changed in SceneData. Ranges index the
+// SceneData arrays of the same name; one span per array, so two edits far
+// apart upload everything between them.
+struct SceneEdits {
+    DirtyRange objects;            // objectGeometry, objectMaterials (types never change)
+    DirtyRange objectTransforms;
+    DirtyRange convexPlanes;
+    DirtyRange materials;
+    DirtyRange instanceTransforms;
+    DirtyRange bvhNodes;
+    bool lightTable = false;       // rebuilt; its size may have changed
+    bool visible = false;          // the image changes, so accumulation must restart
+
+    bool empty() const {
+        return objects.empty() && objectTransforms.empty() && convexPlanes.empty() && materials.empty() &&
+               instanceTransforms.empty() && bvhNodes.empty() && !lightTable;
+    }
+};
+
+// Edits a built scene in place. Each change rewrites only the entries of the
+// kernel arrays it affects, and commit() refits the BVH bounds above moved
+// objects and instances instead of rebuilding it, so node order, primitive
+// order and every other array stay as built. Quality degrades as objects
+// move far from where they were built; rebuild (SceneBuilder) when it
+// matters.
+//
+// Objects keep their type and mesh, planes stay planes. Setters return
+// whether anything changed; setting a value an object already has is free.
+class SceneEditor {
+public:
+    // sceneData must outlive the editor and not be rebuilt under it
+    explicit SceneEditor(SceneData& sceneData);
+
+    // Stream object index (scene objects, then prototype objects). Center,
+    // rotation, scale, radius (spheres), normal and distance (planes) and
+    // materialIndex are taken from obj; the bounding radius of non-spheres
+    // is derived from scale as when the scene is built.
+    bool setObject(size_t index, const SceneObject& obj);
+    bool setMaterial(size_t index, const GPUMaterial& material);
+    // Position, rotation and scale; the prototype stays
+    bool setInstance(size_t index, const SceneInstance& instance);
+
+    // Refits the BVH, rebuilds the light table if an emitter's power
+    // changed and returns what to upload. Clears the pending edits.
+    SceneEdits commit();
+
+private:
+    SceneData& scene;
+    SceneEdits pending;
+
+    // Built once from the BVH: parent of every node (-1 for roots), the leaf
+    // holding each stream object and instance, the prototype whose root a
+    // node is, the prototype of each prototype object and the instances of
+    // each prototype
+    std::vector<int> nodeParent;
+    std::vector<int> objectLeaf;
+    std::vector<int> instanceLeaf;
+    std::vector<int> rootPrototype;
+    std::vector<int> objectPrototype;
+    std::vector<std::vector<int>> prototypeInstances;
+
+    std::vector<int> dirtyLeaves;
+
+    // Edits to prototypes nobody instances are not on screen
+    bool objectVisible(size_t index) const;
+    bool materialVisible(int index) const;
+    bool emits(int materialIndex) const;
+
+    void markLeaf(int node);
+    AABB leafBounds(const GPUBVHNode& leaf) const;
+    void refit();
+};
@@ -1,13 +1,36 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <optional>
 #include "SceneConfig.h"
 
+// Receives each material / object / prototype / instance entry of a scene
+// file as soon as it has been parsed, in file order. An empty callback skips
+// that array entirely.
+struct SceneStreamCallbacks {
+    std::function<void(const MaterialConfig&)> onMaterial;
+    std::function<void(const ObjectConfig&)> onObject;
+    std::function<void(const PrototypeConfig&)> onPrototype;
+    std::function<void(const InstanceConfig&)> onInstance;
+};
+
 class SceneLoader {
 public:
     // Load scene from file
     static std::optional<SceneConfig> loadFromFile(const std::string& filepath);
+
+    // Like loadFromFile, but the "materials", "objects", "prototypes" and
+    // "instances" arrays are skipped while parsing; used when the built scene
+    // comes from a .rpscene cache
+    static std::optional<SceneConfig> loadSettingsFromFile(const std::string& filepath);
     
+    // Parses a scene file with a SAX parser instead of a DOM. The returned
+    // config holds the settings only; the array entries are handed to the
+    // callbacks one at a time, so memory stays bounded by the largest
+    // single element however large the file is
+    static std::optional<SceneConfig> streamFromFile(const std::string& filepath,
+                                                     const SceneStreamCallbacks& callbacks);
+
     // Load from JSON string (for testing)
     static std::optional<SceneConfig> loadFromString(const std::string& jsonString);
     
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SceneBuilder.h"
+#include "SceneConfig.h"
+
+// A new version of the watched scene file
+struct SceneReload {
+    SceneConfig config;
+
+    // rebuilt == false: the scene as parsed (SceneBuilder::parseSceneFile),
+    // with the same materials, objects and instances as before; only the
+    // listed entries differ from the previous version of the file. Apply them
+    // with SceneEditor (stream object indices, see SceneData::streamObject).
+    // rebuilt == true: objects were added, removed or retyped, so this is the
+    // complete scene, built on the watcher thread, to replace the current one.
+    SceneData scene;
+    bool rebuilt = false;
+    std::vector<size_t> changedMaterials;
+    std::vector<size_t> changedObjects;
+    std::vector<size_t> changedInstances;
+};
+
+// Watches a scene file on a background thread: inotify on its directory on
+// Linux (so editors that save by renaming are seen), the modification time
+// elsewhere. Saves that change the file's bytes are parsed and compared with
+// the previous version on that thread, and built there too when the
+// structure changed (rewriting the .rpscene cache), so the render thread
+// only applies the result. Mesh files are not watched.
+class SceneWatcher {
+public:
+    // current is the scene loaded from scenePath; its materials, objects and
+    // instances are what the first save is compared against
+    SceneWatcher(const std::string& scenePath, const SceneData& current);
+    ~SceneWatcher();
+
+    SceneWatcher(const SceneWatcher&) = delete;
+    SceneWatcher& operator=(const SceneWatcher&) = delete;
+
+    // The reload not yet taken, if any. A reload that is not taken before
+    // the next one is merged into it.
+    std::optional<SceneReload> poll();
+
+private:
+    std::string path;
+    std::string fileName;
+    SceneData previous;        // authored parts of the last version
+    uint64_t previousHash = 0;
+
+    int notifyFd = -1;         // inotify instance, -1 when polling
+    std::filesystem::file_time_type lastWrite;
+
+    std::mutex mutex;
+    std::optional<SceneReload> ready;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    void run();
+    // Blocks for at most ~200 ms; true if the file may have changed
+    bool waitForChange();
+    void reload(uint64_t hash);
+};
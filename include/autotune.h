@@ -0,0 +1,22 @@
+#pragma once
+
+// Frame budgeting for the viewer. Costs are GPU milliseconds of path tracing
+// per sample per pixel of a frame (GpuFrameTimer::msPerFrameSample), so they
+// already reflect the pixels and tiles that still render and their boosts;
+// 0 means not measured yet.
+
+// Most samples per pixel a single frame may take
+constexpr int MAX_SAMPLES_PER_FRAME = 1024;
+// Longest a single dispatch may run before the next one is submitted, well
+// below the driver watchdog (2 s on Windows)
+constexpr double MAX_SUBMISSION_MS = 50.0;
+
+// samplesPerFrame for the next frame so that its dispatch takes about
+// targetMs. Grows at most 2x per frame, since the rate lags a few frames
+// behind; shrinks at once, so a heavy view never stalls the UI for long.
+// Stays put within 10% of the target.
+int tuneSamplesPerFrame(int current, double msPerFrameSample, double targetMs);
+
+// Number of row bands to split a dispatch of samplesPerFrame into, each
+// predicted to take at most MAX_SUBMISSION_MS
+int dispatchBandCount(int samplesPerFrame, double msPerFrameSample);
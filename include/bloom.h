@@ -0,0 +1,61 @@
+#pragma once
+#include <glad/gl.h>
+
+#include "SceneConfig.h"
+
+class GpuProfiler;
+
+struct BloomFrameResult {
+    GLuint textureId = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Compute-shader bloom over a mip pyramid (shaders/bloom_*.glsl). The
+// thresholded bloom radiance is filtered into mip 0 at downscale x the
+// source size, then halved level by level with a 13-tap downsample and
+// recombined bottom-up with a tent upsample, so every level adds a blur twice
+// as wide as the previous one. Both chains are immutable RGBA16F textures
+// that are only reallocated when the size or the level count changes.
+class BloomPipeline {
+public:
+    BloomPipeline();
+    ~BloomPipeline();
+
+    BloomPipeline(const BloomPipeline&) = delete;
+    BloomPipeline& operator=(const BloomPipeline&) = delete;
+
+    // false if any of the bloom shaders failed to compile
+    bool isValid() const { return valid; }
+
+    // config.iterations is the number of pyramid levels. Returns an empty
+    // result when bloom is disabled or the pipeline is not valid. With a
+    // profiler, the prefilter and every pyramid level are timed as zones.
+    BloomFrameResult apply(const BloomConfig& config, GLuint sourceTexture, int sourceWidth, int sourceHeight,
+                           GpuProfiler* profiler = nullptr);
+
+private:
+    void ensureChains(int width, int height, int levels);
+
+    bool valid = false;
+
+    GLuint prefilterProgram = 0;
+    GLuint downsampleProgram = 0;
+    GLuint upsampleProgram = 0;
+    GLuint mipSampler = 0;
+
+    GLuint downChain = 0;
+    GLuint upChain = 0;
+    int chainWidth = 0;
+    int chainHeight = 0;
+    int chainLevels = 0;
+
+    GLint prefilterTexelSizeLoc = -1;
+    GLint prefilterThresholdLoc = -1;
+    GLint prefilterKneeLoc = -1;
+    GLint downsampleLevelLoc = -1;
+    GLint upsampleCoarseLevelLoc = -1;
+    GLint upsampleDetailLevelLoc = -1;
+    GLint upsampleRadiusLoc = -1;
+    GLint upsampleScaleLoc = -1;
+};
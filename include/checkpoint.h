@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <glad/gl.h>
+
+#include "SceneCache.h"
+
+// Progressive-render checkpoints (.rpck). The file is a fixed 64-byte header
+// followed by the raw RGBA32F contents of the accumulation, bloom
+// accumulation and adaptive-moment textures, row 0 at the bottom, so it can
+// be read or mapped without any decoding. Writes go to a temporary file that
+// replaces the previous checkpoint only once complete.
+
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+struct CheckpointHeader {
+    char magic[4];            // "RPCK"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameCount;      // next frame to dispatch; seeds the RNG
+    uint32_t samplesPerFrame;
+    uint64_t sceneHash;       // hashSceneSources() of the scene that was rendered
+    uint32_t samplesPerPixel; // frameCount * samplesPerFrame (informational)
+    uint32_t layerCount;
+    uint32_t reserved[6];
+};
+static_assert(sizeof(CheckpointHeader) == 64, "checkpoint header must stay 64 bytes");
+
+struct CheckpointTextures {
+    GLuint accum;
+    GLuint accumBloom;
+    GLuint moment;
+    GLuint output;            // rebuilt from accum on load
+    GLuint outputBloom;
+};
+
+bool saveCheckpoint(const std::string& path, const CheckpointHeader& header, const CheckpointTextures& textures);
+
+// Uploads a checkpoint into textures of width x height. Fails if the size,
+// the samples per frame (frameCount counts frames of that many samples) or
+// the scene hash does not match; on success header holds the stored state.
+bool loadCheckpoint(const std::string& path, int width, int height, int samplesPerFrame, uint64_t sceneHash,
+                    const CheckpointTextures& textures, CheckpointHeader& header);
+
+CheckpointHeader makeCheckpointHeader(int width, int height, uint32_t frameCount, int samplesPerFrame, uint64_t sceneHash);
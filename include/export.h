@@ -1,5 +1,55 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <glad/gl.h>
 
 void saveToEXR(GLuint texture, int width, int height, const char* filename);
-const char* generateTimestampedFilename(const char* prefix, const char* extension);
\ No newline at end of file
+// rgba holds width * height RGBA floats with row 0 at the bottom (OpenGL order)
+void savePixelsToEXR(const float* rgba, int width, int height, const char* filename);
+const char* generateTimestampedFilename(const char* prefix, const char* extension);
+
+// Non-blocking alternative to saveToEXR for use inside the frame loop.
+// request() queues a texture -> PBO copy and a fence and returns immediately;
+// poll() (once per frame) hands finished copies to a worker thread, which
+// flips, converts to half and writes the EXR straight from the persistently
+// mapped buffer. All GL calls stay on the thread that owns the context.
+class AsyncEXRExporter {
+public:
+    AsyncEXRExporter();
+    ~AsyncEXRExporter();
+
+    void request(GLuint texture, int width, int height, const char* filename);
+    void poll();
+    // Blocks until every requested snapshot has been written
+    void flush();
+
+    size_t pendingCount() const { return snapshots.size(); }
+
+private:
+    struct Snapshot {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        const float* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        std::string filename;
+        bool queued = false;
+        std::atomic<bool> written{false};
+    };
+
+    void workerLoop();
+
+    std::vector<std::unique_ptr<Snapshot>> snapshots;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<Snapshot*> encodeQueue;
+    bool stopping = false;
+    std::thread worker;
+};
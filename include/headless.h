@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "SceneBuilder.h"
+#include "SceneConfig.h"
+
+struct HeadlessOptions {
+    std::string scenePath;
+    std::string outPath;    // empty: timestamped raypulse_*.exr
+    int spp = -1;           // <= 0: render.maxSamples from the scene
+    int width = -1;         // <= 0: render.width from the scene
+    int height = -1;        // <= 0: render.height from the scene
+    bool progress = true;   // print per-frame progress to stdout
+    std::string checkpointPath;      // non-empty: write a checkpoint every checkpointInterval seconds
+    double checkpointInterval = 300.0;
+    std::string resumePath;          // non-empty: continue from this checkpoint
+    bool keepImage = false;          // read the output back into HeadlessRenderStats::image
+};
+
+struct HeadlessRenderStats {
+    int width = 0;
+    int height = 0;
+    int frames = 0;
+    int samplesPerPixel = 0;
+    double seconds = 0.0;   // dispatch loop wall time, each frame waited on with glFinish
+    std::vector<glm::vec4> image;   // with keepImage: output texture, row 0 at the bottom
+};
+
+// Parses the arguments following `raypulse render`:
+//   <scene.json> [--spp N] [--out file.exr] [--width W] [--height H]
+//                [--checkpoint file.rpck] [--checkpoint-interval S] [--resume file.rpck]
+// --resume without --checkpoint keeps checkpointing to the resumed file.
+bool parseHeadlessArgs(int argc, char** argv, HeadlessOptions& options);
+void printHeadlessUsage(const char* exe);
+
+// Creates a windowless EGL context (surfaceless platform, pbuffer fallback),
+// dispatches the compute kernel until the sample budget is reached and writes
+// the output texture to an EXR. No GLFW window, ImGui or UI framebuffer is
+// created. Returns the process exit code.
+int runHeadlessRender(const HeadlessOptions& options);
+
+// Building blocks of runHeadlessRender, shared with raypulse-bench.
+// openHeadlessContext() makes the EGL context current and loads GL.
+bool openHeadlessContext();
+void closeHeadlessContext();
+
+// Renders with the current context; writes an EXR only if options.outPath is set
+bool renderHeadless(const SceneConfig& sceneConfig, const SceneData& sceneData, const HeadlessOptions& options,
+                    HeadlessRenderStats* stats);
@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+
+// One timed stage of a frame. Times are in nanoseconds: CPU times on
+// std::chrono::steady_clock, GPU times on the GL_TIMESTAMP clock.
+struct ProfileZone {
+    std::string name;
+    int depth = 0;             // nesting level, 0 for top-level zones
+    int64_t cpuBegin = 0;
+    int64_t cpuEnd = 0;
+    int64_t gpuBegin = 0;
+    int64_t gpuEnd = 0;
+};
+
+struct ProfileFrame {
+    uint64_t index = 0;
+    int64_t cpuBegin = 0;
+    int64_t cpuEnd = 0;
+    std::vector<ProfileZone> zones;
+};
+
+// Smoothed timings of one zone; zones with the same name in a frame add up
+struct ProfileSummary {
+    std::string name;
+    int depth = 0;
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+    uint64_t lastFrame = 0;    // index of the last resolved frame that ran it
+};
+
+// Per-stage GPU and CPU timings of the frame loop. Every zone writes a
+// GL_TIMESTAMP query at its start and end (glQueryCounter), so zones can nest
+// and overlap other queries. Queries go into one pool per frame in flight;
+// a frame's pool is read once GL_QUERY_RESULT_AVAILABLE says its last query
+// is done, a few frames later, so profiling never waits for the GPU. When
+// the driver runs further behind than there are pools, another pool is
+// added; past MAX_POOLS frames in flight the oldest frame is dropped.
+//
+// Resolved frames are kept for the last HISTORY_FRAMES frames and can be
+// written as a Chrome trace (chrome://tracing, Perfetto).
+class GpuProfiler {
+public:
+    static constexpr size_t MAX_POOLS = 16;
+    static constexpr size_t HISTORY_FRAMES = 600;
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Brackets one iteration of the frame loop; beginFrame also reads the
+    // pools of earlier frames that have finished
+    void beginFrame();
+    void endFrame();
+
+    // Zones must end in reverse order of their start (see ProfileScope).
+    // Outside a frame they are ignored.
+    int beginZone(std::string name);
+    void endZone(int zone);
+
+    // Exponential averages over the resolved frames. Zones stay listed for
+    // a while after they stop running (the UI is not drawn every frame).
+    const std::vector<ProfileSummary>& summary() const { return summaries; }
+    double frameCpuMs() const { return frameCpu; }
+    double frameGpuMs() const { return frameGpu; }
+    size_t droppedFrames() const { return dropped; }
+    size_t historySize() const { return history.size(); }
+
+    // Chrome trace_event JSON of the history: CPU and GPU zones on two
+    // threads of one process, on the CPU clock
+    bool saveTrace(const char* filename);
+
+private:
+    struct Pool {
+        ProfileFrame frame;
+        std::vector<GLuint> queries;   // begin and end timestamp of each zone
+        bool pending = false;
+    };
+
+    void resolve();
+    bool tryResolve(Pool& pool);
+    void record(ProfileFrame& frame);
+    void calibrate();
+
+    // A ring: pools[current] is the one being recorded or the oldest
+    std::vector<Pool> pools;
+    size_t current = 0;
+    bool inFrame = false;
+    uint64_t frameIndex = 0;
+    std::vector<int> openZones;
+
+    std::deque<ProfileFrame> history;
+    std::vector<ProfileSummary> summaries;
+    double frameCpu = 0.0;
+    double frameGpu = 0.0;
+    size_t dropped = 0;
+
+    // steady_clock minus GL_TIMESTAMP, in nanoseconds
+    int64_t gpuToCpu = 0;
+};
+
+// GPU time of the path-tracing dispatch, measured without waiting for it: a
+// ring of GL_TIME_ELAPSED queries collected once GL_QUERY_RESULT_AVAILABLE is
+// set, usually a few frames later.
+//
+// Each timed frame carries its samples per pixel (frameSamples), so the time
+// per unit of it over the last WINDOW finished frames predicts the next frame
+// with the same tiles and boosts in play. The sample rate instead uses the
+// pixel samples the kernels counted (FrameCounts), which arrive separately:
+// the average count of the last WINDOW read frames over the average time.
+class GpuFrameTimer {
+public:
+    static constexpr size_t QUERY_COUNT = 8;
+    static constexpr size_t WINDOW = 32;
+
+    GpuFrameTimer();
+    ~GpuFrameTimer();
+
+    GpuFrameTimer(const GpuFrameTimer&) = delete;
+    GpuFrameTimer& operator=(const GpuFrameTimer&) = delete;
+
+    // Starts timing a frame. When every query is still in flight the frame
+    // is not timed and end() does nothing.
+    void begin(int frameSamples);
+    void end();
+    // Collects finished queries; call once per frame
+    void poll();
+    // Pixel samples a finished frame rendered, as counted on the GPU
+    void addRenderedSamples(double samples);
+
+    // 0 until the first frame has been timed (and counted)
+    double averageMs() const;
+    double msPerFrameSample() const;
+    double samplesPerSecond() const;
+
+private:
+    struct Timing {
+        double ms = 0.0;
+        double frameSamples = 0.0;
+    };
+
+    GLuint queries[QUERY_COUNT] = {};
+    double queryFrameSamples[QUERY_COUNT] = {};
+    size_t oldest = 0;      // first query in flight
+    size_t inFlight = 0;
+    bool timing = false;
+
+    std::deque<Timing> window;
+    double windowMs = 0.0;
+    double windowFrameSamples = 0.0;
+
+    std::deque<double> counted;
+    double countedSamples = 0.0;
+};
+
+// Times the enclosing block as a zone; a null profiler times nothing
+class ProfileScope {
+public:
+    ProfileScope(GpuProfiler* profiler, std::string name)
+        : owner(profiler), zone(profiler ? profiler->beginZone(std::move(name)) : -1) {}
+    ~ProfileScope() {
+        if (owner) owner->endZone(zone);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    GpuProfiler* owner;
+    int zone;
+};
@@ -1,9 +1,11 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
 #include "material.h"
+#include "BVH.h"
 
 struct QuadVertex {
     glm::vec2 position;
@@ -33,55 +35,135 @@ enum ObjectType {
     OBJ_TETRAHEDRON = 6,
     OBJ_PRISM = 7,
     OBJ_DODECAHEDRON = 8,
-    OBJ_ICOSAHEDRON = 9
+    OBJ_ICOSAHEDRON = 9,
+    OBJ_MESH = 10
 };
 
-struct GPUObject {
-    glm::vec4 data1;
-    glm::vec4 data2;
-    glm::vec4 data3;
-    glm::vec4 data4;
+// An object as authored. SceneBuilder::packObjects splits these into the
+// per-object streams the kernels read (SceneData::objectGeometry etc.).
+struct SceneObject {
+    int type = OBJ_SPHERE;
+    int materialIndex = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;                  // Spheres: radius; others: bounding radius
+    glm::vec3 rotation = glm::vec3(0.0f); // Euler angles, see buildRotationMatrix
+    glm::vec3 scale = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);   // Planes only
+    float distance = 0.0f;                // Planes only
+    int mesh = -1;                        // Meshes only: index into SceneData::meshes
 };
 
-inline GPUObject makeObject(int type, glm::vec3 center, glm::vec3 rot, glm::vec3 scale, int matIdx) {
-    GPUObject obj{};
-    obj.data1 = glm::vec4(center, glm::length(scale));
-    obj.data2 = glm::vec4(rot, static_cast<float>(matIdx));
-    obj.data3 = glm::vec4(scale, static_cast<float>(type));
+inline SceneObject makeObject(int type, glm::vec3 center, glm::vec3 rot, glm::vec3 scale, int matIdx) {
+    SceneObject obj;
+    obj.type = type;
+    obj.materialIndex = matIdx;
+    obj.center = center;
+    obj.radius = glm::length(scale);
+    obj.rotation = rot;
+    obj.scale = scale;
     return obj;
 }
 
-inline GPUObject makeSphere(const glm::vec3 center, const float radius, const int matIndex = 0) {
-    GPUObject obj{};
-    obj.data1 = glm::vec4(center, radius);
-    obj.data2 = glm::vec4(static_cast<float>(matIndex), 0.0f, 0.0f, static_cast<float>(OBJ_SPHERE));
-    // FIX: Ensure data3 is populated so the shader knows the radius!
-    obj.data3 = glm::vec4(radius, radius, radius, static_cast<float>(OBJ_SPHERE));
+inline SceneObject makeSphere(const glm::vec3 center, const float radius, const int matIndex = 0) {
+    SceneObject obj;
+    obj.type = OBJ_SPHERE;
+    obj.materialIndex = matIndex;
+    obj.center = center;
+    obj.radius = radius;
+    obj.scale = glm::vec3(radius);
     return obj;
 }
 
-inline GPUObject makePlane(const glm::vec3 normal, float dist, int matIndex = 0) {
-    GPUObject obj{};
-    obj.data1 = glm::vec4(normal, dist);
-    obj.data2 = glm::vec4(static_cast<float>(matIndex), 0.0f, 0.0f, static_cast<float>(OBJ_PLANE));
+inline SceneObject makePlane(const glm::vec3 normal, float dist, int matIndex = 0) {
+    SceneObject obj;
+    obj.type = OBJ_PLANE;
+    obj.materialIndex = matIndex;
+    obj.normal = normal;
+    obj.distance = dist;
     return obj;
 }
 
-class SceneBuffer {
-public:
-    SceneBuffer();
-    ~SceneBuffer();
-    void update(const std::vector<GPUObject>& objects) const;
-    void bind(GLuint bindingPoint) const;
-private:
-    GLuint ssbo{};
+// A named group of objects authored around its own origin. Its objects are
+// SceneData::prototypeObjects[firstObject .. firstObject + objectCount) and
+// are intersected through instances with their own BVH rooted at rootNode.
+struct ScenePrototype {
+    int firstObject = 0;
+    int objectCount = 0;
+    int rootNode = -1;                   // in SceneData::bvhNodes, set by buildAccelerationStructure
+};
+
+// Triangle mesh loaded from one file, shared by every object that names it.
+// Its triangles are SceneData::meshIndices[3 * firstTriangle ..) in the leaf
+// order of its BVH, which is rooted at meshNodes[rootNode].
+struct SceneMesh {
+    int firstTriangle = 0;
+    int triangleCount = 0;
+    int firstVertex = 0;
+    int vertexCount = 0;
+    int rootNode = -1;                   // -1 if the file failed to load
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// One placed copy of a prototype: scale, then rotate, then translate
+struct SceneInstance {
+    int prototype = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f); // Euler angles, see buildRotationMatrix
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Rigid transform of a cylinder, cone, box or polyhedron, precomputed by
+// SceneBuilder so intersection never evaluates sin/cos (std430, 112 bytes).
+// Matches `ObjectTransform` in hittable.glsl. For each row r:
+//   local[r] = dot(worldToLocal[r].xyz, p) + worldToLocal[r].w
+// Meshes also carry their scale in the transform, so local space is the
+// space of the mesh file.
+struct GPUObjectTransform {
+    glm::vec4 worldToLocal[3];
+    glm::vec4 localToWorld[3]; // xyz: rotation rows (normals; meshes: rotation * scale), w: translation
+    int planeOffset;           // Polyhedra: first entry in SceneData::convexPlanes
+    int planeCount;
+    int meshRoot;              // Meshes: root of the mesh BVH in SceneData::meshNodes, -1 if empty
+    int _pad1;
+};
+
+// Affine placement of an instance (std430, 112 bytes). Matches
+// `ObjectInstance` in hittable.glsl. Rays are moved into prototype space with
+// worldToLocal without renormalising the direction, so hit distances are the
+// same in both spaces.
+struct GPUInstance {
+    glm::vec4 worldToLocal[3];
+    glm::vec4 localToWorld[3]; // xyz: rows of rotation * scale, w: translation
+    int rootNode;              // BVH of the prototype, in SceneData::bvhNodes
+    float maxScale;            // largest axis scale, grows light bounding spheres
+    int _pad0;
+    int _pad1;
 };
 
+// Alias-table entry for power-weighted light selection (std430, 32 bytes).
+// Slot i keeps itself with probability aliasProb, otherwise defers to alias;
+// pdf is the overall probability of picking this light. Emitters inside
+// prototypes get one entry per instance.
+struct GPULight {
+    int objIndex;
+    int matIndex;
+    int alias;
+    float aliasProb;
+    float pdf;
+    int instance;              // -1 for objects placed directly in the scene
+    float _pad[2];
+};
+
+// Scene buffers: update() reallocates and uploads the whole array;
+// updateRange() rewrites entries [first, first + count) in place with
+// glBufferSubData and needs the size set by the last update().
 class MaterialBuffer {
 public:
     MaterialBuffer();
     ~MaterialBuffer();
     void update(const std::vector<GPUMaterial>& materials) const;
+    void updateRange(const std::vector<GPUMaterial>& materials, size_t first, size_t count) const;
     void bind(GLuint bindingPoint) const;
 private:
     GLuint ssbo{};
@@ -97,6 +179,119 @@ private:
     GLuint ssbo{};
 };
 
+class BVHBuffer {
+public:
+    BVHBuffer();
+    ~BVHBuffer();
+    void update(const std::vector<GPUBVHNode>& nodes) const;
+    void updateRange(const std::vector<GPUBVHNode>& nodes, size_t first, size_t count) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+class TransformBuffer {
+public:
+    TransformBuffer();
+    ~TransformBuffer();
+    void update(const std::vector<GPUObjectTransform>& transforms) const;
+    void updateRange(const std::vector<GPUObjectTransform>& transforms, size_t first, size_t count) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+    void update(const std::vector<GPUInstance>& instances) const;
+    void updateRange(const std::vector<GPUInstance>& instances, size_t first, size_t count) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+// Plain vec4 array (object geometry, polyhedron face planes)
+class Vec4Buffer {
+public:
+    Vec4Buffer();
+    ~Vec4Buffer();
+    void update(const std::vector<glm::vec4>& values) const;
+    void updateRange(const std::vector<glm::vec4>& values, size_t first, size_t count) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+// Tightly packed vec3 array, read as float[] by the kernel (mesh vertices)
+class Vec3Buffer {
+public:
+    Vec3Buffer();
+    ~Vec3Buffer();
+    void update(const std::vector<glm::vec3>& values) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+class LightTableBuffer {
+public:
+    LightTableBuffer();
+    ~LightTableBuffer();
+    void update(const std::vector<GPULight>& lights) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
+// AdaptiveStats (binding 7 in main.glsl and wf_accumulate.glsl), counted
+// with atomics over one frame
+typedef struct{
+    GLuint activePixels;      // pixels that still want samples after the frame
+    GLuint renderedSamples;   // pixel samples traced, boosts included
+} FrameCounts;
+
+// FrameCounts written by the kernels
+class CounterBuffer {
+public:
+    CounterBuffer();
+    ~CounterBuffer();
+    void reset() const;
+    // Waits for every kernel that writes the counters
+    FrameCounts read() const;
+    void bind(GLuint bindingPoint) const;
+
+    // Non-blocking read: queueRead() copies the counters into a slot of a
+    // persistently mapped ring behind a fence, pollRead() returns the oldest
+    // copy that has landed and the tag it was queued with; call it until it
+    // returns false. A copy still in flight when its slot comes round again
+    // is discarded.
+    void queueRead(uint64_t tag);
+    bool pollRead(FrameCounts& counts, uint64_t& tag);
+private:
+    static constexpr int READBACK_SLOTS = 4;
+
+    GLuint ssbo{};
+    GLuint readback{};
+    const FrameCounts* readbackValues = nullptr;
+    GLsync readbackFences[READBACK_SLOTS] = {};
+    uint64_t readbackTags[READBACK_SLOTS] = {};
+    int nextReadback = 0;
+};
+
+// Plain int array (BVH primitive order, plane list, object types, ...)
+class IndexBuffer {
+public:
+    IndexBuffer();
+    ~IndexBuffer();
+    void update(const std::vector<int>& indices) const;
+    void updateRange(const std::vector<int>& indices, size_t first, size_t count) const;
+    void bind(GLuint bindingPoint) const;
+private:
+    GLuint ssbo{};
+};
+
 typedef struct{
     int width, height;
 } RaytracerDimensions;
@@ -117,6 +312,18 @@ typedef struct{
     glm::vec3 colorBottom;
 } SkyParams;
 
+typedef struct{
+    bool enabled;
+    float threshold;
+    int minSamples;
+    int maxBoost;
+} AdaptiveParams;
+
+typedef struct{
+    int type;          // SamplerType
+    uint32_t seed;
+} SamplerParams;
+
 typedef struct{
     bool enabled;
     float threshold;
@@ -126,9 +333,103 @@ typedef struct{
     float downscale;
 } BloomParams;
 
+// Camera, sky, scene-size and sampling parameters shared by every
+// path-tracing kernel (std140, 160 bytes). Matches the `FrameConstants`
+// uniform block in frame.glsl; each vec3 shares its 16 bytes with the scalar
+// after it.
+struct GPUFrameConstants {
+    glm::vec3 cameraOrigin;
+    float cameraFOV;
+    glm::vec3 cameraForward;
+    float aperture;
+    glm::vec3 cameraRight;
+    float focusDist;
+    glm::vec3 cameraUp;
+    uint32_t frameCount;
+    glm::vec3 skyColorTop;
+    int samplesPerFrame;
+    glm::vec3 skyColorBottom;
+    int maxTotalSamples;
+    glm::vec2 resolution;
+    uint32_t maxBounces;
+    int lightCount;
+    int lightTableSize;
+    int lightSamples;
+    int objectCount;
+    int planeCount;
+    int bvhNodeCount;
+    int adaptiveEnabled;
+    float adaptiveThreshold;
+    int adaptiveMinSamples;
+    int adaptiveMaxBoost;
+    int samplerType;
+    uint32_t samplerSeed;
+    int _pad0;
+};
+static_assert(sizeof(GPUFrameConstants) == 160, "GPUFrameConstants must match the std140 FrameConstants block");
+
+// Uniform block binding of FrameConstants
+constexpr GLuint FRAME_CONSTANTS_BINDING = 0;
+// SSBO binding of the blue-noise mask (blueNoiseRanks() in sampler.h)
+constexpr GLuint BLUE_NOISE_BINDING = 22;
+// Explicit uniform locations in main.glsl
+constexpr GLint DISPATCH_OFFSET_LOCATION = 0;
+constexpr GLint TILE_SCHEDULE_LOCATION = 1;
+constexpr GLint PRIORITY_TILES_LOCATION = 2;
+constexpr GLint PRIORITY_BOOST_LOCATION = 3;
+// Pixels per side of a megakernel workgroup
+constexpr int TILE_SIZE = 16;
+
+// FrameConstants storage: three slots of one persistently mapped buffer, so
+// the constants of a frame are written while the GPU may still read the
+// previous two. update() waits (normally not at all) for the slot written
+// three updates ago, copies the constants and binds the slot.
+class FrameConstantsBuffer {
+public:
+    static constexpr int SLOTS = 3;
+
+    FrameConstantsBuffer();
+    ~FrameConstantsBuffer();
+
+    FrameConstantsBuffer(const FrameConstantsBuffer&) = delete;
+    FrameConstantsBuffer& operator=(const FrameConstantsBuffer&) = delete;
+
+    void update(const GPUFrameConstants& constants);
+private:
+    GLuint ubo{};
+    GLsizeiptr slotStride = 0;
+    char* mapped = nullptr;
+    GLsync fences[SLOTS] = {};
+    int slot = 0;
+};
+
+GPUFrameConstants makeFrameConstants(
+    RaytracerDimensions raytracer_dimensions, const CameraParams& camera_params, const SkyParams& sky_params,
+    AdaptiveParams adaptive_params, SamplerParams sampler_params,
+    size_t objectCount, int lightCount,
+    int planeCount, int bvhNodeCount,
+    int lightTableSize, int lightSamples,
+    int samplesPerFrame, int maxTotalSamples, uint32_t maxBounces);
+
+// Euler XYZ in degrees, composed as Rz * Ry * Rx
+glm::mat3 buildRotationMatrix(const glm::vec3& rotEuler);
+
+void calculateBasisFromEuler(float pitch, float yaw, float roll,
+                             glm::vec3& forward, glm::vec3& right, glm::vec3& up);
+
+// One megakernel frame. The frame's constants must already be in the bound
+// FrameConstants slot (FrameConstantsBuffer::update); `frame` is the same
+// data, read on the host for the dispatch size. bands > 1 splits the image
+// into that many row bands of whole 16x16 tiles, each flushed as its own
+// submission, so no single dispatch runs long enough to hit the driver
+// watchdog.
 void dispatchComputeShader(GLuint program,
     GLuint accumTexture, GLuint outputTexture,
     GLuint accumBloom, GLuint outputBloom,
-    RaytracerDimensions raytracer_dimensions, CameraParams camera_params, SkyParams sky_params,
-    size_t objectCount, int lightCount,
-    int samplesPerFrame, int maxTotalSamples, uint32_t maxBounces);
\ No newline at end of file
+    GLuint momentTexture,
+    const GPUFrameConstants& frame, int bands = 1);
+
+// Dispatches the bound megakernel over tilesX x tilesY tiles starting at
+// tile (firstX, firstY), in up to `bands` bands of tile rows with a flush
+// between them. Sets dispatchOffset.
+void dispatchTileRows(int firstX, int firstY, int tilesX, int tilesY, int bands);
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "SceneConfig.h"
+
+// "pcg", "sobol" and "bluenoise", as written in the render block
+const char* samplerTypeName(SamplerType type);
+// false, leaving type alone, for an unknown name
+bool parseSamplerType(const std::string& name, SamplerType& type);
+
+// Side of the blue-noise mask used by SamplerType::BlueNoise; matches
+// BLUE_NOISE_SIZE in random.glsl
+constexpr int BLUE_NOISE_SIZE = 64;
+
+// Void-and-cluster dither mask (Ulichney 1993) of BLUE_NOISE_SIZE^2 texels,
+// row-major: the rank 0 .. N-1 of each texel. The texels below any rank
+// form a blue-noise point set, and the mask tiles seamlessly. Built on the
+// first call (about 0.1 s) and shared afterwards.
+const std::vector<int>& blueNoiseRanks();
@@ -7,4 +7,5 @@ GLuint compileShader(GLenum type, const GLchar* source);
 GLuint compileShaderFromFile(GLenum type, const char* filepath);
 GLuint createShaderProgram(const GLchar* vertexSource, const GLchar* fragmentSource);
 GLuint createShaderProgramFromFiles(const char* vertPath, const char* fragPath);
-GLuint createComputeProgramFromBinary(const char* binaryPath);
\ No newline at end of file
+GLuint createComputeProgramFromBinary(const char* binaryPath);
+GLuint createComputeProgramFromFile(const char* sourcePath);
@@ -0,0 +1,74 @@
+#pragma once
+#include <glad/gl.h>
+
+#include "renderer.h"
+
+// Tiles [minX, maxX) x [minY, maxY) rendered before the rest of the frame
+// with `boost` times the samples; none when empty
+struct PriorityRegion {
+    int minX = 0;
+    int minY = 0;
+    int maxX = 0;
+    int maxY = 0;
+    int boost = 1;
+
+    bool empty() const { return maxX <= minX || maxY <= minY; }
+};
+
+// Megakernel frames over the tiles that still want samples. The kernel
+// appends every tile with a pixel left to render to a list in an SSBO
+// (tiles.glsl); the next frame dispatches only the listed tiles with
+// glDispatchComputeIndirect, sized on the GPU by tile_prepare.glsl, so
+// converged tiles stop launching and nothing is read back. The first frame
+// after invalidate(), or after the image size or the convergence criteria
+// changed, renders the whole grid to rebuild the list.
+//
+// A priority region is dispatched first, as its own grid, with more samples
+// per pixel, so it converges ahead of the rest of the image.
+class TileScheduler {
+public:
+    static constexpr int MAX_BANDS = 16;
+
+    TileScheduler();
+    ~TileScheduler();
+
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    // false if tile_prepare.spv failed to load
+    bool isValid() const { return valid; }
+
+    // The accumulation restarted, or another pipeline rendered frames the
+    // lists did not see; the next dispatch renders every tile
+    void invalidate() { rebuild = true; }
+
+    // Same contract as dispatchComputeShader(); binding 21 is used here.
+    // bands splits the listed tiles into up to MAX_BANDS submissions.
+    void dispatch(GLuint program,
+        GLuint accumTexture, GLuint outputTexture,
+        GLuint accumBloom, GLuint outputBloom,
+        GLuint momentTexture,
+        const GPUFrameConstants& frame, int bands,
+        const PriorityRegion& priority);
+
+private:
+    void ensureCapacity(int tileCount);
+    bool criteriaChanged(const GPUFrameConstants& frame);
+
+    bool valid = false;
+    GLuint prepareProgram = 0;
+    GLint readListLocation = -1;
+    GLint bandCountLocation = -1;
+
+    GLuint scheduleBuffer = 0;
+    int tileCapacity = 0;
+    GLuint readList = 0;
+    // The lists do not describe the current image; render every tile
+    bool rebuild = true;
+
+    // What decides whether a pixel still wants samples
+    int maxTotalSamples = 0;
+    int adaptiveEnabled = 0;
+    float adaptiveThreshold = 0.0f;
+    int adaptiveMinSamples = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <glad/gl.h>
+
+#include "renderer.h"
+
+// Alternative to the megakernel (main.glsl) that splits a path into
+// generate / extend / shade / subsurface / shadow / accumulate kernels
+// (shaders/compute/wf_*.glsl). Paths live in an SSBO and move between the
+// stages through index queues; queue lengths are kept with atomics and turned
+// into glDispatchComputeIndirect sizes on the GPU, so a frame never reads back.
+//
+// Each bounce runs every stage once, so warps only ever execute one kind of
+// work. The image is processed in chunks of up to pathCapacity pixels to cap
+// the path-state memory. Adaptive sampling stops converged pixels but does
+// not redistribute their samples (no per-tile boost).
+class WavefrontPipeline {
+public:
+    WavefrontPipeline();
+    ~WavefrontPipeline();
+
+    // false if any of the wf_*.spv kernels failed to load
+    bool isValid() const { return valid; }
+
+    // Same contract as dispatchComputeShader(): one frame of samplesPerFrame
+    // samples into the accumulation images. The scene SSBOs (1-10, 15-20),
+    // AdaptiveStats (7) and the frame's FrameConstants must already be bound;
+    // bindings 11-14 are used here.
+    void dispatch(GLuint accumTexture, GLuint outputTexture,
+        GLuint accumBloom, GLuint outputBloom,
+        GLuint momentTexture,
+        const GPUFrameConstants& frame);
+
+private:
+    // Locations of the per-dispatch uniforms of one kernel, resolved once;
+    // -1 where the kernel does not use them
+    struct KernelUniforms {
+        GLint pathCapacity = -1;
+        GLint chunkOffset = -1;
+        GLint chunkSize = -1;
+        GLint queueParity = -1;
+        GLint bounceIndex = -1;
+        GLint sampleIndex = -1;
+        GLint prepareStage = -1;
+    };
+
+    struct Kernel {
+        GLuint program = 0;
+        KernelUniforms uniforms;
+    };
+
+    void ensureCapacity(int pixelCount, int neeSamples);
+    void runPrepare(int stage, GLuint queueParity) const;
+
+    bool valid = false;
+
+    Kernel generate;
+    Kernel extend;
+    Kernel shade;
+    Kernel medium;
+    Kernel shadow;
+    Kernel accumulate;
+    Kernel prepare;
+
+    GLuint pathBuffer = 0;
+    GLuint queueBuffer = 0;
+    GLuint counterBuffer = 0;
+    GLuint shadowRayBuffer = 0;
+
+    int pathCapacity = 0;
+    int shadowRaysPerPath = 0;
+    int allocatedPixels = 0;
+};
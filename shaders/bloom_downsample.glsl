@@ -0,0 +1,47 @@
+#version 460 core
+// One step down the bloom pyramid (level N -> N+1, half resolution) with the
+// 13-tap filter from bloom_prefilter.glsl. The 20x20 source texels behind an
+// 8x8 tile of outputs are fetched once into shared memory; each output then
+// reads its 36 texels from there instead of issuing 13 bilinear fetches.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rgba16f, binding = 0) uniform writeonly image2D destImage;
+
+uniform sampler2D sourceTexture;
+uniform int sourceLevel;
+
+const int TILE_SIZE = 20; // 2 * 8 outputs + 2 texels of apron on each side
+
+shared vec3 tile[TILE_SIZE][TILE_SIZE];
+
+// Mean of the 2x2 source texels starting at tile coordinate p
+vec3 box(ivec2 p) {
+    return 0.25 * (tile[p.y][p.x] + tile[p.y][p.x + 1] + tile[p.y + 1][p.x] + tile[p.y + 1][p.x + 1]);
+}
+
+void main() {
+    ivec2 sourceSize = textureSize(sourceTexture, sourceLevel);
+    ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * 16 - 2;
+
+    for (uint idx = gl_LocalInvocationIndex; idx < uint(TILE_SIZE * TILE_SIZE); idx += 64u) {
+        ivec2 t = ivec2(int(idx) % TILE_SIZE, int(idx) / TILE_SIZE);
+        ivec2 texel = clamp(tileOrigin + t, ivec2(0), sourceSize - 1);
+        tile[t.y][t.x] = texelFetch(sourceTexture, texel, sourceLevel).rgb;
+    }
+    barrier();
+
+    ivec2 dest = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(dest, imageSize(destImage)))) return;
+
+    // Tile coordinate of source texel 2 * dest
+    ivec2 p = ivec2(gl_LocalInvocationID.xy) * 2 + 2;
+
+    // The bilinear taps of the 13-tap pattern are exactly these 2x2 boxes
+    vec3 inner = box(p + ivec2(-1, -1)) + box(p + ivec2(1, -1)) + box(p + ivec2(-1, 1)) + box(p + ivec2(1, 1));
+    vec3 corners = box(p + ivec2(-2, -2)) + box(p + ivec2(2, -2)) + box(p + ivec2(-2, 2)) + box(p + ivec2(2, 2));
+    vec3 edges = box(p + ivec2(0, -2)) + box(p + ivec2(-2, 0)) + box(p + ivec2(2, 0)) + box(p + ivec2(0, 2));
+    vec3 color = inner * 0.125 + corners * 0.03125 + edges * 0.0625 + box(p) * 0.125;
+
+    imageStore(destImage, dest, vec4(color, 1.0));
+}
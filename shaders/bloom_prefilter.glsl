@@ -0,0 +1,65 @@
+#version 460 core
+// First level of the bloom pyramid: soft-knee threshold of the bloom
+// radiance, filtered down to the top mip with a 13-tap bilinear pattern so
+// single-pixel highlights do not shimmer as the image converges.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rgba16f, binding = 0) uniform writeonly image2D destImage;
+
+uniform sampler2D sourceTexture;
+uniform vec2 sourceTexelSize;
+uniform float bloomThreshold;
+uniform float bloomKnee;
+
+vec3 thresholdColor(vec3 color) {
+    float brightness = max(max(abs(color.r), abs(color.g)), abs(color.b));
+
+    // Standard soft-knee curve calculation
+    float softKnee = max(bloomThreshold * bloomKnee, 0.0);
+    float kneeStart = bloomThreshold - softKnee;
+
+    float contribution = 0.0;
+    if (brightness > bloomThreshold) {
+        contribution = brightness - bloomThreshold;
+    } else if (brightness > kneeStart && softKnee > 0.0) {
+        float soft = brightness - kneeStart;
+        contribution = (soft * soft) / (4.0 * softKnee);
+    }
+
+    return color * (contribution / max(brightness, 1e-5));
+}
+
+vec3 tap(vec2 uv, vec2 offset) {
+    return thresholdColor(textureLod(sourceTexture, uv + offset * sourceTexelSize, 0.0).rgb);
+}
+
+void main() {
+    ivec2 dest = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 destSize = imageSize(destImage);
+    if (any(greaterThanEqual(dest, destSize))) return;
+
+    vec2 uv = (vec2(dest) + 0.5) / vec2(destSize);
+
+    vec3 a = tap(uv, vec2(-2.0, -2.0));
+    vec3 b = tap(uv, vec2( 0.0, -2.0));
+    vec3 c = tap(uv, vec2( 2.0, -2.0));
+    vec3 d = tap(uv, vec2(-1.0, -1.0));
+    vec3 e = tap(uv, vec2( 1.0, -1.0));
+    vec3 f = tap(uv, vec2(-2.0,  0.0));
+    vec3 g = tap(uv, vec2( 0.0,  0.0));
+    vec3 h = tap(uv, vec2( 2.0,  0.0));
+    vec3 i = tap(uv, vec2(-1.0,  1.0));
+    vec3 j = tap(uv, vec2( 1.0,  1.0));
+    vec3 k = tap(uv, vec2(-2.0,  2.0));
+    vec3 l = tap(uv, vec2( 0.0,  2.0));
+    vec3 m = tap(uv, vec2( 2.0,  2.0));
+
+    vec3 color = (d + e + i + j) * 0.125
+               + (a + b + f + g) * 0.03125
+               + (b + c + g + h) * 0.03125
+               + (f + g + k + l) * 0.03125
+               + (g + h + l + m) * 0.03125;
+
+    imageStore(destImage, dest, vec4(color, 1.0));
+}
@@ -0,0 +1,40 @@
+#version 460 core
+// One step up the bloom pyramid: a 3x3 tent filter over the coarser
+// (already accumulated) level, added to the downsampled level of the same
+// size. Repeating this from the smallest mip widens the blur by a factor of
+// two per level.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rgba16f, binding = 0) uniform writeonly image2D destImage;
+
+uniform sampler2D coarseTexture;
+uniform int coarseLevel;
+uniform sampler2D detailTexture;
+uniform int detailLevel;
+uniform float filterRadius;
+uniform float outputScale;
+
+void main() {
+    ivec2 dest = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 destSize = imageSize(destImage);
+    if (any(greaterThanEqual(dest, destSize))) return;
+
+    vec2 uv = (vec2(dest) + 0.5) / vec2(destSize);
+    vec2 r = filterRadius / vec2(textureSize(coarseTexture, coarseLevel));
+    float lod = float(coarseLevel);
+
+    vec3 color = textureLod(coarseTexture, uv, lod).rgb * 4.0;
+    color += (textureLod(coarseTexture, uv + vec2(-r.x, 0.0), lod).rgb
+            + textureLod(coarseTexture, uv + vec2( r.x, 0.0), lod).rgb
+            + textureLod(coarseTexture, uv + vec2(0.0, -r.y), lod).rgb
+            + textureLod(coarseTexture, uv + vec2(0.0,  r.y), lod).rgb) * 2.0;
+    color += textureLod(coarseTexture, uv + vec2(-r.x, -r.y), lod).rgb
+           + textureLod(coarseTexture, uv + vec2( r.x, -r.y), lod).rgb
+           + textureLod(coarseTexture, uv + vec2(-r.x,  r.y), lod).rgb
+           + textureLod(coarseTexture, uv + vec2( r.x,  r.y), lod).rgb;
+    color *= 1.0 / 16.0;
+
+    color += texelFetch(detailTexture, dest, detailLevel).rgb;
+    imageStore(destImage, dest, vec4(color * outputScale, 1.0));
+}
@@ -1,19 +1,2 @@
-// Viewport Resolution
-uniform vec2 resolution;
-
-// Camera Basis Vectors
-uniform vec3 cameraOrigin;
-uniform vec3 cameraForward;
-uniform vec3 cameraRight;
-uniform vec3 cameraUp;
-uniform float cameraFOV;
-
-uniform float aperture;
-uniform float focusDist;
-
-uniform uint frameCount;
-uniform int samplesPerFrame;
-uniform int maxTotalSamples;
-uniform uint maxBounces;
-
-uniform int lightCount;
+// Camera and sampling parameters are members of the FrameConstants block
+#include "frame.glsl"
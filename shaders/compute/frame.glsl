@@ -0,0 +1,35 @@
+#ifndef FRAME_GLSL
+#define FRAME_GLSL
+
+// Camera, sky, scene-size and sampling parameters, written once per frame by
+// the host. Matches GPUFrameConstants in renderer.h.
+layout(std140, binding = 0) uniform FrameConstants {
+    vec3 cameraOrigin;
+    float cameraFOV;
+    vec3 cameraForward;
+    float aperture;
+    vec3 cameraRight;
+    float focusDist;
+    vec3 cameraUp;
+    uint frameCount;
+    vec3 skyColorTop;
+    int samplesPerFrame;
+    vec3 skyColorBottom;
+    int maxTotalSamples;
+    vec2 resolution;       // viewport resolution
+    uint maxBounces;
+    int lightCount;
+    int lightTableSize;
+    int lightSamples;
+    int objectCount;
+    int planeCount;
+    int bvhNodeCount;
+    int adaptiveEnabled;
+    float adaptiveThreshold;
+    int adaptiveMinSamples;
+    int adaptiveMaxBoost;
+    int samplerType;       // SAMPLER_* in random.glsl
+    uint samplerSeed;
+};
+
+#endif
@@ -1,3 +1,5 @@
+#include "frame.glsl"
+
 // --- CONSTANTS ---
 #define TYPE_SPHERE 0
 #define TYPE_PLANE 1
@@ -9,6 +11,7 @@
 #define TYPE_PRISM 7
 #define TYPE_DODECAHEDRON 8
 #define TYPE_ICOSAHEDRON 9
+#define TYPE_MESH 10
 
 #define INFINITY 10000.0
 #define PI 3.1415926535
@@ -20,36 +23,119 @@ struct HitRecord {
     bool frontFace;
     int matIndex;
     int objIndex;
+    int instIndex;   // instance the object was reached through, -1 if none
+};
+
+// Per-object streams built by SceneBuilder::packObjects. Intersection reads
+// only geometry and type; the material index is fetched for the closest hit.
+//   sphere: center, radius   plane: unit normal, distance   others: scale, bounding radius
+layout(std430, binding = 1) readonly buffer ObjectGeometryBuffer {
+    vec4 objectGeometry[];
 };
 
-struct GPUObject {
-    vec4 data1; // Center(xyz), BoundingRadius(w)
-    vec4 data2; // Rotation(xyz), Material(w)
-    vec4 data3; // Scale(xyz), Type(w)
-    vec4 data4; // Padding
+layout(std430, binding = 15) readonly buffer ObjectTypeBuffer {
+    int objectTypes[];
 };
 
-layout(std430, binding = 1) readonly buffer SceneBuffer {
-    GPUObject objects[];
+layout(std430, binding = 16) readonly buffer ObjectMaterialBuffer {
+    int objectMaterials[];
 };
 
 layout(std430, binding = 3) readonly buffer LightBuffer {
     int lightIndices[];
 };
 
-uniform int objectCount;
+// Power-weighted alias table over all emitters, built by SceneBuilder
+struct LightEntry {
+    int objIndex;
+    int matIndex;
+    int alias;      // Taken when the slot's coin flip exceeds aliasProb
+    float aliasProb;
+    float pdf;      // Probability of selecting this light
+    int instIndex;  // -1 unless the emitter belongs to a prototype
+    float _pad0; float _pad1;
+};
 
+layout(std430, binding = 8) readonly buffer LightTableBuffer {
+    LightEntry lightTable[];
+};
+
+// SAH BVHs built by SceneBuilder. Node 0 is the root of the top level over
+// all finite objects and instances; leaf entries >= 0 are objects, -1 - i is
+// instance i. Every prototype's BVH follows in the same buffers.
+struct BVHNode {
+    vec3 boundsMin; int leftFirst; // Interior: left child index; Leaf: first primIndices entry
+    vec3 boundsMax; int count;     // 0 for interior nodes
+};
+
+layout(std430, binding = 4) readonly buffer BVHBuffer {
+    BVHNode bvhNodes[];
+};
+
+layout(std430, binding = 5) readonly buffer PrimIndexBuffer {
+    int primIndices[];
+};
+
+// Infinite planes can't be bounded, so they live in their own list
+layout(std430, binding = 6) readonly buffer PlaneBuffer {
+    int planeIndices[];
+};
+
+// Per-object rigid transform for cylinders, cones, boxes, polyhedra and
+// meshes. local = vec3(dot(worldToLocal[r].xyz, p) + worldToLocal[r].w) for
+// each row r. Meshes also carry their scale here.
+struct ObjectTransform {
+    vec4 worldToLocal[3];
+    vec4 localToWorld[3];  // xyz: rotation rows for normals, w: translation
+    int planeOffset;       // Polyhedra: first entry in convexPlanes
+    int planeCount;
+    int meshRoot;          // Meshes: root in meshNodes, -1 if not loaded
+    int _pad1;
+};
+
+layout(std430, binding = 9) readonly buffer TransformBuffer {
+    ObjectTransform objectTransforms[];
+};
+
+// Local-space face planes of every polyhedron, already scaled
+layout(std430, binding = 10) readonly buffer ConvexPlaneBuffer {
+    vec4 convexPlanes[];
+};
+
+// Placement of a prototype. The ray is moved into prototype space with
+// worldToLocal and its direction is not renormalised, so hit distances are
+// the same in both spaces.
+struct ObjectInstance {
+    vec4 worldToLocal[3];
+    vec4 localToWorld[3];  // xyz: rows of rotation * scale, w: translation
+    int rootNode;          // prototype BVH in bvhNodes
+    float maxScale;
+    int _pad0; int _pad1;
+};
+
+layout(std430, binding = 17) readonly buffer InstanceBuffer {
+    ObjectInstance instances[];
+};
+
+// Triangle meshes, all files in shared buffers. Vertices are packed xyz
+// floats; indices are absolute, three per triangle. Each mesh's BVH is in
+// meshNodes, with leaf leftFirst the first triangle of the leaf.
+layout(std430, binding = 18) readonly buffer MeshVertexBuffer {
+    float meshVertices[];
+};
+
+layout(std430, binding = 19) readonly buffer MeshIndexBuffer {
+    int meshIndices[];
+};
+
+layout(std430, binding = 20) readonly buffer MeshNodeBuffer {
+    BVHNode meshNodes[];
+};
+
+// BVH_MAX_DEPTH in BVH.h: the builder keeps every leaf within the stack
+#define BVH_STACK_SIZE 64
+#define BVH_MISS 1e30
 
-mat3 buildRotationMatrix(vec3 rotEuler) {
-    vec3 rad = radians(rotEuler);
-    float cx = cos(rad.x), sx = sin(rad.x);
-    float cy = cos(rad.y), sy = sin(rad.y);
-    float cz = cos(rad.z), sz = sin(rad.z);
-    mat3 rx = mat3(1, 0, 0, 0, cx, sx, 0, -sx, cx);
-    mat3 ry = mat3(cy, 0, -sy, 0, 1, 0, sy, 0, cy);
-    mat3 rz = mat3(cz, sz, 0, -sz, cz, 0, 0, 0, 1);
-    return rz * ry * rx;
-}
 
 bool solveQuadratic(float a, float b, float c, out float t0, out float t1) {
     float disc = b*b - 4.0*a*c;
@@ -62,9 +148,9 @@ bool solveQuadratic(float a, float b, float c, out float t0, out float t1) {
 
 // --- PRIMITIVES ---
 
-bool hitSphere(GPUObject obj, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
-    vec3 center = obj.data1.xyz;
-    float radius = obj.data1.w;
+bool hitSphere(vec4 sphere, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
+    vec3 center = sphere.xyz;
+    float radius = sphere.w;
     vec3 oc = rayOrigin - center;
     float a = dot(rayDir, rayDir);
     float b = 2.0 * dot(oc, rayDir);
@@ -82,15 +168,13 @@ bool hitSphere(GPUObject obj, vec3 rayOrigin, vec3 rayDir, float tMin, float tMa
     vec3 outwardNormal = (rec.p - center) / radius;
     rec.frontFace = dot(rayDir, outwardNormal) < 0.0;
     rec.normal = rec.frontFace ? outwardNormal : -outwardNormal;
-
-    rec.matIndex = int(obj.data2.x);  // ← FIXED: Read from .x, not .w
     return true;
 }
 
 
-bool hitPlane(GPUObject obj, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
-    vec3 normal = normalize(obj.data1.xyz);
-    float dist = obj.data1.w;
+bool hitPlane(vec4 plane, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
+    vec3 normal = plane.xyz;
+    float dist = plane.w;
     float denom = dot(normal, rayDir);
     if (abs(denom) > 1e-6) {
         float t = -(dot(rayOrigin, normal) + dist) / denom;
@@ -99,9 +183,6 @@ bool hitPlane(GPUObject obj, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax
             rec.p = rayOrigin + t * rayDir;
             rec.frontFace = denom < 0.0;
             rec.normal = rec.frontFace ? normal : -normal;
-
-            // --- FIX: ASSIGN MATERIAL ---
-            rec.matIndex = int(obj.data2.w);
             return true;
         }
     }
@@ -208,149 +289,45 @@ bool hitLocalCone(vec3 ro, vec3 rd, vec3 scale, float tMin, float tMax, out floa
     return false;
 }
 
-bool intersectConvexPlanes(vec3 ro, vec3 rd, vec3 scale, int type, float tMin, float tMax, out float tOut, out vec3 nOut) {
-    float t0 = -1e6;
-    float t1 = 1e6;
-
-    vec3 n0 = vec3(0.0);
-    vec3 n1 = vec3(0.0);
-
-    if (type == TYPE_CUBE) {
-        vec3 rad = scale;
-        vec3 m = 1.0 / rd;
-        vec3 n = m * ro;
-        vec3 k = abs(m) * rad;
-        vec3 t_1 = -n - k;
-        vec3 t_2 = -n + k;
-
-        float tN = max(max(t_1.x, t_1.y), t_1.z);
-        float tF = min(min(t_2.x, t_2.y), t_2.z);
-
-        if (tN > tF || tF < 0.0) return false;
-
-        float t = tN;
-        if (t <= tMin) t = tF;
-        if (t <= tMin || t >= tMax) return false;
-
-        tOut = t;
-        vec3 p = ro + rd * tOut;
-        vec3 s = sign(p);
-        vec3 a = abs(p) / rad;
+bool hitLocalBox(vec3 ro, vec3 rd, vec3 scale, float tMin, float tMax, out float tOut, out vec3 nOut) {
+    vec3 rad = scale;
+    vec3 m = 1.0 / rd;
+    vec3 n = m * ro;
+    vec3 k = abs(m) * rad;
+    vec3 t_1 = -n - k;
+    vec3 t_2 = -n + k;
 
-        if (a.x > a.y && a.x > a.z) nOut = vec3(s.x, 0, 0);
-        else if (a.y > a.z)         nOut = vec3(0, s.y, 0);
-        else                        nOut = vec3(0, 0, s.z);
-        return true;
-    }
+    float tN = max(max(t_1.x, t_1.y), t_1.z);
+    float tF = min(min(t_2.x, t_2.y), t_2.z);
 
-    vec4 planes[20];
-    int count = 0;
-    float s = scale.x; // Radius / Scale
-
-    if (type == TYPE_TETRAHEDRON) {
-        // Distance to face = s / 3.0
-        float d = s / 3.0;
-        float k = 0.577350269; // 1/sqrt(3)
-        planes[0] = vec4( k, k, k, d);
-        planes[1] = vec4( k,-k,-k, d);
-        planes[2] = vec4(-k, k,-k, d);
-        planes[3] = vec4(-k,-k, k, d);
-        count = 4;
-    }
-    else if (type == TYPE_PYRAMID) {
-        // Square Pyramid (1x1 base, height 1)
-        // Base is at y = -0.5*s, Apex at y = 0.5*s
-
-        // Base plane (pointing down)
-        planes[0] = vec4(0, -1, 0, s * 0.5);
-
-        // Side planes
-        // Normal slope = 2.0 (rise/run) -> normalized: (0.8944, 0.4472)
-        float ny = 0.4472136;
-        float nx = 0.8944271;
-        // For a unit pyramid (base width 1, height 1), distance is 1/sqrt(5) ~ 0.4472 * (s/2)
-        // Adjusted for scale 's' being full width/height
-        float d = (s * 0.5) * nx; // ~ 0.447 * s
-
-        planes[1] = vec4( nx, ny, 0, d);
-        planes[2] = vec4(-nx, ny, 0, d);
-        planes[3] = vec4( 0, ny, nx, d);
-        planes[4] = vec4( 0, ny,-nx, d);
-        count = 5;
-    }
-    else if (type == TYPE_PRISM) {
-        float h = scale.y * 0.5;
-        float r = scale.x * 0.5;
+    if (tN > tF || tF < 0.0) return false;
 
-        // Top/Bottom caps
-        planes[0] = vec4(0,  1, 0, h);
-        planes[1] = vec4(0, -1, 0, h);
+    float t = tN;
+    if (t <= tMin) t = tF;
+    if (t <= tMin || t >= tMax) return false;
 
-        // Sides (Equilateral triangle)
-        float d = scale.x * 0.5;
+    tOut = t;
+    vec3 p = ro + rd * tOut;
+    vec3 s = sign(p);
+    vec3 a = abs(p) / rad;
 
-        planes[2] = vec4(0, 0, 1, d); // Front face
+    if (a.x > a.y && a.x > a.z) nOut = vec3(s.x, 0, 0);
+    else if (a.y > a.z)         nOut = vec3(0, s.y, 0);
+    else                        nOut = vec3(0, 0, s.z);
+    return true;
+}
 
-        // Rotated faces (+- 120 deg)
-        float kx = 0.866025; // sin(60)
-        float kz = 0.5;      // cos(60)
+// Polyhedra: intersect the object's cached local-space planes (xyz = normal, w = distance)
+bool intersectConvexPlanes(vec3 ro, vec3 rd, int planeOffset, int count, float tMin, float tMax, out float tOut, out vec3 nOut) {
+    float t0 = -1e6;
+    float t1 = 1e6;
 
-        // Back-right: normal ( kx, 0, -kz)
-        // Back-left:  normal (-kx, 0, -kz)
-        planes[3] = vec4( kx, 0, -kz, d);
-        planes[4] = vec4(-kx, 0, -kz, d);
-        count = 5;
-    }
-    else if (type == TYPE_DODECAHEDRON) {
-
-        float G = 1.61803398875; // Golden Ratio
-        float k1 = 1.0 / sqrt(1.0 + G*G); // 0.52573111
-        float k2 = G * k1;                // 0.85065080
-
-        float d = s * 1.0;
-
-        // 12 Faces
-        planes[0] = vec4(0, k1, k2, d);  planes[1] = vec4(0, -k1, k2, d);
-        planes[2] = vec4(0, k1,-k2, d);  planes[3] = vec4(0, -k1,-k2, d);
-        planes[4] = vec4(k2, 0, k1, d);  planes[5] = vec4(k2, 0, -k1, d);
-        planes[6] = vec4(-k2,0, k1, d);  planes[7] = vec4(-k2,0, -k1, d);
-        planes[8] = vec4(k1, k2, 0, d);  planes[9] = vec4(k1, -k2, 0, d);
-        planes[10]= vec4(-k1,k2, 0, d);  planes[11]= vec4(-k1,-k2, 0, d);
-        count = 12;
-    }
-    else if (type == TYPE_ICOSAHEDRON) {
-        // 20 faces.
-
-        float G = 1.61803398875;
-        // Normals (same as Dodecahedron vertices normalized)
-
-        float d = s * 1.0;
-
-        float n_a = 0.35682208;
-        float n_b = 0.93417235;
-
-        float k = 0.577350269;
-        float m = 0.356822089;
-        float n = 0.934172359;
-
-        // 20 Faces
-        planes[0] = vec4( k, k, k, d); planes[1] = vec4( k, k,-k, d);
-        planes[2] = vec4( k,-k, k, d); planes[3] = vec4( k,-k,-k, d);
-        planes[4] = vec4(-k, k, k, d); planes[5] = vec4(-k, k,-k, d);
-        planes[6] = vec4(-k,-k, k, d); planes[7] = vec4(-k,-k,-k, d);
-
-        planes[8] = vec4(0, m, n, d);  planes[9] = vec4(0, -m, n, d);
-        planes[10]= vec4(0, m,-n, d);  planes[11]= vec4(0, -m,-n, d);
-        planes[12]= vec4(n, 0, m, d);  planes[13]= vec4(n, 0, -m, d);
-        planes[14]= vec4(-n,0, m, d);  planes[15]= vec4(-n,0, -m, d);
-        planes[16]= vec4(m, n, 0, d);  planes[17]= vec4(m, -n, 0, d);
-        planes[18]= vec4(-m,n, 0, d);  planes[19]= vec4(-m,-n, 0, d);
-        count = 20;
-    }
+    vec3 n0 = vec3(0.0);
+    vec3 n1 = vec3(0.0);
 
     // Slab Method Loop (Standard)
     for (int i = 0; i < count; i++) {
-        vec4 p = planes[i];
+        vec4 p = convexPlanes[planeOffset + i];
         vec3 norm = p.xyz;
         float dist = p.w;
 
@@ -380,63 +357,350 @@ bool intersectConvexPlanes(vec3 ro, vec3 rd, vec3 scale, int type, float tMin, f
     return true;
 }
 
-bool hitWorld(vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
+// Slab test; returns the entry distance or BVH_MISS
+float hitAABB(vec3 boundsMin, vec3 boundsMax, vec3 rayOrigin, vec3 invDir, float tMin, float tMax) {
+    vec3 t0 = (boundsMin - rayOrigin) * invDir;
+    vec3 t1 = (boundsMax - rayOrigin) * invDir;
+    vec3 tSmall = min(t0, t1);
+    vec3 tBig = max(t0, t1);
+    float tEnter = max(max(tSmall.x, tSmall.y), max(tSmall.z, tMin));
+    float tExit = min(min(tBig.x, tBig.y), min(tBig.z, tMax));
+    return tEnter <= tExit ? tEnter : BVH_MISS;
+}
+
+vec3 meshVertex(int index) {
+    int v = meshIndices[index];
+    return vec3(meshVertices[3 * v], meshVertices[3 * v + 1], meshVertices[3 * v + 2]);
+}
+
+// Watertight ray/triangle test (Woop, Benthin, Wald 2013). The ray is
+// sheared so that it runs along +z from the origin; edges shared by two
+// triangles then give the same edge function in both, so rays cannot slip
+// between them. k holds the permuted axes and shear the per-ray constants.
+bool hitTriangle(int tri, vec3 ro, ivec3 k, vec3 shear, float tMin, float tMax, out float tOut, out vec3 nOut) {
+    vec3 p0 = meshVertex(3 * tri);
+    vec3 p1 = meshVertex(3 * tri + 1);
+    vec3 p2 = meshVertex(3 * tri + 2);
+    vec3 a = p0 - ro;
+    vec3 b = p1 - ro;
+    vec3 c = p2 - ro;
+
+    float ax = a[k.x] - shear.x * a[k.z];
+    float ay = a[k.y] - shear.y * a[k.z];
+    float bx = b[k.x] - shear.x * b[k.z];
+    float by = b[k.y] - shear.y * b[k.z];
+    float cx = c[k.x] - shear.x * c[k.z];
+    float cy = c[k.y] - shear.y * c[k.z];
+
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0)) return false;
+
+    float det = u + v + w;
+    if (det == 0.0) return false;
+
+    float t = (u * a[k.z] + v * b[k.z] + w * c[k.z]) * shear.z / det;
+    if (t <= tMin || t >= tMax) return false;
+
+    tOut = t;
+    nOut = cross(p1 - p0, p2 - p0);
+    return true;
+}
+
+// Closest triangle of the mesh rooted at rootNode, for a ray in mesh space
+bool hitMesh(int rootNode, vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, out float tOut, out vec3 nOut) {
+    // Largest direction component becomes z; swapping x and y keeps the
+    // winding when that component is negative
+    vec3 absDir = abs(rayDir);
+    int kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+    int kx = kz == 2 ? 0 : kz + 1;
+    int ky = kx == 2 ? 0 : kx + 1;
+    if (rayDir[kz] < 0.0) { int tmp = kx; kx = ky; ky = tmp; }
+    ivec3 k = ivec3(kx, ky, kz);
+    vec3 shear = vec3(rayDir[kx] / rayDir[kz], rayDir[ky] / rayDir[kz], 1.0 / rayDir[kz]);
+
+    vec3 safeDir = vec3(abs(rayDir.x) > 1e-8 ? rayDir.x : 1e-8,
+                        abs(rayDir.y) > 1e-8 ? rayDir.y : 1e-8,
+                        abs(rayDir.z) > 1e-8 ? rayDir.z : 1e-8);
+    vec3 invDir = 1.0 / safeDir;
+
+    if (hitAABB(meshNodes[rootNode].boundsMin, meshNodes[rootNode].boundsMax, rayOrigin, invDir, tMin, tMax) == BVH_MISS) {
+        return false;
+    }
+
     bool hitAnything = false;
-    float closestSoFar = tMax;
+    float closest = tMax;
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = rootNode;
+
+    while (true) {
+        BVHNode node = meshNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                float t;
+                vec3 n;
+                if (hitTriangle(node.leftFirst + i, rayOrigin, k, shear, tMin, closest, t, n)) {
+                    closest = t;
+                    nOut = n;
+                    hitAnything = true;
+                }
+            }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+            continue;
+        }
+
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(meshNodes[childNear].boundsMin, meshNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closest);
+        float tFar = hitAABB(meshNodes[childFar].boundsMin, meshNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closest);
+        if (tFar < tNear) {
+            int tmpIndex = childNear; childNear = childFar; childFar = tmpIndex;
+            float tmpT = tNear; tNear = tFar; tFar = tmpT;
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
+        }
+    }
+    tOut = closest;
+    return hitAnything;
+}
+
+bool hitObject(int i, vec3 rayOrigin, vec3 rayDir, float tMin, inout float closestSoFar, inout HitRecord rec) {
+    int type = objectTypes[i];
+
+    if (type == TYPE_SPHERE) {
+        if (hitSphere(objectGeometry[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) {
+            closestSoFar = rec.t;
+            rec.objIndex = i;
+            rec.instIndex = -1;
+            return true;
+        }
+        return false;
+    }
 
-    for (int i = 0; i < objectCount; i++) {
-        GPUObject obj = objects[i];
-        int type = int(obj.data3.w);
+    if (type == TYPE_PLANE) {
+        if (hitPlane(objectGeometry[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) {
+            closestSoFar = rec.t;
+            rec.objIndex = i;
+            rec.instIndex = -1;
+            return true;
+        }
+        return false;
+    }
+
+    // Complex Shapes: transforms and plane sets are precomputed by SceneBuilder
+    ObjectTransform xf = objectTransforms[i];
+    vec3 scale = objectGeometry[i].xyz;
+
+    vec3 roLocal = vec3(dot(xf.worldToLocal[0].xyz, rayOrigin) + xf.worldToLocal[0].w,
+                        dot(xf.worldToLocal[1].xyz, rayOrigin) + xf.worldToLocal[1].w,
+                        dot(xf.worldToLocal[2].xyz, rayOrigin) + xf.worldToLocal[2].w);
+    vec3 rdLocal = vec3(dot(xf.worldToLocal[0].xyz, rayDir),
+                        dot(xf.worldToLocal[1].xyz, rayDir),
+                        dot(xf.worldToLocal[2].xyz, rayDir));
+
+    float tHit = closestSoFar;
+    vec3 nHit;
+    bool localHit = false;
+    if (type == TYPE_CYLINDER) localHit = hitLocalCylinder(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == TYPE_CONE) localHit = hitLocalCone(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == TYPE_CUBE) localHit = hitLocalBox(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == TYPE_MESH) {
+        if (xf.meshRoot < 0) return false;
+        localHit = hitMesh(xf.meshRoot, roLocal, rdLocal, tMin, closestSoFar, tHit, nHit);
+    }
+    else localHit = intersectConvexPlanes(roLocal, rdLocal, xf.planeOffset, xf.planeCount, tMin, closestSoFar, tHit, nHit);
+
+    if (localHit) {
+        closestSoFar = tHit;
+        rec.t = tHit;
+        rec.p = rayOrigin + tHit * rayDir;
+        if (type == TYPE_MESH) {
+            // Meshes are scaled, so normals take the inverse transpose: the
+            // worldToLocal columns
+            rec.normal = normalize(nHit.x * xf.worldToLocal[0].xyz + nHit.y * xf.worldToLocal[1].xyz +
+                                   nHit.z * xf.worldToLocal[2].xyz);
+        } else {
+            rec.normal = normalize(vec3(dot(xf.localToWorld[0].xyz, nHit),
+                                        dot(xf.localToWorld[1].xyz, nHit),
+                                        dot(xf.localToWorld[2].xyz, nHit)));
+        }
+        rec.frontFace = dot(rayDir, rec.normal) < 0.0;
+        if (!rec.frontFace) rec.normal = -rec.normal;
+        rec.objIndex = i;
+        rec.instIndex = -1;
+    }
+    return localHit;
+}
+
+// Closest hit among a prototype's objects, for a ray already in prototype space
+bool hitPrototype(int rootNode, vec3 rayOrigin, vec3 rayDir, float tMin, inout float closestSoFar, inout HitRecord rec) {
+    vec3 safeDir = vec3(abs(rayDir.x) > 1e-8 ? rayDir.x : 1e-8,
+                        abs(rayDir.y) > 1e-8 ? rayDir.y : 1e-8,
+                        abs(rayDir.z) > 1e-8 ? rayDir.z : 1e-8);
+    vec3 invDir = 1.0 / safeDir;
 
-        bool hit = false;
-        float tHit = closestSoFar;
-        vec3 nHit;
+    if (hitAABB(bvhNodes[rootNode].boundsMin, bvhNodes[rootNode].boundsMax, rayOrigin, invDir, tMin, closestSoFar) == BVH_MISS) {
+        return false;
+    }
+
+    bool hitAnything = false;
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = rootNode;
 
-        if (type == TYPE_SPHERE) {
-            if (hitSphere(obj, rayOrigin, rayDir, tMin, closestSoFar, rec)) {
-                hitAnything = true;
-                closestSoFar = rec.t;
-                rec.objIndex = i;
+    while (true) {
+        BVHNode node = bvhNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                if (hitObject(primIndices[node.leftFirst + i], rayOrigin, rayDir, tMin, closestSoFar, rec)) hitAnything = true;
             }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
             continue;
         }
 
-        if (type == TYPE_PLANE) {
-            if (hitPlane(obj, rayOrigin, rayDir, tMin, closestSoFar, rec)) {
-                hitAnything = true;
-                closestSoFar = rec.t;
-                rec.objIndex = i;
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(bvhNodes[childNear].boundsMin, bvhNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        float tFar = hitAABB(bvhNodes[childFar].boundsMin, bvhNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        if (tFar < tNear) {
+            int tmpIndex = childNear; childNear = childFar; childFar = tmpIndex;
+            float tmpT = tNear; tNear = tFar; tFar = tmpT;
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
+        }
+    }
+    return hitAnything;
+}
+
+bool hitInstance(int inst, vec3 rayOrigin, vec3 rayDir, float tMin, inout float closestSoFar, inout HitRecord rec) {
+    ObjectInstance xf = instances[inst];
+    if (xf.rootNode < 0) return false;
+
+    vec3 roLocal = vec3(dot(xf.worldToLocal[0].xyz, rayOrigin) + xf.worldToLocal[0].w,
+                        dot(xf.worldToLocal[1].xyz, rayOrigin) + xf.worldToLocal[1].w,
+                        dot(xf.worldToLocal[2].xyz, rayOrigin) + xf.worldToLocal[2].w);
+    vec3 rdLocal = vec3(dot(xf.worldToLocal[0].xyz, rayDir),
+                        dot(xf.worldToLocal[1].xyz, rayDir),
+                        dot(xf.worldToLocal[2].xyz, rayDir));
+
+    if (!hitPrototype(xf.rootNode, roLocal, rdLocal, tMin, closestSoFar, rec)) return false;
+
+    // Normals go through the inverse transpose: the columns of worldToLocal.
+    // That keeps the sign of dot(normal, dir), so frontFace stays valid.
+    rec.p = rayOrigin + rec.t * rayDir;
+    rec.normal = normalize(xf.worldToLocal[0].xyz * rec.normal.x +
+                           xf.worldToLocal[1].xyz * rec.normal.y +
+                           xf.worldToLocal[2].xyz * rec.normal.z);
+    rec.instIndex = inst;
+    return true;
+}
+
+// Closest hit without its material (rec.matIndex is left untouched)
+bool hitClosest(vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
+    bool hitAnything = false;
+    float closestSoFar = tMax;
+
+    for (int i = 0; i < planeCount; i++) {
+        if (hitObject(planeIndices[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) hitAnything = true;
+    }
+
+    if (bvhNodeCount == 0) return hitAnything;
+
+    // Avoid 0 * inf = NaN in the slab test for axis-aligned rays
+    vec3 safeDir = vec3(abs(rayDir.x) > 1e-8 ? rayDir.x : 1e-8,
+                        abs(rayDir.y) > 1e-8 ? rayDir.y : 1e-8,
+                        abs(rayDir.z) > 1e-8 ? rayDir.z : 1e-8);
+    vec3 invDir = 1.0 / safeDir;
+
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = 0;
+
+    if (hitAABB(bvhNodes[0].boundsMin, bvhNodes[0].boundsMax, rayOrigin, invDir, tMin, closestSoFar) == BVH_MISS) {
+        return hitAnything;
+    }
+
+    while (true) {
+        BVHNode node = bvhNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                int prim = primIndices[node.leftFirst + i];
+                bool hit = prim >= 0 ? hitObject(prim, rayOrigin, rayDir, tMin, closestSoFar, rec)
+                                     : hitInstance(-1 - prim, rayOrigin, rayDir, tMin, closestSoFar, rec);
+                if (hit) hitAnything = true;
             }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
             continue;
         }
 
-        // Complex Shapes
-        vec3 center = obj.data1.xyz;
-        vec3 rot = obj.data2.xyz;
-        vec3 scale = obj.data3.xyz;
-
-        mat3 rotMat = buildRotationMatrix(rot);
-        mat3 invRot = transpose(rotMat);
-
-        vec3 roLocal = invRot * (rayOrigin - center);
-        vec3 rdLocal = invRot * rayDir;
-
-        bool localHit = false;
-        if (type == TYPE_CYLINDER) localHit = hitLocalCylinder(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
-        else if (type == TYPE_CONE) localHit = hitLocalCone(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
-        else localHit = intersectConvexPlanes(roLocal, rdLocal, scale, type, tMin, closestSoFar, tHit, nHit);
-
-        if (localHit) {
-            hitAnything = true;
-            closestSoFar = tHit;
-            rec.t = tHit;
-            rec.p = rayOrigin + tHit * rayDir;
-            rec.normal = normalize(rotMat * nHit);
-            rec.frontFace = dot(rayDir, rec.normal) < 0.0;
-            if (!rec.frontFace) rec.normal = -rec.normal;
-            rec.matIndex = int(obj.data2.w);
-            rec.objIndex = i;
+        // Visit the nearer child first, defer the other
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(bvhNodes[childNear].boundsMin, bvhNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        float tFar = hitAABB(bvhNodes[childFar].boundsMin, bvhNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        if (tFar < tNear) {
+            int tmpIndex = childNear; childNear = childFar; childFar = tmpIndex;
+            float tmpT = tNear; tNear = tFar; tFar = tmpT;
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
         }
     }
     return hitAnything;
-}
\ No newline at end of file
+}
+
+bool hitWorld(vec3 rayOrigin, vec3 rayDir, float tMin, float tMax, inout HitRecord rec) {
+    if (!hitClosest(rayOrigin, rayDir, tMin, tMax, rec)) return false;
+    rec.matIndex = objectMaterials[rec.objIndex];
+    return true;
+}
+
+// Sphere that light sampling and tint sources treat an object as. Only
+// spheres keep their center in the geometry stream; every other finite
+// shape has it as the translation of its transform.
+vec4 objectBoundingSphere(int i) {
+    int type = objectTypes[i];
+    vec4 geometry = objectGeometry[i];
+    if (type == TYPE_SPHERE || type == TYPE_PLANE) return geometry;
+    return vec4(objectTransforms[i].localToWorld[0].w,
+                objectTransforms[i].localToWorld[1].w,
+                objectTransforms[i].localToWorld[2].w,
+                geometry.w);
+}
+
+// World-space bounding sphere of an emitter; prototype objects are placed
+// by their instance (inst >= 0)
+vec4 emitterBoundingSphere(int i, int inst) {
+    vec4 sphere = objectBoundingSphere(i);
+    if (inst < 0) return sphere;
+    ObjectInstance xf = instances[inst];
+    return vec4(dot(xf.localToWorld[0].xyz, sphere.xyz) + xf.localToWorld[0].w,
+                dot(xf.localToWorld[1].xyz, sphere.xyz) + xf.localToWorld[1].w,
+                dot(xf.localToWorld[2].xyz, sphere.xyz) + xf.localToWorld[2].w,
+                sphere.w * xf.maxScale);
+}
@@ -0,0 +1,285 @@
+// Path-tracing building blocks shared by the megakernel (main.glsl) and the
+// wavefront stages (wf_*.glsl). Expects camera, hittable, random and material
+// to be included first.
+
+bool isSafe(vec3 v) {
+    if (isnan(v.x) || isnan(v.y) || isnan(v.z)) return false;
+    if (isinf(v.x) || isinf(v.y) || isinf(v.z)) return false;
+    return true;
+}
+
+vec3 sampleSky(vec3 rayDir) {
+    float t = 0.5 * (rayDir.y + 1.0);
+    return mix(skyColorBottom, skyColorTop, t);
+}
+
+vec4 sampleTintSources(vec3 surfacePos, vec3 surfaceNormal, int ignoreObjIndex) {
+    vec3 accumulatedTint = vec3(0.0);
+    float totalInfluence = 0.0;
+
+    for (int i = 0; i < objectCount; i++) {
+        if (i == ignoreObjIndex) continue;
+
+        Material mat = materials[objectMaterials[i]];
+
+        if (mat.emissionMode == EMISSION_ABSOLUTE && mat.emissionStrength > 0.0) {
+
+            vec4 target = objectBoundingSphere(i);
+            vec3 targetCenter = target.xyz;
+            float targetRadius = target.w;
+
+            vec3 randomOffset = randomPointOnUnitSphere();
+            vec3 targetPoint = targetCenter + (randomOffset * targetRadius);
+
+            vec3 toLight = targetPoint - surfacePos;
+            float distToTarget = length(toLight);
+            vec3 L = toLight / distToTarget; // Normalized
+
+            float NdotL = max(dot(surfaceNormal, L), 0.0);
+            if (NdotL <= 0.0) continue;
+
+            bool visible = false;
+
+            // Start slightly off surface to avoid self-intersection
+            vec3 currentOrigin = surfacePos + surfaceNormal * 0.001;
+
+            // Trace 99% of the way to avoid hitting the emitter surface itself
+            float remainingDist = distToTarget * 0.99;
+
+            // Loop to handle transparent obstacles (Max 6 bounces)
+            for (int k = 0; k < 6; k++) {
+                HitRecord shadowRec;
+                bool hit = hitWorld(currentOrigin, L, 0.001, remainingDist, shadowRec);
+
+                if (!hit) {
+                    visible = true;
+                    break;
+                }
+
+                if (shadowRec.objIndex == i) {
+                    visible = true;
+                    break;
+                }
+
+                if (shadowRec.objIndex == ignoreObjIndex) {
+                    currentOrigin = shadowRec.p + L * 0.001;
+                    remainingDist -= shadowRec.t;
+                    continue;
+                }
+
+                Material occMat = materials[shadowRec.matIndex];
+
+                if (occMat.transmission > 0.01 || occMat.subsurface > 0.0) {
+                    currentOrigin = shadowRec.p + L * 0.001;
+                    remainingDist -= shadowRec.t;
+
+                    if (remainingDist <= 0.001) {
+                        visible = true;
+                        break;
+                    }
+                } else {
+                    visible = false;
+                    break;
+                }
+            }
+
+            if (visible) {
+                float physicalDist = max(distance(surfacePos, targetCenter) - targetRadius, 0.0);
+
+                // Falloff
+                float attenuation = 1.0 / (1.0 + pow(physicalDist * 0.15f, 2.0f));
+                float influence = mat.emissionStrength * attenuation * NdotL;
+                influence = clamp(influence, 0.0, 1.0);
+
+                accumulatedTint += mat.emission * influence;
+                totalInfluence += influence;
+            }
+        }
+    }
+
+    return vec4(accumulatedTint, min(totalInfluence, 1.0));
+}
+
+
+// O(1) light selection: pick a slot uniformly, then keep it or take its alias
+LightEntry sampleLightTable() {
+    float u = randomFloat() * float(lightTableSize);
+    int slot = min(int(u), lightTableSize - 1);
+    LightEntry entry = lightTable[slot];
+    if (u - float(slot) >= entry.aliasProb) entry = lightTable[entry.alias];
+    return entry;
+}
+
+// Unoccluded part of a light sample. Picks a point on the light and returns
+// false if it cannot contribute; otherwise `contribution` is radiance * BRDF,
+// to be scaled by the transmittance returned from traceShadowRay().
+bool sampleLightContribution(vec3 surfacePos, vec3 surfaceNormal, vec3 V, Material surfaceMat,
+                             LightEntry light, out vec3 L, out float dist, out vec3 contribution) {
+    L = vec3(0.0);
+    dist = 0.0;
+    contribution = vec3(0.0);
+
+    vec4 lightSphere = emitterBoundingSphere(light.objIndex, light.instIndex);
+    vec3 lightPos = lightSphere.xyz;
+    float lightRadius = lightSphere.w;
+    Material lightMat = materials[light.matIndex];
+
+    if (lightMat.emissionMode == EMISSION_ABSOLUTE) return false;
+
+    vec3 randomOnSphere = randomPointOnUnitSphere();
+    vec3 lightSamplePos = lightPos + randomOnSphere * lightRadius;
+
+    vec3 toLight = lightSamplePos - surfacePos;
+    float distSq = dot(toLight, toLight);
+    dist = sqrt(distSq);
+    L = normalize(toLight);
+
+    float NdotL = dot(surfaceNormal, L);
+    if (NdotL <= 0.0) return false;
+
+    float lightArea = 4.0 * PI * lightRadius * lightRadius;
+    float weight = lightArea / max(distSq, 0.001);
+
+    vec3 lightRadiance = lightMat.emission * lightMat.emissionStrength * weight;
+    vec3 brdf = evalBRDF(surfaceMat, surfaceNormal, V, L);
+    contribution = lightRadiance * brdf;
+    return true;
+}
+
+// Transmittance towards the light; transmissive and subsurface occluders
+// are passed through and tint the result, anything else blocks it. The light
+// is identified by its object and instance (-1 outside prototypes).
+vec3 traceShadowRay(vec3 origin, vec3 L, float dist, int lightObjIndex, int lightInstIndex) {
+    vec3 currentOrigin = origin;
+    vec3 throughput = vec3(1.0);
+    float remainingDist = dist - 0.01;
+    bool visible = false;
+
+    for (int i = 0; i < 5; i++) {
+        HitRecord shadowRec;
+
+        bool occluded = hitWorld(currentOrigin, L, 0.001, dist + 0.01, shadowRec);
+
+        if (!occluded) {
+            visible = true;
+            break;
+        }
+
+        if (shadowRec.objIndex == lightObjIndex && shadowRec.instIndex == lightInstIndex) {
+            visible = true;
+            break;
+        }
+
+        Material occMat = materials[shadowRec.matIndex];
+        if (occMat.transmission > 0.01 || occMat.subsurface > 0.0) {
+            throughput *= occMat.albedo;
+            currentOrigin = shadowRec.p + L * 0.001;
+            remainingDist -= shadowRec.t;
+            if (remainingDist <= 0.0) break;
+        } else {
+            visible = false;
+            break;
+        }
+    }
+
+    return visible ? throughput : vec3(0.0);
+}
+
+vec3 sampleDirectLight(vec3 surfacePos, vec3 surfaceNormal, vec3 V, Material surfaceMat, LightEntry light) {
+    vec3 L;
+    float dist;
+    vec3 contribution;
+    if (!sampleLightContribution(surfacePos, surfaceNormal, V, surfaceMat, light, L, dist, contribution)) {
+        return vec3(0.0);
+    }
+    return contribution * traceShadowRay(surfacePos + surfaceNormal * 0.001, L, dist, light.objIndex, light.instIndex);
+}
+
+// Extinction and single-scattering albedo of the random-walk medium entered
+// through a subsurface material
+void subsurfaceCoefficients(Material mat, out vec3 sigmaT, out vec3 albedo) {
+    float radius = max(mat.subsurfaceRadius, 0.001);
+    sigmaT = vec3(1.0 / radius);
+    sigmaT += mat.absorption;
+    albedo = mat.albedo;
+}
+
+// One step of the subsurface random walk. `rec` is the boundary hit along
+// dir (hitBoundary false if there is none): either scatter inside the medium
+// or leave through the boundary, refracting out unless totally reflected.
+void subsurfaceStep(bool hitBoundary, HitRecord rec, vec3 sssSigmaT, vec3 sssAlbedo,
+                    inout vec3 currentOrigin, inout vec3 currentDir, inout vec3 throughput,
+                    inout bool insideSSS, inout bool lastPathWasSpecular) {
+    float distToBoundary = hitBoundary ? rec.t : INFINITY;
+    int channel = int(min(randomFloat() * 3.0, 2.0));
+    float selectedDensity = sssSigmaT[channel];
+
+    float distToScatter = -log(randomFloat()) / max(selectedDensity, 0.0001);
+
+    if (distToScatter < distToBoundary) {
+        currentOrigin += currentDir * distToScatter;
+
+
+        // vec3 trReal = exp(-sssSigmaT * distToScatter);
+        // float pdf = densityMax * exp(-densityMax * distToScatter);
+        // vec3 weight = sssAlbedo * (trReal * densityMax / pdf); // Leads to explosion
+
+
+        vec3 trReal = exp(-sssSigmaT * distToScatter);
+
+        vec3 channelPDFs = sssSigmaT * trReal;
+        float pdf = (channelPDFs.r + channelPDFs.g + channelPDFs.b) / 3.0;
+
+        vec3 sigmaS = sssSigmaT * sssAlbedo;
+
+        vec3 weight = (trReal * sigmaS) / max(pdf, 1e-8);
+
+        throughput *= weight;
+
+        throughput = min(throughput, vec3(10.0));
+
+        currentDir = randomPointOnUnitSphere();
+    } else {
+        currentOrigin = rec.p;
+
+        vec3 trReal = exp(-sssSigmaT * distToBoundary);
+
+        vec3 channelExitProbs = exp(-sssSigmaT * distToBoundary);
+        float pdfExit = (channelExitProbs.r + channelExitProbs.g + channelExitProbs.b) / 3.0;
+
+        vec3 weight = trReal / max(pdfExit, 1e-8);
+        throughput *= weight;
+
+        throughput = min(throughput, vec3(10.0));
+
+        Material mat = materials[rec.matIndex];
+        vec3 outwardN = rec.frontFace ? rec.normal : -rec.normal;
+        vec3 unitDir = normalize(currentDir);
+        float eta = mat.ior;
+        float cosTheta = min(dot(-unitDir, -outwardN), 1.0);
+        float sinTheta = sqrt(max(0.0, 1.0 - cosTheta*cosTheta));
+
+        if (eta * sinTheta > 1.0) {
+            // TIR
+            currentDir = normalize(-outwardN + randomPointOnUnitSphere());
+            currentOrigin -= outwardN * 0.001;
+        } else {
+            currentDir = refractVec(unitDir, -outwardN, eta);
+            currentOrigin += outwardN * 0.001;
+            insideSSS = false;
+            lastPathWasSpecular = true;
+        }
+    }
+}
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Relative standard error of the pixel mean, from first and second luminance moments
+float relativeError(float lumSum, float lumSqSum, float n) {
+    float mean = lumSum / n;
+    float variance = max(lumSqSum / n - mean * mean, 0.0) * n / max(n - 1.0, 1.0);
+    return sqrt(variance / n) / (mean + 1e-3);
+}
+
@@ -5,179 +5,50 @@
 #include "hittable.glsl"
 #include "random.glsl"
 #include "material.glsl"
+#include "integrator.glsl"
+#include "tiles.glsl"
 
 layout (local_size_x = 16, local_size_y = 16) in;
 layout (rgba32f, binding = 0) uniform image2D outputImage;
 layout (rgba32f, binding = 1) uniform image2D accumImage;
 
+// Adaptive sampling: r = running sum of per-sample luminance^2, g = 1 once converged
+layout (rgba32f, binding = 2) uniform image2D momentImage;
+
 // Bloom Buffers
 layout (rgba32f, binding = 4) uniform image2D outputBloom;
 layout (rgba32f, binding = 5) uniform image2D accumBloom;
 
-uniform vec3 skyColorTop;
-uniform vec3 skyColorBottom;
-
-bool isSafe(vec3 v) {
-    if (isnan(v.x) || isnan(v.y) || isnan(v.z)) return false;
-    if (isinf(v.x) || isinf(v.y) || isinf(v.z)) return false;
-    return true;
-}
-
-vec3 sampleSky(vec3 rayDir) {
-    float t = 0.5 * (rayDir.y + 1.0);
-    return mix(skyColorBottom, skyColorTop, t);
-}
-
-vec4 sampleTintSources(vec3 surfacePos, vec3 surfaceNormal, int ignoreObjIndex) {
-    vec3 accumulatedTint = vec3(0.0);
-    float totalInfluence = 0.0;
-
-    for (int i = 0; i < objectCount; i++) {
-        if (i == ignoreObjIndex) continue;
-
-        GPUObject obj = objects[i];
-        int matIndex = int(obj.data2.x);
-        Material mat = materials[matIndex];
-
-        if (mat.emissionMode == EMISSION_ABSOLUTE && mat.emissionStrength > 0.0) {
-
-            vec3 targetCenter = obj.data1.xyz;
-            float targetRadius = obj.data1.w;
-
-            vec3 randomOffset = randomPointOnUnitSphere();
-            vec3 targetPoint = targetCenter + (randomOffset * targetRadius);
-
-            vec3 toLight = targetPoint - surfacePos;
-            float distToTarget = length(toLight);
-            vec3 L = toLight / distToTarget; // Normalized
-
-            float NdotL = max(dot(surfaceNormal, L), 0.0);
-            if (NdotL <= 0.0) continue;
-
-            bool visible = false;
-
-            // Start slightly off surface to avoid self-intersection
-            vec3 currentOrigin = surfacePos + surfaceNormal * 0.001;
-
-            // Trace 99% of the way to avoid hitting the emitter surface itself
-            float remainingDist = distToTarget * 0.99;
-
-            // Loop to handle transparent obstacles (Max 6 bounces)
-            for (int k = 0; k < 6; k++) {
-                HitRecord shadowRec;
-                bool hit = hitWorld(currentOrigin, L, 0.001, remainingDist, shadowRec);
-
-                if (!hit) {
-                    visible = true;
-                    break;
-                }
-
-                if (shadowRec.objIndex == i) {
-                    visible = true;
-                    break;
-                }
-
-                if (shadowRec.objIndex == ignoreObjIndex) {
-                    currentOrigin = shadowRec.p + L * 0.001;
-                    remainingDist -= shadowRec.t;
-                    continue;
-                }
-
-                Material occMat = materials[shadowRec.matIndex];
-
-                if (occMat.transmission > 0.01 || occMat.subsurface > 0.0) {
-                    currentOrigin = shadowRec.p + L * 0.001;
-                    remainingDist -= shadowRec.t;
-
-                    if (remainingDist <= 0.001) {
-                        visible = true;
-                        break;
-                    }
-                } else {
-                    visible = false;
-                    break;
-                }
-            }
-
-            if (visible) {
-                float physicalDist = max(distance(surfacePos, targetCenter) - targetRadius, 0.0);
-
-                // Falloff
-                float attenuation = 1.0 / (1.0 + pow(physicalDist * 0.15f, 2.0f));
-                float influence = mat.emissionStrength * attenuation * NdotL;
-                influence = clamp(influence, 0.0, 1.0);
-
-                accumulatedTint += mat.emission * influence;
-                totalInfluence += influence;
-            }
-        }
-    }
-
-    return vec4(accumulatedTint, min(totalInfluence, 1.0));
-}
-
-
-vec3 sampleDirectLight(vec3 surfacePos, vec3 surfaceNormal, vec3 V, Material surfaceMat, int lightObjIndex) {
-    GPUObject lightObj = objects[lightObjIndex];
-    vec3 lightPos = lightObj.data1.xyz;
-    float lightRadius = lightObj.data1.w;
-    Material lightMat = materials[int(lightObj.data2.x)];
-
-    if (lightMat.emissionMode == EMISSION_ABSOLUTE) return vec3(0.0);
-
-    vec3 randomOnSphere = randomPointOnUnitSphere();
-    vec3 lightSamplePos = lightPos + randomOnSphere * lightRadius;
-
-    vec3 toLight = lightSamplePos - surfacePos;
-    float distSq = dot(toLight, toLight);
-    float dist = sqrt(distSq);
-    vec3 L = normalize(toLight);
-
-    float NdotL = dot(surfaceNormal, L);
-    if (NdotL <= 0.0) return vec3(0.0);
-
-    // Shadow Ray
-    vec3 currentOrigin = surfacePos + surfaceNormal * 0.001;
-    vec3 throughput = vec3(1.0);
-    float remainingDist = dist - 0.01;
-    bool visible = false;
-
-    for (int i = 0; i < 5; i++) {
-        HitRecord shadowRec;
-
-        bool occluded = hitWorld(currentOrigin, L, 0.001, dist + 0.01, shadowRec);
-
-        if (!occluded) {
-            visible = true;
-            break;
-        }
-
-        if (shadowRec.objIndex == lightObjIndex) {
-            visible = true;
-            break;
-        }
-
-        Material occMat = materials[shadowRec.matIndex];
-        if (occMat.transmission > 0.01 || occMat.subsurface > 0.0) {
-            throughput *= occMat.albedo;
-            currentOrigin = shadowRec.p + L * 0.001;
-            remainingDist -= shadowRec.t;
-            if (remainingDist <= 0.0) break;
-        } else {
-            visible = false;
-            break;
-        }
-    }
-
-    if (!visible) return vec3(0.0);
-
-    float lightArea = 4.0 * PI * lightRadius * lightRadius;
-    float weight = lightArea / max(distSq, 0.001);
-
-    vec3 lightRadiance = lightMat.emission * lightMat.emissionStrength * weight;
-    vec3 brdf = evalBRDF(surfaceMat, surfaceNormal, V, L);
+// Counts of this frame (FrameCounts in renderer.h); reset by the host every frame
+layout(std430, binding = 7) buffer AdaptiveStats {
+    uint activePixels;
+    uint renderedSamples;   // pixel samples traced this frame
+};
 
-    return lightRadiance * brdf * throughput;
+// First tile of a grid dispatch (row bands, the priority region)
+layout(location = 0) uniform ivec2 dispatchOffset;
+
+// How a dispatch picks its tiles (TileScheduler, tiles.cpp)
+#define TILES_OFF 0        // the grid at dispatchOffset; no lists (dispatchComputeShader)
+#define TILES_GRID 1       // the grid at dispatchOffset, listing tiles that stay active
+#define TILES_LIST 2       // one band of the list being read
+#define TILES_PRIORITY 3   // the priority region at dispatchOffset, priorityBoost times the samples
+
+// x: TILES_* mode, y: list read this frame, z: band
+layout(location = 1) uniform ivec4 tileSchedule;
+// Tiles [xy, zw), rendered only by the TILES_PRIORITY dispatch
+layout(location = 2) uniform ivec4 priorityTiles;
+layout(location = 3) uniform int priorityBoost;
+
+shared uint tileActivePixels;
+shared uint tileInsidePixels;     // pixels of the tile inside the image
+shared uint tileKeptPixels;
+
+// Appends the tile to the list the next frame reads
+void keepTile(ivec2 tile) {
+    uint writeList = uint(tileSchedule.y) ^ 1u;
+    uint entry = atomicAdd(listLength[writeList], 1u);
+    tileLists[writeList * tileCapacity + entry] = (uint(tile.y) << 16) | uint(tile.x);
 }
 
 struct TraceResult {
@@ -203,66 +74,8 @@ TraceResult traceRay(vec3 rayOrigin, vec3 rayDir) {
         if (insideSSS) {
             HitRecord rec;
             bool hitBoundary = hitWorld(currentOrigin, currentDir, 0.001, INFINITY, rec);
-            float distToBoundary = hitBoundary ? rec.t : INFINITY;
-            int channel = int(min(randomFloat() * 3.0, 2.0));
-            float selectedDensity = sssSigmaT[channel];
-
-            float distToScatter = -log(randomFloat()) / max(selectedDensity, 0.0001);
-
-            if (distToScatter < distToBoundary) {
-                currentOrigin += currentDir * distToScatter;
-
-
-                // vec3 trReal = exp(-sssSigmaT * distToScatter);
-                // float pdf = densityMax * exp(-densityMax * distToScatter);
-                // vec3 weight = sssAlbedo * (trReal * densityMax / pdf); // Leads to explosion
-
-
-                vec3 trReal = exp(-sssSigmaT * distToScatter);
-
-                vec3 channelPDFs = sssSigmaT * trReal;
-                float pdf = (channelPDFs.r + channelPDFs.g + channelPDFs.b) / 3.0;
-
-                vec3 sigmaS = sssSigmaT * sssAlbedo;
-
-                vec3 weight = (trReal * sigmaS) / max(pdf, 1e-8);
-
-                throughput *= weight;
-
-                throughput = min(throughput, vec3(10.0));
-
-                currentDir = randomPointOnUnitSphere();
-            } else {
-                currentOrigin = rec.p;
-
-                vec3 trReal = exp(-sssSigmaT * distToBoundary);
-
-                vec3 channelExitProbs = exp(-sssSigmaT * distToBoundary);
-                float pdfExit = (channelExitProbs.r + channelExitProbs.g + channelExitProbs.b) / 3.0;
-
-                vec3 weight = trReal / max(pdfExit, 1e-8);
-                throughput *= weight;
-
-                throughput = min(throughput, vec3(10.0));
-
-                Material mat = materials[rec.matIndex];
-                vec3 outwardN = rec.frontFace ? rec.normal : -rec.normal;
-                vec3 unitDir = normalize(currentDir);
-                float eta = mat.ior;
-                float cosTheta = min(dot(-unitDir, -outwardN), 1.0);
-                float sinTheta = sqrt(max(0.0, 1.0 - cosTheta*cosTheta));
-
-                if (eta * sinTheta > 1.0) {
-                    // TIR
-                    currentDir = normalize(-outwardN + randomPointOnUnitSphere());
-                    currentOrigin -= outwardN * 0.001;
-                } else {
-                    currentDir = refractVec(unitDir, -outwardN, eta);
-                    currentOrigin += outwardN * 0.001;
-                    insideSSS = false;
-                    lastPathWasSpecular = true;
-                }
-            }
+            subsurfaceStep(hitBoundary, rec, sssSigmaT, sssAlbedo,
+                           currentOrigin, currentDir, throughput, insideSSS, lastPathWasSpecular);
             continue;
         }
 
@@ -310,10 +123,7 @@ TraceResult traceRay(vec3 rayOrigin, vec3 rayDir) {
                 float reflectProb = (fresnel.r + fresnel.g + fresnel.b) / 3.0;
                 if (randomFloat() > reflectProb) {
                     insideSSS = true;
-                    float radius = max(mat.subsurfaceRadius, 0.001);
-                    sssSigmaT = vec3(1.0 / radius);
-                    sssSigmaT += mat.absorption;
-                    sssAlbedo = mat.albedo;
+                    subsurfaceCoefficients(mat, sssSigmaT, sssAlbedo);
                     float eta = 1.0 / mat.ior;
                     currentDir = refractVec(currentDir, rec.normal, eta);
                     currentOrigin = rec.p - rec.normal * 0.001;
@@ -322,10 +132,13 @@ TraceResult traceRay(vec3 rayOrigin, vec3 rayDir) {
             }
 
             bool skipNEE = mat.transmission > 0.01 || mat.subsurface > 0.0;
-            if (!skipNEE && bounce < maxBounces - 1 && lightCount > 0) {
+            if (!skipNEE && bounce < maxBounces - 1 && lightTableSize > 0) {
                 vec3 V = -currentDir;
-                for (int lightIdx = 0; lightIdx < lightCount; lightIdx++) {
-                    vec3 directLight = sampleDirectLight(rec.p, rec.normal, V, mat, lightIndices[lightIdx]);
+                int neeSamples = max(lightSamples, 1);
+                for (int s = 0; s < neeSamples; s++) {
+                    LightEntry light = sampleLightTable();
+                    vec3 directLight = sampleDirectLight(rec.p, rec.normal, V, mat, light)
+                                     / (light.pdf * float(neeSamples));
                     radiance += throughput * directLight;
                     bloomRadiance += throughput * directLight;
                 }
@@ -361,20 +174,66 @@ TraceResult traceRay(vec3 rayOrigin, vec3 rayDir) {
 
 void main()
 {
-    ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
-    if (pixelCoords.x >= int(resolution.x) || pixelCoords.y >= int(resolution.y)) return;
+    int mode = tileSchedule.x;
+    ivec2 tile;
+    if (mode == TILES_LIST) {
+        uint entry = bandArgs[tileSchedule.z].w + gl_WorkGroupID.x;
+        uint packedTile = tileLists[uint(tileSchedule.y) * tileCapacity + entry];
+        tile = ivec2(packedTile & 0xffffu, packedTile >> 16);
+    } else {
+        tile = ivec2(gl_WorkGroupID.xy) + dispatchOffset;
+    }
+
+    // The priority dispatch renders and lists these itself
+    bool prioritized = all(greaterThanEqual(tile, priorityTiles.xy)) && all(lessThan(tile, priorityTiles.zw));
+    if ((mode == TILES_GRID || mode == TILES_LIST) && prioritized) return;
 
-    vec4 prevVisual = imageLoad(accumImage, pixelCoords);
-    vec4 prevBloom = imageLoad(accumBloom, pixelCoords);
+    ivec2 pixelCoords = tile * ivec2(gl_WorkGroupSize.xy) + ivec2(gl_LocalInvocationID.xy);
+    bool inside = pixelCoords.x < int(resolution.x) && pixelCoords.y < int(resolution.y);
+
+    vec4 prevVisual = vec4(0.0);
+    vec4 prevBloom = vec4(0.0);
+    vec4 prevMoment = vec4(0.0);
+    if (inside) {
+        prevVisual = imageLoad(accumImage, pixelCoords);
+        prevBloom = imageLoad(accumBloom, pixelCoords);
+        prevMoment = imageLoad(momentImage, pixelCoords);
+    }
     float currentSampleCount = prevVisual.a;
 
-    if (currentSampleCount >= float(maxTotalSamples)) return;
+    bool active = inside && currentSampleCount < float(maxTotalSamples);
+    if (adaptiveEnabled != 0 && prevMoment.g > 0.5) active = false;
+
+    // Converged pixels hand their share of the tile's sample budget to the
+    // pixels of the same tile that are still noisy
+    if (gl_LocalInvocationIndex == 0) {
+        tileActivePixels = 0;
+        tileInsidePixels = 0;
+        tileKeptPixels = 0;
+    }
+    barrier();
+    if (active) atomicAdd(tileActivePixels, 1u);
+    if (inside) atomicAdd(tileInsidePixels, 1u);
+    barrier();
+
+    if (!active) return;
+
+    int boost = 1;
+    if (adaptiveEnabled != 0) {
+        // Edge tiles are only partly inside; their missing pixels never converged
+        boost = clamp(int(tileInsidePixels / tileActivePixels), 1, max(adaptiveMaxBoost, 1));
+    }
+    if (mode == TILES_PRIORITY) boost *= max(priorityBoost, 1);
+    int frameSamples = min(samplesPerFrame * boost, maxTotalSamples - int(currentSampleCount));
+    atomicAdd(renderedSamples, uint(frameSamples));
 
     initRNG(uvec2(pixelCoords), frameCount);
 
     TraceResult result = { vec3(0.0), vec3(0.0) };
+    float lumSqSum = 0.0;
 
-    for (int numSample = 0; numSample < samplesPerFrame; numSample ++) {
+    for (int numSample = 0; numSample < frameSamples; numSample ++) {
+        beginSample(uint(currentSampleCount) + uint(numSample));
         vec2 jitter = vec2(randomFloat(), randomFloat());
         vec2 uv = (vec2(pixelCoords) + jitter) / resolution;
         vec2 ndc = uv * 2.0 - 1.0;
@@ -390,11 +249,14 @@ void main()
         TraceResult sampleRes = traceRay(rayOrigin, rayDir);
         result.radiance += sampleRes.radiance;
         result.bloom += sampleRes.bloom;
+
+        float sampleLum = luminance(sampleRes.radiance);
+        lumSqSum += sampleLum * sampleLum;
     }
 
     if (isSafe(result.radiance) && isSafe(result.bloom)) {
         vec3 totalVisual = prevVisual.rgb + result.radiance;
-        float totalSamples = currentSampleCount + float(samplesPerFrame);
+        float totalSamples = currentSampleCount + float(frameSamples);
         imageStore(accumImage, pixelCoords, vec4(totalVisual, totalSamples));
 
         vec3 totalBloom = prevBloom.rgb + result.bloom;
@@ -405,8 +267,22 @@ void main()
 
         imageStore(outputImage, pixelCoords, vec4(finalVisual, 1.0));
         imageStore(outputBloom, pixelCoords, vec4(finalBloom, 1.0));
+
+        bool stillActive = totalSamples < float(maxTotalSamples);
+        if (adaptiveEnabled != 0) {
+            float totalLumSq = prevMoment.r + lumSqSum;
+            bool converged = totalSamples >= float(adaptiveMinSamples) &&
+                relativeError(luminance(totalVisual), totalLumSq, totalSamples) < adaptiveThreshold;
+            imageStore(momentImage, pixelCoords, vec4(totalLumSq, converged ? 1.0 : 0.0, 0.0, 0.0));
+            stillActive = stillActive && !converged;
+        }
+        if (!stillActive) return;
     } else {
         imageStore(accumImage, pixelCoords, prevVisual);
         imageStore(accumBloom, pixelCoords, prevBloom);
     }
-}
\ No newline at end of file
+
+    atomicAdd(activePixels, 1u);
+    // The first pixel of the tile still wanting samples lists it
+    if (mode != TILES_OFF && atomicAdd(tileKeptPixels, 1u) == 0u) keepTile(tile);
+}
@@ -1,3 +1,25 @@
+#include "frame.glsl"
+
+// Random numbers of the kernels. Each sample of a pixel draws its numbers in
+// order, one dimension per randomFloat() call; beginSample() starts the next
+// sample. samplerType picks the generator:
+//   SAMPLER_PCG: a PCG stream per pixel and frame (white noise)
+//   SAMPLER_SOBOL: each pair of dimensions is the Owen-scrambled Sobol
+//     (0,2)-sequence indexed by the pixel's sample number, with the index
+//     shuffled per pixel and pair (padding, Burley 2020)
+//   SAMPLER_BLUE_NOISE: the same sequence scrambled alike in every pixel and
+//     shifted (Cranley-Patterson) per pixel and dimension by a blue-noise
+//     mask, so the error left at low sample counts is blue noise on screen
+#define SAMPLER_PCG 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+
+// Void-and-cluster ranks, BLUE_NOISE_SIZE^2 texels row-major (sampler.h)
+#define BLUE_NOISE_SIZE 64
+layout(std430, binding = 22) readonly buffer BlueNoiseBuffer {
+    int blueNoiseRanks[];
+};
+
 uint pcg_hash(inout uint state) {
     uint state_curr = state * 747796405u + 2891336453u;
     uint word = ((state_curr >> ((state_curr >> 28u) + 4u)) ^ state_curr) * 277803737u;
@@ -6,20 +28,102 @@ uint pcg_hash(inout uint state) {
 }
 
 uint rngState;
+uvec2 samplerPixel;
+uint samplerPixelSeed;  // scrambles of SAMPLER_SOBOL
+uint sampleNumber;      // index of the current sample in the pixel's sequence
+uint sampleDimension;   // next dimension of the current sample
+
+uint hashCombine(uint seed, uint value) {
+    uint state = seed ^ (value * 0x9e3779b9u + 0x7f4a7c15u);
+    return pcg_hash(state);
+}
+
+void beginSample(uint index) {
+    sampleNumber = index;
+    sampleDimension = 0u;
+}
+
+void setSamplerPixel(uvec2 pixelCoord) {
+    samplerPixel = pixelCoord;
+    samplerPixelSeed = hashCombine(hashCombine(samplerSeed, pixelCoord.x), pixelCoord.y);
+}
 
 void initRNG(uvec2 pixelCoord, uint frame) {
     // Mix pixel coordinates and frame into a single seed
     uint seed = pixelCoord.x * 747796405u +
     pixelCoord.y * 2891336453u +
-    frame * 277803737u;
+    frame * 277803737u +
+    samplerSeed * 3266489917u;
 
     // Run the hash once to scramble the initial seed
     // (avoids patterns if seed values are sequential)
     rngState = seed;
     pcg_hash(rngState);
+
+    setSamplerPixel(pixelCoord);
+    beginSample(0u);
+}
+
+// State a wavefront path carries between stages (PathState.pixel.yzw)
+uvec3 samplerState() {
+    return uvec3(rngState, sampleNumber, sampleDimension);
+}
+
+void restoreSampler(uvec2 pixelCoord, uvec3 state) {
+    setSamplerPixel(pixelCoord);
+    rngState = state.x;
+    sampleNumber = state.y;
+    sampleDimension = state.z;
+}
+
+// Each output bit depends only on the input bits below it, so on reversed
+// bits this is an Owen scramble (Laine-Karras hash as in Burley 2020)
+uint laineKarrasPermutation(uint x, uint seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint nestedUniformScramble(uint x, uint seed) {
+    return bitfieldReverse(laineKarrasPermutation(bitfieldReverse(x), seed));
+}
+
+// Second Sobol dimension (x + 1 polynomial); the first is bitfieldReverse
+uint sobolSecondDimension(uint index) {
+    uint result = 0u;
+    for (uint v = 0x80000000u; index != 0u; index >>= 1u, v ^= v >> 1u) {
+        if ((index & 1u) != 0u) result ^= v;
+    }
+    return result;
+}
+
+float sobolSample(uint seed) {
+    uint pairSeed = hashCombine(seed, sampleDimension >> 1u);
+    uint component = sampleDimension & 1u;
+    sampleDimension++;
+
+    // Both dimensions of a pair see the same shuffled index
+    uint index = nestedUniformScramble(sampleNumber, pairSeed);
+    uint bits = component == 0u ? bitfieldReverse(index) : sobolSecondDimension(index);
+    bits = nestedUniformScramble(bits, hashCombine(pairSeed, component + 1u));
+    return float(bits >> 8u) * (1.0 / 16777216.0);
+}
+
+float blueNoiseSample() {
+    // The mask is read at a different toroidal offset for every dimension
+    uvec2 texel = (samplerPixel + sampleDimension * uvec2(37u, 23u)) % uint(BLUE_NOISE_SIZE);
+    int rank = blueNoiseRanks[texel.y * uint(BLUE_NOISE_SIZE) + texel.x];
+    float shift = (float(rank) + 0.5) / float(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+    return fract(sobolSample(samplerSeed) + shift);
 }
 
 float randomFloat() {
+    if (samplerType == SAMPLER_SOBOL) return sobolSample(samplerPixelSeed);
+    if (samplerType == SAMPLER_BLUE_NOISE) return blueNoiseSample();
+
     uint x = pcg_hash(rngState);
 
     // 0x3f800000u is the bit representation of 1.0
@@ -47,6 +151,23 @@ vec3 randomPointOnUnitSphere() {
 }
 
 vec2 randomPointInUnitDisk() {
+    // Low-discrepancy points keep their stratification only through a
+    // mapping that uses exactly two dimensions: concentric (Shirley-Chiu)
+    if (samplerType != SAMPLER_PCG) {
+        vec2 u = vec2(randomFloat(), randomFloat()) * 2.0 - 1.0;
+        if (u.x == 0.0 && u.y == 0.0) return vec2(0.0);
+        float r;
+        float theta;
+        if (abs(u.x) > abs(u.y)) {
+            r = u.x;
+            theta = 0.78539816 * (u.y / u.x);
+        } else {
+            r = u.y;
+            theta = 1.57079633 - 0.78539816 * (u.x / u.y);
+        }
+        return r * vec2(cos(theta), sin(theta));
+    }
+
     // Rejection sampling is simplest and works well
     while (true) {
         vec2 p = vec2(randomFloat(-1.0, 1.0), randomFloat(-1.0, 1.0));
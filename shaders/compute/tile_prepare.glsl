@@ -0,0 +1,25 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "tiles.glsl"
+
+// Single-invocation bookkeeping before a scheduled megakernel frame: splits
+// the list read this frame into bandCount indirect dispatches and empties
+// the list the frame appends to.
+
+layout (local_size_x = 1) in;
+
+uniform uint readList;
+uniform uint bandCount;
+
+void main()
+{
+    uint length = listLength[readList];
+    uint perBand = (length + bandCount - 1u) / bandCount;
+    for (uint band = 0u; band < uint(TILE_MAX_BANDS); band++) {
+        uint first = min(band * perBand, length);
+        uint groups = band < bandCount ? min(perBand, length - first) : 0u;
+        bandArgs[band] = uvec4(groups, 1u, 1u, first);
+    }
+    listLength[readList ^ 1u] = 0u;
+}
@@ -0,0 +1,24 @@
+#ifndef TILES_GLSL
+#define TILES_GLSL
+
+// Tile lists of the megakernel (TileScheduler in tiles.cpp). A tile is one
+// 16x16 workgroup of main.glsl. Two lists take turns: a frame renders the
+// tiles of one and appends the tiles that still want samples to the other,
+// so converged tiles drop out of later frames. Matches the layout in
+// tiles.cpp.
+
+#define TILE_MAX_BANDS 16
+
+layout(std430, binding = 21) buffer TileSchedule {
+    // glDispatchComputeIndirect arguments (xyz) of each band of the list
+    // being read; w: its first entry
+    uvec4 bandArgs[TILE_MAX_BANDS];
+    uint listLength[2];
+    uint tileCapacity;
+    uint _tilePad;
+    // [0, tileCapacity): list 0, [tileCapacity, 2 * tileCapacity): list 1.
+    // Entries are (y << 16) | x in tiles.
+    uint tileLists[];
+};
+
+#endif
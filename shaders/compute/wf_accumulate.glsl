@@ -0,0 +1,82 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 5: adds the finished sample to the pixel's frame sums and,
+// after the frame's last sample, merges them into the accumulation images
+// exactly like the tail of the megakernel.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+layout (rgba32f, binding = 0) uniform image2D outputImage;
+layout (rgba32f, binding = 1) uniform image2D accumImage;
+layout (rgba32f, binding = 2) uniform image2D momentImage;
+layout (rgba32f, binding = 4) uniform image2D outputBloom;
+layout (rgba32f, binding = 5) uniform image2D accumBloom;
+
+layout(std430, binding = 7) buffer AdaptiveStats {
+    uint activePixels;
+    uint renderedSamples;   // pixel samples traced this frame
+};
+
+uniform uint sampleIndex;
+
+void main()
+{
+    uint pathIndex = gl_GlobalInvocationID.x;
+    if (pathIndex >= chunkSize) return;
+
+    PathState path = paths[pathIndex];
+    if (path.pixel.x == WF_IDLE_PIXEL) return;
+
+    float sampleLum = luminance(path.radiance.rgb);
+    vec4 frameRadiance = path.frameRadiance + vec4(path.radiance.rgb, sampleLum * sampleLum);
+    vec4 frameBloom = path.frameBloom + vec4(path.bloom.rgb, 0.0);
+
+    if (sampleIndex + 1u < uint(samplesPerFrame)) {
+        paths[pathIndex].frameRadiance = frameRadiance;
+        paths[pathIndex].frameBloom = frameBloom;
+        return;
+    }
+
+    atomicAdd(renderedSamples, uint(samplesPerFrame));
+
+    uint width = uint(resolution.x);
+    ivec2 pixelCoords = ivec2(path.pixel.x % width, path.pixel.x / width);
+    vec4 prevVisual = imageLoad(accumImage, pixelCoords);
+    vec4 prevBloom = imageLoad(accumBloom, pixelCoords);
+    vec4 prevMoment = imageLoad(momentImage, pixelCoords);
+    float currentSampleCount = prevVisual.a;
+
+    if (isSafe(frameRadiance.rgb) && isSafe(frameBloom.rgb)) {
+        vec3 totalVisual = prevVisual.rgb + frameRadiance.rgb;
+        float totalSamples = currentSampleCount + float(samplesPerFrame);
+        imageStore(accumImage, pixelCoords, vec4(totalVisual, totalSamples));
+
+        vec3 totalBloom = prevBloom.rgb + frameBloom.rgb;
+        imageStore(accumBloom, pixelCoords, vec4(totalBloom, totalSamples));
+
+        vec3 finalVisual = totalVisual / totalSamples;
+        vec3 finalBloom = totalBloom / totalSamples;
+
+        imageStore(outputImage, pixelCoords, vec4(finalVisual, 1.0));
+        imageStore(outputBloom, pixelCoords, vec4(finalBloom, 1.0));
+
+        bool stillActive = totalSamples < float(maxTotalSamples);
+        if (adaptiveEnabled != 0) {
+            float totalLumSq = prevMoment.r + frameRadiance.a;
+            bool converged = totalSamples >= float(adaptiveMinSamples) &&
+                relativeError(luminance(totalVisual), totalLumSq, totalSamples) < adaptiveThreshold;
+            imageStore(momentImage, pixelCoords, vec4(totalLumSq, converged ? 1.0 : 0.0, 0.0, 0.0));
+            stillActive = stillActive && !converged;
+        }
+        if (stillActive) atomicAdd(activePixels, 1u);
+    } else {
+        atomicAdd(activePixels, 1u);
+    }
+}
@@ -0,0 +1,94 @@
+// Shared state of the wavefront pipeline (wf_*.glsl). One path slot per pixel
+// of the current chunk; the stages hand paths to each other through index
+// queues whose lengths are bumped with atomics. Matches WavefrontPipeline in
+// wavefront.cpp.
+
+#define WF_GROUP_SIZE 64
+
+struct PathState {
+    vec4 origin;         // xyz: ray origin, w: hit distance written by extend
+    vec4 direction;      // xyz: ray direction, w: 1 if the last bounce was specular
+    vec4 throughput;     // xyz
+    vec4 radiance;       // xyz: this sample
+    vec4 bloom;          // xyz: this sample
+    vec4 hitNormal;      // xyz: normal written by extend, w: 1 if front face
+    vec4 frameRadiance;  // xyz: sum over this frame's samples, w: sum of luminance^2
+    vec4 frameBloom;     // xyz: sum over this frame's samples
+    ivec4 hitInfo;       // x: material, y: object, z: subsurface material (-1 outside), w: 1 if hit
+    uvec4 pixel;         // x: pixel index (WF_IDLE_PIXEL if done this frame), yzw: sampler state
+};
+
+struct ShadowRay {
+    vec4 origin;         // xyz: origin, w: distance to the light sample
+    vec3 direction;
+    int lightInstIndex;  // instance of the light object, -1 if none
+    vec3 contribution;   // throughput * radiance * BRDF / pdf, before transmittance
+    int lightObjIndex;   // -1: no contribution
+};
+
+layout(std430, binding = 11) buffer PathBuffer {
+    PathState paths[];
+};
+
+// [0, 2 * pathCapacity): extension queues (ping-pong by queueParity)
+// [2 * pathCapacity, 3 * pathCapacity): surface shading queue
+// [3 * pathCapacity, 4 * pathCapacity): subsurface (medium) queue
+// [4 * pathCapacity, 5 * pathCapacity): shadow queue
+layout(std430, binding = 12) buffer QueueBuffer {
+    uint queues[];
+};
+
+layout(std430, binding = 13) buffer WavefrontCounters {
+    uint rayCount[2];
+    uint surfaceCount;
+    uint mediumCount;
+    uint shadowCount;
+    uint _counterPad0;
+    uint _counterPad1;
+    uint _counterPad2;
+    uvec4 extendArgs;    // glDispatchComputeIndirect arguments (xyz)
+    uvec4 surfaceArgs;
+    uvec4 mediumArgs;
+    uvec4 shadowArgs;
+};
+
+// lightSamples entries per path slot
+layout(std430, binding = 14) buffer ShadowRayBuffer {
+    ShadowRay shadowRays[];
+};
+
+uniform uint pathCapacity;
+uniform uint chunkOffset;   // first pixel of the current chunk
+uniform uint chunkSize;     // path slots in use
+uniform uint queueParity;   // extension queue read this bounce; the other one is filled
+uniform uint bounceIndex;
+
+#define WF_IDLE_PIXEL 0xffffffffu
+
+uvec2 pathPixel(uint pixelIndex) {
+    uint width = uint(resolution.x);
+    return uvec2(pixelIndex % width, pixelIndex / width);
+}
+
+uint extendQueueBase(uint parity) { return parity * pathCapacity; }
+uint surfaceQueueBase() { return 2u * pathCapacity; }
+uint mediumQueueBase() { return 3u * pathCapacity; }
+uint shadowQueueBase() { return 4u * pathCapacity; }
+
+void pushExtend(uint pathIndex) {
+    uint slot = atomicAdd(rayCount[queueParity ^ 1u], 1u);
+    queues[extendQueueBase(queueParity ^ 1u) + slot] = pathIndex;
+}
+
+// Hit written by the extend stage; p is rebuilt exactly as hitWorld() computes it
+HitRecord pathHit(PathState path) {
+    HitRecord rec;
+    rec.t = path.origin.w;
+    rec.p = path.origin.xyz + rec.t * path.direction.xyz;
+    rec.normal = path.hitNormal.xyz;
+    rec.frontFace = path.hitNormal.w > 0.5;
+    rec.matIndex = path.hitInfo.x;
+    rec.objIndex = path.hitInfo.y;
+    rec.instIndex = -1;  // not kept; shading only needs the object
+    return rec;
+}
@@ -0,0 +1,52 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 2: closest hit for every queued ray. Misses pick up the sky
+// and end; hits are sorted into the surface or the subsurface queue so the
+// shading kernels only see one kind of work.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+
+void main()
+{
+    uint queueIndex = gl_GlobalInvocationID.x;
+    if (queueIndex >= rayCount[queueParity]) return;
+    uint pathIndex = queues[extendQueueBase(queueParity) + queueIndex];
+
+    vec3 rayOrigin = paths[pathIndex].origin.xyz;
+    vec3 rayDir = paths[pathIndex].direction.xyz;
+    bool insideSSS = paths[pathIndex].hitInfo.z >= 0;
+
+    HitRecord rec;
+    bool hit = hitWorld(rayOrigin, rayDir, 0.001, INFINITY, rec);
+
+    if (!hit && !insideSSS) {
+        vec3 sky = sampleSky(rayDir);
+        vec3 throughput = paths[pathIndex].throughput.xyz;
+        paths[pathIndex].radiance.xyz += throughput * sky;
+        paths[pathIndex].bloom.xyz += throughput * sky;
+        return;
+    }
+
+    if (hit) {
+        paths[pathIndex].origin.w = rec.t;
+        paths[pathIndex].hitNormal = vec4(rec.normal, rec.frontFace ? 1.0 : 0.0);
+        paths[pathIndex].hitInfo.xy = ivec2(rec.matIndex, rec.objIndex);
+    }
+    paths[pathIndex].hitInfo.w = hit ? 1 : 0;
+
+    if (insideSSS) {
+        uint slot = atomicAdd(mediumCount, 1u);
+        queues[mediumQueueBase() + slot] = pathIndex;
+    } else {
+        uint slot = atomicAdd(surfaceCount, 1u);
+        queues[surfaceQueueBase() + slot] = pathIndex;
+    }
+}
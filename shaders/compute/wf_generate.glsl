@@ -0,0 +1,71 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 1: one camera ray per active pixel of the chunk into
+// extension queue 0. The sampler state carries over between the samples of
+// a frame, so a pixel sees the same sequence as in the megakernel.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+layout (rgba32f, binding = 1) uniform image2D accumImage;
+layout (rgba32f, binding = 2) uniform image2D momentImage;
+
+uniform uint sampleIndex;   // 0 .. samplesPerFrame - 1
+
+void main()
+{
+    uint pathIndex = gl_GlobalInvocationID.x;
+    if (pathIndex >= chunkSize) return;
+
+    uint pixelIndex = chunkOffset + pathIndex;
+    uint width = uint(resolution.x);
+    ivec2 pixelCoords = ivec2(pixelIndex % width, pixelIndex / width);
+
+    if (sampleIndex == 0u) {
+        vec4 prevVisual = imageLoad(accumImage, pixelCoords);
+        vec4 prevMoment = imageLoad(momentImage, pixelCoords);
+        bool active = prevVisual.a < float(maxTotalSamples);
+        if (adaptiveEnabled != 0 && prevMoment.g > 0.5) active = false;
+        if (!active) {
+            paths[pathIndex].pixel = uvec4(WF_IDLE_PIXEL, 0u, 0u, 0u);
+            return;
+        }
+        initRNG(uvec2(pixelCoords), frameCount);
+        beginSample(uint(prevVisual.a));
+        paths[pathIndex].frameRadiance = vec4(0.0);
+        paths[pathIndex].frameBloom = vec4(0.0);
+    } else {
+        if (paths[pathIndex].pixel.x == WF_IDLE_PIXEL) return;
+        restoreSampler(uvec2(pixelCoords), paths[pathIndex].pixel.yzw);
+        beginSample(sampleNumber + 1u);
+    }
+
+    vec2 jitter = vec2(randomFloat(), randomFloat());
+    vec2 uv = (vec2(pixelCoords) + jitter) / resolution;
+    vec2 ndc = uv * 2.0 - 1.0;
+    float aspectRatio = resolution.x / resolution.y;
+    ndc.x *= aspectRatio;
+    float fovRadians = radians(cameraFOV);
+    float planeScale = tan(fovRadians * 0.5);
+    vec3 pixelTarget = cameraOrigin + (cameraForward + (ndc.x * planeScale * cameraRight) + (ndc.y * planeScale * cameraUp)) * focusDist;
+    vec2 lensSample = randomPointInUnitDisk() * aperture * 0.5;
+    vec3 rayOrigin = cameraOrigin + (cameraRight * lensSample.x) + (cameraUp * lensSample.y);
+    vec3 rayDir = normalize(pixelTarget - rayOrigin);
+
+    paths[pathIndex].origin = vec4(rayOrigin, 0.0);
+    paths[pathIndex].direction = vec4(rayDir, 1.0);
+    paths[pathIndex].throughput = vec4(1.0);
+    paths[pathIndex].radiance = vec4(0.0);
+    paths[pathIndex].bloom = vec4(0.0);
+    paths[pathIndex].hitInfo = ivec4(-1, -1, -1, 0);
+    paths[pathIndex].pixel = uvec4(pixelIndex, samplerState());
+
+    uint slot = atomicAdd(rayCount[0], 1u);
+    queues[extendQueueBase(0u) + slot] = pathIndex;
+}
@@ -0,0 +1,47 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 3b: one subsurface random-walk step for paths inside a
+// medium. Kept apart from wf_shade so the long SSS walks do not hold up
+// surface shading warps.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+
+void main()
+{
+    uint queueIndex = gl_GlobalInvocationID.x;
+    if (queueIndex >= mediumCount) return;
+    uint pathIndex = queues[mediumQueueBase() + queueIndex];
+
+    PathState path = paths[pathIndex];
+    HitRecord rec = pathHit(path);
+    bool hitBoundary = path.hitInfo.w != 0;
+    restoreSampler(pathPixel(path.pixel.x), path.pixel.yzw);
+
+    vec3 sssSigmaT;
+    vec3 sssAlbedo;
+    subsurfaceCoefficients(materials[path.hitInfo.z], sssSigmaT, sssAlbedo);
+
+    vec3 currentOrigin = path.origin.xyz;
+    vec3 currentDir = path.direction.xyz;
+    vec3 throughput = path.throughput.xyz;
+    bool insideSSS = true;
+    bool lastPathWasSpecular = path.direction.w > 0.5;
+
+    subsurfaceStep(hitBoundary, rec, sssSigmaT, sssAlbedo,
+                   currentOrigin, currentDir, throughput, insideSSS, lastPathWasSpecular);
+
+    paths[pathIndex].origin.xyz = currentOrigin;
+    paths[pathIndex].direction = vec4(currentDir, lastPathWasSpecular ? 1.0 : 0.0);
+    paths[pathIndex].throughput.xyz = throughput;
+    paths[pathIndex].hitInfo.z = insideSSS ? path.hitInfo.z : -1;
+    paths[pathIndex].pixel.yzw = samplerState();
+    pushExtend(pathIndex);
+}
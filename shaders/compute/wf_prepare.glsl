@@ -0,0 +1,44 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "hittable.glsl"
+#include "wf_common.glsl"
+
+// Single-invocation bookkeeping between wavefront stages: turns queue lengths
+// into indirect dispatch sizes and clears the queues about to be filled.
+
+#define STAGE_RESET 0
+#define STAGE_EXTEND 1
+#define STAGE_SHADE 2
+#define STAGE_SHADOW 3
+
+layout (local_size_x = 1) in;
+
+uniform int prepareStage;
+
+uvec4 groupsFor(uint count) {
+    uint groupSize = uint(WF_GROUP_SIZE);
+    return uvec4((count + groupSize - 1u) / groupSize, 1u, 1u, 0u);
+}
+
+void main()
+{
+    if (prepareStage == STAGE_RESET) {
+        rayCount[0] = 0u;
+        rayCount[1] = 0u;
+        surfaceCount = 0u;
+        mediumCount = 0u;
+        shadowCount = 0u;
+    } else if (prepareStage == STAGE_EXTEND) {
+        extendArgs = groupsFor(rayCount[queueParity]);
+        rayCount[queueParity ^ 1u] = 0u;
+        surfaceCount = 0u;
+        mediumCount = 0u;
+        shadowCount = 0u;
+    } else if (prepareStage == STAGE_SHADE) {
+        surfaceArgs = groupsFor(surfaceCount);
+        mediumArgs = groupsFor(mediumCount);
+    } else if (prepareStage == STAGE_SHADOW) {
+        shadowArgs = groupsFor(shadowCount);
+    }
+}
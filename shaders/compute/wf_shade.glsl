@@ -0,0 +1,137 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 3a: surface interactions (emission, tint, subsurface entry,
+// BSDF sampling, russian roulette). Light samples are not traced here; they
+// are written to the shadow-ray buffer and resolved by wf_shadow.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+
+void main()
+{
+    uint queueIndex = gl_GlobalInvocationID.x;
+    if (queueIndex >= surfaceCount) return;
+    uint pathIndex = queues[surfaceQueueBase() + queueIndex];
+
+    PathState path = paths[pathIndex];
+    HitRecord rec = pathHit(path);
+    restoreSampler(pathPixel(path.pixel.x), path.pixel.yzw);
+
+    vec3 throughput = path.throughput.xyz;
+    vec3 radiance = path.radiance.xyz;
+    vec3 bloomRadiance = path.bloom.xyz;
+    vec3 currentOrigin = path.origin.xyz;
+    vec3 currentDir = path.direction.xyz;
+    bool lastPathWasSpecular = path.direction.w > 0.5;
+    int sssMatIndex = -1;
+    bool alive = true;
+
+    Material mat = materials[rec.matIndex];
+    float effectiveBloomStr = (mat.bloomIntensity < 0.0) ? mat.emissionStrength : mat.bloomIntensity;
+
+    bool hitLight = false;
+    for (int i = 0; i < lightCount; i++) {
+        if (rec.objIndex == lightIndices[i]) { hitLight = true; break; }
+    }
+
+    if (mat.emissionMode == EMISSION_ABSOLUTE) {
+        if (effectiveBloomStr > 0.0) {
+            vec3 filterDelta = mat.emission - vec3(1.0);
+            bloomRadiance += throughput * filterDelta * effectiveBloomStr;
+        }
+        throughput *= mat.emission * mat.emissionStrength;
+        currentOrigin = rec.p + currentDir * 0.001;
+    } else if (hitLight || (mat.emissionStrength > 0.0 || effectiveBloomStr > 0.0)) {
+        if (lastPathWasSpecular) {
+            radiance += throughput * mat.emission * mat.emissionStrength;
+            bloomRadiance += throughput * mat.emission * effectiveBloomStr;
+        }
+        alive = false;
+    } else {
+        vec4 tintData = sampleTintSources(rec.p, rec.normal, rec.objIndex);
+        vec3 tintColor = tintData.rgb;
+        float tintFactor = tintData.a;
+        radiance += throughput * tintColor;
+        bloomRadiance += throughput * tintColor;
+        throughput *= (1.0 - tintFactor);
+
+        bool enteredSSS = false;
+        if (mat.subsurface > 0.0 && rec.frontFace) {
+            vec3 f0 = calculateF0(mat.albedo, mat.metallic, mat.specularTint, mat.specular);
+            vec3 fresnel = schlickFresnelRoughness(dot(rec.normal, -currentDir), f0, mat.roughness);
+            float reflectProb = (fresnel.r + fresnel.g + fresnel.b) / 3.0;
+            if (randomFloat() > reflectProb) {
+                enteredSSS = true;
+                sssMatIndex = rec.matIndex;
+                float eta = 1.0 / mat.ior;
+                currentDir = refractVec(currentDir, rec.normal, eta);
+                currentOrigin = rec.p - rec.normal * 0.001;
+            }
+        }
+
+        if (!enteredSSS) {
+            bool skipNEE = mat.transmission > 0.01 || mat.subsurface > 0.0;
+            if (!skipNEE && bounceIndex < maxBounces - 1u && lightTableSize > 0) {
+                vec3 V = -currentDir;
+                int neeSamples = max(lightSamples, 1);
+                bool anyShadowRay = false;
+                for (int s = 0; s < neeSamples; s++) {
+                    LightEntry light = sampleLightTable();
+                    vec3 L;
+                    float dist;
+                    vec3 contribution;
+                    bool valid = sampleLightContribution(rec.p, rec.normal, V, mat, light, L, dist, contribution);
+                    ShadowRay shadowRay;
+                    shadowRay.origin = vec4(rec.p + rec.normal * 0.001, dist);
+                    shadowRay.direction = L;
+                    shadowRay.lightInstIndex = light.instIndex;
+                    shadowRay.contribution = throughput * contribution / (light.pdf * float(neeSamples));
+                    shadowRay.lightObjIndex = valid ? light.objIndex : -1;
+                    shadowRays[pathIndex * uint(neeSamples) + uint(s)] = shadowRay;
+                    anyShadowRay = anyShadowRay || valid;
+                }
+                if (anyShadowRay) {
+                    uint slot = atomicAdd(shadowCount, 1u);
+                    queues[shadowQueueBase() + slot] = pathIndex;
+                }
+            }
+
+            vec3 attenuation;
+            vec3 scattered;
+            bool isSpecularBounce;
+            if (scatter(mat, currentDir, rec, attenuation, scattered, isSpecularBounce)) {
+                throughput *= attenuation;
+                currentOrigin = rec.p;
+                currentDir = scattered;
+                if (isSpecularBounce) lastPathWasSpecular = true;
+                else lastPathWasSpecular = skipNEE;
+
+                if (bounceIndex > 3u) {
+                    float p = max(throughput.r, max(throughput.g, throughput.b));
+                    if (randomFloat() > p) alive = false;
+                    else throughput /= p;
+                }
+            } else {
+                alive = false;
+            }
+        }
+    }
+
+    paths[pathIndex].radiance.xyz = radiance;
+    paths[pathIndex].bloom.xyz = bloomRadiance;
+    paths[pathIndex].pixel.yzw = samplerState();
+    if (!alive) return;
+
+    paths[pathIndex].origin.xyz = currentOrigin;
+    paths[pathIndex].direction = vec4(currentDir, lastPathWasSpecular ? 1.0 : 0.0);
+    paths[pathIndex].throughput.xyz = throughput;
+    paths[pathIndex].hitInfo.z = sssMatIndex;
+    pushExtend(pathIndex);
+}
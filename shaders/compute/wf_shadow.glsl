@@ -0,0 +1,35 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive: require
+
+#include "camera.glsl"
+#include "hittable.glsl"
+#include "random.glsl"
+#include "material.glsl"
+#include "integrator.glsl"
+#include "wf_common.glsl"
+
+// Wavefront stage 4: occlusion for the light samples queued by wf_shade.
+// One invocation per path walks all of its lightSamples rays, so the path's
+// radiance is only written by one thread.
+
+layout (local_size_x = WF_GROUP_SIZE) in;
+
+void main()
+{
+    uint queueIndex = gl_GlobalInvocationID.x;
+    if (queueIndex >= shadowCount) return;
+    uint pathIndex = queues[shadowQueueBase() + queueIndex];
+
+    int neeSamples = max(lightSamples, 1);
+    vec3 directLight = vec3(0.0);
+    for (int s = 0; s < neeSamples; s++) {
+        ShadowRay shadowRay = shadowRays[pathIndex * uint(neeSamples) + uint(s)];
+        if (shadowRay.lightObjIndex < 0) continue;
+        directLight += shadowRay.contribution *
+            traceShadowRay(shadowRay.origin.xyz, shadowRay.direction, shadowRay.origin.w,
+                           shadowRay.lightObjIndex, shadowRay.lightInstIndex);
+    }
+
+    paths[pathIndex].radiance.xyz += directLight;
+    paths[pathIndex].bloom.xyz += directLight;
+}
@@ -0,0 +1,453 @@
+#include "BVH.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RAYPULSE_BVH_SSE 1
+#endif
+
+namespace {
+
+constexpr int MAX_LEAF_SIZE = 4;
+constexpr int BIN_COUNT = 32;
+constexpr float TRAVERSAL_COST = 1.0f;
+constexpr float INTERSECT_COST = 1.0f;
+
+// Ranges at least this large are reduced and binned on every thread
+constexpr int PARALLEL_RANGE_MIN = 1 << 16;
+// The top of the tree is split on the calling thread until ranges are this
+// small (or 1/256 of the primitives); each such subtree is then one task.
+// Fixed rather than derived from the thread count so the node order is too.
+constexpr int TASK_MIN_SIZE = 1024;
+constexpr int TASKS_PER_BUILD = 256;
+
+// Box and point as four lanes (x, y, z, unused) so a grow is one min and
+// one max
+struct alignas(16) Box {
+    float lo[4];
+    float hi[4];
+};
+
+struct alignas(16) Point {
+    float p[4];
+};
+
+#ifdef RAYPULSE_BVH_SSE
+struct BoxAccumulator {
+    __m128 lo = _mm_set1_ps(1e30f);
+    __m128 hi = _mm_set1_ps(-1e30f);
+
+    void grow(const Box& box) {
+        lo = _mm_min_ps(lo, _mm_load_ps(box.lo));
+        hi = _mm_max_ps(hi, _mm_load_ps(box.hi));
+    }
+
+    void grow(const Point& point) {
+        const __m128 p = _mm_load_ps(point.p);
+        lo = _mm_min_ps(lo, p);
+        hi = _mm_max_ps(hi, p);
+    }
+
+    void grow(const BoxAccumulator& other) {
+        lo = _mm_min_ps(lo, other.lo);
+        hi = _mm_max_ps(hi, other.hi);
+    }
+
+    Box box() const {
+        Box result;
+        _mm_store_ps(result.lo, lo);
+        _mm_store_ps(result.hi, hi);
+        return result;
+    }
+};
+#else
+struct BoxAccumulator {
+    Box bounds = {{1e30f, 1e30f, 1e30f, 1e30f}, {-1e30f, -1e30f, -1e30f, -1e30f}};
+
+    void grow(const Box& box) {
+        for (int k = 0; k < 4; ++k) {
+            bounds.lo[k] = std::min(bounds.lo[k], box.lo[k]);
+            bounds.hi[k] = std::max(bounds.hi[k], box.hi[k]);
+        }
+    }
+
+    void grow(const Point& point) {
+        for (int k = 0; k < 4; ++k) {
+            bounds.lo[k] = std::min(bounds.lo[k], point.p[k]);
+            bounds.hi[k] = std::max(bounds.hi[k], point.p[k]);
+        }
+    }
+
+    void grow(const BoxAccumulator& other) { grow(other.bounds); }
+
+    Box box() const { return bounds; }
+};
+#endif
+
+float halfArea(const Box& box) {
+    const float ex = box.hi[0] - box.lo[0];
+    const float ey = box.hi[1] - box.lo[1];
+    const float ez = box.hi[2] - box.lo[2];
+    if (ex < 0.0f || ey < 0.0f || ez < 0.0f) return 0.0f;
+    return ex * ey + ey * ez + ez * ex;
+}
+
+struct Bin {
+    BoxAccumulator bounds;
+    int count = 0;
+};
+
+// Small ranges use fewer bins: resetting and sweeping all of them would
+// cost more than binning the few primitives
+struct BinSet {
+    Bin bins[3][BIN_COUNT];
+    int binCount;
+
+    explicit BinSet(const int binCount) : binCount(binCount) {}
+
+    void merge(const BinSet& other) {
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int b = 0; b < binCount; ++b) {
+                bins[axis][b].bounds.grow(other.bins[axis][b].bounds);
+                bins[axis][b].count += other.bins[axis][b].count;
+            }
+        }
+    }
+};
+
+int binCountFor(const int count) {
+    return std::clamp(count, 4, BIN_COUNT);
+}
+
+struct Split {
+    int axis = -1;           // -1: no split separates the centroids
+    int bin = 0;             // bins [0, bin) go left
+    int binCount = BIN_COUNT;
+    float cost = 1e30f;
+};
+
+// A subtree left for the task phase; nodeIndex is its root in the final array
+struct Task {
+    int nodeIndex;
+    int first;
+    int count;
+    int depth;
+};
+
+// Runs job(k) for every k in [0, count); the last one on the calling thread
+template <typename Job>
+void runParallel(const unsigned count, const Job& job) {
+    std::vector<std::thread> workers;
+    workers.reserve(count > 0 ? count - 1 : 0);
+    for (unsigned k = 0; k + 1 < count; ++k) {
+        workers.emplace_back(job, k);
+    }
+    if (count > 0) job(count - 1);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+class Builder {
+public:
+    Builder(const std::vector<AABB>& primBounds, std::vector<int>& primIndices, const unsigned threadCount)
+        : boxes(primBounds.size()), centroids(primBounds.size()), primIndices(primIndices), threadCount(threadCount) {
+        for (size_t i = 0; i < primBounds.size(); ++i) {
+            const AABB& b = primBounds[i];
+            const glm::vec3 c = b.centroid();
+            boxes[i] = {{b.min.x, b.min.y, b.min.z, 0.0f}, {b.max.x, b.max.y, b.max.z, 0.0f}};
+            centroids[i] = {{c.x, c.y, c.z, 0.0f}};
+        }
+    }
+
+    // Splits [first, first + count) under nodes[nodeIndex], which is at
+    // depth. With tasks set, ranges of at most taskSize are queued there
+    // instead of being built.
+    void subdivide(std::vector<GPUBVHNode>& nodes, const int nodeIndex, const int first, const int count,
+                   const int depth, std::vector<Task>* tasks, const int taskSize) {
+        if (tasks != nullptr && count <= taskSize) {
+            tasks->push_back({nodeIndex, first, count, depth});
+            return;
+        }
+
+        const bool parallel = tasks != nullptr && threadCount > 1 && count >= PARALLEL_RANGE_MIN;
+        Box bounds;
+        Box centroidBounds;
+        reduce(first, count, parallel, bounds, centroidBounds);
+        nodes[nodeIndex].boundsMin = glm::vec3(bounds.lo[0], bounds.lo[1], bounds.lo[2]);
+        nodes[nodeIndex].boundsMax = glm::vec3(bounds.hi[0], bounds.hi[1], bounds.hi[2]);
+
+        if (count <= 1) {
+            makeLeaf(nodes[nodeIndex], first, count);
+            return;
+        }
+
+        // Halving reaches single primitives ceilLog2(count) levels down; once
+        // that is all the depth left, SAH splits could run past it
+        int leftCount;
+        if (depth + ceilLog2(count) >= BVH_MAX_DEPTH) {
+            leftCount = medianSplit(first, count, centroidBounds);
+        } else {
+            const Split split = findSplit(first, count, bounds, centroidBounds, parallel);
+            const float leafCost = INTERSECT_COST * count;
+            if (count <= MAX_LEAF_SIZE && (split.axis < 0 || split.cost >= leafCost)) {
+                makeLeaf(nodes[nodeIndex], first, count);
+                return;
+            }
+
+            // Coincident centroids cannot be binned apart; halve the range
+            leftCount = split.axis >= 0 ? partition(first, count, split, centroidBounds) : count / 2;
+        }
+
+        const int leftChild = static_cast<int>(nodes.size());
+        nodes.push_back({});
+        nodes.push_back({});
+        nodes[nodeIndex].leftFirst = leftChild;
+        nodes[nodeIndex].count = 0;
+
+        subdivide(nodes, leftChild, first, leftCount, depth + 1, tasks, taskSize);
+        subdivide(nodes, leftChild + 1, first + leftCount, count - leftCount, depth + 1, tasks, taskSize);
+    }
+
+private:
+    std::vector<Box> boxes;
+    std::vector<Point> centroids;
+    std::vector<int>& primIndices;
+    unsigned threadCount;
+
+    static void makeLeaf(GPUBVHNode& node, const int first, const int count) {
+        node.leftFirst = first;
+        node.count = count;
+    }
+
+    static int ceilLog2(const int n) {
+        int bits = 0;
+        while ((int64_t{1} << bits) < n) ++bits;
+        return bits;
+    }
+
+    // Lower half of the centroids along the widest axis goes left
+    int medianSplit(const int first, const int count, const Box& centroidBounds) {
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (centroidBounds.hi[a] - centroidBounds.lo[a] > centroidBounds.hi[axis] - centroidBounds.lo[axis]) {
+                axis = a;
+            }
+        }
+        const int half = count / 2;
+        const auto begin = primIndices.begin() + first;
+        std::nth_element(begin, begin + half, begin + count, [&](const int a, const int b) {
+            return centroids[a].p[axis] < centroids[b].p[axis];
+        });
+        return half;
+    }
+
+    // Chunks of [first, first + count) for parallel passes
+    unsigned chunkCount(const int count, const bool parallel) const {
+        if (!parallel) return 1;
+        return std::max(1u, std::min(threadCount, static_cast<unsigned>(count / (PARALLEL_RANGE_MIN / 4))));
+    }
+
+    static int chunkBegin(const int first, const int count, const unsigned chunk, const unsigned chunks) {
+        return first + static_cast<int>(static_cast<int64_t>(count) * chunk / chunks);
+    }
+
+    static float binScale(const Box& centroidBounds, const int axis, const int binCount) {
+        const float extent = centroidBounds.hi[axis] - centroidBounds.lo[axis];
+        return extent > 0.0f ? static_cast<float>(binCount) / extent : 0.0f;
+    }
+
+    // Shared by binning and partitioning so both agree on every primitive
+    static int binIndex(const float c, const float origin, const float scale, const int binCount) {
+        return std::min(binCount - 1, static_cast<int>((c - origin) * scale));
+    }
+
+    void reduceRange(const int begin, const int end, BoxAccumulator& bounds, BoxAccumulator& centroidBounds) const {
+        for (int i = begin; i < end; ++i) {
+            const int prim = primIndices[i];
+            bounds.grow(boxes[prim]);
+            centroidBounds.grow(centroids[prim]);
+        }
+    }
+
+    void reduce(const int first, const int count, const bool parallel, Box& bounds, Box& centroidBounds) const {
+        BoxAccumulator boxAcc;
+        BoxAccumulator centroidAcc;
+        const unsigned chunks = chunkCount(count, parallel);
+        if (chunks == 1) {
+            reduceRange(first, first + count, boxAcc, centroidAcc);
+        } else {
+            std::vector<BoxAccumulator> chunkBoxes(chunks);
+            std::vector<BoxAccumulator> chunkCentroids(chunks);
+            runParallel(chunks, [&](const unsigned chunk) {
+                reduceRange(chunkBegin(first, count, chunk, chunks), chunkBegin(first, count, chunk + 1, chunks),
+                            chunkBoxes[chunk], chunkCentroids[chunk]);
+            });
+            for (unsigned chunk = 0; chunk < chunks; ++chunk) {
+                boxAcc.grow(chunkBoxes[chunk]);
+                centroidAcc.grow(chunkCentroids[chunk]);
+            }
+        }
+        bounds = boxAcc.box();
+        centroidBounds = centroidAcc.box();
+    }
+
+    void binRange(const int begin, const int end, const Box& centroidBounds, const float* scale, BinSet& set) const {
+        for (int i = begin; i < end; ++i) {
+            const int prim = primIndices[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                if (scale[axis] == 0.0f) continue;
+                Bin& bin = set.bins[axis][binIndex(centroids[prim].p[axis], centroidBounds.lo[axis], scale[axis], set.binCount)];
+                bin.bounds.grow(boxes[prim]);
+                bin.count++;
+            }
+        }
+    }
+
+    Split findSplit(const int first, const int count, const Box& bounds, const Box& centroidBounds,
+                    const bool parallel) const {
+        const int binCount = binCountFor(count);
+        float scale[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            scale[axis] = binScale(centroidBounds, axis, binCount);
+        }
+
+        BinSet binSet(binCount);
+        const unsigned chunks = chunkCount(count, parallel);
+        if (chunks == 1) {
+            binRange(first, first + count, centroidBounds, scale, binSet);
+        } else {
+            std::vector<BinSet> chunkBins(chunks, BinSet(binCount));
+            runParallel(chunks, [&](const unsigned chunk) {
+                binRange(chunkBegin(first, count, chunk, chunks), chunkBegin(first, count, chunk + 1, chunks),
+                         centroidBounds, scale, chunkBins[chunk]);
+            });
+            for (unsigned chunk = 0; chunk < chunks; ++chunk) {
+                binSet.merge(chunkBins[chunk]);
+            }
+        }
+
+        Split best;
+        best.binCount = binCount;
+        const float parentArea = std::max(halfArea(bounds), 1e-12f);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scale[axis] == 0.0f) continue;
+            const Bin* bins = binSet.bins[axis];
+
+            float rightArea[BIN_COUNT];
+            int rightCount[BIN_COUNT];
+            BoxAccumulator right;
+            int rightSum = 0;
+            for (int b = binCount - 1; b > 0; --b) {
+                right.grow(bins[b].bounds);
+                rightSum += bins[b].count;
+                rightArea[b] = halfArea(right.box());
+                rightCount[b] = rightSum;
+            }
+
+            BoxAccumulator left;
+            int leftSum = 0;
+            for (int b = 1; b < binCount; ++b) {
+                left.grow(bins[b - 1].bounds);
+                leftSum += bins[b - 1].count;
+                if (leftSum == 0 || rightCount[b] == 0) continue;
+                const float cost = TRAVERSAL_COST + INTERSECT_COST *
+                    (halfArea(left.box()) * leftSum + rightArea[b] * rightCount[b]) / parentArea;
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.bin = b;
+                }
+            }
+        }
+        return best;
+    }
+
+    int partition(const int first, const int count, const Split& split, const Box& centroidBounds) {
+        const float origin = centroidBounds.lo[split.axis];
+        const float scale = binScale(centroidBounds, split.axis, split.binCount);
+        const auto begin = primIndices.begin() + first;
+        const auto middle = std::partition(begin, begin + count, [&](const int prim) {
+            return binIndex(centroids[prim].p[split.axis], origin, scale, split.binCount) < split.bin;
+        });
+        return static_cast<int>(middle - begin);
+    }
+};
+
+} // namespace
+
+void BVHBuilder::build(const std::vector<AABB>& primBounds,
+                       std::vector<GPUBVHNode>& nodes,
+                       std::vector<int>& primIndices,
+                       const unsigned threadCount) {
+    nodes.clear();
+    primIndices.resize(primBounds.size());
+    std::iota(primIndices.begin(), primIndices.end(), 0);
+
+    if (primBounds.empty()) return;
+
+    const unsigned threads = threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    const int primCount = static_cast<int>(primBounds.size());
+    Builder builder(primBounds, primIndices, threads);
+
+    // Top levels on this thread (large ranges binned on all threads); the
+    // subtrees below them are independent tasks
+    std::vector<Task> tasks;
+    nodes.reserve(primBounds.size() * 2);
+    nodes.push_back({});
+    builder.subdivide(nodes, 0, 0, primCount, 0, &tasks, std::max(TASK_MIN_SIZE, primCount / TASKS_PER_BUILD));
+
+    // Workers take the largest remaining subtree next, each into its own array
+    std::vector<int> order(tasks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) {
+        return tasks[a].count > tasks[b].count;
+    });
+    std::vector<std::vector<GPUBVHNode>> subtrees(tasks.size());
+    std::atomic<size_t> nextTask{0};
+    const auto worker = [&](unsigned) {
+        for (size_t k = nextTask.fetch_add(1); k < order.size(); k = nextTask.fetch_add(1)) {
+            const Task& task = tasks[order[k]];
+            std::vector<GPUBVHNode>& subtree = subtrees[order[k]];
+            subtree.reserve(static_cast<size_t>(task.count) * 2);
+            subtree.push_back({});
+            builder.subdivide(subtree, 0, task.first, task.count, task.depth, nullptr, 0);
+        }
+    };
+    runParallel(std::min<unsigned>(threads, static_cast<unsigned>(tasks.size())), worker);
+
+    // Splice the subtrees in task order: a subtree's root replaces its
+    // placeholder and the rest is appended, so local node j lands at base + j
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        std::vector<GPUBVHNode>& subtree = subtrees[t];
+        const int base = static_cast<int>(nodes.size()) - 1;
+        for (GPUBVHNode& node : subtree) {
+            if (node.count == 0) node.leftFirst += base;
+        }
+        nodes[tasks[t].nodeIndex] = subtree[0];
+        nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+    }
+}
+
+float BVHBuilder::sahCost(const std::vector<GPUBVHNode>& nodes) {
+    if (nodes.empty()) return 0.0f;
+
+    const auto area = [](const GPUBVHNode& node) {
+        AABB box;
+        box.grow(node.boundsMin);
+        box.grow(node.boundsMax);
+        return box.surfaceArea();
+    };
+    const float rootArea = std::max(area(nodes[0]), 1e-12f);
+
+    double cost = 0.0;
+    for (const GPUBVHNode& node : nodes) {
+        const float nodeCost = node.count > 0 ? INTERSECT_COST * node.count : TRAVERSAL_COST;
+        cost += static_cast<double>(nodeCost) * area(node) / rootArea;
+    }
+    return static_cast<float>(cost);
+}
@@ -0,0 +1,1527 @@
+#include "CpuRenderer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "BVH.h"
+#include "sampler.h"
+
+// Everything below is a line-by-line port of shaders/compute/*.glsl.
+// Keep the two in sync: any change to the kernel should be mirrored here.
+
+namespace {
+
+constexpr float kInfinity = 10000.0f; // INFINITY in hittable.glsl
+constexpr float PI = 3.1415926535f;
+
+struct HitRecord {
+    float t = 0.0f;
+    glm::vec3 p{0.0f};
+    glm::vec3 normal{0.0f};
+    bool frontFace = false;
+    int matIndex = 0;
+    int objIndex = 0;
+    int instIndex = -1;
+};
+
+struct TraceResult {
+    glm::vec3 radiance;
+    glm::vec3 bloom;
+};
+
+// --- random.glsl ---
+
+uint32_t pcg_hash(uint32_t& state) {
+    const uint32_t state_curr = state * 747796405u + 2891336453u;
+    const uint32_t word = ((state_curr >> ((state_curr >> 28u) + 4u)) ^ state_curr) * 277803737u;
+    state = state_curr;
+    return (word >> 22u) ^ word;
+}
+
+float uintBitsToFloat(const uint32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+// GLSL SAMPLER_* values; SamplerType in SceneConfig.h
+constexpr int SAMPLER_SOBOL = static_cast<int>(SamplerType::Sobol);
+constexpr int SAMPLER_BLUE_NOISE = static_cast<int>(SamplerType::BlueNoise);
+
+uint32_t bitfieldReverse(uint32_t x) {
+    x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+    x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+    x = ((x >> 4u) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4u);
+    x = ((x >> 8u) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8u);
+    return (x >> 16u) | (x << 16u);
+}
+
+uint32_t hashCombine(const uint32_t seed, const uint32_t value) {
+    uint32_t state = seed ^ (value * 0x9e3779b9u + 0x7f4a7c15u);
+    return pcg_hash(state);
+}
+
+uint32_t laineKarrasPermutation(uint32_t x, const uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint32_t nestedUniformScramble(const uint32_t x, const uint32_t seed) {
+    return bitfieldReverse(laineKarrasPermutation(bitfieldReverse(x), seed));
+}
+
+uint32_t sobolSecondDimension(uint32_t index) {
+    uint32_t result = 0u;
+    for (uint32_t v = 0x80000000u; index != 0u; index >>= 1u, v ^= v >> 1u) {
+        if ((index & 1u) != 0u) result ^= v;
+    }
+    return result;
+}
+
+glm::vec3 reflectVec(const glm::vec3& I, const glm::vec3& N) {
+    return I - 2.0f * glm::dot(N, I) * N;
+}
+
+float signf(const float x) {
+    return static_cast<float>((x > 0.0f) - (x < 0.0f));
+}
+
+// --- hittable.glsl (free functions, no RNG) ---
+
+bool solveQuadratic(const float a, const float b, const float c, float& t0, float& t1) {
+    const float disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) return false;
+    const float sqrtDisc = std::sqrt(disc);
+    t0 = (-b - sqrtDisc) / (2.0f * a);
+    t1 = (-b + sqrtDisc) / (2.0f * a);
+    return true;
+}
+
+bool hitSphere(const glm::vec4& sphere, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+               const float tMin, const float tMax, HitRecord& rec) {
+    const glm::vec3 center = glm::vec3(sphere);
+    const float radius = sphere.w;
+    const glm::vec3 oc = rayOrigin - center;
+    const float a = glm::dot(rayDir, rayDir);
+    const float b = 2.0f * glm::dot(oc, rayDir);
+    const float c = glm::dot(oc, oc) - radius * radius;
+
+    float t0, t1;
+    if (!solveQuadratic(a, b, c, t0, t1)) return false;
+    float root = t0;
+    if (root <= tMin || root >= tMax) {
+        root = t1;
+        if (root <= tMin || root >= tMax) return false;
+    }
+    rec.t = root;
+    rec.p = rayOrigin + rec.t * rayDir;
+    const glm::vec3 outwardNormal = (rec.p - center) / radius;
+    rec.frontFace = glm::dot(rayDir, outwardNormal) < 0.0f;
+    rec.normal = rec.frontFace ? outwardNormal : -outwardNormal;
+    return true;
+}
+
+bool hitPlane(const glm::vec4& plane, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+              const float tMin, const float tMax, HitRecord& rec) {
+    const glm::vec3 normal = glm::vec3(plane);
+    const float dist = plane.w;
+    const float denom = glm::dot(normal, rayDir);
+    if (std::abs(denom) > 1e-6f) {
+        const float t = -(glm::dot(rayOrigin, normal) + dist) / denom;
+        if (t > tMin && t < tMax) {
+            rec.t = t;
+            rec.p = rayOrigin + t * rayDir;
+            rec.frontFace = denom < 0.0f;
+            rec.normal = rec.frontFace ? normal : -normal;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hitLocalCylinder(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& scale,
+                      const float tMin, const float tMax, float& tOut, glm::vec3& nOut) {
+    const float r = scale.x;
+    const float h = scale.y;
+    const float halfH = h * 0.5f;
+
+    const float a = rd.x * rd.x + rd.z * rd.z;
+    const float b = 2.0f * (ro.x * rd.x + ro.z * rd.z);
+    const float c = ro.x * ro.x + ro.z * ro.z - r * r;
+
+    float t0 = 0.0f, t1 = 0.0f;
+    const bool hitBody = solveQuadratic(a, b, c, t0, t1);
+
+    float tClosest = tMax;
+    glm::vec3 nClosest(0, 1, 0);
+    bool hit = false;
+
+    if (hitBody) {
+        const float y0 = ro.y + t0 * rd.y;
+        if (t0 > tMin && t0 < tClosest && y0 >= -halfH && y0 <= halfH) {
+            tClosest = t0;
+            nClosest = glm::vec3(ro.x + t0 * rd.x, 0.0f, ro.z + t0 * rd.z) / r;
+            hit = true;
+        }
+        const float y1 = ro.y + t1 * rd.y;
+        if (t1 > tMin && t1 < tClosest && y1 >= -halfH && y1 <= halfH) {
+            tClosest = t1;
+            nClosest = glm::vec3(ro.x + t1 * rd.x, 0.0f, ro.z + t1 * rd.z) / r;
+            hit = true;
+        }
+    }
+
+    const float tTop = (halfH - ro.y) / rd.y;
+    const glm::vec3 pTop = ro + tTop * rd;
+    if (tTop > tMin && tTop < tClosest && (pTop.x * pTop.x + pTop.z * pTop.z <= r * r)) {
+        tClosest = tTop; nClosest = glm::vec3(0, 1, 0); hit = true;
+    }
+
+    const float tBot = (-halfH - ro.y) / rd.y;
+    const glm::vec3 pBot = ro + tBot * rd;
+    if (tBot > tMin && tBot < tClosest && (pBot.x * pBot.x + pBot.z * pBot.z <= r * r)) {
+        tClosest = tBot; nClosest = glm::vec3(0, -1, 0); hit = true;
+    }
+
+    if (hit) { tOut = tClosest; nOut = nClosest; return true; }
+    return false;
+}
+
+bool hitLocalCone(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& scale,
+                  const float tMin, const float tMax, float& tOut, glm::vec3& nOut) {
+    const float r = scale.x;
+    const float h = scale.y;
+    const float halfH = h * 0.5f;
+
+    const float k = r / h;
+    const float k2 = k * k;
+
+    glm::vec3 ro_tip = ro; ro_tip.y -= halfH;
+
+    const float A = rd.x * rd.x + rd.z * rd.z - k2 * rd.y * rd.y;
+    const float B = 2.0f * (ro_tip.x * rd.x + ro_tip.z * rd.z - k2 * ro_tip.y * rd.y);
+    const float C = ro_tip.x * ro_tip.x + ro_tip.z * ro_tip.z - k2 * ro_tip.y * ro_tip.y;
+
+    float t0 = 0.0f, t1 = 0.0f;
+    const bool hitBody = solveQuadratic(A, B, C, t0, t1);
+
+    float tClosest = tMax;
+    glm::vec3 nClosest(0, 1, 0);
+    bool hit = false;
+
+    if (hitBody) {
+        const float y0 = ro.y + t0 * rd.y;
+        if (t0 > tMin && t0 < tClosest && y0 >= -halfH && y0 <= halfH) {
+            tClosest = t0;
+            const glm::vec3 p = ro + t0 * rd;
+            nClosest = glm::normalize(glm::vec3(p.x, -k2 * (p.y - halfH), p.z));
+            hit = true;
+        }
+        const float y1 = ro.y + t1 * rd.y;
+        if (t1 > tMin && t1 < tClosest && y1 >= -halfH && y1 <= halfH) {
+            tClosest = t1;
+            const glm::vec3 p = ro + t1 * rd;
+            nClosest = glm::normalize(glm::vec3(p.x, -k2 * (p.y - halfH), p.z));
+            hit = true;
+        }
+    }
+
+    const float tBase = (-halfH - ro.y) / rd.y;
+    const glm::vec3 pBase = ro + tBase * rd;
+    if (tBase > tMin && tBase < tClosest && (pBase.x * pBase.x + pBase.z * pBase.z <= r * r)) {
+        tClosest = tBase;
+        nClosest = glm::vec3(0, -1, 0);
+        hit = true;
+    }
+
+    if (hit) { tOut = tClosest; nOut = nClosest; return true; }
+    return false;
+}
+
+bool hitLocalBox(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& scale,
+                 const float tMin, const float tMax, float& tOut, glm::vec3& nOut) {
+    const glm::vec3 rad = scale;
+    const glm::vec3 m = 1.0f / rd;
+    const glm::vec3 n = m * ro;
+    const glm::vec3 k = glm::abs(m) * rad;
+    const glm::vec3 t_1 = -n - k;
+    const glm::vec3 t_2 = -n + k;
+
+    const float tN = std::max(std::max(t_1.x, t_1.y), t_1.z);
+    const float tF = std::min(std::min(t_2.x, t_2.y), t_2.z);
+
+    if (tN > tF || tF < 0.0f) return false;
+
+    float t = tN;
+    if (t <= tMin) t = tF;
+    if (t <= tMin || t >= tMax) return false;
+
+    tOut = t;
+    const glm::vec3 p = ro + rd * tOut;
+    const glm::vec3 a = glm::abs(p) / rad;
+
+    if (a.x > a.y && a.x > a.z) nOut = glm::vec3(signf(p.x), 0, 0);
+    else if (a.y > a.z)         nOut = glm::vec3(0, signf(p.y), 0);
+    else                        nOut = glm::vec3(0, 0, signf(p.z));
+    return true;
+}
+
+bool intersectConvexPlanes(const glm::vec3& ro, const glm::vec3& rd, const glm::vec4* planes, const int count,
+                           const float tMin, const float tMax, float& tOut, glm::vec3& nOut) {
+    float t0 = -1e6f;
+    float t1 = 1e6f;
+
+    glm::vec3 n0(0.0f);
+    glm::vec3 n1(0.0f);
+
+    for (int i = 0; i < count; i++) {
+        const glm::vec3 norm = glm::vec3(planes[i]);
+        const float dist = planes[i].w;
+
+        const float denom = glm::dot(norm, rd);
+        const float num = dist - glm::dot(norm, ro);
+
+        if (std::abs(denom) < 1e-6f) {
+            if (num < 0.0f) return false;
+        } else {
+            const float t = num / denom;
+            if (denom < 0.0f) { if (t > t0) { t0 = t; n0 = norm; } }
+            else { if (t < t1) { t1 = t; n1 = norm; } }
+        }
+    }
+
+    if (t0 > t1) return false;
+
+    float t = t0;
+    if (t <= tMin) t = t1;
+    if (t <= tMin || t >= tMax) return false;
+
+    tOut = t;
+    nOut = (t == t0) ? n0 : n1;
+    return true;
+}
+
+constexpr int BVH_STACK_SIZE = BVH_MAX_DEPTH;
+constexpr float BVH_MISS = 1e30f;
+
+float hitAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& rayOrigin,
+              const glm::vec3& invDir, const float tMin, const float tMax) {
+    const glm::vec3 t0 = (boundsMin - rayOrigin) * invDir;
+    const glm::vec3 t1 = (boundsMax - rayOrigin) * invDir;
+    const glm::vec3 tSmall = glm::min(t0, t1);
+    const glm::vec3 tBig = glm::max(t0, t1);
+    const float tEnter = std::max(std::max(tSmall.x, tSmall.y), std::max(tSmall.z, tMin));
+    const float tExit = std::min(std::min(tBig.x, tBig.y), std::min(tBig.z, tMax));
+    return tEnter <= tExit ? tEnter : BVH_MISS;
+}
+
+// Watertight test as in hittable.glsl; corners are the triangle's vertices
+bool hitTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& ro,
+                 const glm::ivec3& k, const glm::vec3& shear, const float tMin, const float tMax,
+                 float& tOut, glm::vec3& nOut) {
+    const glm::vec3 a = p0 - ro;
+    const glm::vec3 b = p1 - ro;
+    const glm::vec3 c = p2 - ro;
+
+    const float ax = a[k.x] - shear.x * a[k.z];
+    const float ay = a[k.y] - shear.y * a[k.z];
+    const float bx = b[k.x] - shear.x * b[k.z];
+    const float by = b[k.y] - shear.y * b[k.z];
+    const float cx = c[k.x] - shear.x * c[k.z];
+    const float cy = c[k.y] - shear.y * c[k.z];
+
+    const float u = cx * by - cy * bx;
+    const float v = ax * cy - ay * cx;
+    const float w = bx * ay - by * ax;
+    if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) return false;
+
+    const float det = u + v + w;
+    if (det == 0.0f) return false;
+
+    const float t = (u * a[k.z] + v * b[k.z] + w * c[k.z]) * shear.z / det;
+    if (t <= tMin || t >= tMax) return false;
+
+    tOut = t;
+    nOut = glm::cross(p1 - p0, p2 - p0);
+    return true;
+}
+
+// --- camera.glsl uniforms + per-invocation state ---
+
+struct KernelParams {
+    glm::vec2 resolution;
+    CameraParams camera;
+    SkyParams sky;
+    int samplesPerFrame;
+    int maxTotalSamples;
+    uint32_t maxBounces;
+    int lightSamples;
+    SamplerParams sampler;
+    const int* blueNoise;   // blueNoiseRanks(), BLUE_NOISE_SIZE^2 entries
+};
+
+// One instance per worker thread; holds the sampler state that the GLSL
+// keeps in globals (`rngState`, `sampleNumber`, ...) and exposes the
+// functions that consume it.
+class Kernel {
+public:
+    Kernel(const SceneData& scene, const KernelParams& params)
+        : objectGeometry(scene.objectGeometry.data()),
+          objectTypes(scene.objectTypes.data()),
+          objectMaterials(scene.objectMaterials.data()),
+          objectCount(static_cast<int>(scene.objects.size())),
+          materials(scene.materials.data()),
+          materialCount(static_cast<int>(scene.materials.size())),
+          lightIndices(scene.lightIndices.data()),
+          lightCount(static_cast<int>(scene.lightIndices.size())),
+          lightTable(scene.lightTable.data()),
+          lightTableSize(static_cast<int>(scene.lightTable.size())),
+          bvhNodes(scene.bvhNodes.data()),
+          bvhNodeCount(static_cast<int>(scene.bvhNodes.size())),
+          primIndices(scene.bvhPrimIndices.data()),
+          planeIndices(scene.planeIndices.data()),
+          planeCount(static_cast<int>(scene.planeIndices.size())),
+          transforms(scene.objectTransforms.data()),
+          convexPlanes(scene.convexPlanes.data()),
+          instances(scene.instanceTransforms.data()),
+          meshVertices(scene.meshVertices.data()),
+          meshIndices(scene.meshIndices.data()),
+          meshNodes(scene.meshNodes.data()),
+          params(params) {}
+
+    void shadePixel(glm::ivec2 pixelCoords, glm::vec4& accumVisual, glm::vec4& accumBloomPx,
+                    glm::vec4& outVisual, glm::vec4& outBloom);
+
+    // hitWorld() calls: camera, bounce, shadow and tint rays
+    uint64_t getRayCount() const { return rayCount; }
+
+private:
+    const glm::vec4* objectGeometry;
+    const int* objectTypes;
+    const int* objectMaterials;
+    int objectCount;
+    const GPUMaterial* materials;
+    int materialCount;
+    const int* lightIndices;
+    int lightCount;
+    const GPULight* lightTable;
+    int lightTableSize;
+    const GPUBVHNode* bvhNodes;
+    int bvhNodeCount;
+    const int* primIndices;
+    const int* planeIndices;
+    int planeCount;
+    const GPUObjectTransform* transforms;
+    const glm::vec4* convexPlanes;
+    const GPUInstance* instances;
+    const glm::vec3* meshVertices;
+    const int* meshIndices;
+    const GPUBVHNode* meshNodes;
+    const KernelParams& params;
+
+    uint32_t rngState = 0;
+    glm::uvec2 samplerPixel{0u};
+    uint32_t samplerPixelSeed = 0;
+    uint32_t sampleNumber = 0;
+    uint32_t sampleDimension = 0;
+    mutable uint64_t rayCount = 0;
+
+    // Out-of-range material reads come back zeroed, as with robust buffer
+    // access in the kernel.
+    const GPUMaterial& material(const int index) const {
+        static const GPUMaterial zero{};
+        return (index >= 0 && index < materialCount) ? materials[index] : zero;
+    }
+
+    void initRNG(glm::uvec2 pixelCoord, uint32_t frame);
+    void beginSample(uint32_t index);
+    float sobolSample(uint32_t seed);
+    float blueNoiseSample();
+    float randomFloat();
+    float randomFloat(float min, float max);
+    glm::vec3 randomPointOnUnitSphere();
+    glm::vec2 randomPointInUnitDisk();
+
+    bool hitMesh(int rootNode, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float tMax,
+                 float& tOut, glm::vec3& nOut) const;
+    bool hitObject(int i, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float& closestSoFar, HitRecord& rec) const;
+    bool hitPrototype(int rootNode, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float& closestSoFar, HitRecord& rec) const;
+    bool hitInstance(int inst, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float& closestSoFar, HitRecord& rec) const;
+    bool hitClosest(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float tMax, HitRecord& rec) const;
+    bool hitWorld(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float tMin, float tMax, HitRecord& rec) const;
+    glm::vec4 objectBoundingSphere(int i) const;
+    glm::vec4 emitterBoundingSphere(int i, int inst) const;
+
+    glm::vec3 randomCosineDirection();
+    glm::vec3 sampleGGXMicrofacet(float roughness, const glm::vec3& N);
+    glm::vec3 sampleCosineHemisphere(const glm::vec3& N);
+    bool scatter(const GPUMaterial& mat, const glm::vec3& rayDir, const HitRecord& rec,
+                 glm::vec3& attenuation, glm::vec3& scattered, bool& isSpecularBounce);
+
+    glm::vec3 sampleSky(const glm::vec3& rayDir) const;
+    glm::vec4 sampleTintSources(const glm::vec3& surfacePos, const glm::vec3& surfaceNormal, int ignoreObjIndex);
+    const GPULight& sampleLightTable();
+    glm::vec3 sampleDirectLight(const glm::vec3& surfacePos, const glm::vec3& surfaceNormal, const glm::vec3& V,
+                                const GPUMaterial& surfaceMat, const GPULight& light);
+    TraceResult traceRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir);
+};
+
+void Kernel::initRNG(const glm::uvec2 pixelCoord, const uint32_t frame) {
+    const uint32_t seed = pixelCoord.x * 747796405u +
+                          pixelCoord.y * 2891336453u +
+                          frame * 277803737u +
+                          params.sampler.seed * 3266489917u;
+    rngState = seed;
+    pcg_hash(rngState);
+
+    samplerPixel = pixelCoord;
+    samplerPixelSeed = hashCombine(hashCombine(params.sampler.seed, pixelCoord.x), pixelCoord.y);
+    beginSample(0u);
+}
+
+void Kernel::beginSample(const uint32_t index) {
+    sampleNumber = index;
+    sampleDimension = 0u;
+}
+
+float Kernel::sobolSample(const uint32_t seed) {
+    const uint32_t pairSeed = hashCombine(seed, sampleDimension >> 1u);
+    const uint32_t component = sampleDimension & 1u;
+    sampleDimension++;
+
+    const uint32_t index = nestedUniformScramble(sampleNumber, pairSeed);
+    uint32_t bits = component == 0u ? bitfieldReverse(index) : sobolSecondDimension(index);
+    bits = nestedUniformScramble(bits, hashCombine(pairSeed, component + 1u));
+    return static_cast<float>(bits >> 8u) * (1.0f / 16777216.0f);
+}
+
+float Kernel::blueNoiseSample() {
+    const uint32_t size = BLUE_NOISE_SIZE;
+    const uint32_t x = (samplerPixel.x + sampleDimension * 37u) % size;
+    const uint32_t y = (samplerPixel.y + sampleDimension * 23u) % size;
+    const int rank = params.blueNoise[y * size + x];
+    const float shift = (static_cast<float>(rank) + 0.5f) / static_cast<float>(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+    const float value = sobolSample(params.sampler.seed) + shift;
+    return value - std::floor(value);
+}
+
+float Kernel::randomFloat() {
+    if (params.sampler.type == SAMPLER_SOBOL) return sobolSample(samplerPixelSeed);
+    if (params.sampler.type == SAMPLER_BLUE_NOISE) return blueNoiseSample();
+
+    const uint32_t x = pcg_hash(rngState);
+    const uint32_t floatBits = (x >> 9u) | 0x3f800000u;
+    return uintBitsToFloat(floatBits) - 1.0f;
+}
+
+float Kernel::randomFloat(const float min, const float max) {
+    return min + (max - min) * randomFloat();
+}
+
+glm::vec3 Kernel::randomPointOnUnitSphere() {
+    const float u = randomFloat();
+    const float v = randomFloat();
+    const float theta = 2.0f * 3.14159265f * u;
+    const float phi = std::acos(2.0f * v - 1.0f);
+    return {std::sin(phi) * std::cos(theta), std::sin(phi) * std::sin(theta), std::cos(phi)};
+}
+
+glm::vec2 Kernel::randomPointInUnitDisk() {
+    if (params.sampler.type == SAMPLER_SOBOL || params.sampler.type == SAMPLER_BLUE_NOISE) {
+        const float ux = randomFloat() * 2.0f - 1.0f;
+        const float uy = randomFloat() * 2.0f - 1.0f;
+        if (ux == 0.0f && uy == 0.0f) return glm::vec2(0.0f);
+        float r;
+        float theta;
+        if (std::abs(ux) > std::abs(uy)) {
+            r = ux;
+            theta = 0.78539816f * (uy / ux);
+        } else {
+            r = uy;
+            theta = 1.57079633f - 0.78539816f * (ux / uy);
+        }
+        return r * glm::vec2(std::cos(theta), std::sin(theta));
+    }
+
+    while (true) {
+        const float x = randomFloat(-1.0f, 1.0f);
+        const float y = randomFloat(-1.0f, 1.0f);
+        if (x * x + y * y < 1.0f) return {x, y};
+    }
+}
+
+bool Kernel::hitMesh(const int rootNode, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                     const float tMin, const float tMax, float& tOut, glm::vec3& nOut) const {
+    const glm::vec3 absDir = glm::abs(rayDir);
+    const int kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+    int kx = kz == 2 ? 0 : kz + 1;
+    int ky = kx == 2 ? 0 : kx + 1;
+    if (rayDir[kz] < 0.0f) std::swap(kx, ky);
+    const glm::ivec3 k(kx, ky, kz);
+    const glm::vec3 shear(rayDir[kx] / rayDir[kz], rayDir[ky] / rayDir[kz], 1.0f / rayDir[kz]);
+
+    const glm::vec3 safeDir(std::abs(rayDir.x) > 1e-8f ? rayDir.x : 1e-8f,
+                            std::abs(rayDir.y) > 1e-8f ? rayDir.y : 1e-8f,
+                            std::abs(rayDir.z) > 1e-8f ? rayDir.z : 1e-8f);
+    const glm::vec3 invDir = 1.0f / safeDir;
+
+    if (hitAABB(meshNodes[rootNode].boundsMin, meshNodes[rootNode].boundsMax, rayOrigin, invDir, tMin, tMax) == BVH_MISS) {
+        return false;
+    }
+
+    bool hitAnything = false;
+    float closest = tMax;
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = rootNode;
+
+    while (true) {
+        const GPUBVHNode& node = meshNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                const int* tri = meshIndices + 3 * (node.leftFirst + i);
+                float t;
+                glm::vec3 n;
+                if (hitTriangle(meshVertices[tri[0]], meshVertices[tri[1]], meshVertices[tri[2]], rayOrigin, k, shear,
+                                tMin, closest, t, n)) {
+                    closest = t;
+                    nOut = n;
+                    hitAnything = true;
+                }
+            }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+            continue;
+        }
+
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(meshNodes[childNear].boundsMin, meshNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closest);
+        float tFar = hitAABB(meshNodes[childFar].boundsMin, meshNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closest);
+        if (tFar < tNear) {
+            std::swap(childNear, childFar);
+            std::swap(tNear, tFar);
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
+        }
+    }
+    tOut = closest;
+    return hitAnything;
+}
+
+bool Kernel::hitObject(const int i, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                       const float tMin, float& closestSoFar, HitRecord& rec) const {
+    const int type = objectTypes[i];
+
+    if (type == OBJ_SPHERE) {
+        if (hitSphere(objectGeometry[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) {
+            closestSoFar = rec.t;
+            rec.objIndex = i;
+            rec.instIndex = -1;
+            return true;
+        }
+        return false;
+    }
+
+    if (type == OBJ_PLANE) {
+        if (hitPlane(objectGeometry[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) {
+            closestSoFar = rec.t;
+            rec.objIndex = i;
+            rec.instIndex = -1;
+            return true;
+        }
+        return false;
+    }
+
+    const GPUObjectTransform& xf = transforms[i];
+    const glm::vec3 scale = glm::vec3(objectGeometry[i]);
+
+    const glm::vec3 roLocal(glm::dot(glm::vec3(xf.worldToLocal[0]), rayOrigin) + xf.worldToLocal[0].w,
+                            glm::dot(glm::vec3(xf.worldToLocal[1]), rayOrigin) + xf.worldToLocal[1].w,
+                            glm::dot(glm::vec3(xf.worldToLocal[2]), rayOrigin) + xf.worldToLocal[2].w);
+    const glm::vec3 rdLocal(glm::dot(glm::vec3(xf.worldToLocal[0]), rayDir),
+                            glm::dot(glm::vec3(xf.worldToLocal[1]), rayDir),
+                            glm::dot(glm::vec3(xf.worldToLocal[2]), rayDir));
+
+    float tHit = closestSoFar;
+    glm::vec3 nHit(0.0f);
+    bool localHit;
+    if (type == OBJ_CYLINDER) localHit = hitLocalCylinder(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == OBJ_CONE) localHit = hitLocalCone(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == OBJ_CUBE) localHit = hitLocalBox(roLocal, rdLocal, scale, tMin, closestSoFar, tHit, nHit);
+    else if (type == OBJ_MESH) {
+        if (xf.meshRoot < 0) return false;
+        localHit = hitMesh(xf.meshRoot, roLocal, rdLocal, tMin, closestSoFar, tHit, nHit);
+    }
+    else localHit = intersectConvexPlanes(roLocal, rdLocal, convexPlanes + xf.planeOffset, xf.planeCount,
+                                          tMin, closestSoFar, tHit, nHit);
+
+    if (localHit) {
+        closestSoFar = tHit;
+        rec.t = tHit;
+        rec.p = rayOrigin + tHit * rayDir;
+        if (type == OBJ_MESH) {
+            rec.normal = glm::normalize(nHit.x * glm::vec3(xf.worldToLocal[0]) + nHit.y * glm::vec3(xf.worldToLocal[1]) +
+                                        nHit.z * glm::vec3(xf.worldToLocal[2]));
+        } else {
+            rec.normal = glm::normalize(glm::vec3(glm::dot(glm::vec3(xf.localToWorld[0]), nHit),
+                                                  glm::dot(glm::vec3(xf.localToWorld[1]), nHit),
+                                                  glm::dot(glm::vec3(xf.localToWorld[2]), nHit)));
+        }
+        rec.frontFace = glm::dot(rayDir, rec.normal) < 0.0f;
+        if (!rec.frontFace) rec.normal = -rec.normal;
+        rec.objIndex = i;
+        rec.instIndex = -1;
+    }
+    return localHit;
+}
+
+bool Kernel::hitPrototype(const int rootNode, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                          const float tMin, float& closestSoFar, HitRecord& rec) const {
+    const glm::vec3 safeDir(std::abs(rayDir.x) > 1e-8f ? rayDir.x : 1e-8f,
+                            std::abs(rayDir.y) > 1e-8f ? rayDir.y : 1e-8f,
+                            std::abs(rayDir.z) > 1e-8f ? rayDir.z : 1e-8f);
+    const glm::vec3 invDir = 1.0f / safeDir;
+
+    if (hitAABB(bvhNodes[rootNode].boundsMin, bvhNodes[rootNode].boundsMax, rayOrigin, invDir, tMin, closestSoFar) == BVH_MISS) {
+        return false;
+    }
+
+    bool hitAnything = false;
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = rootNode;
+
+    while (true) {
+        const GPUBVHNode& node = bvhNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                if (hitObject(primIndices[node.leftFirst + i], rayOrigin, rayDir, tMin, closestSoFar, rec)) hitAnything = true;
+            }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+            continue;
+        }
+
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(bvhNodes[childNear].boundsMin, bvhNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        float tFar = hitAABB(bvhNodes[childFar].boundsMin, bvhNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        if (tFar < tNear) {
+            std::swap(childNear, childFar);
+            std::swap(tNear, tFar);
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
+        }
+    }
+    return hitAnything;
+}
+
+bool Kernel::hitInstance(const int inst, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                         const float tMin, float& closestSoFar, HitRecord& rec) const {
+    const GPUInstance& xf = instances[inst];
+    if (xf.rootNode < 0) return false;
+
+    const glm::vec3 roLocal(glm::dot(glm::vec3(xf.worldToLocal[0]), rayOrigin) + xf.worldToLocal[0].w,
+                            glm::dot(glm::vec3(xf.worldToLocal[1]), rayOrigin) + xf.worldToLocal[1].w,
+                            glm::dot(glm::vec3(xf.worldToLocal[2]), rayOrigin) + xf.worldToLocal[2].w);
+    const glm::vec3 rdLocal(glm::dot(glm::vec3(xf.worldToLocal[0]), rayDir),
+                            glm::dot(glm::vec3(xf.worldToLocal[1]), rayDir),
+                            glm::dot(glm::vec3(xf.worldToLocal[2]), rayDir));
+
+    if (!hitPrototype(xf.rootNode, roLocal, rdLocal, tMin, closestSoFar, rec)) return false;
+
+    rec.p = rayOrigin + rec.t * rayDir;
+    rec.normal = glm::normalize(glm::vec3(xf.worldToLocal[0]) * rec.normal.x +
+                                glm::vec3(xf.worldToLocal[1]) * rec.normal.y +
+                                glm::vec3(xf.worldToLocal[2]) * rec.normal.z);
+    rec.instIndex = inst;
+    return true;
+}
+
+bool Kernel::hitClosest(const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                        const float tMin, const float tMax, HitRecord& rec) const {
+    bool hitAnything = false;
+    float closestSoFar = tMax;
+
+    for (int i = 0; i < planeCount; i++) {
+        if (hitObject(planeIndices[i], rayOrigin, rayDir, tMin, closestSoFar, rec)) hitAnything = true;
+    }
+
+    if (bvhNodeCount == 0) return hitAnything;
+
+    const glm::vec3 safeDir(std::abs(rayDir.x) > 1e-8f ? rayDir.x : 1e-8f,
+                            std::abs(rayDir.y) > 1e-8f ? rayDir.y : 1e-8f,
+                            std::abs(rayDir.z) > 1e-8f ? rayDir.z : 1e-8f);
+    const glm::vec3 invDir = 1.0f / safeDir;
+
+    int stack[BVH_STACK_SIZE];
+    int stackPtr = 0;
+    int nodeIndex = 0;
+
+    if (hitAABB(bvhNodes[0].boundsMin, bvhNodes[0].boundsMax, rayOrigin, invDir, tMin, closestSoFar) == BVH_MISS) {
+        return hitAnything;
+    }
+
+    while (true) {
+        const GPUBVHNode& node = bvhNodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                const int prim = primIndices[node.leftFirst + i];
+                const bool hit = prim >= 0 ? hitObject(prim, rayOrigin, rayDir, tMin, closestSoFar, rec)
+                                           : hitInstance(-1 - prim, rayOrigin, rayDir, tMin, closestSoFar, rec);
+                if (hit) hitAnything = true;
+            }
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+            continue;
+        }
+
+        int childNear = node.leftFirst;
+        int childFar = node.leftFirst + 1;
+        float tNear = hitAABB(bvhNodes[childNear].boundsMin, bvhNodes[childNear].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        float tFar = hitAABB(bvhNodes[childFar].boundsMin, bvhNodes[childFar].boundsMax, rayOrigin, invDir, tMin, closestSoFar);
+        if (tFar < tNear) {
+            std::swap(childNear, childFar);
+            std::swap(tNear, tFar);
+        }
+
+        if (tNear == BVH_MISS) {
+            if (stackPtr == 0) break;
+            nodeIndex = stack[--stackPtr];
+        } else {
+            nodeIndex = childNear;
+            if (tFar != BVH_MISS && stackPtr < BVH_STACK_SIZE) stack[stackPtr++] = childFar;
+        }
+    }
+    return hitAnything;
+}
+
+bool Kernel::hitWorld(const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                      const float tMin, const float tMax, HitRecord& rec) const {
+    ++rayCount;
+    if (!hitClosest(rayOrigin, rayDir, tMin, tMax, rec)) return false;
+    rec.matIndex = objectMaterials[rec.objIndex];
+    return true;
+}
+
+glm::vec4 Kernel::objectBoundingSphere(const int i) const {
+    const int type = objectTypes[i];
+    const glm::vec4& geometry = objectGeometry[i];
+    if (type == OBJ_SPHERE || type == OBJ_PLANE) return geometry;
+    const GPUObjectTransform& xf = transforms[i];
+    return {xf.localToWorld[0].w, xf.localToWorld[1].w, xf.localToWorld[2].w, geometry.w};
+}
+
+glm::vec4 Kernel::emitterBoundingSphere(const int i, const int inst) const {
+    const glm::vec4 sphere = objectBoundingSphere(i);
+    if (inst < 0) return sphere;
+    const GPUInstance& xf = instances[inst];
+    const glm::vec3 center(sphere);
+    return {glm::dot(glm::vec3(xf.localToWorld[0]), center) + xf.localToWorld[0].w,
+            glm::dot(glm::vec3(xf.localToWorld[1]), center) + xf.localToWorld[1].w,
+            glm::dot(glm::vec3(xf.localToWorld[2]), center) + xf.localToWorld[2].w,
+            sphere.w * xf.maxScale};
+}
+
+// --- material.glsl ---
+
+float schlickFresnel(const float cosine, const float ior) {
+    float r0 = (1.0f - ior) / (1.0f + ior);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * std::pow(std::max(0.0f, 1.0f - cosine), 5.0f);
+}
+
+glm::vec3 refractVec(const glm::vec3& uv, const glm::vec3& n, const float etai_over_etat) {
+    const float cos_theta = std::min(glm::dot(-uv, n), 1.0f);
+    const glm::vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
+    const glm::vec3 r_out_parallel = -std::sqrt(std::abs(1.0f - glm::dot(r_out_perp, r_out_perp))) * n;
+    return r_out_perp + r_out_parallel;
+}
+
+glm::vec3 calculateF0(const glm::vec3& albedo, const float metallic, const glm::vec3& specularTint, const float specular) {
+    const glm::vec3 dielectricF0 = 0.04f * specular * specularTint;
+    const glm::vec3 metallicF0 = albedo;
+    return glm::mix(dielectricF0, metallicF0, metallic);
+}
+
+glm::vec3 schlickFresnelRoughness(const float cosine, const glm::vec3& f0, const float roughness) {
+    return f0 + (glm::max(glm::vec3(1.0f - roughness), f0) - f0) * std::pow(std::max(0.0f, 1.0f - cosine), 5.0f);
+}
+
+float clearcoatFresnel(const float cosTheta) {
+    constexpr float clearcoatIOR = 1.5f;
+    float r0 = (1.0f - clearcoatIOR) / (1.0f + clearcoatIOR);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * std::pow(1.0f - cosTheta, 5.0f);
+}
+
+float clearcoatAttenuation(const float clearcoat, const float NdotV) {
+    if (clearcoat < 0.01f) return 1.0f;
+    const float F = clearcoatFresnel(NdotV);
+    const float transmission = (1.0f - F);
+    return glm::mix(1.0f, transmission, clearcoat);
+}
+
+float DistributionGGX(const glm::vec3& N, const glm::vec3& H, const float roughness) {
+    const float a = roughness * roughness;
+    const float a2 = a * a;
+    const float NdotH = std::max(glm::dot(N, H), 0.0f);
+    const float NdotH2 = NdotH * NdotH;
+    float denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+    denom = PI * denom * denom;
+    return a2 / std::max(denom, 0.0001f);
+}
+
+float GeometrySchlickGGX(const float NdotV, const float roughness) {
+    const float r = (roughness + 1.0f);
+    const float k = (r * r) / 8.0f;
+    const float denom = NdotV * (1.0f - k) + k;
+    return NdotV / std::max(denom, 0.0001f);
+}
+
+float GeometrySmith(const glm::vec3& N, const glm::vec3& V, const glm::vec3& L, const float roughness) {
+    const float NdotV = std::max(glm::dot(N, V), 0.0f);
+    const float NdotL = std::max(glm::dot(N, L), 0.0f);
+    return GeometrySchlickGGX(NdotL, roughness) * GeometrySchlickGGX(NdotV, roughness);
+}
+
+glm::vec3 evalBRDF(const GPUMaterial& mat, const glm::vec3& N, const glm::vec3& V, const glm::vec3& L) {
+    if (mat.transmission > 0.5f || mat.roughness < 0.05f) return glm::vec3(0.0f);
+
+    const glm::vec3 H = glm::normalize(V + L);
+    const float NdotV = std::max(glm::dot(N, V), 0.001f);
+    const float NdotL = std::max(glm::dot(N, L), 0.001f);
+
+    const glm::vec3 F0 = calculateF0(mat.albedo, mat.metallic, mat.specularTint, mat.specular);
+    const float NDF = DistributionGGX(N, H, mat.roughness);
+    const float G = GeometrySmith(N, V, L, mat.roughness);
+
+    const glm::vec3 F = schlickFresnelRoughness(std::max(glm::dot(H, V), 0.0f), F0, mat.roughness);
+
+    const glm::vec3 numerator = NDF * G * F;
+    const float denominator = 4.0f * NdotV * NdotL;
+    const glm::vec3 specular = numerator / std::max(denominator, 0.0001f);
+
+    glm::vec3 kD = glm::vec3(1.0f) - F;
+    kD *= (1.0f - mat.metallic);
+    const glm::vec3 diffuse = kD * mat.albedo / PI;
+
+    return (diffuse + specular) * NdotL;
+}
+
+glm::vec3 Kernel::randomCosineDirection() {
+    const float r1 = randomFloat();
+    const float r2 = randomFloat();
+    const float phi = 2.0f * PI * r1;
+    const float z = std::sqrt(1.0f - r2);
+    const float sinTheta = std::sqrt(r2);
+    return {sinTheta * std::cos(phi), sinTheta * std::sin(phi), z};
+}
+
+glm::vec3 Kernel::sampleGGXMicrofacet(const float roughness, const glm::vec3& N) {
+    const float a = roughness * roughness;
+    const float r1 = randomFloat();
+    const float r2 = randomFloat();
+    const float phi = 2.0f * PI * r1;
+    const float denom = 1.0f + (a * a - 1.0f) * r2;
+    const float cosTheta = std::sqrt((1.0f - r2) / std::max(denom, 0.00001f));
+    const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+    const glm::vec3 H(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+    const glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    const glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+    const glm::vec3 bitangent = glm::cross(N, tangent);
+    return glm::normalize(tangent * H.x + bitangent * H.y + N * H.z);
+}
+
+glm::vec3 Kernel::sampleCosineHemisphere(const glm::vec3& N) {
+    const glm::vec3 randomDir = randomCosineDirection();
+    const glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    const glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+    const glm::vec3 bitangent = glm::cross(N, tangent);
+    return glm::normalize(tangent * randomDir.x + bitangent * randomDir.y + N * randomDir.z);
+}
+
+bool Kernel::scatter(const GPUMaterial& mat, const glm::vec3& rayDir, const HitRecord& rec,
+                     glm::vec3& attenuation, glm::vec3& scattered, bool& isSpecularBounce) {
+    const glm::vec3 N = rec.normal;
+    const glm::vec3 V = -glm::normalize(rayDir);
+
+    if (mat.transmission > 0.01f) {
+        const float refractionRatio = rec.frontFace ? (1.0f / mat.ior) : mat.ior;
+        const glm::vec3 unitDir = glm::normalize(rayDir);
+        const float cosTheta = std::min(glm::dot(-unitDir, N), 1.0f);
+        const float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        const bool cannotRefract = (refractionRatio * sin_theta) > 1.0f;
+
+        const float reflectProb = schlickFresnel(cosTheta, refractionRatio);
+
+        if (cannotRefract || randomFloat() < reflectProb) {
+            scattered = reflectVec(unitDir, N);
+        } else {
+            scattered = refractVec(unitDir, N, refractionRatio);
+        }
+
+        attenuation = mat.albedo;
+        isSpecularBounce = true;
+        return true;
+    }
+
+    const float NdotV = std::max(glm::dot(N, V), 0.001f);
+    const bool hasClearcoat = mat.clearcoat > 0.01f;
+
+    if (hasClearcoat) {
+        const float clearcoatF = clearcoatFresnel(NdotV);
+        const float clearcoatProb = glm::clamp(mat.clearcoat * clearcoatF * 2.0f, 0.0f, 0.9f);
+        if (randomFloat() < clearcoatProb) {
+            const glm::vec3 H = sampleGGXMicrofacet(std::max(mat.clearcoatRoughness, 0.01f), N);
+            scattered = reflectVec(-V, H);
+            if (glm::dot(scattered, N) <= 0.0f) {
+                scattered = reflectVec(-V, N);
+                if (glm::dot(scattered, N) <= 0.0f) return false;
+            }
+            const float HdotV = std::max(glm::dot(H, V), 0.001f);
+            const float F = clearcoatFresnel(HdotV);
+            attenuation = glm::vec3(F * mat.clearcoat / std::max(clearcoatProb, 0.001f));
+            isSpecularBounce = true;
+            return true;
+        }
+    }
+
+    const glm::vec3 f0 = calculateF0(mat.albedo, mat.metallic, mat.specularTint, mat.specular);
+    const glm::vec3 fresnel = schlickFresnelRoughness(NdotV, f0, mat.roughness);
+    const float fresnelAvg = (fresnel.x + fresnel.y + fresnel.z) / 3.0f;
+
+    float specularProbability = glm::mix(fresnelAvg, 1.0f, mat.metallic);
+
+    const float roughnessFactor = 1.0f - mat.roughness;
+
+    float selectionProbability = specularProbability;
+    if (mat.metallic < 0.01f) {
+        selectionProbability *= (roughnessFactor * roughnessFactor);
+    }
+
+    selectionProbability = glm::clamp(selectionProbability, 0.0f, 1.0f);
+
+    if (randomFloat() < selectionProbability) {
+        const glm::vec3 H = sampleGGXMicrofacet(mat.roughness, N);
+        scattered = reflectVec(-V, H);
+
+        if (glm::dot(scattered, N) <= 0.0f) {
+            return false;
+        }
+
+        const float HdotV = std::max(glm::dot(H, V), 0.001f);
+        const glm::vec3 F = schlickFresnelRoughness(HdotV, f0, mat.roughness);
+        attenuation = F / std::max(selectionProbability, 0.001f);
+        isSpecularBounce = true;
+    } else {
+        scattered = sampleCosineHemisphere(N);
+        const glm::vec3 diffuseColor = mat.albedo * (1.0f - mat.metallic);
+
+        const float diffuseProb = 1.0f - selectionProbability;
+
+        float effectiveFresnel = fresnelAvg;
+        if (mat.metallic < 0.01f) {
+            effectiveFresnel *= (roughnessFactor * roughnessFactor);
+        }
+
+        const glm::vec3 energyForDiffuse = glm::vec3(1.0f) - glm::vec3(effectiveFresnel);
+        attenuation = (diffuseColor * energyForDiffuse) / std::max(diffuseProb, 0.001f);
+        isSpecularBounce = false;
+    }
+
+    if (mat.sheen > 0.01f && mat.metallic < 0.9f) {
+        const float sheenFactor = std::pow(1.0f - NdotV, 5.0f);
+        const glm::vec3 sheenColor = glm::mix(glm::vec3(1.0f), mat.albedo, 0.5f);
+        attenuation += mat.sheen * sheenFactor * sheenColor;
+    }
+
+    if (hasClearcoat) {
+        const float transmission = clearcoatAttenuation(mat.clearcoat, NdotV);
+        const float clearcoatF = clearcoatFresnel(NdotV);
+        const float clearcoatProb = glm::clamp(mat.clearcoat * clearcoatF * 2.0f, 0.0f, 0.9f);
+        attenuation *= transmission / std::max(1.0f - clearcoatProb, 0.001f);
+    }
+
+    return true;
+}
+
+// --- main.glsl ---
+
+bool isSafe(const glm::vec3& v) {
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+glm::vec3 Kernel::sampleSky(const glm::vec3& rayDir) const {
+    const float t = 0.5f * (rayDir.y + 1.0f);
+    return glm::mix(params.sky.colorBottom, params.sky.colorTop, t);
+}
+
+glm::vec4 Kernel::sampleTintSources(const glm::vec3& surfacePos, const glm::vec3& surfaceNormal, const int ignoreObjIndex) {
+    glm::vec3 accumulatedTint(0.0f);
+    float totalInfluence = 0.0f;
+
+    for (int i = 0; i < objectCount; i++) {
+        if (i == ignoreObjIndex) continue;
+
+        const GPUMaterial& mat = material(objectMaterials[i]);
+
+        if (mat.emissionMode == EMISSION_ABSOLUTE && mat.emissionStrength > 0.0f) {
+            const glm::vec4 target = objectBoundingSphere(i);
+            const glm::vec3 targetCenter = glm::vec3(target);
+            const float targetRadius = target.w;
+
+            const glm::vec3 randomOffset = randomPointOnUnitSphere();
+            const glm::vec3 targetPoint = targetCenter + (randomOffset * targetRadius);
+
+            const glm::vec3 toLight = targetPoint - surfacePos;
+            const float distToTarget = glm::length(toLight);
+            const glm::vec3 L = toLight / distToTarget;
+
+            const float NdotL = std::max(glm::dot(surfaceNormal, L), 0.0f);
+            if (NdotL <= 0.0f) continue;
+
+            bool visible = false;
+            glm::vec3 currentOrigin = surfacePos + surfaceNormal * 0.001f;
+            float remainingDist = distToTarget * 0.99f;
+
+            for (int k = 0; k < 6; k++) {
+                HitRecord shadowRec;
+                const bool hit = hitWorld(currentOrigin, L, 0.001f, remainingDist, shadowRec);
+
+                if (!hit) {
+                    visible = true;
+                    break;
+                }
+
+                if (shadowRec.objIndex == i) {
+                    visible = true;
+                    break;
+                }
+
+                if (shadowRec.objIndex == ignoreObjIndex) {
+                    currentOrigin = shadowRec.p + L * 0.001f;
+                    remainingDist -= shadowRec.t;
+                    continue;
+                }
+
+                const GPUMaterial& occMat = material(shadowRec.matIndex);
+
+                if (occMat.transmission > 0.01f || occMat.subsurface > 0.0f) {
+                    currentOrigin = shadowRec.p + L * 0.001f;
+                    remainingDist -= shadowRec.t;
+
+                    if (remainingDist <= 0.001f) {
+                        visible = true;
+                        break;
+                    }
+                } else {
+                    visible = false;
+                    break;
+                }
+            }
+
+            if (visible) {
+                const float physicalDist = std::max(glm::distance(surfacePos, targetCenter) - targetRadius, 0.0f);
+                const float attenuation = 1.0f / (1.0f + std::pow(physicalDist * 0.15f, 2.0f));
+                float influence = mat.emissionStrength * attenuation * NdotL;
+                influence = glm::clamp(influence, 0.0f, 1.0f);
+
+                accumulatedTint += mat.emission * influence;
+                totalInfluence += influence;
+            }
+        }
+    }
+
+    return {accumulatedTint, std::min(totalInfluence, 1.0f)};
+}
+
+const GPULight& Kernel::sampleLightTable() {
+    const float u = randomFloat() * static_cast<float>(lightTableSize);
+    const int slot = std::min(static_cast<int>(u), lightTableSize - 1);
+    const GPULight& entry = lightTable[slot];
+    if (u - static_cast<float>(slot) >= entry.aliasProb) return lightTable[entry.alias];
+    return entry;
+}
+
+glm::vec3 Kernel::sampleDirectLight(const glm::vec3& surfacePos, const glm::vec3& surfaceNormal, const glm::vec3& V,
+                                    const GPUMaterial& surfaceMat, const GPULight& light) {
+    const glm::vec4 lightSphere = emitterBoundingSphere(light.objIndex, light.instance);
+    const glm::vec3 lightPos = glm::vec3(lightSphere);
+    const float lightRadius = lightSphere.w;
+    const GPUMaterial& lightMat = material(light.matIndex);
+
+    if (lightMat.emissionMode == EMISSION_ABSOLUTE) return glm::vec3(0.0f);
+
+    const glm::vec3 randomOnSphere = randomPointOnUnitSphere();
+    const glm::vec3 lightSamplePos = lightPos + randomOnSphere * lightRadius;
+
+    const glm::vec3 toLight = lightSamplePos - surfacePos;
+    const float distSq = glm::dot(toLight, toLight);
+    const float dist = std::sqrt(distSq);
+    const glm::vec3 L = glm::normalize(toLight);
+
+    const float NdotL = glm::dot(surfaceNormal, L);
+    if (NdotL <= 0.0f) return glm::vec3(0.0f);
+
+    glm::vec3 currentOrigin = surfacePos + surfaceNormal * 0.001f;
+    glm::vec3 throughput(1.0f);
+    float remainingDist = dist - 0.01f;
+    bool visible = false;
+
+    for (int i = 0; i < 5; i++) {
+        HitRecord shadowRec;
+
+        const bool occluded = hitWorld(currentOrigin, L, 0.001f, dist + 0.01f, shadowRec);
+
+        if (!occluded) {
+            visible = true;
+            break;
+        }
+
+        if (shadowRec.objIndex == light.objIndex && shadowRec.instIndex == light.instance) {
+            visible = true;
+            break;
+        }
+
+        const GPUMaterial& occMat = material(shadowRec.matIndex);
+        if (occMat.transmission > 0.01f || occMat.subsurface > 0.0f) {
+            throughput *= occMat.albedo;
+            currentOrigin = shadowRec.p + L * 0.001f;
+            remainingDist -= shadowRec.t;
+            if (remainingDist <= 0.0f) break;
+        } else {
+            visible = false;
+            break;
+        }
+    }
+
+    if (!visible) return glm::vec3(0.0f);
+
+    const float lightArea = 4.0f * PI * lightRadius * lightRadius;
+    const float weight = lightArea / std::max(distSq, 0.001f);
+
+    const glm::vec3 lightRadiance = lightMat.emission * lightMat.emissionStrength * weight;
+    const glm::vec3 brdf = evalBRDF(surfaceMat, surfaceNormal, V, L);
+
+    return lightRadiance * brdf * throughput;
+}
+
+TraceResult Kernel::traceRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir) {
+    glm::vec3 throughput(1.0f);
+    glm::vec3 radiance(0.0f);
+    glm::vec3 bloomRadiance(0.0f);
+
+    glm::vec3 currentOrigin = rayOrigin;
+    glm::vec3 currentDir = rayDir;
+
+    bool lastPathWasSpecular = true;
+    bool insideSSS = false;
+    glm::vec3 sssSigmaT(0.0f);
+    glm::vec3 sssAlbedo(0.0f);
+
+    const uint32_t maxBounces = params.maxBounces;
+
+    for (uint32_t bounce = 0u; bounce < maxBounces; ++bounce) {
+
+        if (insideSSS) {
+            HitRecord rec;
+            const bool hitBoundary = hitWorld(currentOrigin, currentDir, 0.001f, kInfinity, rec);
+            const float distToBoundary = hitBoundary ? rec.t : kInfinity;
+            const int channel = static_cast<int>(std::min(randomFloat() * 3.0f, 2.0f));
+            const float selectedDensity = sssSigmaT[channel];
+
+            const float distToScatter = -std::log(randomFloat()) / std::max(selectedDensity, 0.0001f);
+
+            if (distToScatter < distToBoundary) {
+                currentOrigin += currentDir * distToScatter;
+
+                const glm::vec3 trReal = glm::exp(-sssSigmaT * distToScatter);
+
+                const glm::vec3 channelPDFs = sssSigmaT * trReal;
+                const float pdf = (channelPDFs.x + channelPDFs.y + channelPDFs.z) / 3.0f;
+
+                const glm::vec3 sigmaS = sssSigmaT * sssAlbedo;
+                const glm::vec3 weight = (trReal * sigmaS) / std::max(pdf, 1e-8f);
+
+                throughput *= weight;
+                throughput = glm::min(throughput, glm::vec3(10.0f));
+
+                currentDir = randomPointOnUnitSphere();
+            } else {
+                currentOrigin = rec.p;
+
+                const glm::vec3 trReal = glm::exp(-sssSigmaT * distToBoundary);
+
+                const glm::vec3 channelExitProbs = glm::exp(-sssSigmaT * distToBoundary);
+                const float pdfExit = (channelExitProbs.x + channelExitProbs.y + channelExitProbs.z) / 3.0f;
+
+                const glm::vec3 weight = trReal / std::max(pdfExit, 1e-8f);
+                throughput *= weight;
+                throughput = glm::min(throughput, glm::vec3(10.0f));
+
+                const GPUMaterial& mat = material(rec.matIndex);
+                const glm::vec3 outwardN = rec.frontFace ? rec.normal : -rec.normal;
+                const glm::vec3 unitDir = glm::normalize(currentDir);
+                const float eta = mat.ior;
+                const float cosTheta = std::min(glm::dot(-unitDir, -outwardN), 1.0f);
+                const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+
+                if (eta * sinTheta > 1.0f) {
+                    currentDir = glm::normalize(-outwardN + randomPointOnUnitSphere());
+                    currentOrigin -= outwardN * 0.001f;
+                } else {
+                    currentDir = refractVec(unitDir, -outwardN, eta);
+                    currentOrigin += outwardN * 0.001f;
+                    insideSSS = false;
+                    lastPathWasSpecular = true;
+                }
+            }
+            continue;
+        }
+
+        HitRecord rec;
+        if (hitWorld(currentOrigin, currentDir, 0.001f, kInfinity, rec)) {
+            const GPUMaterial& mat = material(rec.matIndex);
+
+            const float effectiveBloomStr = (mat.bloomIntensity < 0.0f) ? mat.emissionStrength : mat.bloomIntensity;
+
+            if (mat.emissionMode == EMISSION_ABSOLUTE) {
+                if (effectiveBloomStr > 0.0f) {
+                    const glm::vec3 filterDelta = mat.emission - glm::vec3(1.0f);
+                    bloomRadiance += throughput * filterDelta * effectiveBloomStr;
+                }
+                throughput *= mat.emission * mat.emissionStrength;
+                currentOrigin = rec.p + currentDir * 0.001f;
+                continue;
+            }
+
+            bool hitLight = false;
+            for (int i = 0; i < lightCount; i++) {
+                if (rec.objIndex == lightIndices[i]) { hitLight = true; break; }
+            }
+
+            if (hitLight || (mat.emissionStrength > 0.0f || effectiveBloomStr > 0.0f)) {
+                if (lastPathWasSpecular) {
+                    radiance += throughput * mat.emission * mat.emissionStrength;
+                    bloomRadiance += throughput * mat.emission * effectiveBloomStr;
+                }
+                break;
+            }
+
+            if (mat.emissionMode != EMISSION_ABSOLUTE) {
+                const glm::vec4 tintData = sampleTintSources(rec.p, rec.normal, rec.objIndex);
+                const glm::vec3 tintColor = glm::vec3(tintData);
+                const float tintFactor = tintData.w;
+                radiance += throughput * tintColor;
+                bloomRadiance += throughput * tintColor;
+                throughput *= (1.0f - tintFactor);
+            }
+
+            if (mat.subsurface > 0.0f && rec.frontFace) {
+                const glm::vec3 f0 = calculateF0(mat.albedo, mat.metallic, mat.specularTint, mat.specular);
+                const glm::vec3 fresnel = schlickFresnelRoughness(glm::dot(rec.normal, -currentDir), f0, mat.roughness);
+                const float reflectProb = (fresnel.x + fresnel.y + fresnel.z) / 3.0f;
+                if (randomFloat() > reflectProb) {
+                    insideSSS = true;
+                    const float radius = std::max(mat.subsurfaceRadius, 0.001f);
+                    sssSigmaT = glm::vec3(1.0f / radius);
+                    sssSigmaT += mat.absorption;
+                    sssAlbedo = mat.albedo;
+                    const float eta = 1.0f / mat.ior;
+                    currentDir = refractVec(currentDir, rec.normal, eta);
+                    currentOrigin = rec.p - rec.normal * 0.001f;
+                    continue;
+                }
+            }
+
+            const bool skipNEE = mat.transmission > 0.01f || mat.subsurface > 0.0f;
+            if (!skipNEE && bounce < maxBounces - 1 && lightTableSize > 0) {
+                const glm::vec3 V = -currentDir;
+                const int neeSamples = std::max(params.lightSamples, 1);
+                for (int s = 0; s < neeSamples; s++) {
+                    const GPULight& light = sampleLightTable();
+                    const glm::vec3 directLight = sampleDirectLight(rec.p, rec.normal, V, mat, light)
+                                                / (light.pdf * static_cast<float>(neeSamples));
+                    radiance += throughput * directLight;
+                    bloomRadiance += throughput * directLight;
+                }
+            }
+
+            glm::vec3 attenuation(0.0f);
+            glm::vec3 scattered(0.0f);
+            bool isSpecularBounce = false;
+            if (scatter(mat, currentDir, rec, attenuation, scattered, isSpecularBounce)) {
+                throughput *= attenuation;
+                currentOrigin = rec.p;
+                currentDir = scattered;
+                if (isSpecularBounce) lastPathWasSpecular = true;
+                else lastPathWasSpecular = skipNEE;
+
+                if (bounce > 3) {
+                    const float p = std::max(throughput.x, std::max(throughput.y, throughput.z));
+                    if (randomFloat() > p) break;
+                    throughput /= p;
+                }
+            } else {
+                break;
+            }
+        } else {
+            const glm::vec3 sky = sampleSky(currentDir);
+            radiance += throughput * sky;
+            bloomRadiance += throughput * sky;
+            break;
+        }
+    }
+    return {radiance, bloomRadiance};
+}
+
+void Kernel::shadePixel(const glm::ivec2 pixelCoords, glm::vec4& accumVisual, glm::vec4& accumBloomPx,
+                        glm::vec4& outVisual, glm::vec4& outBloom) {
+    const glm::vec4 prevVisual = accumVisual;
+    const glm::vec4 prevBloom = accumBloomPx;
+    const float currentSampleCount = prevVisual.w;
+
+    if (currentSampleCount >= static_cast<float>(params.maxTotalSamples)) return;
+
+    initRNG(glm::uvec2(pixelCoords), params.camera.frameCount);
+
+    const glm::vec2 resolution = params.resolution;
+    const CameraParams& cam = params.camera;
+
+    // The last frame only renders what is left of maxTotalSamples, as in main.glsl
+    const int frameSamples = std::min(params.samplesPerFrame,
+                                      params.maxTotalSamples - static_cast<int>(currentSampleCount));
+
+    TraceResult result = {glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    for (int numSample = 0; numSample < frameSamples; numSample++) {
+        beginSample(static_cast<uint32_t>(currentSampleCount) + static_cast<uint32_t>(numSample));
+        const float jx = randomFloat();
+        const float jy = randomFloat();
+        const glm::vec2 uv = (glm::vec2(pixelCoords) + glm::vec2(jx, jy)) / resolution;
+        glm::vec2 ndc = uv * 2.0f - 1.0f;
+        const float aspectRatio = resolution.x / resolution.y;
+        ndc.x *= aspectRatio;
+        const float fovRadians = glm::radians(cam.FOV);
+        const float planeScale = std::tan(fovRadians * 0.5f);
+        const glm::vec3 pixelTarget = cam.pos + (cam.forward + (ndc.x * planeScale * cam.right) + (ndc.y * planeScale * cam.up)) * cam.focusDist;
+        const glm::vec2 lensSample = randomPointInUnitDisk() * cam.aperture * 0.5f;
+        const glm::vec3 rayOrigin = cam.pos + (cam.right * lensSample.x) + (cam.up * lensSample.y);
+        const glm::vec3 rayDir = glm::normalize(pixelTarget - rayOrigin);
+
+        const TraceResult sampleRes = traceRay(rayOrigin, rayDir);
+        result.radiance += sampleRes.radiance;
+        result.bloom += sampleRes.bloom;
+    }
+
+    if (isSafe(result.radiance) && isSafe(result.bloom)) {
+        const glm::vec3 totalVisual = glm::vec3(prevVisual) + result.radiance;
+        const float totalSamples = currentSampleCount + static_cast<float>(frameSamples);
+        accumVisual = glm::vec4(totalVisual, totalSamples);
+
+        const glm::vec3 totalBloom = glm::vec3(prevBloom) + result.bloom;
+        accumBloomPx = glm::vec4(totalBloom, totalSamples);
+
+        outVisual = glm::vec4(totalVisual / totalSamples, 1.0f);
+        outBloom = glm::vec4(totalBloom / totalSamples, 1.0f);
+    }
+}
+
+} // namespace
+
+CpuRenderer::CpuRenderer(const SceneData& scene, const unsigned threadCount)
+    : scene(scene),
+      threadCount(threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())) {}
+
+void CpuRenderer::resize(const int newWidth, const int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+    accum.assign(pixelCount, glm::vec4(0.0f));
+    accumBloom.assign(pixelCount, glm::vec4(0.0f));
+    output.assign(pixelCount, glm::vec4(0.0f));
+    outputBloom.assign(pixelCount, glm::vec4(0.0f));
+}
+
+void CpuRenderer::resetAccumulation() {
+    std::fill(accum.begin(), accum.end(), glm::vec4(0.0f));
+    std::fill(accumBloom.begin(), accumBloom.end(), glm::vec4(0.0f));
+    rayCount = 0;
+}
+
+void CpuRenderer::renderFrame(const CameraParams& camera_params, const SkyParams& sky_params,
+                              const int samplesPerFrame, const int maxTotalSamples, const uint32_t maxBounces,
+                              const int lightSamples, const SamplerParams sampler_params) {
+    if (width <= 0 || height <= 0) return;
+
+    const KernelParams params = {
+        glm::vec2(static_cast<float>(width), static_cast<float>(height)),
+        camera_params, sky_params,
+        samplesPerFrame, maxTotalSamples, maxBounces, lightSamples,
+        sampler_params,
+        sampler_params.type == SAMPLER_BLUE_NOISE ? blueNoiseRanks().data() : nullptr
+    };
+
+    const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    const int tileCount = tilesX * tilesY;
+
+    // Tiles are handed out dynamically so expensive regions (glass, SSS)
+    // don't leave the other threads idle.
+    std::atomic<int> nextTile{0};
+    std::atomic<uint64_t> frameRays{0};
+
+    auto worker = [&]() {
+        Kernel kernel(scene, params);
+        for (int tile = nextTile.fetch_add(1); tile < tileCount; tile = nextTile.fetch_add(1)) {
+            const int x0 = (tile % tilesX) * TILE_SIZE;
+            const int y0 = (tile / tilesX) * TILE_SIZE;
+            const int x1 = std::min(x0 + TILE_SIZE, width);
+            const int y1 = std::min(y0 + TILE_SIZE, height);
+
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    const size_t index = static_cast<size_t>(y) * width + x;
+                    kernel.shadePixel(glm::ivec2(x, y), accum[index], accumBloom[index],
+                                      output[index], outputBloom[index]);
+                }
+            }
+        }
+        frameRays.fetch_add(kernel.getRayCount(), std::memory_order_relaxed);
+    };
+
+    const unsigned workerCount = std::min<unsigned>(threadCount, static_cast<unsigned>(tileCount));
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount > 0 ? workerCount - 1 : 0);
+    for (unsigned i = 1; i < workerCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    rayCount += frameRays.load();
+}
@@ -0,0 +1,549 @@
+#include "MeshLoader.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Below this much work per thread, starting the thread costs more than it saves
+constexpr size_t MIN_OBJ_CHUNK_BYTES = 1 << 20;
+constexpr size_t MIN_PLY_CHUNK_VERTICES = 1 << 16;
+
+unsigned workerCountFor(const size_t work, const size_t minPerWorker) {
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(std::min<size_t>(hardware, std::max<size_t>(1, work / minPerWorker)));
+}
+
+// Runs job(k) for every k in [0, count); the last one on the calling thread
+template <typename Job>
+void runParallel(const unsigned count, const Job& job) {
+    std::vector<std::thread> workers;
+    workers.reserve(count > 0 ? count - 1 : 0);
+    for (unsigned k = 0; k + 1 < count; ++k) {
+        workers.emplace_back(job, k);
+    }
+    if (count > 0) job(count - 1);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+bool readFile(const std::string& path, std::vector<char>& bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    const std::streamsize size = file.tellg();
+    if (size < 0) return false;
+    bytes.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(bytes.data(), size));
+}
+
+bool checkIndices(const MeshData& mesh, std::string& errorMsg) {
+    const auto vertexCount = static_cast<int>(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        if (mesh.indices[i] < 0 || mesh.indices[i] >= vertexCount) {
+            errorMsg = "triangle " + std::to_string(i / 3) + " references vertex " + std::to_string(mesh.indices[i]) +
+                       " of " + std::to_string(vertexCount);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fan triangulation of a convex polygon
+void appendPolygon(const std::vector<int>& polygon, std::vector<int>& indices) {
+    for (size_t k = 1; k + 1 < polygon.size(); k++) {
+        indices.push_back(polygon[0]);
+        indices.push_back(polygon[k]);
+        indices.push_back(polygon[k + 1]);
+    }
+}
+
+// --- OBJ ---
+
+bool isSpace(const char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+const char* lineEnd(const char* p, const char* end) {
+    const void* newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return newline != nullptr ? static_cast<const char*>(newline) : end;
+}
+
+const char* nextLine(const char* eol, const char* end) {
+    return eol < end ? eol + 1 : end;
+}
+
+bool isStatement(const char* p, const char* end, const char keyword) {
+    return end - p >= 2 && p[0] == keyword && isSpace(p[1]);
+}
+
+// Line-aligned slice of an OBJ file, parsed by one thread. Negative
+// (relative) face indices need the number of vertices defined before the
+// chunk, so a counting pass over all chunks runs first.
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t vertexCount = 0;
+    size_t lineCount = 0;
+    size_t firstVertex = 0;
+    size_t firstLine = 0;
+
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;
+    size_t errorLine = 0;
+    std::string error;
+};
+
+void countObjChunk(ObjChunk& chunk) {
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* eol = lineEnd(p, chunk.end);
+        if (isStatement(skipSpaces(p, eol), eol, 'v')) ++chunk.vertexCount;
+        ++chunk.lineCount;
+        p = nextLine(eol, chunk.end);
+    }
+}
+
+void parseObjChunk(ObjChunk& chunk) {
+    chunk.vertices.reserve(chunk.vertexCount);
+    std::vector<int> polygon;
+    size_t line = 0;
+
+    const auto fail = [&](const char* message) {
+        chunk.errorLine = chunk.firstLine + line;
+        chunk.error = message;
+    };
+
+    for (const char* p = chunk.begin; p < chunk.end; p = nextLine(lineEnd(p, chunk.end), chunk.end)) {
+        const char* eol = lineEnd(p, chunk.end);
+        const char* s = skipSpaces(p, eol);
+        ++line;
+
+        if (isStatement(s, eol, 'v')) {
+            // "v x y z [w]"
+            glm::vec3 v;
+            s += 1;
+            for (int axis = 0; axis < 3; axis++) {
+                s = skipSpaces(s, eol);
+                if (s < eol && *s == '+') ++s;
+                const auto [next, ec] = std::from_chars(s, eol, v[axis]);
+                if (ec != std::errc()) return fail("malformed vertex");
+                s = next;
+            }
+            chunk.vertices.push_back(v);
+        }
+        else if (isStatement(s, eol, 'f')) {
+            // "f v1 v2 v3 ...", each as v, v/vt, v//vn or v/vt/vn
+            polygon.clear();
+            s += 1;
+            while ((s = skipSpaces(s, eol)) < eol) {
+                long long ref = 0;
+                const auto [next, ec] = std::from_chars(s, eol, ref);
+                if (ec != std::errc() || ref == 0) return fail("malformed face");
+
+                // 1-based, or negative: counted back from the last vertex so far
+                const long long index = ref > 0 ? ref - 1
+                    : static_cast<long long>(chunk.firstVertex + chunk.vertices.size()) + ref;
+                if (index < 0 || index > INT_MAX) return fail("face index out of range");
+                polygon.push_back(static_cast<int>(index));
+
+                s = next;
+                while (s < eol && !isSpace(*s)) ++s;
+            }
+            if (polygon.size() < 3) return fail("face with fewer than 3 vertices");
+            appendPolygon(polygon, chunk.indices);
+        }
+    }
+}
+
+// --- PLY ---
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, None };
+
+PlyType plyTypeFromName(const std::string& name) {
+    if (name == "char" || name == "int8") return PlyType::Int8;
+    if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+    if (name == "short" || name == "int16") return PlyType::Int16;
+    if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+    if (name == "int" || name == "int32") return PlyType::Int32;
+    if (name == "uint" || name == "uint32") return PlyType::UInt32;
+    if (name == "float" || name == "float32") return PlyType::Float32;
+    if (name == "double" || name == "float64") return PlyType::Float64;
+    return PlyType::None;
+}
+
+size_t plyTypeSize(const PlyType type) {
+    switch (type) {
+        case PlyType::Int8:
+        case PlyType::UInt8: return 1;
+        case PlyType::Int16:
+        case PlyType::UInt16: return 2;
+        case PlyType::Int32:
+        case PlyType::UInt32:
+        case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+        default: return 0;
+    }
+}
+
+template <typename T>
+T loadScalar(const unsigned char* raw) {
+    T value;
+    std::memcpy(&value, raw, sizeof(T));
+    return value;
+}
+
+double readPlyValue(const unsigned char* p, const PlyType type, const bool swapBytes) {
+    unsigned char raw[8];
+    const size_t size = plyTypeSize(type);
+    std::memcpy(raw, p, size);
+    if (swapBytes) std::reverse(raw, raw + size);
+
+    switch (type) {
+        case PlyType::Int8: return loadScalar<int8_t>(raw);
+        case PlyType::UInt8: return loadScalar<uint8_t>(raw);
+        case PlyType::Int16: return loadScalar<int16_t>(raw);
+        case PlyType::UInt16: return loadScalar<uint16_t>(raw);
+        case PlyType::Int32: return loadScalar<int32_t>(raw);
+        case PlyType::UInt32: return loadScalar<uint32_t>(raw);
+        case PlyType::Float32: return loadScalar<float>(raw);
+        case PlyType::Float64: return loadScalar<double>(raw);
+        default: return 0.0;
+    }
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::None;
+    PlyType countType = PlyType::None;  // set for list properties
+
+    bool isList() const { return countType != PlyType::None; }
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    // Bytes per record, or 0 if any property is a list
+    size_t stride() const {
+        size_t size = 0;
+        for (const auto& property : properties) {
+            if (property.isList()) return 0;
+            size += plyTypeSize(property.type);
+        }
+        return size;
+    }
+};
+
+bool parsePlyHeader(const std::string& header, std::vector<PlyElement>& elements, bool& bigEndian,
+                    std::string& errorMsg) {
+    std::istringstream lines(header);
+    std::string line;
+    bool hasFormat = false;
+
+    while (std::getline(lines, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii") {
+                errorMsg = "ASCII PLY is not supported, only binary";
+                return false;
+            }
+            if (format != "binary_little_endian" && format != "binary_big_endian") {
+                errorMsg = "unknown PLY format " + format;
+                return false;
+            }
+            bigEndian = format == "binary_big_endian";
+            hasFormat = true;
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            tokens >> element.name >> element.count;
+            if (!tokens) {
+                errorMsg = "malformed element line: " + line;
+                return false;
+            }
+            elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            if (elements.empty()) {
+                errorMsg = "property before any element";
+                return false;
+            }
+            PlyProperty property;
+            std::string typeName;
+            tokens >> typeName;
+            if (typeName == "list") {
+                std::string countName;
+                tokens >> countName >> typeName;
+                property.countType = plyTypeFromName(countName);
+                if (property.countType == PlyType::None || property.countType == PlyType::Float32 ||
+                    property.countType == PlyType::Float64) {
+                    errorMsg = "bad list count type in: " + line;
+                    return false;
+                }
+            }
+            property.type = plyTypeFromName(typeName);
+            tokens >> property.name;
+            if (property.type == PlyType::None || property.name.empty()) {
+                errorMsg = "malformed property line: " + line;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    if (!hasFormat) {
+        errorMsg = "PLY header has no format line";
+        return false;
+    }
+    return true;
+}
+
+// Walks past one record of an element with list properties; false if it
+// runs past the end of the file
+bool skipPlyRecord(const PlyElement& element, const unsigned char*& p, const unsigned char* end, const bool swapBytes) {
+    for (const auto& property : element.properties) {
+        if (property.isList()) {
+            const size_t countSize = plyTypeSize(property.countType);
+            if (static_cast<size_t>(end - p) < countSize) return false;
+            const auto count = static_cast<size_t>(readPlyValue(p, property.countType, swapBytes));
+            p += countSize;
+            if (static_cast<size_t>(end - p) / plyTypeSize(property.type) < count) return false;
+            p += count * plyTypeSize(property.type);
+        }
+        else {
+            if (static_cast<size_t>(end - p) < plyTypeSize(property.type)) return false;
+            p += plyTypeSize(property.type);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool MeshLoader::loadFromFile(const std::string& path, MeshData& mesh, std::string& errorMsg) {
+    mesh = MeshData{};
+    if (path.empty()) {
+        errorMsg = "Mesh object has no \"file\"";
+        return false;
+    }
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension != ".obj" && extension != ".ply") {
+        errorMsg = "Unsupported mesh format '" + extension + "' in " + path + " (expected .obj or .ply)";
+        return false;
+    }
+
+    std::vector<char> bytes;
+    if (!readFile(path, bytes)) {
+        errorMsg = "Could not read mesh file " + path;
+        return false;
+    }
+
+    std::string parseError;
+    const bool parsed = extension == ".obj" ? parseObj(bytes, mesh, parseError) : parsePly(bytes, mesh, parseError);
+    if (!parsed || !checkIndices(mesh, parseError)) {
+        mesh = MeshData{};
+        errorMsg = path + ": " + parseError;
+        return false;
+    }
+    if (mesh.indices.empty()) {
+        errorMsg = path + " contains no triangles";
+        return false;
+    }
+    return true;
+}
+
+bool MeshLoader::parseObj(const std::vector<char>& text, MeshData& mesh, std::string& errorMsg) {
+    const char* data = text.data();
+    const char* end = data + text.size();
+
+    const unsigned chunkCount = workerCountFor(text.size(), MIN_OBJ_CHUNK_BYTES);
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* begin = data;
+    for (unsigned k = 0; k < chunkCount; k++) {
+        const char* split = end;
+        if (k + 1 < chunkCount) {
+            split = std::max(begin, data + text.size() / chunkCount * (k + 1));
+            split = nextLine(lineEnd(split, end), end);
+        }
+        chunks[k].begin = begin;
+        chunks[k].end = split;
+        begin = split;
+    }
+
+    runParallel(chunkCount, [&chunks](const unsigned k) { countObjChunk(chunks[k]); });
+
+    size_t vertexCount = 0;
+    size_t lineCount = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.firstVertex = vertexCount;
+        chunk.firstLine = lineCount;
+        vertexCount += chunk.vertexCount;
+        lineCount += chunk.lineCount;
+    }
+
+    runParallel(chunkCount, [&chunks](const unsigned k) { parseObjChunk(chunks[k]); });
+
+    size_t indexCount = 0;
+    for (const ObjChunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            errorMsg = "line " + std::to_string(chunk.errorLine) + ": " + chunk.error;
+            return false;
+        }
+        indexCount += chunk.indices.size();
+    }
+
+    mesh.vertices.reserve(vertexCount);
+    mesh.indices.reserve(indexCount);
+    for (const ObjChunk& chunk : chunks) {
+        mesh.vertices.insert(mesh.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        mesh.indices.insert(mesh.indices.end(), chunk.indices.begin(), chunk.indices.end());
+    }
+    return true;
+}
+
+bool MeshLoader::parsePly(const std::vector<char>& bytes, MeshData& mesh, std::string& errorMsg) {
+    if (bytes.size() < 4 || std::memcmp(bytes.data(), "ply", 3) != 0 || (bytes[3] != '\n' && bytes[3] != '\r')) {
+        errorMsg = "not a PLY file";
+        return false;
+    }
+
+    static constexpr char END_HEADER[] = "end_header";
+    const char* headerEnd = std::search(bytes.data(), bytes.data() + bytes.size(),
+                                        END_HEADER, END_HEADER + sizeof(END_HEADER) - 1);
+    if (headerEnd == bytes.data() + bytes.size()) {
+        errorMsg = "PLY header has no end_header";
+        return false;
+    }
+
+    std::vector<PlyElement> elements;
+    bool bigEndian = false;
+    if (!parsePlyHeader(std::string(bytes.data(), headerEnd), elements, bigEndian, errorMsg)) return false;
+    const bool swapBytes = bigEndian != (std::endian::native == std::endian::big);
+
+    const char* dataStart = nextLine(lineEnd(headerEnd, bytes.data() + bytes.size()), bytes.data() + bytes.size());
+    const auto* p = reinterpret_cast<const unsigned char*>(dataStart);
+    const auto* end = reinterpret_cast<const unsigned char*>(bytes.data() + bytes.size());
+    const auto truncated = [&errorMsg](const std::string& element) {
+        errorMsg = "file ends inside the " + element + " element";
+        return false;
+    };
+
+    std::vector<int> polygon;
+    for (const PlyElement& element : elements) {
+        const size_t stride = element.stride();
+
+        if (element.name == "vertex") {
+            if (stride == 0) {
+                errorMsg = "vertex element with list properties is not supported";
+                return false;
+            }
+
+            // Offsets of x, y and z within a record
+            size_t offsets[3];
+            PlyType types[3] = {PlyType::None, PlyType::None, PlyType::None};
+            size_t offset = 0;
+            for (const auto& property : element.properties) {
+                const int axis = property.name == "x" ? 0 : property.name == "y" ? 1 : property.name == "z" ? 2 : -1;
+                if (axis >= 0) {
+                    offsets[axis] = offset;
+                    types[axis] = property.type;
+                }
+                offset += plyTypeSize(property.type);
+            }
+            if (types[0] == PlyType::None || types[1] == PlyType::None || types[2] == PlyType::None) {
+                errorMsg = "vertex element lacks x, y or z";
+                return false;
+            }
+            if (static_cast<size_t>(end - p) / stride < element.count) return truncated(element.name);
+
+            // Fixed-size records: every thread decodes its own index range
+            mesh.vertices.resize(element.count);
+            const unsigned workers = workerCountFor(element.count, MIN_PLY_CHUNK_VERTICES);
+            const unsigned char* records = p;
+            runParallel(workers, [&](const unsigned k) {
+                const size_t first = element.count * k / workers;
+                const size_t last = element.count * (k + 1) / workers;
+                for (size_t i = first; i < last; i++) {
+                    const unsigned char* record = records + i * stride;
+                    for (int axis = 0; axis < 3; axis++) {
+                        mesh.vertices[i][axis] = static_cast<float>(readPlyValue(record + offsets[axis], types[axis], swapBytes));
+                    }
+                }
+            });
+            p += element.count * stride;
+        }
+        else if (element.name == "face") {
+            const auto indexProperty = std::find_if(element.properties.begin(), element.properties.end(),
+                [](const PlyProperty& property) {
+                    return property.isList() && (property.name == "vertex_indices" || property.name == "vertex_index");
+                });
+            if (indexProperty == element.properties.end()) {
+                errorMsg = "face element lacks a vertex_indices list";
+                return false;
+            }
+
+            // Records have variable length, so faces are read in order
+            mesh.indices.reserve(element.count * 3);
+            for (size_t f = 0; f < element.count; f++) {
+                for (auto property = element.properties.begin(); property != element.properties.end(); ++property) {
+                    if (!property->isList()) {
+                        if (static_cast<size_t>(end - p) < plyTypeSize(property->type)) return truncated(element.name);
+                        p += plyTypeSize(property->type);
+                        continue;
+                    }
+
+                    const size_t countSize = plyTypeSize(property->countType);
+                    const size_t itemSize = plyTypeSize(property->type);
+                    if (static_cast<size_t>(end - p) < countSize) return truncated(element.name);
+                    const auto count = static_cast<size_t>(readPlyValue(p, property->countType, swapBytes));
+                    p += countSize;
+                    if (static_cast<size_t>(end - p) / itemSize < count) return truncated(element.name);
+
+                    if (property == indexProperty) {
+                        polygon.clear();
+                        for (size_t k = 0; k < count; k++) {
+                            // Out-of-range values become -1 and are rejected by checkIndices
+                            const double index = readPlyValue(p + k * itemSize, property->type, swapBytes);
+                            polygon.push_back(index >= 0.0 && index <= INT_MAX ? static_cast<int>(index) : -1);
+                        }
+                        appendPolygon(polygon, mesh.indices);
+                    }
+                    p += count * itemSize;
+                }
+            }
+        }
+        else if (stride > 0) {
+            if (static_cast<size_t>(end - p) / stride < element.count) return truncated(element.name);
+            p += element.count * stride;
+        }
+        else {
+            for (size_t i = 0; i < element.count; i++) {
+                if (!skipPlyRecord(element, p, end, swapBytes)) return truncated(element.name);
+            }
+        }
+    }
+    return true;
+}
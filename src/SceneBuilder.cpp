@@ -1,8 +1,231 @@
 #include "SceneBuilder.h"
 #include "MaterialFactory.h"
+#include "MeshLoader.h"
+#include "SceneLoader.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <set>
 
+namespace {
+
+// Local-space face planes (xyz = outward normal, w = distance) of the
+// polyhedra intersected by intersectConvexPlanes in hittable.glsl
+void appendConvexPlanes(const int type, const glm::vec3& scale, std::vector<glm::vec4>& planes) {
+    const float s = scale.x;
+
+    if (type == OBJ_TETRAHEDRON) {
+        const float d = s / 3.0f;
+        const float k = 0.577350269f; // 1/sqrt(3)
+        planes.emplace_back( k, k, k, d);
+        planes.emplace_back( k,-k,-k, d);
+        planes.emplace_back(-k, k,-k, d);
+        planes.emplace_back(-k,-k, k, d);
+    }
+    else if (type == OBJ_PYRAMID) {
+        // Base at y = -s/2, side slope 2 (rise/run)
+        planes.emplace_back(0, -1, 0, s * 0.5f);
+
+        const float ny = 0.4472136f;
+        const float nx = 0.8944271f;
+        const float d = (s * 0.5f) * nx;
+        planes.emplace_back( nx, ny, 0, d);
+        planes.emplace_back(-nx, ny, 0, d);
+        planes.emplace_back( 0, ny, nx, d);
+        planes.emplace_back( 0, ny,-nx, d);
+    }
+    else if (type == OBJ_PRISM) {
+        const float h = scale.y * 0.5f;
+        planes.emplace_back(0,  1, 0, h);
+        planes.emplace_back(0, -1, 0, h);
+
+        // Equilateral triangle, front face at +z, others rotated by +-120 deg
+        const float d = scale.x * 0.5f;
+        const float kx = 0.866025f;
+        const float kz = 0.5f;
+        planes.emplace_back(0, 0, 1, d);
+        planes.emplace_back( kx, 0, -kz, d);
+        planes.emplace_back(-kx, 0, -kz, d);
+    }
+    else if (type == OBJ_DODECAHEDRON) {
+        const float G = 1.61803398875f; // Golden ratio
+        const float k1 = 1.0f / std::sqrt(1.0f + G * G);
+        const float k2 = G * k1;
+        const float d = s;
+
+        planes.emplace_back(0, k1, k2, d);  planes.emplace_back(0, -k1, k2, d);
+        planes.emplace_back(0, k1,-k2, d);  planes.emplace_back(0, -k1,-k2, d);
+        planes.emplace_back(k2, 0, k1, d);  planes.emplace_back(k2, 0, -k1, d);
+        planes.emplace_back(-k2,0, k1, d);  planes.emplace_back(-k2,0, -k1, d);
+        planes.emplace_back(k1, k2, 0, d);  planes.emplace_back(k1, -k2, 0, d);
+        planes.emplace_back(-k1,k2, 0, d);  planes.emplace_back(-k1,-k2, 0, d);
+    }
+    else if (type == OBJ_ICOSAHEDRON) {
+        const float d = s;
+        const float k = 0.577350269f;
+        const float m = 0.356822089f;
+        const float n = 0.934172359f;
+
+        planes.emplace_back( k, k, k, d); planes.emplace_back( k, k,-k, d);
+        planes.emplace_back( k,-k, k, d); planes.emplace_back( k,-k,-k, d);
+        planes.emplace_back(-k, k, k, d); planes.emplace_back(-k, k,-k, d);
+        planes.emplace_back(-k,-k, k, d); planes.emplace_back(-k,-k,-k, d);
+
+        planes.emplace_back(0, m, n, d);  planes.emplace_back(0, -m, n, d);
+        planes.emplace_back(0, m,-n, d);  planes.emplace_back(0, -m,-n, d);
+        planes.emplace_back(n, 0, m, d);  planes.emplace_back(n, 0, -m, d);
+        planes.emplace_back(-n,0, m, d);  planes.emplace_back(-n,0, -m, d);
+        planes.emplace_back(m, n, 0, d);  planes.emplace_back(m, -n, 0, d);
+        planes.emplace_back(-m,n, 0, d);  planes.emplace_back(-m,-n, 0, d);
+    }
+}
+
+// Checks the prototype and instance entries; materialExists tells whether a
+// material name resolves
+template <typename MaterialLookup>
+bool validateInstancing(const std::vector<PrototypeConfig>& prototypes, const std::vector<InstanceConfig>& instances,
+                        const MaterialLookup& materialExists, std::string& errorMsg) {
+    std::set<std::string> prototypeNames;
+    for (const auto& proto : prototypes) {
+        if (proto.name.empty()) {
+            errorMsg = "Prototype with empty name found";
+            return false;
+        }
+        if (!prototypeNames.insert(proto.name).second) {
+            errorMsg = "Duplicate prototype name: " + proto.name;
+            return false;
+        }
+        if (proto.objects.empty()) {
+            errorMsg = "Prototype " + proto.name + " has no objects";
+            return false;
+        }
+        for (size_t i = 0; i < proto.objects.size(); i++) {
+            const auto& obj = proto.objects[i];
+            const std::string where = "Object " + std::to_string(i) + " of prototype " + proto.name;
+            if (obj.type == "plane") {
+                errorMsg = where + " is a plane; infinite planes cannot be instanced";
+                return false;
+            }
+            if (!materialExists(obj.material)) {
+                errorMsg = where + " references unknown material: " + obj.material;
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < instances.size(); i++) {
+        if (prototypeNames.count(instances[i].prototype) == 0) {
+            errorMsg = "Instance entry " + std::to_string(i) + " references unknown prototype: " + instances[i].prototype;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Deterministic per-entry random numbers for the scatter generator, so the
+// same file always produces the same scene on every platform
+float nextRandom(uint32_t& state) {
+    state = state * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return static_cast<float>(word >> 8) * (1.0f / 16777216.0f);
+}
+
+// Expands one "instances" entry into placed copies of prototype
+void expandInstances(const InstanceConfig& config, const int prototype, std::vector<SceneInstance>& instances) {
+    SceneInstance base;
+    base.prototype = prototype;
+    base.position = config.position;
+    base.rotation = config.rotation;
+    base.scale = config.scale;
+
+    switch (config.generator) {
+        case InstanceGenerator::Single:
+            instances.push_back(base);
+            break;
+
+        case InstanceGenerator::Grid: {
+            const glm::ivec3 count = glm::max(config.gridCount, glm::ivec3(1));
+            const glm::vec3 origin = config.position - config.spacing * glm::vec3(count - 1) * 0.5f;
+            for (int z = 0; z < count.z; z++) {
+                for (int y = 0; y < count.y; y++) {
+                    for (int x = 0; x < count.x; x++) {
+                        SceneInstance inst = base;
+                        inst.position = origin + config.spacing * glm::vec3(x, y, z);
+                        instances.push_back(inst);
+                    }
+                }
+            }
+            break;
+        }
+
+        case InstanceGenerator::Ring:
+            for (int k = 0; k < config.count; k++) {
+                const float angle = 360.0f * static_cast<float>(k) / static_cast<float>(config.count);
+                const float radians = glm::radians(angle);
+                SceneInstance inst = base;
+                inst.position = config.position + config.radius * glm::vec3(std::cos(radians), 0.0f, std::sin(radians));
+                // Local +x points away from the centre
+                if (config.orient) inst.rotation.y -= angle;
+                instances.push_back(inst);
+            }
+            break;
+
+        case InstanceGenerator::Scatter: {
+            uint32_t state = config.seed;
+            for (int k = 0; k < config.count; k++) {
+                SceneInstance inst = base;
+                for (int axis = 0; axis < 3; axis++) {
+                    inst.position[axis] += (nextRandom(state) * 2.0f - 1.0f) * config.extent[axis];
+                }
+                for (int axis = 0; axis < 3; axis++) {
+                    inst.rotation[axis] += (nextRandom(state) * 2.0f - 1.0f) * config.rotationJitter[axis];
+                }
+                inst.scale *= glm::mix(config.scaleRange.x, config.scaleRange.y, nextRandom(state));
+                instances.push_back(inst);
+            }
+            break;
+        }
+    }
+}
+
+// Keeps a scale invertible
+glm::vec3 safeScale(glm::vec3 scale) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::abs(scale[axis]) < 1e-6f) scale[axis] = scale[axis] < 0.0f ? -1e-6f : 1e-6f;
+    }
+    return scale;
+}
+
+// Distance from a mesh object's origin to the farthest corner of its box
+float meshBoundingRadius(const SceneMesh& mesh, const glm::vec3& scale) {
+    float radius = 0.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 p((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                          (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                          (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+        radius = std::max(radius, glm::length(p * scale));
+    }
+    return radius;
+}
+
+// SAH BVH over one mesh's triangles; order receives the triangles in leaf order
+void buildMeshBVH(const MeshData& mesh, std::vector<GPUBVHNode>& nodes, std::vector<int>& order) {
+    std::vector<AABB> bounds(mesh.indices.size() / 3);
+    for (size_t t = 0; t < bounds.size(); t++) {
+        for (int k = 0; k < 3; k++) {
+            bounds[t].grow(mesh.vertices[mesh.indices[3 * t + k]]);
+        }
+        // Axis-aligned triangles have flat boxes; keep grazing rays inside
+        const glm::vec3 pad = (bounds[t].max - bounds[t].min) * 1e-4f + glm::vec3(1e-6f);
+        bounds[t].min -= pad;
+        bounds[t].max += pad;
+    }
+    BVHBuilder::build(bounds, nodes, order);
+}
+
+} // namespace
+
 bool SceneBuilder::validate(const SceneConfig& config, std::string& errorMsg) {
     if (config.materials.empty()) {
         errorMsg = "Scene has no materials defined";
@@ -43,7 +266,8 @@ bool SceneBuilder::validate(const SceneConfig& config, std::string& errorMsg) {
         }
     }
 
-    return true;
+    const auto materialExists = [&materialNames](const std::string& name) { return materialNames.count(name) > 0; };
+    return validateInstancing(config.prototypes, config.instances, materialExists, errorMsg);
 }
 
 std::map<std::string, int> SceneBuilder::buildMaterialMap(
@@ -74,6 +298,413 @@ int SceneBuilder::resolveMaterialIndex(
     return 0;
 }
 
+AABB SceneBuilder::computeObjectBounds(const SceneObject& obj, const std::vector<SceneMesh>& meshes) {
+    const int type = obj.type;
+    const glm::vec3 center = obj.center;
+
+    AABB bounds;
+    if (type == OBJ_SPHERE) {
+        bounds.grow(center - glm::vec3(obj.radius));
+        bounds.grow(center + glm::vec3(obj.radius));
+        return bounds;
+    }
+
+    // Local-space extents, matching the intersectors in hittable.glsl
+    const glm::vec3 scale = obj.scale;
+    const float s = scale.x;
+    glm::vec3 localMin, localMax;
+
+    switch (type) {
+        case OBJ_CUBE:
+            localMin = -scale;
+            localMax = scale;
+            break;
+        case OBJ_CYLINDER:
+        case OBJ_CONE:
+            localMin = glm::vec3(-scale.x, -scale.y * 0.5f, -scale.x);
+            localMax = glm::vec3(scale.x, scale.y * 0.5f, scale.x);
+            break;
+        case OBJ_PYRAMID:
+            // Base at y = -s/2 reaching x,z = +-0.75s, apex at y = s
+            localMin = glm::vec3(-0.75f * s, -0.5f * s, -0.75f * s);
+            localMax = glm::vec3(0.75f * s, s, 0.75f * s);
+            break;
+        case OBJ_TETRAHEDRON:
+            // Vertices at s / sqrt(3) along each axis
+            localMin = glm::vec3(-0.57736f * s);
+            localMax = glm::vec3(0.57736f * s);
+            break;
+        case OBJ_PRISM:
+            // Triangle with inradius scale.x / 2, front face at +z
+            localMin = glm::vec3(-0.86603f * scale.x, -scale.y * 0.5f, -scale.x);
+            localMax = glm::vec3(0.86603f * scale.x, scale.y * 0.5f, 0.5f * scale.x);
+            break;
+        case OBJ_MESH: {
+            // Box of the file's vertices, scaled (possibly mirrored)
+            const SceneMesh& mesh = meshes[obj.mesh];
+            localMin = glm::min(mesh.boundsMin * scale, mesh.boundsMax * scale);
+            localMax = glm::max(mesh.boundsMin * scale, mesh.boundsMax * scale);
+            break;
+        }
+        default:
+            // Dodecahedron/icosahedron: inradius s, circumradius ~1.2584s
+            localMin = glm::vec3(-1.2585f * s);
+            localMax = glm::vec3(1.2585f * s);
+            break;
+    }
+
+    const glm::mat3 rotMat = buildRotationMatrix(obj.rotation);
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 local((corner & 1) ? localMax.x : localMin.x,
+                              (corner & 2) ? localMax.y : localMin.y,
+                              (corner & 4) ? localMax.z : localMin.z);
+        bounds.grow(center + rotMat * local);
+    }
+
+    // Small pad so grazing hits on flat faces are never culled
+    const glm::vec3 pad = (bounds.max - bounds.min) * 1e-4f + glm::vec3(1e-5f);
+    bounds.min -= pad;
+    bounds.max += pad;
+    return bounds;
+}
+
+glm::vec4 SceneBuilder::packGeometry(const SceneObject& obj) {
+    if (obj.type == OBJ_SPHERE) return glm::vec4(obj.center, obj.radius);
+    if (obj.type == OBJ_PLANE) return glm::vec4(glm::normalize(obj.normal), obj.distance);
+    return glm::vec4(obj.scale, obj.radius);
+}
+
+float SceneBuilder::boundingRadius(const SceneObject& obj, const std::vector<SceneMesh>& meshes) {
+    if (obj.type == OBJ_SPHERE) return obj.radius;
+    if (obj.type == OBJ_MESH) return meshBoundingRadius(meshes[obj.mesh], obj.scale);
+    return glm::length(obj.scale);
+}
+
+void SceneBuilder::packObjects(SceneData& sceneData) {
+    const size_t count = sceneData.streamObjectCount();
+    sceneData.objectGeometry.resize(count);
+    sceneData.objectTypes.resize(count);
+    sceneData.objectMaterials.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const SceneObject& obj = sceneData.streamObject(i);
+        sceneData.objectGeometry[i] = packGeometry(obj);
+        sceneData.objectTypes[i] = obj.type;
+        sceneData.objectMaterials[i] = obj.materialIndex;
+    }
+}
+
+GPUObjectTransform SceneBuilder::buildObjectTransform(const SceneObject& obj, const std::vector<SceneMesh>& meshes,
+                                                      std::vector<glm::vec4>& planes) {
+    GPUObjectTransform xf{};
+    const int type = obj.type;
+    const glm::vec3 center = obj.center;
+    const glm::mat3 rotMat = buildRotationMatrix(obj.rotation);
+
+    if (type == OBJ_MESH) {
+        // Scale goes into the transform, so rays are intersected with
+        // the vertices as stored
+        const glm::vec3 scale = safeScale(obj.scale);
+        glm::mat3 linear = rotMat;
+        for (int c = 0; c < 3; c++) linear[c] *= scale[c];
+        const glm::mat3 inverse = glm::inverse(linear);
+        const glm::vec3 inverseTranslation = -(inverse * center);
+        for (int r = 0; r < 3; r++) {
+            xf.worldToLocal[r] = glm::vec4(inverse[0][r], inverse[1][r], inverse[2][r], inverseTranslation[r]);
+            xf.localToWorld[r] = glm::vec4(linear[0][r], linear[1][r], linear[2][r], center[r]);
+        }
+        xf.meshRoot = meshes[obj.mesh].rootNode;
+        return xf;
+    }
+
+    // Inverse of a rotation is its transpose: rows of the inverse are
+    // the columns of rotMat
+    for (int r = 0; r < 3; r++) {
+        xf.worldToLocal[r] = glm::vec4(rotMat[r], -glm::dot(rotMat[r], center));
+        xf.localToWorld[r] = glm::vec4(rotMat[0][r], rotMat[1][r], rotMat[2][r], center[r]);
+    }
+
+    xf.planeOffset = static_cast<int>(planes.size());
+    appendConvexPlanes(type, obj.scale, planes);
+    xf.planeCount = static_cast<int>(planes.size()) - xf.planeOffset;
+    return xf;
+}
+
+void SceneBuilder::buildObjectTransforms(SceneData& sceneData) {
+    sceneData.objectTransforms.assign(sceneData.streamObjectCount(), GPUObjectTransform{});
+    sceneData.convexPlanes.clear();
+
+    for (size_t i = 0; i < sceneData.streamObjectCount(); i++) {
+        const SceneObject& obj = sceneData.streamObject(i);
+        if (obj.type == OBJ_SPHERE || obj.type == OBJ_PLANE) continue;
+        sceneData.objectTransforms[i] = buildObjectTransform(obj, sceneData.meshes, sceneData.convexPlanes);
+    }
+}
+
+bool SceneBuilder::loadMeshes(SceneData& sceneData, std::string& errorMsg) {
+    std::vector<int> pending;
+    std::vector<std::string> paths(sceneData.meshes.size());
+    for (const auto& [path, index] : sceneData.meshMap) {
+        paths[index] = path;
+        if (sceneData.meshes[index].rootNode < 0) pending.push_back(index);
+    }
+    if (pending.empty()) return true;
+
+    bool ok = true;
+    for (const int index : pending) {
+        MeshData meshData;
+        std::string loadError;
+        if (!MeshLoader::loadFromFile(paths[index], meshData, loadError)) {
+            std::cout << "  ERROR: " << loadError << std::endl;
+            if (ok) errorMsg = loadError;
+            ok = false;
+            continue;
+        }
+
+        std::vector<GPUBVHNode> nodes;
+        std::vector<int> order;
+        buildMeshBVH(meshData, nodes, order);
+        SceneMesh& mesh = sceneData.meshes[index];
+        mesh.firstVertex = static_cast<int>(sceneData.meshVertices.size());
+        mesh.vertexCount = static_cast<int>(meshData.vertices.size());
+        mesh.firstTriangle = static_cast<int>(sceneData.meshIndices.size() / 3);
+        mesh.triangleCount = static_cast<int>(order.size());
+        mesh.rootNode = static_cast<int>(sceneData.meshNodes.size());
+        mesh.boundsMin = nodes[0].boundsMin;
+        mesh.boundsMax = nodes[0].boundsMax;
+
+        sceneData.meshVertices.insert(sceneData.meshVertices.end(),
+                                      meshData.vertices.begin(), meshData.vertices.end());
+        // Triangles in leaf order, so leaves index them directly
+        for (const int triangle : order) {
+            for (int v = 0; v < 3; v++) {
+                sceneData.meshIndices.push_back(mesh.firstVertex + meshData.indices[3 * triangle + v]);
+            }
+        }
+        for (GPUBVHNode node : nodes) {
+            node.leftFirst += node.count > 0 ? mesh.firstTriangle : mesh.rootNode;
+            sceneData.meshNodes.push_back(node);
+        }
+        std::cout << "  Mesh '" << paths[index] << "': " << mesh.triangleCount << " triangles, "
+                  << nodes.size() << " BVH nodes" << std::endl;
+    }
+
+    for (std::vector<SceneObject>* objects : {&sceneData.objects, &sceneData.prototypeObjects}) {
+        for (SceneObject& obj : *objects) {
+            if (obj.type == OBJ_MESH) obj.radius = boundingRadius(obj, sceneData.meshes);
+        }
+    }
+    return ok;
+}
+
+GPUInstance SceneBuilder::buildInstanceTransform(const SceneInstance& inst, const int rootNode) {
+    GPUInstance xf{};
+    const glm::vec3 scale = safeScale(inst.scale);
+
+    glm::mat3 linear = buildRotationMatrix(inst.rotation);
+    for (int c = 0; c < 3; c++) linear[c] *= scale[c];
+    const glm::mat3 inverse = glm::inverse(linear);
+    const glm::vec3 inverseTranslation = -(inverse * inst.position);
+
+    for (int r = 0; r < 3; r++) {
+        xf.localToWorld[r] = glm::vec4(linear[0][r], linear[1][r], linear[2][r], inst.position[r]);
+        xf.worldToLocal[r] = glm::vec4(inverse[0][r], inverse[1][r], inverse[2][r], inverseTranslation[r]);
+    }
+    xf.rootNode = rootNode;
+    xf.maxScale = std::max(std::abs(scale.x), std::max(std::abs(scale.y), std::abs(scale.z)));
+    return xf;
+}
+
+void SceneBuilder::buildInstanceTransforms(SceneData& sceneData) {
+    sceneData.instanceTransforms.resize(sceneData.instances.size());
+    for (size_t i = 0; i < sceneData.instances.size(); i++) {
+        const SceneInstance& inst = sceneData.instances[i];
+        sceneData.instanceTransforms[i] = buildInstanceTransform(inst, sceneData.prototypes[inst.prototype].rootNode);
+    }
+}
+
+AABB SceneBuilder::transformBounds(const AABB& local, const GPUInstance& xf) {
+    AABB bounds;
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 p((corner & 1) ? local.max.x : local.min.x,
+                          (corner & 2) ? local.max.y : local.min.y,
+                          (corner & 4) ? local.max.z : local.min.z);
+        bounds.grow(glm::vec3(glm::dot(glm::vec3(xf.localToWorld[0]), p) + xf.localToWorld[0].w,
+                              glm::dot(glm::vec3(xf.localToWorld[1]), p) + xf.localToWorld[1].w,
+                              glm::dot(glm::vec3(xf.localToWorld[2]), p) + xf.localToWorld[2].w));
+    }
+    return bounds;
+}
+
+void SceneBuilder::buildLightTable(SceneData& sceneData) {
+    sceneData.lightTable.clear();
+
+    const std::set<int> flaggedLights(sceneData.lightIndices.begin(), sceneData.lightIndices.end());
+    std::vector<float> power;
+
+    // objIndex is the stream index; radiusScale grows the bounding sphere of
+    // an object placed by an instance
+    const auto addEmitter = [&](const int objIndex, const int instance, const float radiusScale) {
+        const SceneObject& obj = sceneData.streamObject(objIndex);
+        // Infinite planes cannot be sampled by position
+        if (obj.type == OBJ_PLANE) return;
+
+        const int matIndex = obj.materialIndex;
+        if (matIndex < 0 || matIndex >= static_cast<int>(sceneData.materials.size())) return;
+        const GPUMaterial& mat = sceneData.materials[matIndex];
+        if (mat.emissionMode == EMISSION_ABSOLUTE) return;
+
+        // sampleDirectLight treats every emitter as its bounding sphere
+        const float radius = obj.radius * radiusScale;
+        const float luminance = glm::dot(mat.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        const float emitted = luminance * mat.emissionStrength * 4.0f * 3.14159265f * radius * radius;
+        if (emitted <= 0.0f) {
+            if (instance < 0 && flaggedLights.count(objIndex) > 0) {
+                std::cout << "  Light object " << objIndex << " emits no power, excluded from light sampling" << std::endl;
+            }
+            return;
+        }
+
+        GPULight light{};
+        light.objIndex = objIndex;
+        light.matIndex = matIndex;
+        light.instance = instance;
+        sceneData.lightTable.push_back(light);
+        power.push_back(emitted);
+    };
+
+    for (size_t i = 0; i < sceneData.objects.size(); i++) {
+        addEmitter(static_cast<int>(i), -1, 1.0f);
+    }
+
+    // Emitters inside a prototype are sampled separately for every instance
+    const int objectBase = static_cast<int>(sceneData.objects.size());
+    for (size_t i = 0; i < sceneData.instances.size(); i++) {
+        const ScenePrototype& proto = sceneData.prototypes[sceneData.instances[i].prototype];
+        for (int k = 0; k < proto.objectCount; k++) {
+            addEmitter(objectBase + proto.firstObject + k, static_cast<int>(i), sceneData.instanceTransforms[i].maxScale);
+        }
+    }
+
+    const int n = static_cast<int>(sceneData.lightTable.size());
+    if (n == 0) return;
+
+    double totalPower = 0.0;
+    for (const float p : power) totalPower += p;
+
+    // Vose's alias method: scaled[i] = n * pdf[i], split into under- and
+    // over-full slots and pair them up
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; i++) {
+        sceneData.lightTable[i].pdf = static_cast<float>(power[i] / totalPower);
+        scaled[i] = power[i] / totalPower * n;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        const int s = small.back();
+        small.pop_back();
+        const int l = large.back();
+
+        sceneData.lightTable[s].aliasProb = static_cast<float>(scaled[s]);
+        sceneData.lightTable[s].alias = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Leftovers are full up to rounding error
+    for (const int i : small) {
+        sceneData.lightTable[i].aliasProb = 1.0f;
+        sceneData.lightTable[i].alias = i;
+    }
+    for (const int i : large) {
+        sceneData.lightTable[i].aliasProb = 1.0f;
+        sceneData.lightTable[i].alias = i;
+    }
+}
+
+void SceneBuilder::buildAccelerationStructure(SceneData& sceneData) {
+    std::vector<AABB> primBounds;
+    std::vector<int> primRefs;
+    sceneData.planeIndices.clear();
+
+    for (size_t i = 0; i < sceneData.objects.size(); i++) {
+        const SceneObject& obj = sceneData.objects[i];
+        if (obj.type == OBJ_PLANE) {
+            sceneData.planeIndices.push_back(static_cast<int>(i));
+            continue;
+        }
+        primBounds.push_back(computeObjectBounds(obj, sceneData.meshes));
+        primRefs.push_back(static_cast<int>(i));
+    }
+
+    // Instances enter the top level as the transformed box of their prototype
+    std::vector<AABB> prototypeObjectBounds;
+    prototypeObjectBounds.reserve(sceneData.prototypeObjects.size());
+    for (const SceneObject& obj : sceneData.prototypeObjects) {
+        prototypeObjectBounds.push_back(computeObjectBounds(obj, sceneData.meshes));
+    }
+
+    std::vector<AABB> prototypeBounds(sceneData.prototypes.size());
+    for (size_t p = 0; p < sceneData.prototypes.size(); p++) {
+        const ScenePrototype& proto = sceneData.prototypes[p];
+        for (int k = 0; k < proto.objectCount; k++) {
+            prototypeBounds[p].grow(prototypeObjectBounds[proto.firstObject + k]);
+        }
+    }
+
+    for (size_t i = 0; i < sceneData.instances.size(); i++) {
+        primBounds.push_back(transformBounds(prototypeBounds[sceneData.instances[i].prototype],
+                                             sceneData.instanceTransforms[i]));
+        primRefs.push_back(-1 - static_cast<int>(i));
+    }
+
+    BVHBuilder::build(primBounds, sceneData.bvhNodes, sceneData.bvhPrimIndices);
+
+    // Leaves reference objects and instances, not positions in primBounds
+    for (int& index : sceneData.bvhPrimIndices) {
+        index = primRefs[index];
+    }
+
+    // Each prototype's BVH is appended after the top level, with child and
+    // leaf offsets rebased into the shared arrays. Prototypes are only
+    // reachable through the top level, so without one nothing is appended.
+    for (ScenePrototype& proto : sceneData.prototypes) {
+        proto.rootNode = -1;
+    }
+    if (!sceneData.bvhNodes.empty()) {
+        const int objectBase = static_cast<int>(sceneData.objects.size());
+        std::vector<AABB> bounds;
+        std::vector<GPUBVHNode> nodes;
+        std::vector<int> prims;
+        for (ScenePrototype& proto : sceneData.prototypes) {
+            bounds.assign(prototypeObjectBounds.begin() + proto.firstObject,
+                          prototypeObjectBounds.begin() + proto.firstObject + proto.objectCount);
+            BVHBuilder::build(bounds, nodes, prims);
+            if (nodes.empty()) continue;
+
+            const int nodeOffset = static_cast<int>(sceneData.bvhNodes.size());
+            const int primOffset = static_cast<int>(sceneData.bvhPrimIndices.size());
+            for (GPUBVHNode node : nodes) {
+                node.leftFirst += node.count > 0 ? primOffset : nodeOffset;
+                sceneData.bvhNodes.push_back(node);
+            }
+            for (const int prim : prims) {
+                sceneData.bvhPrimIndices.push_back(objectBase + proto.firstObject + prim);
+            }
+            proto.rootNode = nodeOffset;
+        }
+    }
+
+    for (size_t i = 0; i < sceneData.instances.size(); i++) {
+        sceneData.instanceTransforms[i].rootNode = sceneData.prototypes[sceneData.instances[i].prototype].rootNode;
+    }
+}
+
 SceneData SceneBuilder::buildScene(const SceneConfig& config) {
     SceneData sceneData;
 
@@ -81,73 +712,246 @@ SceneData SceneBuilder::buildScene(const SceneConfig& config) {
     sceneData.materialMap = buildMaterialMap(config.materials, sceneData.materials);
 
     std::cout << "Building objects..." << std::endl;
-    for (size_t i = 0; i < config.objects.size(); i++) {
-        const auto& objConfig = config.objects[i];
-        int matIndex = resolveMaterialIndex(objConfig.material, sceneData.materialMap);
+    sceneData.objects.reserve(config.objects.size());
+    for (const auto& objConfig : config.objects) {
+        appendObject(sceneData, objConfig, resolveMaterialIndex(objConfig.material, sceneData.materialMap));
+    }
+
+    std::string instanceError;
+    if (!buildInstances(config.prototypes, config.instances, sceneData, instanceError)) {
+        std::cout << "  Instances skipped: " << instanceError << std::endl;
+    }
+
+    // Failures are reported by loadMeshes; those meshes stay empty
+    std::string meshError;
+    loadMeshes(sceneData, meshError);
+
+    finishScene(sceneData);
+    return sceneData;
+}
+
+bool SceneBuilder::buildSceneFromFile(const std::string& filepath, SceneConfig& config, SceneData& sceneData,
+                                      std::string& errorMsg) {
+    SceneConfig parsed;
+    SceneData built;
+    if (!parseSceneFile(filepath, parsed, built, errorMsg) || !completeScene(built, errorMsg)) return false;
 
-        GPUObject gpuObj;
+    config = std::move(parsed);
+    sceneData = std::move(built);
+    return true;
+}
 
-        if (objConfig.type == "sphere") {
-            gpuObj = makeSphere(objConfig.center, objConfig.radius, matIndex);
-            sceneData.objects.push_back(gpuObj);
+bool SceneBuilder::parseSceneFile(const std::string& filepath, SceneConfig& config, SceneData& sceneData,
+                                  std::string& errorMsg) {
+    SceneData built;
+    std::string streamError;
+
+    // Objects may name a material that only appears later in the file. Each
+    // such name gets a provisional index -(1 + n), resolved after parsing;
+    // firstUse keeps the first object that referenced it for the error message
+    std::map<std::string, int> forwardRefs;
+    std::vector<size_t> firstUse;
+
+    // Prototypes may also name later materials; they are small, so they are
+    // kept as parsed and built once every material is known
+    std::vector<PrototypeConfig> prototypes;
+    std::vector<InstanceConfig> instances;
+
+    std::cout << "Building scene: " << filepath << std::endl;
+
+    SceneStreamCallbacks callbacks;
+    callbacks.onMaterial = [&](const MaterialConfig& matConfig) {
+        if (!streamError.empty()) return;
+        if (matConfig.name.empty()) {
+            streamError = "Material with empty name found";
+            return;
+        }
+        const int index = static_cast<int>(built.materials.size());
+        if (!built.materialMap.emplace(matConfig.name, index).second) {
+            streamError = "Duplicate material name: " + matConfig.name;
+            return;
+        }
+        built.materials.push_back(MaterialFactory::buildMaterial(matConfig));
+        std::cout << "  Material '" << matConfig.name << "' → index " << index << std::endl;
+    };
+    callbacks.onObject = [&](const ObjectConfig& objConfig) {
+        if (!streamError.empty()) return;
+        if (objConfig.material.empty()) {
+            streamError = "Object " + std::to_string(built.objects.size()) + " has no material assigned";
+            return;
+        }
+        int matIndex;
+        const auto it = built.materialMap.find(objConfig.material);
+        if (it != built.materialMap.end()) {
+            matIndex = it->second;
         }
         else {
-            glm::vec3 scale = glm::vec3(1.0f);
-            int type = 0;
-
-            if (objConfig.type == "plane") {
-                type = 1; // OBJ_PLANE
-                gpuObj.data1 = glm::vec4(objConfig.normal, objConfig.distance);
-                gpuObj.data2 = glm::vec4(0.0f, 0.0f, 0.0f, (float)matIndex);
-                gpuObj.data3 = glm::vec4(0.0f, 0.0f, 0.0f, (float)type);
-                sceneData.objects.push_back(gpuObj);
-                continue;
-            }
-            else if (objConfig.type == "cube" || objConfig.type == "box") {
-                type = 2; // OBJ_CUBE
-                scale = objConfig.size * 0.5f;
-            }
-            else if (objConfig.type == "cylinder") {
-                type = 3; // OBJ_CYLINDER
-                scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
-            }
-            else if (objConfig.type == "cone") {
-                type = 4; // OBJ_CONE
-                scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
-            }
-            else if (objConfig.type == "pyramid") {
-                type = 5; // OBJ_PYRAMID
-                scale = glm::vec3(objConfig.radius);
-            }
-            else if (objConfig.type == "tetrahedron") {
-                type = 6; // OBJ_TETRAHEDRON
-                scale = glm::vec3(objConfig.radius);
-            }
-            else if (objConfig.type == "prism") {
-                type = 7; // OBJ_PRISM
-                scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
-            }
-            else if (objConfig.type == "dodecahedron") {
-                type = 8; // OBJ_DODECAHEDRON
-                scale = glm::vec3(objConfig.radius);
+            const auto [ref, added] = forwardRefs.emplace(objConfig.material, static_cast<int>(firstUse.size()));
+            if (added) firstUse.push_back(built.objects.size());
+            matIndex = -1 - ref->second;
+        }
+        appendObject(built, objConfig, matIndex);
+    };
+    callbacks.onPrototype = [&](const PrototypeConfig& proto) { prototypes.push_back(proto); };
+    callbacks.onInstance = [&](const InstanceConfig& inst) { instances.push_back(inst); };
+
+    auto settings = SceneLoader::streamFromFile(filepath, callbacks);
+    if (!settings.has_value()) {
+        errorMsg = "Failed to load scene: " + SceneLoader::getLastError();
+        return false;
+    }
+
+    if (streamError.empty() && built.materials.empty()) streamError = "Scene has no materials defined";
+    if (streamError.empty() && built.objects.empty()) streamError = "Scene has no objects defined";
+
+    if (streamError.empty() && !forwardRefs.empty()) {
+        std::vector<int> resolved(firstUse.size());
+        size_t firstUnknown = built.objects.size();
+        for (const auto& [name, ref] : forwardRefs) {
+            const auto it = built.materialMap.find(name);
+            if (it != built.materialMap.end()) {
+                resolved[ref] = it->second;
             }
-            else if (objConfig.type == "icosahedron") {
-                type = 9; // OBJ_ICOSAHEDRON
-                scale = glm::vec3(objConfig.radius);
+            else if (firstUse[ref] < firstUnknown) {
+                firstUnknown = firstUse[ref];
+                streamError = "Object " + std::to_string(firstUnknown) + " references unknown material: " + name;
             }
-
-            gpuObj = makeObject(type, objConfig.center, objConfig.rotation, scale, matIndex);
-            sceneData.objects.push_back(gpuObj);
         }
-
-        if (objConfig.isLight) {
-            sceneData.lightIndices.push_back((int)sceneData.objects.size() - 1);
+        for (SceneObject& obj : built.objects) {
+            if (obj.materialIndex < 0) obj.materialIndex = resolved[-1 - obj.materialIndex];
         }
     }
 
+    if (streamError.empty()) {
+        buildInstances(prototypes, instances, built, streamError);
+    }
+
+    if (!streamError.empty()) {
+        errorMsg = "Scene validation failed: " + streamError;
+        return false;
+    }
+
+    config = std::move(settings.value());
+    sceneData = std::move(built);
+    return true;
+}
+
+bool SceneBuilder::completeScene(SceneData& sceneData, std::string& errorMsg) {
+    std::string meshError;
+    if (!loadMeshes(sceneData, meshError)) {
+        errorMsg = "Failed to load mesh: " + meshError;
+        return false;
+    }
+    finishScene(sceneData);
+    return true;
+}
+
+void SceneBuilder::finishScene(SceneData& sceneData) {
+    packObjects(sceneData);
+    buildObjectTransforms(sceneData);
+    buildInstanceTransforms(sceneData);
+    buildAccelerationStructure(sceneData);
+    buildLightTable(sceneData);
+
     std::cout << "Scene built: " << sceneData.objects.size() << " objects, "
+              << sceneData.instances.size() << " instances of "
+              << sceneData.prototypes.size() << " prototypes, "
+              << sceneData.meshes.size() << " meshes ("
+              << sceneData.meshIndices.size() / 3 << " triangles), "
               << sceneData.materials.size() << " materials, "
-              << sceneData.lightIndices.size() << " lights" << std::endl;
+              << sceneData.lightIndices.size() << " lights ("
+              << sceneData.lightTable.size() << " sampled emitters), "
+              << sceneData.bvhNodes.size() << " BVH nodes" << std::endl;
+}
 
-    return sceneData;
-}
\ No newline at end of file
+void SceneBuilder::appendObject(SceneData& sceneData, const ObjectConfig& objConfig, const int matIndex,
+                                const bool prototype) {
+    std::vector<SceneObject>& objects = prototype ? sceneData.prototypeObjects : sceneData.objects;
+
+    if (objConfig.type == "sphere") {
+        objects.push_back(makeSphere(objConfig.center, objConfig.radius, matIndex));
+    }
+    else if (objConfig.type == "mesh") {
+        // Objects naming the same file share one mesh
+        SceneObject obj = makeObject(OBJ_MESH, objConfig.center, objConfig.rotation, objConfig.scale, matIndex);
+        const auto [entry, added] = sceneData.meshMap.emplace(objConfig.file, static_cast<int>(sceneData.meshes.size()));
+        if (added) sceneData.meshes.emplace_back();
+        obj.mesh = entry->second;
+        objects.push_back(obj);
+    }
+    else {
+        glm::vec3 scale = glm::vec3(1.0f);
+        int type = 0;
+
+        if (objConfig.type == "plane") {
+            objects.push_back(makePlane(objConfig.normal, objConfig.distance, matIndex));
+            return;
+        }
+        else if (objConfig.type == "cube" || objConfig.type == "box") {
+            type = 2; // OBJ_CUBE
+            scale = objConfig.size * 0.5f;
+        }
+        else if (objConfig.type == "cylinder") {
+            type = 3; // OBJ_CYLINDER
+            scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
+        }
+        else if (objConfig.type == "cone") {
+            type = 4; // OBJ_CONE
+            scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
+        }
+        else if (objConfig.type == "pyramid") {
+            type = 5; // OBJ_PYRAMID
+            scale = glm::vec3(objConfig.radius);
+        }
+        else if (objConfig.type == "tetrahedron") {
+            type = 6; // OBJ_TETRAHEDRON
+            scale = glm::vec3(objConfig.radius);
+        }
+        else if (objConfig.type == "prism") {
+            type = 7; // OBJ_PRISM
+            scale = glm::vec3(objConfig.radius, objConfig.height, objConfig.radius);
+        }
+        else if (objConfig.type == "dodecahedron") {
+            type = 8; // OBJ_DODECAHEDRON
+            scale = glm::vec3(objConfig.radius);
+        }
+        else if (objConfig.type == "icosahedron") {
+            type = 9; // OBJ_ICOSAHEDRON
+            scale = glm::vec3(objConfig.radius);
+        }
+
+        objects.push_back(makeObject(type, objConfig.center, objConfig.rotation, scale, matIndex));
+    }
+
+    if (objConfig.isLight) {
+        const size_t streamIndex = prototype ? sceneData.streamObjectCount() - 1 : sceneData.objects.size() - 1;
+        sceneData.lightIndices.push_back(static_cast<int>(streamIndex));
+    }
+}
+
+bool SceneBuilder::buildInstances(const std::vector<PrototypeConfig>& prototypeConfigs,
+                                  const std::vector<InstanceConfig>& instanceConfigs,
+                                  SceneData& sceneData, std::string& errorMsg) {
+    const auto materialExists = [&sceneData](const std::string& name) {
+        return sceneData.materialMap.count(name) > 0;
+    };
+    if (!validateInstancing(prototypeConfigs, instanceConfigs, materialExists, errorMsg)) return false;
+
+    std::map<std::string, int> prototypeMap;
+    for (const auto& protoConfig : prototypeConfigs) {
+        ScenePrototype proto;
+        proto.firstObject = static_cast<int>(sceneData.prototypeObjects.size());
+        for (const auto& objConfig : protoConfig.objects) {
+            appendObject(sceneData, objConfig, sceneData.materialMap.at(objConfig.material), true);
+        }
+        proto.objectCount = static_cast<int>(sceneData.prototypeObjects.size()) - proto.firstObject;
+
+        prototypeMap[protoConfig.name] = static_cast<int>(sceneData.prototypes.size());
+        sceneData.prototypes.push_back(proto);
+    }
+
+    for (const auto& instConfig : instanceConfigs) {
+        expandInstances(instConfig, prototypeMap.at(instConfig.prototype), sceneData.instances);
+    }
+    return true;
+}
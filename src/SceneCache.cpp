@@ -0,0 +1,381 @@
+#include "SceneCache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "SceneLoader.h"
+
+namespace {
+
+constexpr char SCENE_CACHE_MAGIC[4] = {'R', 'P', 'S', 'C'};
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+struct CacheHeader {
+    char magic[4];            // "RPSC"
+    uint32_t version;
+    uint64_t sourceHash;      // hashSceneFile() of the JSON it was built from
+    uint32_t sectionCount;
+    uint32_t reserved[11];
+};
+static_assert(sizeof(CacheHeader) == 64, "scene cache header must stay 64 bytes");
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t elementSize;     // sizeof the element type when written
+    uint64_t offset;          // from the start of the file
+    uint64_t count;
+};
+
+enum SectionId : uint32_t {
+    SECTION_OBJECTS,
+    SECTION_OBJECT_GEOMETRY,
+    SECTION_OBJECT_TYPES,
+    SECTION_OBJECT_MATERIALS,
+    SECTION_MATERIALS,
+    SECTION_LIGHT_INDICES,
+    SECTION_LIGHT_TABLE,
+    SECTION_BVH_NODES,
+    SECTION_BVH_PRIM_INDICES,
+    SECTION_PLANE_INDICES,
+    SECTION_OBJECT_TRANSFORMS,
+    SECTION_CONVEX_PLANES,
+    SECTION_PROTOTYPE_OBJECTS,
+    SECTION_PROTOTYPES,
+    SECTION_INSTANCES,
+    SECTION_INSTANCE_TRANSFORMS,
+    SECTION_MESHES,
+    SECTION_MESH_VERTICES,
+    SECTION_MESH_INDICES,
+    SECTION_MESH_NODES,
+    SECTION_MESH_NAMES,       // same encoding as SECTION_MATERIAL_NAMES
+    SECTION_MESH_HASHES,      // hashSceneFile() of each mesh file when built
+    SECTION_MATERIAL_NAMES,   // [uint32 index][uint32 length][name bytes] per entry
+    SECTION_COUNT
+};
+
+struct SectionSource {
+    uint32_t elementSize;
+    const void* data;
+    uint64_t count;
+};
+
+template <typename T>
+SectionSource sectionOf(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>, "cached arrays are written as raw bytes");
+    return {static_cast<uint32_t>(sizeof(T)), values.data(), values.size()};
+}
+
+uint64_t alignOffset(const uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+std::vector<char> packNames(const std::map<std::string, int>& nameMap) {
+    std::vector<char> blob;
+    for (const auto& [name, index] : nameMap) {
+        const uint32_t fields[2] = {static_cast<uint32_t>(index), static_cast<uint32_t>(name.size())};
+        const char* fieldBytes = reinterpret_cast<const char*>(fields);
+        blob.insert(blob.end(), fieldBytes, fieldBytes + sizeof(fields));
+        blob.insert(blob.end(), name.begin(), name.end());
+    }
+    return blob;
+}
+
+bool unpackNames(const std::vector<char>& blob, std::map<std::string, int>& nameMap) {
+    nameMap.clear();
+    size_t pos = 0;
+    while (pos < blob.size()) {
+        uint32_t fields[2];
+        if (blob.size() - pos < sizeof(fields)) return false;
+        std::memcpy(fields, blob.data() + pos, sizeof(fields));
+        pos += sizeof(fields);
+        if (blob.size() - pos < fields[1]) return false;
+        nameMap[std::string(blob.data() + pos, fields[1])] = static_cast<int>(fields[0]);
+        pos += fields[1];
+    }
+    return true;
+}
+
+// Read-only view of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) return;
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (bytes != nullptr) length = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) return;
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) return;
+        bytes = static_cast<const char*>(view);
+        length = static_cast<uint64_t>(info.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes != nullptr) UnmapViewOfFile(bytes);
+        if (mapping != nullptr) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes != nullptr) munmap(const_cast<char*>(bytes), static_cast<size_t>(length));
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    uint64_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    uint64_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+template <typename T>
+bool readSection(const MappedFile& file, const SectionEntry& entry, std::vector<T>& values) {
+    if (entry.elementSize != sizeof(T) || entry.offset > file.size()) return false;
+    if (entry.count > (file.size() - entry.offset) / sizeof(T)) return false;
+    values.resize(entry.count);
+    if (entry.count > 0) {
+        std::memcpy(values.data(), file.data() + entry.offset, entry.count * sizeof(T));
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t hashSceneFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> block(1 << 16);
+    while (file) {
+        file.read(block.data(), static_cast<std::streamsize>(block.size()));
+        const std::streamsize n = file.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+            hash ^= static_cast<unsigned char>(block[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+uint64_t hashSceneSources(const std::string& scenePath, const SceneData& sceneData) {
+    // meshMap is ordered by path, so the result does not depend on load order
+    uint64_t hash = hashSceneFile(scenePath);
+    for (const auto& [path, index] : sceneData.meshMap) {
+        const uint64_t meshHash = hashSceneFile(path);
+        for (int byte = 0; byte < 8; ++byte) {
+            hash ^= (meshHash >> (8 * byte)) & 0xffu;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+std::string SceneCache::cachePathFor(const std::string& scenePath) {
+    return std::filesystem::path(scenePath).replace_extension(".rpscene").string();
+}
+
+bool SceneCache::load(const std::string& cachePath, const uint64_t sourceHash, SceneData& sceneData) {
+    const MappedFile file(cachePath);
+    if (file.data() == nullptr || file.size() < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SCENE_CACHE_VERSION || header.sourceHash != sourceHash ||
+        header.sectionCount != SECTION_COUNT) {
+        return false;
+    }
+    if (file.size() < sizeof(CacheHeader) + SECTION_COUNT * sizeof(SectionEntry)) return false;
+
+    SectionEntry sections[SECTION_COUNT];
+    std::memcpy(sections, file.data() + sizeof(CacheHeader), sizeof(sections));
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+        if (sections[i].id != i) return false;
+    }
+
+    SceneData loaded;
+    std::vector<char> materialNames;
+    std::vector<char> meshNames;
+    std::vector<uint64_t> meshHashes;
+    const bool ok =
+        readSection(file, sections[SECTION_OBJECTS], loaded.objects) &&
+        readSection(file, sections[SECTION_OBJECT_GEOMETRY], loaded.objectGeometry) &&
+        readSection(file, sections[SECTION_OBJECT_TYPES], loaded.objectTypes) &&
+        readSection(file, sections[SECTION_OBJECT_MATERIALS], loaded.objectMaterials) &&
+        readSection(file, sections[SECTION_MATERIALS], loaded.materials) &&
+        readSection(file, sections[SECTION_LIGHT_INDICES], loaded.lightIndices) &&
+        readSection(file, sections[SECTION_LIGHT_TABLE], loaded.lightTable) &&
+        readSection(file, sections[SECTION_BVH_NODES], loaded.bvhNodes) &&
+        readSection(file, sections[SECTION_BVH_PRIM_INDICES], loaded.bvhPrimIndices) &&
+        readSection(file, sections[SECTION_PLANE_INDICES], loaded.planeIndices) &&
+        readSection(file, sections[SECTION_OBJECT_TRANSFORMS], loaded.objectTransforms) &&
+        readSection(file, sections[SECTION_CONVEX_PLANES], loaded.convexPlanes) &&
+        readSection(file, sections[SECTION_PROTOTYPE_OBJECTS], loaded.prototypeObjects) &&
+        readSection(file, sections[SECTION_PROTOTYPES], loaded.prototypes) &&
+        readSection(file, sections[SECTION_INSTANCES], loaded.instances) &&
+        readSection(file, sections[SECTION_INSTANCE_TRANSFORMS], loaded.instanceTransforms) &&
+        readSection(file, sections[SECTION_MESHES], loaded.meshes) &&
+        readSection(file, sections[SECTION_MESH_VERTICES], loaded.meshVertices) &&
+        readSection(file, sections[SECTION_MESH_INDICES], loaded.meshIndices) &&
+        readSection(file, sections[SECTION_MESH_NODES], loaded.meshNodes) &&
+        readSection(file, sections[SECTION_MESH_NAMES], meshNames) &&
+        readSection(file, sections[SECTION_MESH_HASHES], meshHashes) &&
+        readSection(file, sections[SECTION_MATERIAL_NAMES], materialNames) &&
+        unpackNames(meshNames, loaded.meshMap) &&
+        unpackNames(materialNames, loaded.materialMap) &&
+        meshHashes.size() == loaded.meshes.size();
+    if (!ok) {
+        printf("WARNING: Scene cache %s is damaged, rebuilding\n", cachePath.c_str());
+        return false;
+    }
+
+    // The JSON hash does not cover the mesh files it names
+    for (const auto& [path, index] : loaded.meshMap) {
+        if (index < 0 || static_cast<size_t>(index) >= meshHashes.size() || hashSceneFile(path) != meshHashes[index]) {
+            printf("Mesh %s changed since %s was built, rebuilding\n", path.c_str(), cachePath.c_str());
+            return false;
+        }
+    }
+
+    sceneData = std::move(loaded);
+    return true;
+}
+
+bool SceneCache::save(const std::string& cachePath, const uint64_t sourceHash, const SceneData& sceneData) {
+    const std::vector<char> materialNames = packNames(sceneData.materialMap);
+    const std::vector<char> meshNames = packNames(sceneData.meshMap);
+    std::vector<uint64_t> meshHashes(sceneData.meshes.size(), 0);
+    for (const auto& [path, index] : sceneData.meshMap) {
+        meshHashes[index] = hashSceneFile(path);
+    }
+    const SectionSource sources[SECTION_COUNT] = {
+        sectionOf(sceneData.objects),
+        sectionOf(sceneData.objectGeometry),
+        sectionOf(sceneData.objectTypes),
+        sectionOf(sceneData.objectMaterials),
+        sectionOf(sceneData.materials),
+        sectionOf(sceneData.lightIndices),
+        sectionOf(sceneData.lightTable),
+        sectionOf(sceneData.bvhNodes),
+        sectionOf(sceneData.bvhPrimIndices),
+        sectionOf(sceneData.planeIndices),
+        sectionOf(sceneData.objectTransforms),
+        sectionOf(sceneData.convexPlanes),
+        sectionOf(sceneData.prototypeObjects),
+        sectionOf(sceneData.prototypes),
+        sectionOf(sceneData.instances),
+        sectionOf(sceneData.instanceTransforms),
+        sectionOf(sceneData.meshes),
+        sectionOf(sceneData.meshVertices),
+        sectionOf(sceneData.meshIndices),
+        sectionOf(sceneData.meshNodes),
+        sectionOf(meshNames),
+        sectionOf(meshHashes),
+        sectionOf(materialNames),
+    };
+
+    CacheHeader header{};
+    std::memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.sectionCount = SECTION_COUNT;
+
+    SectionEntry sections[SECTION_COUNT];
+    uint64_t offset = sizeof(CacheHeader) + sizeof(sections);
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+        offset = alignOffset(offset);
+        sections[i] = {i, sources[i].elementSize, offset, sources[i].count};
+        offset += sources[i].elementSize * sources[i].count;
+    }
+
+    const std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            printf("WARNING: Could not write scene cache %s\n", tmpPath.c_str());
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+
+        static const char padding[SECTION_ALIGNMENT] = {};
+        uint64_t written = sizeof(CacheHeader) + sizeof(sections);
+        for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+            file.write(padding, static_cast<std::streamsize>(sections[i].offset - written));
+            const uint64_t bytes = sources[i].elementSize * sources[i].count;
+            file.write(static_cast<const char*>(sources[i].data), static_cast<std::streamsize>(bytes));
+            written = sections[i].offset + bytes;
+        }
+        if (!file) {
+            printf("WARNING: Failed while writing scene cache %s\n", tmpPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, cachePath, ec);
+    if (ec) {
+        printf("WARNING: Could not replace scene cache %s: %s\n", cachePath.c_str(), ec.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SceneCache::loadScene(const std::string& scenePath, SceneConfig& config, SceneData& sceneData) {
+    const uint64_t sourceHash = hashSceneFile(scenePath);
+    const std::string cachePath = cachePathFor(scenePath);
+
+    if (sourceHash != 0 && load(cachePath, sourceHash, sceneData)) {
+        auto settings = SceneLoader::loadSettingsFromFile(scenePath);
+        if (!settings.has_value()) {
+            printf("ERROR: Failed to load scene: %s\n", SceneLoader::getLastError().c_str());
+            return false;
+        }
+        config = std::move(settings.value());
+        printf("Loaded compiled scene %s (%zu objects)\n", cachePath.c_str(), sceneData.objects.size());
+        return true;
+    }
+
+    std::string error;
+    if (!SceneBuilder::buildSceneFromFile(scenePath, config, sceneData, error)) {
+        printf("ERROR: %s\n", error.c_str());
+        return false;
+    }
+    if (sourceHash != 0) save(cachePath, sourceHash, sceneData);
+    return true;
+}
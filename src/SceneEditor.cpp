@@ -0,0 +1,272 @@
+#include "SceneEditor.h"
+#include <cstdio>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+bool sameObject(const SceneObject& a, const SceneObject& b) {
+    return a.center == b.center && a.radius == b.radius && a.rotation == b.rotation && a.scale == b.scale &&
+           a.normal == b.normal && a.distance == b.distance;
+}
+
+} // namespace
+
+SceneEditor::SceneEditor(SceneData& sceneData) : scene(sceneData) {
+    const std::vector<GPUBVHNode>& nodes = scene.bvhNodes;
+    nodeParent.assign(nodes.size(), -1);
+    rootPrototype.assign(nodes.size(), -1);
+    objectLeaf.assign(scene.streamObjectCount(), -1);
+    instanceLeaf.assign(scene.instances.size(), -1);
+
+    for (size_t n = 0; n < nodes.size(); n++) {
+        const GPUBVHNode& node = nodes[n];
+        if (node.count == 0) {
+            nodeParent[node.leftFirst] = static_cast<int>(n);
+            nodeParent[node.leftFirst + 1] = static_cast<int>(n);
+            continue;
+        }
+        for (int p = node.leftFirst; p < node.leftFirst + node.count; p++) {
+            const int ref = scene.bvhPrimIndices[p];
+            if (ref < 0) instanceLeaf[-1 - ref] = static_cast<int>(n);
+            else objectLeaf[ref] = static_cast<int>(n);
+        }
+    }
+
+    objectPrototype.assign(scene.prototypeObjects.size(), -1);
+    prototypeInstances.resize(scene.prototypes.size());
+    for (size_t p = 0; p < scene.prototypes.size(); p++) {
+        const ScenePrototype& proto = scene.prototypes[p];
+        for (int k = 0; k < proto.objectCount; k++) {
+            objectPrototype[proto.firstObject + k] = static_cast<int>(p);
+        }
+        if (proto.rootNode >= 0) rootPrototype[proto.rootNode] = static_cast<int>(p);
+    }
+    for (size_t i = 0; i < scene.instances.size(); i++) {
+        prototypeInstances[scene.instances[i].prototype].push_back(static_cast<int>(i));
+    }
+}
+
+bool SceneEditor::setObject(const size_t index, const SceneObject& obj) {
+    if (index >= scene.streamObjectCount()) {
+        printf("ERROR: No object %zu to edit\n", index);
+        return false;
+    }
+    if (obj.materialIndex < 0 || obj.materialIndex >= static_cast<int>(scene.materials.size())) {
+        printf("ERROR: No material %d for object %zu\n", obj.materialIndex, index);
+        return false;
+    }
+
+    SceneObject& current = index < scene.objects.size()
+        ? scene.objects[index]
+        : scene.prototypeObjects[index - scene.objects.size()];
+
+    SceneObject edited = current;
+    edited.materialIndex = obj.materialIndex;
+    if (current.type == OBJ_PLANE) {
+        edited.normal = obj.normal;
+        edited.distance = obj.distance;
+    } else {
+        edited.center = obj.center;
+        edited.rotation = obj.rotation;
+        if (current.type == OBJ_SPHERE) {
+            edited.radius = obj.radius;
+            edited.scale = glm::vec3(obj.radius);
+        } else {
+            edited.scale = obj.scale;
+            edited.radius = SceneBuilder::boundingRadius(edited, scene.meshes);
+        }
+    }
+
+    const bool shapeChanged = !sameObject(current, edited);
+    const bool materialChanged = current.materialIndex != edited.materialIndex;
+    if (!shapeChanged && !materialChanged) return false;
+
+    // Emitted power grows with the bounding sphere
+    if ((materialChanged || current.radius != edited.radius) &&
+        (emits(current.materialIndex) || emits(edited.materialIndex))) {
+        pending.lightTable = true;
+    }
+    current = edited;
+
+    const int i = static_cast<int>(index);
+    scene.objectGeometry[i] = SceneBuilder::packGeometry(current);
+    scene.objectMaterials[i] = current.materialIndex;
+    pending.objects.add(i);
+
+    if (shapeChanged && current.type != OBJ_SPHERE && current.type != OBJ_PLANE) {
+        // Polyhedra keep their face-plane slots: the count depends on the type only
+        std::vector<glm::vec4> planes;
+        GPUObjectTransform xf = SceneBuilder::buildObjectTransform(current, scene.meshes, planes);
+        xf.planeOffset = scene.objectTransforms[i].planeOffset;
+        for (int k = 0; k < xf.planeCount; k++) {
+            scene.convexPlanes[xf.planeOffset + k] = planes[k];
+        }
+        if (xf.planeCount > 0) {
+            pending.convexPlanes.add(xf.planeOffset);
+            pending.convexPlanes.add(xf.planeOffset + xf.planeCount - 1);
+        }
+        scene.objectTransforms[i] = xf;
+        pending.objectTransforms.add(i);
+    }
+
+    if (shapeChanged && objectLeaf[i] >= 0) markLeaf(objectLeaf[i]);
+    if (objectVisible(index)) pending.visible = true;
+    return true;
+}
+
+bool SceneEditor::setMaterial(const size_t index, const GPUMaterial& material) {
+    if (index >= scene.materials.size()) {
+        printf("ERROR: No material %zu to edit\n", index);
+        return false;
+    }
+
+    GPUMaterial& current = scene.materials[index];
+    GPUMaterial edited = material;
+    edited._pad0 = current._pad0;
+    edited._pad2 = current._pad2;
+    if (std::memcmp(&edited, &current, sizeof(GPUMaterial)) == 0) return false;
+
+    const int m = static_cast<int>(index);
+    const bool emissionChanged = edited.emission != current.emission ||
+        edited.emissionStrength != current.emissionStrength || edited.emissionMode != current.emissionMode;
+    const bool emittedBefore = emits(m);
+    current = edited;
+    if (emissionChanged && (emittedBefore || emits(m))) pending.lightTable = true;
+
+    pending.materials.add(m);
+    if (materialVisible(m)) pending.visible = true;
+    return true;
+}
+
+bool SceneEditor::setInstance(const size_t index, const SceneInstance& instance) {
+    if (index >= scene.instances.size()) {
+        printf("ERROR: No instance %zu to edit\n", index);
+        return false;
+    }
+
+    SceneInstance& current = scene.instances[index];
+    if (current.position == instance.position && current.rotation == instance.rotation &&
+        current.scale == instance.scale) {
+        return false;
+    }
+    current.position = instance.position;
+    current.rotation = instance.rotation;
+    current.scale = instance.scale;
+
+    const int i = static_cast<int>(index);
+    const GPUInstance xf = SceneBuilder::buildInstanceTransform(current, scene.prototypes[current.prototype].rootNode);
+    // Emitters inside the prototype are sampled as spheres grown by maxScale
+    if (xf.maxScale != scene.instanceTransforms[i].maxScale) {
+        for (const GPULight& light : scene.lightTable) {
+            if (light.instance == i) {
+                pending.lightTable = true;
+                break;
+            }
+        }
+    }
+    scene.instanceTransforms[i] = xf;
+    pending.instanceTransforms.add(i);
+
+    if (instanceLeaf[i] >= 0) markLeaf(instanceLeaf[i]);
+    pending.visible = true;
+    return true;
+}
+
+SceneEdits SceneEditor::commit() {
+    refit();
+    if (pending.lightTable) SceneBuilder::buildLightTable(scene);
+
+    const SceneEdits edits = pending;
+    pending = SceneEdits{};
+    return edits;
+}
+
+bool SceneEditor::objectVisible(const size_t index) const {
+    if (index < scene.objects.size()) return true;
+    return !prototypeInstances[objectPrototype[index - scene.objects.size()]].empty();
+}
+
+bool SceneEditor::materialVisible(const int index) const {
+    for (size_t i = 0; i < scene.streamObjectCount(); i++) {
+        if (scene.streamObject(i).materialIndex == index && objectVisible(i)) return true;
+    }
+    return false;
+}
+
+bool SceneEditor::emits(const int materialIndex) const {
+    const GPUMaterial& mat = scene.materials[materialIndex];
+    if (mat.emissionMode == EMISSION_ABSOLUTE) return false;
+    return mat.emissionStrength * glm::dot(mat.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f)) > 0.0f;
+}
+
+void SceneEditor::markLeaf(const int node) {
+    dirtyLeaves.push_back(node);
+}
+
+AABB SceneEditor::leafBounds(const GPUBVHNode& leaf) const {
+    AABB bounds;
+    for (int p = leaf.leftFirst; p < leaf.leftFirst + leaf.count; p++) {
+        const int ref = scene.bvhPrimIndices[p];
+        if (ref >= 0) {
+            bounds.grow(SceneBuilder::computeObjectBounds(scene.streamObject(ref), scene.meshes));
+            continue;
+        }
+        // Box of the prototype's root, already refitted (see refit)
+        const int instance = -1 - ref;
+        const int root = scene.prototypes[scene.instances[instance].prototype].rootNode;
+        AABB local;
+        if (root >= 0) {
+            local.grow(scene.bvhNodes[root].boundsMin);
+            local.grow(scene.bvhNodes[root].boundsMax);
+        }
+        bounds.grow(SceneBuilder::transformBounds(local, scene.instanceTransforms[instance]));
+    }
+    return bounds;
+}
+
+void SceneEditor::refit() {
+    if (dirtyLeaves.empty()) return;
+
+    // Children always follow their parent and prototype BVHs follow the top
+    // level, so visiting the highest index first finishes every node's
+    // children (and the prototypes under an instance leaf) before the node
+    std::vector<GPUBVHNode>& nodes = scene.bvhNodes;
+    std::priority_queue<int> queue;
+    std::vector<bool> queued(nodes.size(), false);
+    const auto enqueue = [&](const int node) {
+        if (queued[node]) return;
+        queued[node] = true;
+        queue.push(node);
+    };
+    for (const int leaf : dirtyLeaves) enqueue(leaf);
+    dirtyLeaves.clear();
+
+    while (!queue.empty()) {
+        const int n = queue.top();
+        queue.pop();
+        GPUBVHNode& node = nodes[n];
+
+        AABB bounds;
+        if (node.count > 0) {
+            bounds = leafBounds(node);
+        } else {
+            bounds.min = glm::min(nodes[node.leftFirst].boundsMin, nodes[node.leftFirst + 1].boundsMin);
+            bounds.max = glm::max(nodes[node.leftFirst].boundsMax, nodes[node.leftFirst + 1].boundsMax);
+        }
+        // Unchanged boxes stop the walk
+        if (bounds.min == node.boundsMin && bounds.max == node.boundsMax) continue;
+
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+        pending.bvhNodes.add(n);
+
+        if (nodeParent[n] >= 0) {
+            enqueue(nodeParent[n]);
+        } else if (rootPrototype[n] >= 0) {
+            for (const int instance : prototypeInstances[rootPrototype[n]]) {
+                if (instanceLeaf[instance] >= 0) enqueue(instanceLeaf[instance]);
+            }
+        }
+    }
+}
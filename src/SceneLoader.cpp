@@ -1,7 +1,11 @@
 #include "SceneLoader.h"
+#include "sampler.h"
 #include <json.hpp>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -49,7 +53,8 @@ static MaterialConfig parseMaterial(const json& j) {
     return mat;
 }
 
-static ObjectConfig parseObject(const json& j) {
+// baseDir: directory of the scene file, for relative mesh paths
+static ObjectConfig parseObject(const json& j, const std::filesystem::path& baseDir) {
     ObjectConfig obj;
 
     obj.type = j.value("type", "sphere");
@@ -78,6 +83,15 @@ static ObjectConfig parseObject(const json& j) {
         obj.radius = j.value("radius", 0.5f);
         obj.height = j.value("height", 1.0f);
     }
+    else if (obj.type == "mesh") {
+        const std::string file = j.value("file", "");
+        if (!file.empty()) obj.file = (baseDir / std::filesystem::path(file)).lexically_normal().string();
+        if (j.contains("scale")) {
+            // A single number scales uniformly
+            const auto& scale = j["scale"];
+            obj.scale = scale.is_number() ? glm::vec3(scale.get<float>()) : parseVec3(scale, obj.scale);
+        }
+    }
     else {
         // Polyhedra (Tetra, Dodeca, Icosa, Pyramid)
         obj.radius = j.value("radius", 1.0f);
@@ -86,6 +100,59 @@ static ObjectConfig parseObject(const json& j) {
     return obj;
 }
 
+static PrototypeConfig parsePrototype(const json& j, const std::filesystem::path& baseDir) {
+    PrototypeConfig proto;
+    proto.name = j.value("name", "");
+    if (j.contains("objects")) {
+        for (const auto& objJson : j["objects"]) {
+            if (!objJson.contains("type")) continue;
+            proto.objects.push_back(parseObject(objJson, baseDir));
+        }
+    }
+    return proto;
+}
+
+static InstanceConfig parseInstance(const json& j) {
+    InstanceConfig inst;
+
+    inst.prototype = j.value("prototype", "");
+    if (j.contains("position")) inst.position = parseVec3(j["position"]);
+    if (j.contains("rotation")) inst.rotation = parseVec3(j["rotation"]);
+    if (j.contains("scale")) {
+        // A single number scales uniformly
+        const auto& scale = j["scale"];
+        inst.scale = scale.is_number() ? glm::vec3(scale.get<float>()) : parseVec3(scale, inst.scale);
+    }
+
+    // At most one generator per entry
+    if (j.contains("grid")) {
+        const auto& grid = j["grid"];
+        inst.generator = InstanceGenerator::Grid;
+        if (grid.contains("count")) inst.gridCount = glm::ivec3(parseVec3(grid["count"], glm::vec3(1.0f)));
+        if (grid.contains("spacing")) inst.spacing = parseVec3(grid["spacing"], inst.spacing);
+    }
+    else if (j.contains("ring")) {
+        const auto& ring = j["ring"];
+        inst.generator = InstanceGenerator::Ring;
+        inst.count = ring.value("count", inst.count);
+        inst.radius = ring.value("radius", inst.radius);
+        inst.orient = ring.value("orient", inst.orient);
+    }
+    else if (j.contains("scatter")) {
+        const auto& scatter = j["scatter"];
+        inst.generator = InstanceGenerator::Scatter;
+        inst.count = scatter.value("count", inst.count);
+        inst.seed = scatter.value("seed", inst.seed);
+        if (scatter.contains("extent")) inst.extent = parseVec3(scatter["extent"], inst.extent);
+        if (scatter.contains("rotationJitter")) inst.rotationJitter = parseVec3(scatter["rotationJitter"]);
+        if (scatter.contains("scaleRange") && scatter["scaleRange"].size() >= 2) {
+            inst.scaleRange = glm::vec2(scatter["scaleRange"][0].get<float>(), scatter["scaleRange"][1].get<float>());
+        }
+    }
+
+    return inst;
+}
+
 static BloomConfig parseBloom(const json& j) {
     BloomConfig bloom;
     if (j.contains("enabled")) bloom.enabled = j["enabled"].get<bool>();
@@ -97,62 +164,234 @@ static BloomConfig parseBloom(const json& j) {
     return bloom;
 }
 
-static std::string formatParseError(const json::exception& e, const std::string& filepath) {
-    std::string msg = "JSON Parse Error in '" + filepath + "':\n";
-    msg += "  " + std::string(e.what()) + "\n";
-    return msg;
+static AdaptiveConfig parseAdaptive(const json& j) {
+    AdaptiveConfig adaptive;
+    if (j.contains("enabled")) adaptive.enabled = j["enabled"].get<bool>();
+    if (j.contains("threshold")) adaptive.threshold = j["threshold"].get<float>();
+    if (j.contains("minSamples")) adaptive.minSamples = j["minSamples"].get<int>();
+    if (j.contains("maxBoost")) adaptive.maxBoost = j["maxBoost"].get<int>();
+    return adaptive;
 }
 
-std::optional<SceneConfig> SceneLoader::loadFromString(const std::string& jsonString) {
-    try {
-        json j = json::parse(jsonString, nullptr, true, true);
-
-        SceneConfig config;
 
-        if (j.contains("scene")) {
-            config.scene.name = j["scene"].value("name", config.scene.name);
-            config.scene.version = j["scene"].value("version", config.scene.version);
+// Settings sections; anything else at the top level is ignored
+static void parseSection(const std::string& key, const json& j, SceneConfig& config) {
+    if (key == "scene") {
+        config.scene.name = j.value("name", config.scene.name);
+        config.scene.version = j.value("version", config.scene.version);
+    }
+    else if (key == "camera") {
+        if (j.contains("position")) config.camera.position = parseVec3(j["position"], config.camera.position);
+        if (j.contains("rotation")) config.camera.rotation = parseVec3(j["rotation"], config.camera.rotation);
+        config.camera.fov = j.value("fov", config.camera.fov);
+        config.camera.aperture = j.value("aperture", config.camera.aperture);
+        config.camera.focusDist = j.value("focusDist", config.camera.focusDist);
+    }
+    else if (key == "sky") {
+        if (j.contains("colorTop")) config.sky.colorTop = parseVec3(j["colorTop"], config.sky.colorTop);
+        if (j.contains("colorBottom")) config.sky.colorBottom = parseVec3(j["colorBottom"], config.sky.colorBottom);
+    }
+    else if (key == "render") {
+        config.render.width = j.value("width", config.render.width);
+        config.render.height = j.value("height", config.render.height);
+        config.render.samplesPerFrame = j.value("samplesPerFrame", config.render.samplesPerFrame);
+        config.render.autoSamples = j.value("autoSamples", config.render.autoSamples);
+        config.render.targetFrameMs = j.value("targetFrameMs", config.render.targetFrameMs);
+        config.render.maxSamples = j.value("maxSamples", config.render.maxSamples);
+        config.render.maxBounces = j.value("maxBounces", config.render.maxBounces);
+        config.render.lightSamples = j.value("lightSamples", config.render.lightSamples);
+        config.render.wavefront = j.value("wavefront", config.render.wavefront);
+        if (j.contains("sampler")) {
+            const std::string name = j["sampler"].get<std::string>();
+            if (!parseSamplerType(name, config.render.sampler)) {
+                printf("WARNING: Unknown sampler \"%s\", using %s\n", name.c_str(),
+                       samplerTypeName(config.render.sampler));
+            }
+        }
+        config.render.seed = j.value("seed", config.render.seed);
+        if (j.contains("bloom")) {
+            config.render.bloom = parseBloom(j["bloom"]);
         }
+        if (j.contains("adaptive")) {
+            config.render.adaptive = parseAdaptive(j["adaptive"]);
+        }
+    }
+}
+
+namespace {
+
+// SAX consumer for scene files. Only one value is built as a DOM at a time:
+// a top-level section such as "camera", or a single element of the
+// "materials"/"objects"/"prototypes"/"instances" arrays, which goes to its
+// callback as soon as it is complete and is then dropped. Memory is bounded by the largest element
+// rather than by the file, and elements of an array without a callback are
+// skipped without being built.
+class SceneSaxHandler final : public nlohmann::json_sax<json> {
+public:
+    SceneSaxHandler(SceneConfig& config, const SceneStreamCallbacks& callbacks, std::filesystem::path baseDir)
+        : config(config), callbacks(callbacks), baseDir(std::move(baseDir)) {}
+
+    const std::string& getError() const { return error; }
+
+    bool null() override { return addValue(json(nullptr)); }
+    bool boolean(const bool value) override { return addValue(json(value)); }
+    bool number_integer(const number_integer_t value) override { return addValue(json(value)); }
+    bool number_unsigned(const number_unsigned_t value) override { return addValue(json(value)); }
+    bool number_float(const number_float_t value, const string_t&) override { return addValue(json(value)); }
+    bool string(string_t& value) override { return addValue(json(std::move(value))); }
+    bool binary(binary_t&) override { return true; } // never produced by JSON text
+
+    bool start_object(std::size_t) override { return openContainer(json::value_t::object); }
+    bool start_array(std::size_t) override { return openContainer(json::value_t::array); }
+    bool end_object() override { return closeContainer(); }
+    bool end_array() override { return closeContainer(); }
+
+    bool key(string_t& name) override {
+        if (depth == 1) section = name;
+        else if (!skipping()) pendingKey = std::move(name);
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override {
+        error = e.what();
+        return false;
+    }
+
+private:
+    enum class Stream { None, Materials, Objects, Prototypes, Instances };
+
+    static Stream streamFor(const std::string& key) {
+        if (key == "materials") return Stream::Materials;
+        if (key == "objects") return Stream::Objects;
+        if (key == "prototypes") return Stream::Prototypes;
+        if (key == "instances") return Stream::Instances;
+        return Stream::None;
+    }
+
+    bool fail(const char* message) {
+        error = message;
+        return false;
+    }
 
-        if (j.contains("camera")) {
-            const auto& cam = j["camera"];
-            config.camera.position = parseVec3(cam["position"], config.camera.position);
-            config.camera.rotation = parseVec3(cam["rotation"], config.camera.rotation);
-            config.camera.fov = cam.value("fov", config.camera.fov);
+    bool skipping() const {
+        switch (stream) {
+            case Stream::Materials: return !callbacks.onMaterial;
+            case Stream::Objects: return !callbacks.onObject;
+            case Stream::Prototypes: return !callbacks.onPrototype;
+            case Stream::Instances: return !callbacks.onInstance;
+            default: return false;
         }
+    }
 
-        if (j.contains("sky")) {
-            const auto& sky = j["sky"];
-            config.sky.colorTop = parseVec3(sky["colorTop"], config.sky.colorTop);
-            config.sky.colorBottom = parseVec3(sky["colorBottom"], config.sky.colorBottom);
+    // Places value in the innermost open container, or makes it the value
+    // being built if there is none
+    json* insert(json&& value) {
+        if (stack.empty()) {
+            current = std::move(value);
+            return &current;
+        }
+        json& parent = *stack.back();
+        if (parent.is_object()) {
+            json& slot = parent[pendingKey];
+            slot = std::move(value);
+            return &slot;
         }
+        parent.push_back(std::move(value));
+        return &parent.back();
+    }
 
-        if (j.contains("render")) {
-            const auto& render = j["render"];
-            config.render.width = render.value("width", config.render.width);
-            config.render.height = render.value("height", config.render.height);
-            config.render.samplesPerFrame = render.value("samplesPerFrame", config.render.samplesPerFrame);
-            config.render.maxSamples = render.value("maxSamples", config.render.maxSamples);
-            config.render.maxBounces = render.value("maxBounces", config.render.maxBounces);
-            if (render.contains("bloom")) {
-                config.render.bloom = parseBloom(render["bloom"]);
-            }
+    bool openContainer(const json::value_t type) {
+        const int level = depth++;
+        if (level == 0) {
+            return type == json::value_t::object || fail("Scene file must contain a JSON object");
         }
+        if (level == 1 && type == json::value_t::array && streamFor(section) != Stream::None) {
+            stream = streamFor(section);
+            return true;
+        }
+        if (skipping()) return true;
+        stack.push_back(insert(json(type)));
+        return true;
+    }
 
-        if (j.contains("materials")) {
-            for (const auto& matJson : j["materials"]) {
-                if (!matJson.contains("name")) continue;
-                config.materials.push_back(parseMaterial(matJson));
-            }
+    bool closeContainer() {
+        --depth;
+        if (!stack.empty()) {
+            stack.pop_back();
+            return !stack.empty() || finishValue();
         }
+        if (depth == 1) stream = Stream::None;
+        return true;
+    }
 
-        if (j.contains("objects")) {
-            for (const auto& objJson : j["objects"]) {
-                if (!objJson.contains("type")) continue;
-                config.objects.push_back(parseObject(objJson));
-            }
+    bool addValue(json&& value) {
+        if (depth == 0) return fail("Scene file must contain a JSON object");
+        if (skipping()) return true;
+        insert(std::move(value));
+        return !stack.empty() || finishValue();
+    }
+
+    bool finishValue() {
+        if (stream == Stream::Materials) {
+            if (current.contains("name")) callbacks.onMaterial(parseMaterial(current));
+        }
+        else if (stream == Stream::Objects) {
+            if (current.contains("type")) callbacks.onObject(parseObject(current, baseDir));
+        }
+        else if (stream == Stream::Prototypes) {
+            if (current.contains("name")) callbacks.onPrototype(parsePrototype(current, baseDir));
+        }
+        else if (stream == Stream::Instances) {
+            if (current.contains("prototype")) callbacks.onInstance(parseInstance(current));
         }
+        else {
+            parseSection(section, current, config);
+        }
+        current = nullptr;
+        return true;
+    }
+
+    SceneConfig& config;
+    const SceneStreamCallbacks& callbacks;
+    std::filesystem::path baseDir;
+
+    int depth = 0;              // open containers, including the root object
+    std::string section;        // current top-level key
+    Stream stream = Stream::None;
+    json current;               // value being built
+    std::vector<json*> stack;   // its open containers, innermost last
+    std::string pendingKey;
+    std::string error;
+};
+
+// Streamed elements are appended to config itself
+SceneStreamCallbacks collectInto(SceneConfig& config) {
+    SceneStreamCallbacks callbacks;
+    callbacks.onMaterial = [&config](const MaterialConfig& mat) { config.materials.push_back(mat); };
+    callbacks.onObject = [&config](const ObjectConfig& obj) { config.objects.push_back(obj); };
+    callbacks.onPrototype = [&config](const PrototypeConfig& proto) { config.prototypes.push_back(proto); };
+    callbacks.onInstance = [&config](const InstanceConfig& inst) { config.instances.push_back(inst); };
+    return callbacks;
+}
 
+} // namespace
+
+static std::string formatParseError(const std::string& what, const std::string& filepath) {
+    std::string msg = "JSON Parse Error in '" + filepath + "':\n";
+    msg += "  " + what + "\n";
+    return msg;
+}
+
+std::optional<SceneConfig> SceneLoader::loadFromString(const std::string& jsonString) {
+    SceneConfig config;
+    const SceneStreamCallbacks callbacks = collectInto(config);
+    try {
+        // Relative mesh paths are taken from the working directory
+        SceneSaxHandler handler(config, callbacks, std::filesystem::path());
+        if (!json::sax_parse(jsonString, &handler, json::input_format_t::json, true, true)) {
+            lastError = "JSON parse error: " + handler.getError();
+            return std::nullopt;
+        }
         return config;
 
     } catch (const json::exception& e) {
@@ -165,26 +404,45 @@ std::optional<SceneConfig> SceneLoader::loadFromString(const std::string& jsonSt
 }
 
 std::optional<SceneConfig> SceneLoader::loadFromFile(const std::string& filepath) {
+    SceneConfig config;
+    auto parsed = streamFromFile(filepath, collectInto(config));
+    if (!parsed.has_value()) return std::nullopt;
+    parsed->materials = std::move(config.materials);
+    parsed->objects = std::move(config.objects);
+    parsed->prototypes = std::move(config.prototypes);
+    parsed->instances = std::move(config.instances);
+    return parsed;
+}
+
+std::optional<SceneConfig> SceneLoader::loadSettingsFromFile(const std::string& filepath) {
+    return streamFromFile(filepath, SceneStreamCallbacks{});
+}
+
+std::optional<SceneConfig> SceneLoader::streamFromFile(const std::string& filepath,
+                                                       const SceneStreamCallbacks& callbacks) {
     try {
-        std::ifstream file(filepath);
+        std::ifstream file(filepath, std::ios::binary);
         if (!file.is_open()) {
             lastError = "Could not open file: " + filepath + "\n";
             lastError += "Make sure the file exists and is readable.";
             return std::nullopt;
         }
 
-        std::string content((std::istreambuf_iterator<char>(file)),
-                           std::istreambuf_iterator<char>());
-
-        if (content.empty()) {
+        if (file.peek() == std::ifstream::traits_type::eof()) {
             lastError = "File is empty: " + filepath;
             return std::nullopt;
         }
 
-        return loadFromString(content);
+        SceneConfig config;
+        SceneSaxHandler handler(config, callbacks, std::filesystem::path(filepath).parent_path());
+        if (!json::sax_parse(file, &handler, json::input_format_t::json, true, true)) {
+            lastError = formatParseError(handler.getError(), filepath);
+            return std::nullopt;
+        }
+        return config;
 
     } catch (const json::exception& e) {
-        lastError = formatParseError(e, filepath);
+        lastError = formatParseError(e.what(), filepath);
         return std::nullopt;
     } catch (const std::exception& e) {
         lastError = "File error: " + std::string(e.what());
@@ -194,4 +452,4 @@ std::optional<SceneConfig> SceneLoader::loadFromFile(const std::string& filepath
 
 std::string SceneLoader::getLastError() {
     return lastError;
-}
\ No newline at end of file
+}
@@ -0,0 +1,210 @@
+#include "SceneWatcher.h"
+#include "SceneCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// What parseSceneFile produces; the rest of SceneData is derived
+SceneData authoredParts(const SceneData& scene) {
+    SceneData authored;
+    authored.objects = scene.objects;
+    authored.materials = scene.materials;
+    authored.lightIndices = scene.lightIndices;
+    authored.prototypeObjects = scene.prototypeObjects;
+    authored.prototypes = scene.prototypes;
+    authored.instances = scene.instances;
+    authored.meshMap = scene.meshMap;
+    authored.materialMap = scene.materialMap;
+    return authored;
+}
+
+bool sameObjectTypes(const std::vector<SceneObject>& a, const std::vector<SceneObject>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const SceneObject& x, const SceneObject& y) {
+        return x.type == y.type && x.mesh == y.mesh;
+    });
+}
+
+// Whether SceneEditor can turn a into b entry by entry
+bool sameStructure(const SceneData& a, const SceneData& b) {
+    if (a.materials.size() != b.materials.size() || a.materialMap != b.materialMap ||
+        a.meshMap != b.meshMap || a.lightIndices != b.lightIndices ||
+        !sameObjectTypes(a.objects, b.objects) || !sameObjectTypes(a.prototypeObjects, b.prototypeObjects) ||
+        a.prototypes.size() != b.prototypes.size() || a.instances.size() != b.instances.size()) {
+        return false;
+    }
+    for (size_t p = 0; p < a.prototypes.size(); p++) {
+        if (a.prototypes[p].firstObject != b.prototypes[p].firstObject ||
+            a.prototypes[p].objectCount != b.prototypes[p].objectCount) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.instances.size(); i++) {
+        if (a.instances[i].prototype != b.instances[i].prototype) return false;
+    }
+    return true;
+}
+
+// Compares authored values only: the bounding radius of a loaded mesh
+// object is derived, an unloaded one's is not
+bool objectChanged(const SceneObject& a, const SceneObject& b) {
+    if (a.materialIndex != b.materialIndex) return true;
+    if (a.type == OBJ_PLANE) return a.normal != b.normal || a.distance != b.distance;
+    if (a.type == OBJ_SPHERE) return a.center != b.center || a.radius != b.radius;
+    return a.center != b.center || a.rotation != b.rotation || a.scale != b.scale;
+}
+
+void mergeIndices(std::vector<size_t>& into, const std::vector<size_t>& from) {
+    into.insert(into.end(), from.begin(), from.end());
+    std::sort(into.begin(), into.end());
+    into.erase(std::unique(into.begin(), into.end()), into.end());
+}
+
+} // namespace
+
+SceneWatcher::SceneWatcher(const std::string& scenePath, const SceneData& current)
+    : path(scenePath), fileName(std::filesystem::path(scenePath).filename().string()),
+      previous(authoredParts(current)), previousHash(hashSceneFile(scenePath)) {
+    std::error_code ec;
+    lastWrite = std::filesystem::last_write_time(path, ec);
+
+#ifdef __linux__
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd >= 0) {
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        if (directory.empty()) directory = ".";
+        if (inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            printf("WARNING: Cannot watch %s (%s), polling instead\n", directory.c_str(), std::strerror(errno));
+            close(notifyFd);
+            notifyFd = -1;
+        }
+    }
+#endif
+
+    thread = std::thread(&SceneWatcher::run, this);
+}
+
+SceneWatcher::~SceneWatcher() {
+    stopping = true;
+    thread.join();
+#ifdef __linux__
+    if (notifyFd >= 0) close(notifyFd);
+#endif
+}
+
+std::optional<SceneReload> SceneWatcher::poll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::optional<SceneReload> taken = std::move(ready);
+    ready.reset();
+    return taken;
+}
+
+void SceneWatcher::run() {
+    while (!stopping) {
+        if (!waitForChange()) continue;
+
+        // Editors may write a file in several steps; let it settle, and skip
+        // saves that did not change it
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const uint64_t hash = hashSceneFile(path);
+        if (hash == 0 || hash == previousHash) continue;
+        previousHash = hash;
+        reload(hash);
+    }
+}
+
+bool SceneWatcher::waitForChange() {
+#ifdef __linux__
+    if (notifyFd >= 0) {
+        pollfd request{notifyFd, POLLIN, 0};
+        if (::poll(&request, 1, 200) <= 0) return false;
+
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        ssize_t length;
+        while ((length = read(notifyFd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if (event->len > 0 && fileName == event->name) changed = true;
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+        return changed;
+    }
+#endif
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    if (ec || time == lastWrite) return false;
+    lastWrite = time;
+    return true;
+}
+
+void SceneWatcher::reload(const uint64_t hash) {
+    SceneReload next;
+    std::string error;
+    if (!SceneBuilder::parseSceneFile(path, next.config, next.scene, error)) {
+        printf("WARNING: Scene not reloaded: %s\n", error.c_str());
+        return;
+    }
+
+    // A rebuild nobody has taken yet cannot be patched, so replace it
+    bool rebuildPending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rebuildPending = ready.has_value() && ready->rebuilt;
+    }
+
+    next.rebuilt = rebuildPending || !sameStructure(previous, next.scene);
+    if (next.rebuilt) {
+        SceneData authored = authoredParts(next.scene);
+        if (!SceneBuilder::completeScene(next.scene, error)) {
+            printf("WARNING: Scene not reloaded: %s\n", error.c_str());
+            return;
+        }
+        SceneCache::save(SceneCache::cachePathFor(path), hash, next.scene);
+        previous = std::move(authored);
+    } else {
+        for (size_t m = 0; m < next.scene.materials.size(); m++) {
+            if (std::memcmp(&previous.materials[m], &next.scene.materials[m], sizeof(GPUMaterial)) != 0) {
+                next.changedMaterials.push_back(m);
+            }
+        }
+        for (size_t i = 0; i < next.scene.streamObjectCount(); i++) {
+            if (objectChanged(previous.streamObject(i), next.scene.streamObject(i))) next.changedObjects.push_back(i);
+        }
+        for (size_t i = 0; i < next.scene.instances.size(); i++) {
+            const SceneInstance& a = previous.instances[i];
+            const SceneInstance& b = next.scene.instances[i];
+            if (a.position != b.position || a.rotation != b.rotation || a.scale != b.scale) {
+                next.changedInstances.push_back(i);
+            }
+        }
+        previous = authoredParts(next.scene);
+    }
+
+    if (next.rebuilt) {
+        printf("Scene reloaded: %s (rebuilt)\n", path.c_str());
+    } else {
+        printf("Scene reloaded: %s (%zu materials, %zu objects, %zu instances changed)\n", path.c_str(),
+               next.changedMaterials.size(), next.changedObjects.size(), next.changedInstances.size());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.has_value() && !ready->rebuilt && !next.rebuilt) {
+        mergeIndices(next.changedMaterials, ready->changedMaterials);
+        mergeIndices(next.changedObjects, ready->changedObjects);
+        mergeIndices(next.changedInstances, ready->changedInstances);
+    }
+    ready = std::move(next);
+}
@@ -0,0 +1,23 @@
+#include "autotune.h"
+#include <algorithm>
+#include <cmath>
+
+int tuneSamplesPerFrame(const int current, const double msPerFrameSample, const double targetMs) {
+    if (msPerFrameSample <= 0.0) return current;
+
+    const double ideal = targetMs / msPerFrameSample;
+    int next = current;
+    if (ideal < current * 0.9) {
+        next = static_cast<int>(ideal);
+    } else if (ideal > current * 1.1) {
+        next = static_cast<int>(std::min(ideal, current * 2.0));
+    }
+    return std::clamp(next, 1, MAX_SAMPLES_PER_FRAME);
+}
+
+int dispatchBandCount(const int samplesPerFrame, const double msPerFrameSample) {
+    if (msPerFrameSample <= 0.0) return 1;
+
+    const double predictedMs = samplesPerFrame * msPerFrameSample;
+    return std::max(1, static_cast<int>(std::ceil(predictedMs / MAX_SUBMISSION_MS)));
+}
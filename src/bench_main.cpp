@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+#include "CpuRenderer.h"
+#include "SceneBuilder.h"
+#include "SceneCache.h"
+#include "headless.h"
+#include "sampler.h"
+
+// Renders every scenes/*.json at a fixed resolution and sample count and
+// reports ms/frame, samples/s and rays/s, so kernel changes can be compared
+// run-to-run.
+//   raypulse-bench [--scenes dir] [--backend cpu|gpu] [--wavefront] [--spp N] [--width W] [--height H]
+//                  [--threads N] [--out results.json] [--equal-error [--reference-spp N]]
+//
+// Every run starts at frameCount 0 with adaptive sampling disabled, so the
+// per-pixel RNG sequence (and therefore the image) is identical between runs.
+// The cpu backend counts traced rays exactly; the gpu backend has no counter
+// in the kernel, so its rays/s multiplies samples/s by the rays per sample
+// measured with a small CPU reference pass of the same scene.
+//
+// --equal-error compares the samplers instead of timing: each scene is
+// rendered once at --reference-spp (PCG with another seed, default 16x --spp)
+// and by every sampler at 1, 2, 4 .. --spp samples. The RMSE of PCG at --spp
+// is the target; the spp at which each sampler reaches it (log-log
+// interpolated between levels, extrapolated past the last one) and the
+// speedup over PCG are reported. The reference's own noise is in every RMSE,
+// so raise --reference-spp when the errors get close to it.
+
+using json = nlohmann::json;
+
+namespace {
+
+struct BenchOptions {
+    std::string scenesDir = "./scenes";
+    std::string backend = "cpu";
+    std::string outPath;
+    int spp = 64;
+    int width = 640;
+    int height = 360;
+    unsigned threads = 0;
+    bool wavefront = false;  // gpu: force the wavefront pipeline for every scene
+    bool equalError = false;
+    int referenceSpp = 0;    // <= 0: 16 * spp
+};
+
+struct BenchResult {
+    std::string scene;
+    int width = 0;
+    int height = 0;
+    int samplesPerPixel = 0;
+    int frames = 0;
+    double seconds = 0.0;
+    uint64_t rays = 0;
+    bool raysEstimated = false;
+};
+
+constexpr int RAY_PROBE_SIZE = 64;
+constexpr int RAY_PROBE_SPP = 4;
+
+// Error of one sampler at 1, 2, 4 .. spp samples per pixel
+struct SamplerError {
+    SamplerType sampler = SamplerType::Pcg;
+    std::vector<int> spp;
+    std::vector<double> rmse;
+    double equalErrorSpp = 0.0;
+};
+
+constexpr SamplerType BENCH_SAMPLERS[] = {SamplerType::Pcg, SamplerType::Sobol, SamplerType::BlueNoise};
+constexpr uint32_t REFERENCE_SEED = 1;
+
+void printUsage(const char* exe) {
+    printf("Usage: %s [--scenes dir] [--backend cpu|gpu] [--wavefront] [--spp N] [--width W] [--height H] "
+           "[--threads N] [--out results.json] [--equal-error [--reference-spp N]]\n", exe);
+}
+
+bool parseArgs(const int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--scenes") == 0 && hasValue) options.scenesDir = argv[++i];
+        else if (std::strcmp(argv[i], "--backend") == 0 && hasValue) options.backend = argv[++i];
+        else if (std::strcmp(argv[i], "--spp") == 0 && hasValue) options.spp = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--width") == 0 && hasValue) options.width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && hasValue) options.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--out") == 0 && hasValue) options.outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--reference-spp") == 0 && hasValue) options.referenceSpp = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--wavefront") == 0) options.wavefront = true;
+        else if (std::strcmp(argv[i], "--equal-error") == 0) options.equalError = true;
+        else return false;
+    }
+    if (options.referenceSpp <= 0) options.referenceSpp = 16 * options.spp;
+    return (options.backend == "cpu" || options.backend == "gpu")
+        && options.spp > 0 && options.width > 0 && options.height > 0;
+}
+
+std::vector<std::string> findScenes(const std::string& dir) {
+    std::vector<std::string> scenes;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            scenes.push_back(entry.path().string());
+        }
+    }
+    std::sort(scenes.begin(), scenes.end());
+    return scenes;
+}
+
+CameraParams makeCameraParams(const SceneConfig& sceneConfig) {
+    CameraParams camera_params = {
+        sceneConfig.camera.position,
+        glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f),
+        sceneConfig.camera.fov,
+        sceneConfig.camera.aperture,
+        sceneConfig.camera.focusDist,
+        0
+    };
+    calculateBasisFromEuler(sceneConfig.camera.rotation.x, sceneConfig.camera.rotation.y, sceneConfig.camera.rotation.z,
+                            camera_params.forward, camera_params.right, camera_params.up);
+    return camera_params;
+}
+
+// Same frame loop as raypulse-cpu; returns the number of frames dispatched
+int renderCpu(const SceneConfig& sceneConfig, CpuRenderer& renderer, const int spp) {
+    CameraParams camera_params = makeCameraParams(sceneConfig);
+    SkyParams sky_params = { sceneConfig.sky.colorTop, sceneConfig.sky.colorBottom };
+    const int samplesPerFrame = std::max(1, sceneConfig.render.samplesPerFrame);
+    const auto maxBounces = static_cast<uint32_t>(sceneConfig.render.maxBounces);
+
+    while (static_cast<int>(camera_params.frameCount) * samplesPerFrame < spp) {
+        renderer.renderFrame(camera_params, sky_params, samplesPerFrame, spp, maxBounces,
+                             sceneConfig.render.lightSamples,
+                             {static_cast<int>(sceneConfig.render.sampler), sceneConfig.render.seed});
+        camera_params.frameCount += 1;
+    }
+    return static_cast<int>(camera_params.frameCount);
+}
+
+bool benchCpu(const SceneConfig& sceneConfig, const SceneData& sceneData, const BenchOptions& options,
+              BenchResult& result) {
+    CpuRenderer renderer(sceneData, options.threads);
+    renderer.resize(options.width, options.height);
+
+    const auto start = std::chrono::steady_clock::now();
+    result.frames = renderCpu(sceneConfig, renderer, options.spp);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.width = options.width;
+    result.height = options.height;
+    result.samplesPerPixel = options.spp;
+    result.rays = renderer.getRayCount();
+    return true;
+}
+
+bool benchGpu(const SceneConfig& sceneConfig, const SceneData& sceneData, const BenchOptions& options,
+              BenchResult& result) {
+    HeadlessOptions renderOptions;
+    renderOptions.spp = options.spp;
+    renderOptions.width = options.width;
+    renderOptions.height = options.height;
+    renderOptions.progress = false;
+
+    HeadlessRenderStats stats;
+    if (!renderHeadless(sceneConfig, sceneData, renderOptions, &stats)) return false;
+
+    result.width = stats.width;
+    result.height = stats.height;
+    result.samplesPerPixel = stats.samplesPerPixel;
+    result.frames = stats.frames;
+    result.seconds = stats.seconds;
+
+    // Rays per sample depend on the scene (bounce depth, NEE, russian
+    // roulette), not on the backend, so a low-resolution CPU pass suffices
+    CpuRenderer probe(sceneData, options.threads);
+    probe.resize(RAY_PROBE_SIZE, RAY_PROBE_SIZE);
+    renderCpu(sceneConfig, probe, RAY_PROBE_SPP);
+    const double raysPerSample = static_cast<double>(probe.getRayCount()) /
+        (static_cast<double>(RAY_PROBE_SIZE) * RAY_PROBE_SIZE * RAY_PROBE_SPP);
+    result.rays = static_cast<uint64_t>(raysPerSample * stats.width * stats.height * stats.samplesPerPixel);
+    result.raysEstimated = true;
+    return true;
+}
+
+// The averaged output at spp samples per pixel, with sceneConfig's sampler
+bool renderImage(const SceneConfig& sceneConfig, const SceneData& sceneData, const BenchOptions& options,
+                 const int spp, std::vector<glm::vec4>& image) {
+    if (options.backend == "cpu") {
+        CpuRenderer renderer(sceneData, options.threads);
+        renderer.resize(options.width, options.height);
+        renderCpu(sceneConfig, renderer, spp);
+        image = renderer.getOutput();
+        return true;
+    }
+
+    HeadlessOptions renderOptions;
+    renderOptions.spp = spp;
+    renderOptions.width = options.width;
+    renderOptions.height = options.height;
+    renderOptions.progress = false;
+    renderOptions.keepImage = true;
+
+    HeadlessRenderStats stats;
+    if (!renderHeadless(sceneConfig, sceneData, renderOptions, &stats)) return false;
+    image = std::move(stats.image);
+    return true;
+}
+
+double rmse(const std::vector<glm::vec4>& image, const std::vector<glm::vec4>& reference) {
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); i++) {
+        const glm::dvec3 d = glm::dvec3(image[i]) - glm::dvec3(reference[i]);
+        sum += glm::dot(d, d) / 3.0;
+    }
+    return std::sqrt(sum / static_cast<double>(std::max<size_t>(image.size(), 1)));
+}
+
+// Samples per pixel at which the error curve reaches target, interpolating
+// log(rmse) over log(spp) between the levels around it, or extrapolating
+// from the last two. Curves that do not fall are given the Monte Carlo rate.
+double equalErrorSpp(const SamplerError& error, const double target) {
+    const size_t levels = error.spp.size();
+    size_t i = 1;
+    while (i + 1 < levels && error.rmse[i] > target) i++;
+    if (levels < 2 || target <= 0.0) return levels > 0 ? error.spp.back() : 0.0;
+
+    const double n0 = std::log(static_cast<double>(error.spp[i - 1]));
+    const double n1 = std::log(static_cast<double>(error.spp[i]));
+    const double e0 = std::log(std::max(error.rmse[i - 1], 1e-30));
+    const double e1 = std::log(std::max(error.rmse[i], 1e-30));
+    const double slope = e1 < e0 ? (e1 - e0) / (n1 - n0) : -0.5;
+    return std::exp(n1 + (std::log(target) - e1) / slope);
+}
+
+bool compareSamplers(SceneConfig sceneConfig, const SceneData& sceneData, const BenchOptions& options,
+                     std::vector<SamplerError>& errors) {
+    std::vector<glm::vec4> reference;
+    sceneConfig.render.sampler = SamplerType::Pcg;
+    sceneConfig.render.seed = REFERENCE_SEED;
+    if (!renderImage(sceneConfig, sceneData, options, options.referenceSpp, reference)) return false;
+
+    sceneConfig.render.seed = 0;
+    std::vector<glm::vec4> image;
+    for (const SamplerType sampler : BENCH_SAMPLERS) {
+        SamplerError error;
+        error.sampler = sampler;
+        sceneConfig.render.sampler = sampler;
+        for (int spp = 1;; spp = std::min(2 * spp, options.spp)) {
+            if (!renderImage(sceneConfig, sceneData, options, spp, image)) return false;
+            error.spp.push_back(spp);
+            error.rmse.push_back(rmse(image, reference));
+            if (spp == options.spp) break;
+        }
+        errors.push_back(std::move(error));
+    }
+
+    const double target = errors.front().rmse.back();
+    for (SamplerError& error : errors) error.equalErrorSpp = equalErrorSpp(error, target);
+    return true;
+}
+
+bool writeReport(const std::string& path, const json& report) {
+    std::ofstream file(path);
+    if (!file) {
+        printf("ERROR: Could not write %s\n", path.c_str());
+        return false;
+    }
+    file << report.dump(2) << "\n";
+    printf("Results written to %s\n", path.c_str());
+    return true;
+}
+
+int runEqualError(const std::vector<std::string>& scenes, const BenchOptions& options) {
+    printf("Backend %s%s, %dx%d, equal error at %d spp of pcg, reference %d spp\n", options.backend.c_str(),
+           options.wavefront ? " (wavefront)" : "", options.width, options.height, options.spp, options.referenceSpp);
+    printf("%-28s %-10s %12s %14s %9s\n", "scene", "sampler", "rmse", "equal-err spp", "speedup");
+
+    json report;
+    report["backend"] = options.backend;
+    report["wavefront"] = options.wavefront;
+    report["width"] = options.width;
+    report["height"] = options.height;
+    report["spp"] = options.spp;
+    report["referenceSpp"] = options.referenceSpp;
+    report["scenes"] = json::array();
+
+    size_t compared = 0;
+    for (const std::string& scenePath : scenes) {
+        SceneConfig sceneConfig;
+        SceneData sceneData;
+        if (!SceneCache::loadScene(scenePath, sceneConfig, sceneData)) continue;
+        sceneConfig.render.adaptive.enabled = false;
+        if (options.wavefront) sceneConfig.render.wavefront = true;
+
+        std::vector<SamplerError> errors;
+        if (!compareSamplers(sceneConfig, sceneData, options, errors)) continue;
+        compared++;
+
+        const std::string scene = std::filesystem::path(scenePath).stem().string();
+        json samplers = json::array();
+        for (const SamplerError& error : errors) {
+            const double speedup = options.spp / std::max(error.equalErrorSpp, 1e-9);
+            printf("%-28s %-10s %12.5f %14.1f %8.2fx\n", scene.c_str(), samplerTypeName(error.sampler),
+                   error.rmse.back(), error.equalErrorSpp, speedup);
+            samplers.push_back({
+                {"sampler", samplerTypeName(error.sampler)},
+                {"spp", error.spp},
+                {"rmse", error.rmse},
+                {"equalErrorSpp", error.equalErrorSpp},
+                {"speedup", speedup}
+            });
+        }
+        report["scenes"].push_back({{"scene", scene}, {"samplers", samplers}});
+    }
+
+    if (!options.outPath.empty() && !writeReport(options.outPath, report)) return -1;
+    return compared == scenes.size() ? 0 : -1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::vector<std::string> scenes = findScenes(options.scenesDir);
+    if (scenes.empty()) {
+        printf("ERROR: No scene files found in %s\n", options.scenesDir.c_str());
+        return -1;
+    }
+
+    const bool gpu = options.backend == "gpu";
+    if (gpu && !openHeadlessContext()) return -1;
+    if (options.equalError) {
+        const int status = runEqualError(scenes, options);
+        if (gpu) closeHeadlessContext();
+        return status;
+    }
+
+    printf("Backend %s%s, %dx%d, %d spp\n", options.backend.c_str(), options.wavefront ? " (wavefront)" : "",
+           options.width, options.height, options.spp);
+    printf("%-28s %10s %12s %14s\n", "scene", "ms/frame", "Msamples/s", "Mrays/s");
+
+    std::vector<BenchResult> results;
+    for (const std::string& scenePath : scenes) {
+        SceneConfig sceneConfig;
+        SceneData sceneData;
+        if (!SceneCache::loadScene(scenePath, sceneConfig, sceneData)) continue;
+        // Early-out pixels would make the work per run depend on the image
+        sceneConfig.render.adaptive.enabled = false;
+        if (options.wavefront) sceneConfig.render.wavefront = true;
+
+        BenchResult result;
+        result.scene = std::filesystem::path(scenePath).stem().string();
+        const bool ok = gpu ? benchGpu(sceneConfig, sceneData, options, result)
+                            : benchCpu(sceneConfig, sceneData, options, result);
+        if (!ok) continue;
+
+        const double samples = static_cast<double>(result.width) * result.height * result.samplesPerPixel;
+        printf("%-28s %10.2f %12.2f %13.2f%s\n",
+               result.scene.c_str(),
+               result.seconds * 1000.0 / std::max(result.frames, 1),
+               samples / result.seconds * 1e-6,
+               static_cast<double>(result.rays) / result.seconds * 1e-6,
+               result.raysEstimated ? "*" : "");
+        results.push_back(result);
+    }
+
+    if (gpu) {
+        printf("* rays/s estimated from CPU-measured rays per sample\n");
+        closeHeadlessContext();
+    }
+
+    if (!options.outPath.empty()) {
+        json report;
+        report["backend"] = options.backend;
+        report["wavefront"] = options.wavefront;
+        report["width"] = options.width;
+        report["height"] = options.height;
+        report["spp"] = options.spp;
+        report["scenes"] = json::array();
+        for (const BenchResult& result : results) {
+            const double samples = static_cast<double>(result.width) * result.height * result.samplesPerPixel;
+            report["scenes"].push_back({
+                {"scene", result.scene},
+                {"width", result.width},
+                {"height", result.height},
+                {"samplesPerPixel", result.samplesPerPixel},
+                {"frames", result.frames},
+                {"seconds", result.seconds},
+                {"msPerFrame", result.seconds * 1000.0 / std::max(result.frames, 1)},
+                {"samplesPerSecond", samples / result.seconds},
+                {"raysPerSecond", static_cast<double>(result.rays) / result.seconds},
+                {"raysEstimated", result.raysEstimated}
+            });
+        }
+
+        if (!writeReport(options.outPath, report)) return -1;
+    }
+
+    return results.size() == scenes.size() ? 0 : -1;
+}
@@ -0,0 +1,176 @@
+#include "bloom.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "profiler.h"
+#include "shader.h"
+
+namespace {
+
+constexpr GLuint GROUP_SIZE = 8;
+constexpr int MAX_LEVELS = 8;
+
+constexpr GLbitfield PASS_BARRIER_BITS = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+
+GLuint loadBloomKernel(const char* path) {
+    const GLuint program = createComputeProgramFromFile(path);
+    if (program == 0) {
+        printf("ERROR: Failed to load bloom shader %s\n", path);
+    }
+    return program;
+}
+
+GLuint createChain(const int width, const int height, const int levels) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA16F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+int mipSize(const int size, const int level) {
+    return std::max(1, size >> level);
+}
+
+void dispatchLevel(const int width, const int height) {
+    glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+    glMemoryBarrier(PASS_BARRIER_BITS);
+}
+
+} // namespace
+
+BloomPipeline::BloomPipeline() {
+    prefilterProgram = loadBloomKernel("shaders/bloom_prefilter.glsl");
+    downsampleProgram = loadBloomKernel("shaders/bloom_downsample.glsl");
+    upsampleProgram = loadBloomKernel("shaders/bloom_upsample.glsl");
+    valid = prefilterProgram != 0 && downsampleProgram != 0 && upsampleProgram != 0;
+    if (!valid) return;
+
+    // Sampler units are fixed, so only the per-pass values are set per frame
+    glUseProgram(prefilterProgram);
+    glUniform1i(glGetUniformLocation(prefilterProgram, "sourceTexture"), 0);
+    prefilterTexelSizeLoc = glGetUniformLocation(prefilterProgram, "sourceTexelSize");
+    prefilterThresholdLoc = glGetUniformLocation(prefilterProgram, "bloomThreshold");
+    prefilterKneeLoc = glGetUniformLocation(prefilterProgram, "bloomKnee");
+
+    glUseProgram(downsampleProgram);
+    glUniform1i(glGetUniformLocation(downsampleProgram, "sourceTexture"), 0);
+    downsampleLevelLoc = glGetUniformLocation(downsampleProgram, "sourceLevel");
+
+    glUseProgram(upsampleProgram);
+    glUniform1i(glGetUniformLocation(upsampleProgram, "coarseTexture"), 0);
+    glUniform1i(glGetUniformLocation(upsampleProgram, "detailTexture"), 1);
+    upsampleCoarseLevelLoc = glGetUniformLocation(upsampleProgram, "coarseLevel");
+    upsampleDetailLevelLoc = glGetUniformLocation(upsampleProgram, "detailLevel");
+    upsampleRadiusLoc = glGetUniformLocation(upsampleProgram, "filterRadius");
+    upsampleScaleLoc = glGetUniformLocation(upsampleProgram, "outputScale");
+    glUseProgram(0);
+
+    // The chains are sampled at explicit levels, which the textures' own
+    // non-mipmapped filter would ignore
+    glGenSamplers(1, &mipSampler);
+    glSamplerParameteri(mipSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glSamplerParameteri(mipSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(mipSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(mipSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+BloomPipeline::~BloomPipeline() {
+    for (const GLuint program : {prefilterProgram, downsampleProgram, upsampleProgram}) {
+        if (program != 0) glDeleteProgram(program);
+    }
+    if (mipSampler != 0) glDeleteSamplers(1, &mipSampler);
+    if (downChain != 0) glDeleteTextures(1, &downChain);
+    if (upChain != 0) glDeleteTextures(1, &upChain);
+}
+
+void BloomPipeline::ensureChains(const int width, const int height, const int levels) {
+    if (width == chainWidth && height == chainHeight && levels == chainLevels) return;
+
+    // Immutable storage cannot be resized, so the chains are recreated
+    if (downChain != 0) glDeleteTextures(1, &downChain);
+    if (upChain != 0) glDeleteTextures(1, &upChain);
+    downChain = createChain(width, height, levels);
+    upChain = createChain(width, height, levels);
+    chainWidth = width;
+    chainHeight = height;
+    chainLevels = levels;
+}
+
+BloomFrameResult BloomPipeline::apply(const BloomConfig& config, const GLuint sourceTexture,
+                                      const int sourceWidth, const int sourceHeight,
+                                      GpuProfiler* profiler) {
+    BloomFrameResult result{};
+    if (!config.enabled || !valid || sourceTexture == 0) return result;
+
+    const float downscale = std::clamp(config.downscale, 0.1f, 1.0f);
+    const int width = std::max(1, static_cast<int>(sourceWidth * downscale));
+    const int height = std::max(1, static_cast<int>(sourceHeight * downscale));
+
+    // Stop before the smallest level would collapse below 2x2
+    int levels = std::clamp(config.iterations, 1, MAX_LEVELS);
+    while (levels > 1 && std::min(mipSize(width, levels - 1), mipSize(height, levels - 1)) < 2) --levels;
+    ensureChains(width, height, levels);
+
+    {
+        ProfileScope zone(profiler, "Bloom prefilter");
+        glUseProgram(prefilterProgram);
+        glUniform2f(prefilterTexelSizeLoc, 1.0f / sourceWidth, 1.0f / sourceHeight);
+        glUniform1f(prefilterThresholdLoc, std::max(config.threshold, 0.0f));
+        glUniform1f(prefilterKneeLoc, std::clamp(config.knee, 0.0f, 1.0f));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        glBindImageTexture(0, downChain, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        dispatchLevel(width, height);
+    }
+
+    glBindSampler(0, mipSampler);
+    glBindSampler(1, mipSampler);
+
+    glUseProgram(downsampleProgram);
+    glBindTexture(GL_TEXTURE_2D, downChain);
+    for (int level = 1; level < levels; ++level) {
+        glUniform1i(downsampleLevelLoc, level - 1);
+        glBindImageTexture(0, downChain, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        ProfileScope zone(profiler, "Bloom down " + std::to_string(level));
+        dispatchLevel(mipSize(width, level), mipSize(height, level));
+    }
+
+    if (levels > 1) {
+        // The pyramid sums one blur per level; averaging keeps the bloom
+        // energy independent of the level count
+        glUseProgram(upsampleProgram);
+        glUniform1f(upsampleRadiusLoc, 1.0f);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, downChain);
+        for (int level = levels - 2; level >= 0; --level) {
+            const bool fromBottom = level == levels - 2;
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, fromBottom ? downChain : upChain);
+            glUniform1i(upsampleCoarseLevelLoc, level + 1);
+            glUniform1i(upsampleDetailLevelLoc, level);
+            glUniform1f(upsampleScaleLoc, level == 0 ? 1.0f / static_cast<float>(levels) : 1.0f);
+            glBindImageTexture(0, upChain, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            ProfileScope zone(profiler, "Bloom up " + std::to_string(level));
+            dispatchLevel(mipSize(width, level), mipSize(height, level));
+        }
+    }
+
+    glBindSampler(0, 0);
+    glBindSampler(1, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    result.textureId = levels > 1 ? upChain : downChain;
+    result.width = width;
+    result.height = height;
+    return result;
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BVH.h"
+#include "MeshLoader.h"
+
+// Times BVHBuilder on synthetic primitive sets and mesh files and reports
+// build time and SAH cost per million primitives.
+//   raypulse-bvh-bench [--prims N] [--mesh file.obj|file.ply] [--threads N] [--repeat N]
+//
+// --prims and --mesh may be given several times. Without either, uniform
+// and clustered boxes at 100k and 1M primitives are built. Every input is
+// built --repeat times and the fastest run is reported; the SAH cost
+// (BVHBuilder::sahCost) does not depend on the thread count.
+
+namespace {
+
+struct BenchOptions {
+    std::vector<int> primCounts;
+    std::vector<std::string> meshes;
+    unsigned threads = 0;
+    int repeat = 3;
+};
+
+struct BenchInput {
+    std::string name;
+    std::vector<AABB> bounds;
+};
+
+void printUsage(const char* exe) {
+    printf("Usage: %s [--prims N] [--mesh file.obj|file.ply] [--threads N] [--repeat N]\n", exe);
+}
+
+bool parseArgs(const int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--prims") == 0 && hasValue) options.primCounts.push_back(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--mesh") == 0 && hasValue) options.meshes.emplace_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue) options.repeat = std::atoi(argv[++i]);
+        else return false;
+    }
+    if (options.primCounts.empty() && options.meshes.empty()) options.primCounts = {100000, 1000000};
+    return options.repeat > 0 &&
+        std::all_of(options.primCounts.begin(), options.primCounts.end(), [](const int n) { return n > 0; });
+}
+
+// Boxes about as large as their spacing, so neighbours overlap a little
+AABB boxAround(const glm::vec3& center, const float size) {
+    AABB box;
+    box.grow(center - glm::vec3(size * 0.5f));
+    box.grow(center + glm::vec3(size * 0.5f));
+    return box;
+}
+
+BenchInput makeUniform(const int count) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(0.0f, 1.0f);
+    const float size = 1.0f / std::cbrt(static_cast<float>(count));
+
+    BenchInput input{"uniform", {}};
+    input.bounds.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        input.bounds.push_back(boxAround(glm::vec3(position(rng), position(rng), position(rng)), size));
+    }
+    return input;
+}
+
+// Dense clumps of very different sizes in a mostly empty volume, the case
+// where SAH beats splitting in the middle
+BenchInput makeClustered(const int count) {
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> position(0.0f, 1.0f);
+    std::normal_distribution<float> spread(0.0f, 1.0f);
+    constexpr int CLUSTER_COUNT = 64;
+    glm::vec3 centers[CLUSTER_COUNT];
+    float radii[CLUSTER_COUNT];
+    for (int c = 0; c < CLUSTER_COUNT; ++c) {
+        centers[c] = glm::vec3(position(rng), position(rng), position(rng));
+        radii[c] = 0.002f + 0.05f * position(rng) * position(rng);
+    }
+
+    const float size = 0.2f / std::cbrt(static_cast<float>(count));
+    BenchInput input{"clustered", {}};
+    input.bounds.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int c = static_cast<int>(rng() % CLUSTER_COUNT);
+        const glm::vec3 offset(spread(rng), spread(rng), spread(rng));
+        input.bounds.push_back(boxAround(centers[c] + offset * radii[c], size));
+    }
+    return input;
+}
+
+bool loadMeshInput(const std::string& path, BenchInput& input) {
+    MeshData mesh;
+    std::string error;
+    if (!MeshLoader::loadFromFile(path, mesh, error)) {
+        printf("ERROR: %s\n", error.c_str());
+        return false;
+    }
+    input.name = path;
+    input.bounds.resize(mesh.indices.size() / 3);
+    for (size_t t = 0; t < input.bounds.size(); ++t) {
+        for (int k = 0; k < 3; ++k) {
+            input.bounds[t].grow(mesh.vertices[mesh.indices[3 * t + k]]);
+        }
+    }
+    return true;
+}
+
+void bench(const BenchInput& input, const BenchOptions& options, const unsigned threads) {
+    std::vector<GPUBVHNode> nodes;
+    std::vector<int> primIndices;
+    double best = 1e30;
+    for (int run = 0; run < options.repeat; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        BVHBuilder::build(input.bounds, nodes, primIndices, threads);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    const double mprims = static_cast<double>(input.bounds.size()) * 1e-6;
+    printf("%-28s %10zu %10.2f %12.2f %10.2f %10.2f %10zu\n",
+           input.name.c_str(), input.bounds.size(), best * 1000.0, best * 1000.0 / mprims,
+           mprims / best, BVHBuilder::sahCost(nodes), nodes.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const unsigned threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    printf("%u threads, best of %d\n", threads, options.repeat);
+    printf("%-28s %10s %10s %12s %10s %10s %10s\n", "input", "prims", "build ms", "ms/Mprims", "Mprims/s", "SAH cost", "nodes");
+
+    for (const int count : options.primCounts) {
+        bench(makeUniform(count), options, threads);
+        bench(makeClustered(count), options, threads);
+    }
+
+    bool ok = true;
+    for (const std::string& path : options.meshes) {
+        BenchInput input;
+        if (!loadMeshInput(path, input)) {
+            ok = false;
+            continue;
+        }
+        bench(input, options, threads);
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,139 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[4] = {'R', 'P', 'C', 'K'};
+constexpr uint32_t CHECKPOINT_LAYERS = 3;
+
+void readTexture(const GLuint texture, std::vector<float>& pixels) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void writeTexture(const GLuint texture, const int width, const int height, const float* pixels) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// What the kernel would have written to the output images: the running mean
+void resolveMean(const float* accum, std::vector<float>& mean) {
+    for (size_t i = 0; i < mean.size(); i += 4) {
+        const float count = accum[i + 3];
+        const float scale = count > 0.0f ? 1.0f / count : 0.0f;
+        mean[i + 0] = accum[i + 0] * scale;
+        mean[i + 1] = accum[i + 1] * scale;
+        mean[i + 2] = accum[i + 2] * scale;
+        mean[i + 3] = 1.0f;
+    }
+}
+
+} // namespace
+
+CheckpointHeader makeCheckpointHeader(const int width, const int height, const uint32_t frameCount,
+                                      const int samplesPerFrame, const uint64_t sceneHash) {
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.frameCount = frameCount;
+    header.samplesPerFrame = static_cast<uint32_t>(samplesPerFrame);
+    header.sceneHash = sceneHash;
+    header.samplesPerPixel = frameCount * static_cast<uint32_t>(samplesPerFrame);
+    header.layerCount = CHECKPOINT_LAYERS;
+    return header;
+}
+
+bool saveCheckpoint(const std::string& path, const CheckpointHeader& header, const CheckpointTextures& textures) {
+    const size_t layerFloats = static_cast<size_t>(header.width) * header.height * 4;
+    std::vector<float> pixels(layerFloats);
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            printf("ERROR: Could not write checkpoint %s\n", tmpPath.c_str());
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const GLuint texture : {textures.accum, textures.accumBloom, textures.moment}) {
+            readTexture(texture, pixels);
+            file.write(reinterpret_cast<const char*>(pixels.data()),
+                       static_cast<std::streamsize>(layerFloats * sizeof(float)));
+        }
+        if (!file) {
+            printf("ERROR: Failed while writing checkpoint %s\n", tmpPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        printf("ERROR: Could not replace checkpoint %s: %s\n", path.c_str(), ec.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(const std::string& path, const int width, const int height, const int samplesPerFrame,
+                    const uint64_t sceneHash, const CheckpointTextures& textures, CheckpointHeader& header) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        printf("ERROR: Could not open checkpoint %s\n", path.c_str());
+        return false;
+    }
+
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+        printf("ERROR: %s is not a raypulse checkpoint\n", path.c_str());
+        return false;
+    }
+    if (header.version != CHECKPOINT_VERSION || header.layerCount != CHECKPOINT_LAYERS) {
+        printf("ERROR: Checkpoint %s has unsupported version %u\n", path.c_str(), header.version);
+        return false;
+    }
+    if (header.width != static_cast<uint32_t>(width) || header.height != static_cast<uint32_t>(height)) {
+        printf("ERROR: Checkpoint is %ux%u, render is %dx%d\n", header.width, header.height, width, height);
+        return false;
+    }
+    if (header.samplesPerFrame != static_cast<uint32_t>(samplesPerFrame)) {
+        printf("ERROR: Checkpoint was rendered at %u samples per frame, the scene asks for %d\n",
+               header.samplesPerFrame, samplesPerFrame);
+        return false;
+    }
+    if (header.sceneHash != sceneHash) {
+        printf("ERROR: Checkpoint %s was made from a different scene or mesh file\n", path.c_str());
+        return false;
+    }
+
+    const size_t layerFloats = static_cast<size_t>(width) * height * 4;
+    std::vector<float> layers(layerFloats * CHECKPOINT_LAYERS);
+    file.read(reinterpret_cast<char*>(layers.data()), static_cast<std::streamsize>(layers.size() * sizeof(float)));
+    if (!file) {
+        printf("ERROR: Checkpoint %s is truncated\n", path.c_str());
+        return false;
+    }
+
+    const float* accum = layers.data();
+    const float* accumBloom = accum + layerFloats;
+    const float* moment = accumBloom + layerFloats;
+    writeTexture(textures.accum, width, height, accum);
+    writeTexture(textures.accumBloom, width, height, accumBloom);
+    writeTexture(textures.moment, width, height, moment);
+
+    // Finished pixels are skipped by the kernel, so their output would stay black
+    std::vector<float> mean(layerFloats);
+    resolveMean(accum, mean);
+    writeTexture(textures.output, width, height, mean.data());
+    resolveMean(accumBloom, mean);
+    writeTexture(textures.outputBloom, width, height, mean.data());
+    return true;
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CpuRenderer.h"
+#include "SceneBuilder.h"
+#include "SceneCache.h"
+#include "export.h"
+
+// Renders a scene file on the CPU only; no OpenGL context is created.
+//   raypulse-cpu <scene.json> [--spp N] [--out file.exr] [--threads N] [--width W] [--height H]
+
+static void printUsage(const char* exe) {
+    printf("Usage: %s <scene.json> [--spp N] [--out file.exr] [--threads N] [--width W] [--height H]\n", exe);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string scenePath = argv[1];
+    std::string outPath;
+    int spp = -1;
+    int width = -1;
+    int height = -1;
+    unsigned threads = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--spp") == 0 && hasValue) spp = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--out") == 0 && hasValue) outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--width") == 0 && hasValue) width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && hasValue) height = std::atoi(argv[++i]);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    SceneConfig sceneConfig;
+    SceneData sceneData;
+    if (!SceneCache::loadScene(scenePath, sceneConfig, sceneData)) return -1;
+
+    CameraParams camera_params = {
+        sceneConfig.camera.position,
+        glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f),
+        sceneConfig.camera.fov,
+        sceneConfig.camera.aperture,
+        sceneConfig.camera.focusDist,
+        0
+    };
+    calculateBasisFromEuler(sceneConfig.camera.rotation.x, sceneConfig.camera.rotation.y, sceneConfig.camera.rotation.z,
+                            camera_params.forward, camera_params.right, camera_params.up);
+
+    SkyParams sky_params = { sceneConfig.sky.colorTop, sceneConfig.sky.colorBottom };
+
+    const int renderWidth = width > 0 ? width : sceneConfig.render.width;
+    const int renderHeight = height > 0 ? height : sceneConfig.render.height;
+    const int samplesPerFrame = std::max(1, sceneConfig.render.samplesPerFrame);
+    const int maxSamples = spp > 0 ? spp : sceneConfig.render.maxSamples;
+    const auto maxBounces = static_cast<uint32_t>(sceneConfig.render.maxBounces);
+
+    CpuRenderer renderer(sceneData, threads);
+    renderer.resize(renderWidth, renderHeight);
+
+    printf("Rendering %dx%d, %d samples on %u threads\n",
+           renderWidth, renderHeight, maxSamples, renderer.getThreadCount());
+
+    const auto start = std::chrono::steady_clock::now();
+    while (static_cast<int>(camera_params.frameCount) * samplesPerFrame < maxSamples) {
+        renderer.renderFrame(camera_params, sky_params, samplesPerFrame, maxSamples, maxBounces,
+                             sceneConfig.render.lightSamples,
+                             {static_cast<int>(sceneConfig.render.sampler), sceneConfig.render.seed});
+        camera_params.frameCount += 1;
+
+        const int done = std::min(static_cast<int>(camera_params.frameCount) * samplesPerFrame, maxSamples);
+        printf("\r  %d / %d samples", done, maxSamples);
+        fflush(stdout);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("\nDone in %.2f s\n", seconds);
+
+    if (outPath.empty()) {
+        outPath = generateTimestampedFilename("raypulse_cpu", ".exr");
+    }
+
+    const std::vector<glm::vec4>& pixels = renderer.getOutput();
+    savePixelsToEXR(&pixels[0].x, renderWidth, renderHeight, outPath.c_str());
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <sstream>
 #include <cstdio>
+#include <cstdint>
 
 void saveToEXR(GLuint texture, int width, int height, const char* filename) {
     std::vector<float> pixels(width * height * 4); // RGBA
@@ -13,6 +14,10 @@ void saveToEXR(GLuint texture, int width, int height, const char* filename) {
     glBindTexture(GL_TEXTURE_2D, texture);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
 
+    savePixelsToEXR(pixels.data(), width, height, filename);
+}
+
+void savePixelsToEXR(const float* rgba, int width, int height, const char* filename) {
     // Convert to OpenEXR format
     Imf::Array2D<Imf::Rgba> exrPixels(height, width);
     for (int y = 0; y < height; ++y) {
@@ -20,10 +25,10 @@ void saveToEXR(GLuint texture, int width, int height, const char* filename) {
             // OpenGL origin is bottom-left, OpenEXR is top-left
             int glIndex = ((height - 1 - y) * width + x) * 4;
 
-            exrPixels[y][x].r = pixels[glIndex + 0];
-            exrPixels[y][x].g = pixels[glIndex + 1];
-            exrPixels[y][x].b = pixels[glIndex + 2];
-            exrPixels[y][x].a = pixels[glIndex + 3];
+            exrPixels[y][x].r = rgba[glIndex + 0];
+            exrPixels[y][x].g = rgba[glIndex + 1];
+            exrPixels[y][x].b = rgba[glIndex + 2];
+            exrPixels[y][x].a = rgba[glIndex + 3];
         }
     }
 
@@ -35,6 +40,106 @@ void saveToEXR(GLuint texture, int width, int height, const char* filename) {
     printf("Saved image to %s (%dx%d)\n", filename, width, height);
 }
 
+AsyncEXRExporter::AsyncEXRExporter() {
+    worker = std::thread(&AsyncEXRExporter::workerLoop, this);
+}
+
+AsyncEXRExporter::~AsyncEXRExporter() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_one();
+    worker.join();
+}
+
+void AsyncEXRExporter::request(GLuint texture, int width, int height, const char* filename) {
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->width = width;
+    snapshot->height = height;
+    snapshot->filename = filename;
+
+    const GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4 * sizeof(float);
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &snapshot->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, snapshot->pbo);
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+
+    // With a pack buffer bound the "pointer" is an offset and the copy is
+    // queued on the GPU instead of stalling here
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+    snapshot->pixels = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    snapshot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    if (snapshot->pixels == nullptr) {
+        printf("ERROR: Failed to map readback buffer for %s\n", filename);
+        glDeleteSync(snapshot->fence);
+        glDeleteBuffers(1, &snapshot->pbo);
+        return;
+    }
+    snapshots.push_back(std::move(snapshot));
+}
+
+void AsyncEXRExporter::poll() {
+    for (auto& snapshot : snapshots) {
+        if (snapshot->queued) continue;
+
+        const GLenum status = glClientWaitSync(snapshot->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+        glDeleteSync(snapshot->fence);
+        snapshot->fence = nullptr;
+        snapshot->queued = true;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            encodeQueue.push_back(snapshot.get());
+        }
+        queueCondition.notify_one();
+    }
+
+    // Buffers can only be released on the GL thread, once the worker is done
+    std::erase_if(snapshots, [](const std::unique_ptr<Snapshot>& snapshot) {
+        if (!snapshot->written.load(std::memory_order_acquire)) return false;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, snapshot->pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(1, &snapshot->pbo);
+        return true;
+    });
+}
+
+void AsyncEXRExporter::flush() {
+    for (auto& snapshot : snapshots) {
+        if (snapshot->fence) glClientWaitSync(snapshot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+    }
+    while (!snapshots.empty()) {
+        poll();
+        if (!snapshots.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void AsyncEXRExporter::workerLoop() {
+    for (;;) {
+        Snapshot* snapshot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopping || !encodeQueue.empty(); });
+            if (encodeQueue.empty()) return;
+            snapshot = encodeQueue.front();
+            encodeQueue.pop_front();
+        }
+        savePixelsToEXR(snapshot->pixels, snapshot->width, snapshot->height, snapshot->filename.c_str());
+        snapshot->written.store(true, std::memory_order_release);
+    }
+}
+
 const char* generateTimestampedFilename(const char* prefix, const char* extension) {
     static char buffer[256];
     
@@ -0,0 +1,426 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#ifdef RAYPULSE_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "shader.h"
+#include "texture.h"
+#include "renderer.h"
+#include "wavefront.h"
+#include "export.h"
+#include "checkpoint.h"
+#include "paths.h"
+#include "sampler.h"
+#include "SceneBuilder.h"
+#include "SceneCache.h"
+
+void printHeadlessUsage(const char* exe) {
+    printf("Usage: %s render <scene.json> [--spp N] [--out file.exr] [--width W] [--height H]\n"
+           "       [--checkpoint file.rpck] [--checkpoint-interval seconds] [--resume file.rpck]\n", exe);
+}
+
+bool parseHeadlessArgs(const int argc, char** argv, HeadlessOptions& options) {
+    if (argc < 1) return false;
+    options.scenePath = argv[0];
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--spp") == 0 && hasValue) options.spp = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--out") == 0 && hasValue) options.outPath = argv[++i];
+        else if (std::strcmp(argv[i], "--width") == 0 && hasValue) options.width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && hasValue) options.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--checkpoint") == 0 && hasValue) options.checkpointPath = argv[++i];
+        else if (std::strcmp(argv[i], "--checkpoint-interval") == 0 && hasValue) options.checkpointInterval = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--resume") == 0 && hasValue) options.resumePath = argv[++i];
+        else return false;
+    }
+    if (!options.resumePath.empty() && options.checkpointPath.empty()) {
+        options.checkpointPath = options.resumePath;
+    }
+    return true;
+}
+
+#ifdef RAYPULSE_HAS_EGL
+
+namespace {
+
+struct HeadlessContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+bool hasExtension(const char* extensions, const char* name) {
+    if (extensions == nullptr) return false;
+    const size_t length = std::strlen(name);
+    for (const char* p = extensions; (p = std::strstr(p, name)) != nullptr; p += length) {
+        const bool startsWord = p == extensions || p[-1] == ' ';
+        const bool endsWord = p[length] == ' ' || p[length] == '\0';
+        if (startsWord && endsWord) return true;
+    }
+    return false;
+}
+
+EGLDisplay openDisplay() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    // Mesa's surfaceless platform needs neither X11 nor a DRM node, so it
+    // works inside containers where only llvmpipe is available
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY) return display;
+        }
+    }
+#endif
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+void destroyHeadlessContext(HeadlessContext& ctx) {
+    if (ctx.display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (ctx.surface != EGL_NO_SURFACE) eglDestroySurface(ctx.display, ctx.surface);
+    if (ctx.context != EGL_NO_CONTEXT) eglDestroyContext(ctx.display, ctx.context);
+    eglTerminate(ctx.display);
+    ctx = {};
+}
+
+bool createHeadlessContext(HeadlessContext& ctx) {
+    ctx.display = openDisplay();
+    if (ctx.display == EGL_NO_DISPLAY) {
+        printf("ERROR: No EGL display available\n");
+        return false;
+    }
+
+    EGLint major = 0, minor = 0;
+    if (!eglInitialize(ctx.display, &major, &minor)) {
+        printf("ERROR: eglInitialize failed (0x%x)\n", eglGetError());
+        ctx.display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("ERROR: EGL implementation does not support desktop OpenGL\n");
+        return false;
+    }
+
+    // Without EGL_KHR_surfaceless_context we fall back to a 1x1 pbuffer; all
+    // rendering goes to textures either way
+    const bool surfaceless = hasExtension(eglQueryString(ctx.display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(ctx.display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        printf("ERROR: No suitable EGL config\n");
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    ctx.context = eglCreateContext(ctx.display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx.context == EGL_NO_CONTEXT) {
+        printf("ERROR: Failed to create an OpenGL 4.6 core context (0x%x)\n", eglGetError());
+        return false;
+    }
+
+    if (!surfaceless) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        ctx.surface = eglCreatePbufferSurface(ctx.display, config, pbufferAttribs);
+        if (ctx.surface == EGL_NO_SURFACE) {
+            printf("ERROR: Failed to create EGL pbuffer surface (0x%x)\n", eglGetError());
+            return false;
+        }
+    }
+
+    if (!eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context)) {
+        printf("ERROR: eglMakeCurrent failed (0x%x)\n", eglGetError());
+        return false;
+    }
+
+    printf("EGL %d.%d, %s context\n", major, minor, surfaceless ? "surfaceless" : "pbuffer");
+    return true;
+}
+
+HeadlessContext context;
+
+} // namespace
+
+bool openHeadlessContext() {
+    if (!createHeadlessContext(context)) {
+        destroyHeadlessContext(context);
+        return false;
+    }
+
+    if (gladLoadGL(reinterpret_cast<GLADloadfunc>(eglGetProcAddress)) == 0) {
+        printf("ERROR: Failed to load OpenGL functions\n");
+        destroyHeadlessContext(context);
+        return false;
+    }
+    printf("OpenGL %s (%s)\n",
+           reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+           reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    return true;
+}
+
+void closeHeadlessContext() {
+    destroyHeadlessContext(context);
+}
+
+#else
+
+bool openHeadlessContext() {
+    printf("ERROR: Headless rendering requires EGL, which was not found when this build was configured\n");
+    return false;
+}
+
+void closeHeadlessContext() {}
+
+#endif
+
+// All GL objects live inside this function so they are released before the
+// context is torn down
+bool renderHeadless(const SceneConfig& sceneConfig, const SceneData& sceneData, const HeadlessOptions& options,
+                    HeadlessRenderStats* stats) {
+    const std::string shaderPath = getResourcePath("main.spv");
+    const GLuint computeProgram = createComputeProgramFromBinary(shaderPath.c_str());
+    if (computeProgram == 0) {
+        printf("ERROR: Failed to load compute shader %s\n", shaderPath.c_str());
+        return false;
+    }
+
+    Vec4Buffer objectGeometryBuffer;
+    IndexBuffer objectTypeBuffer;
+    IndexBuffer objectMaterialBuffer;
+    MaterialBuffer materialBuffer;
+    LightBuffer lightBuffer;
+    BVHBuffer bvhBuffer;
+    IndexBuffer primIndexBuffer;
+    IndexBuffer planeIndexBuffer;
+
+    objectGeometryBuffer.update(sceneData.objectGeometry);
+    objectGeometryBuffer.bind(1);
+    objectTypeBuffer.update(sceneData.objectTypes);
+    objectTypeBuffer.bind(15);
+    objectMaterialBuffer.update(sceneData.objectMaterials);
+    objectMaterialBuffer.bind(16);
+    materialBuffer.update(sceneData.materials);
+    materialBuffer.bind(2);
+    lightBuffer.update(sceneData.lightIndices);
+    lightBuffer.bind(3);
+    bvhBuffer.update(sceneData.bvhNodes);
+    bvhBuffer.bind(4);
+    primIndexBuffer.update(sceneData.bvhPrimIndices);
+    primIndexBuffer.bind(5);
+    planeIndexBuffer.update(sceneData.planeIndices);
+    planeIndexBuffer.bind(6);
+    LightTableBuffer lightTableBuffer;
+    lightTableBuffer.update(sceneData.lightTable);
+    lightTableBuffer.bind(8);
+    TransformBuffer transformBuffer;
+    transformBuffer.update(sceneData.objectTransforms);
+    transformBuffer.bind(9);
+    Vec4Buffer convexPlaneBuffer;
+    convexPlaneBuffer.update(sceneData.convexPlanes);
+    convexPlaneBuffer.bind(10);
+    InstanceBuffer instanceBuffer;
+    instanceBuffer.update(sceneData.instanceTransforms);
+    instanceBuffer.bind(17);
+    Vec3Buffer meshVertexBuffer;
+    meshVertexBuffer.update(sceneData.meshVertices);
+    meshVertexBuffer.bind(18);
+    IndexBuffer meshIndexBuffer;
+    meshIndexBuffer.update(sceneData.meshIndices);
+    meshIndexBuffer.bind(19);
+    BVHBuffer meshNodeBuffer;
+    meshNodeBuffer.update(sceneData.meshNodes);
+    meshNodeBuffer.bind(20);
+    IndexBuffer blueNoiseBuffer;
+    if (sceneConfig.render.sampler == SamplerType::BlueNoise) blueNoiseBuffer.update(blueNoiseRanks());
+    blueNoiseBuffer.bind(BLUE_NOISE_BINDING);
+
+    CameraParams camera_params = {
+        sceneConfig.camera.position,
+        glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f),
+        sceneConfig.camera.fov,
+        sceneConfig.camera.aperture,
+        sceneConfig.camera.focusDist,
+        0
+    };
+    calculateBasisFromEuler(sceneConfig.camera.rotation.x, sceneConfig.camera.rotation.y, sceneConfig.camera.rotation.z,
+                            camera_params.forward, camera_params.right, camera_params.up);
+
+    SkyParams sky_params = { sceneConfig.sky.colorTop, sceneConfig.sky.colorBottom };
+
+    const int renderWidth = options.width > 0 ? options.width : sceneConfig.render.width;
+    const int renderHeight = options.height > 0 ? options.height : sceneConfig.render.height;
+    const int samplesPerFrame = std::max(1, sceneConfig.render.samplesPerFrame);
+    const int maxSamples = options.spp > 0 ? options.spp : sceneConfig.render.maxSamples;
+    const auto maxBounces = static_cast<uint32_t>(sceneConfig.render.maxBounces);
+
+    RayTexture accumTexture = createTexture(renderWidth, renderHeight, GL_RGBA32F);
+    RayTexture outputTexture = createTexture(renderWidth, renderHeight, GL_RGBA32F);
+    RayTexture accumBloom = createTexture(renderWidth, renderHeight, GL_RGBA32F);
+    RayTexture outputBloom = createTexture(renderWidth, renderHeight, GL_RGBA32F);
+    RayTexture momentTexture = createTexture(renderWidth, renderHeight, GL_RGBA32F);
+
+    std::unique_ptr<WavefrontPipeline> wavefront;
+    if (sceneConfig.render.wavefront) {
+        wavefront = std::make_unique<WavefrontPipeline>();
+        if (!wavefront->isValid()) {
+            printf("WARNING: Wavefront kernels unavailable, using the megakernel\n");
+            wavefront.reset();
+        }
+    }
+
+    const float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearTexImage(accumTexture.id, 0, GL_RGBA, GL_FLOAT, clearColor);
+    glClearTexImage(accumBloom.id, 0, GL_RGBA, GL_FLOAT, clearColor);
+    glClearTexImage(momentTexture.id, 0, GL_RGBA, GL_FLOAT, clearColor);
+
+    const CheckpointTextures checkpointTextures = {
+        accumTexture.id, accumBloom.id, momentTexture.id, outputTexture.id, outputBloom.id
+    };
+    const bool checkpointing = !options.checkpointPath.empty() || !options.resumePath.empty();
+    const uint64_t sceneHash = checkpointing ? hashSceneSources(options.scenePath, sceneData) : 0;
+    if (!options.resumePath.empty()) {
+        CheckpointHeader header{};
+        if (!loadCheckpoint(options.resumePath, renderWidth, renderHeight, samplesPerFrame, sceneHash,
+                            checkpointTextures, header)) {
+            destroyTexture(accumTexture);
+            destroyTexture(outputTexture);
+            destroyTexture(accumBloom);
+            destroyTexture(outputBloom);
+            destroyTexture(momentTexture);
+            glDeleteProgram(computeProgram);
+            return false;
+        }
+        // frameCount seeds the per-pixel RNG, so the continuation matches an uninterrupted run
+        camera_params.frameCount = header.frameCount;
+        if (options.progress) printf("Resuming %s at %u samples\n", options.resumePath.c_str(), header.samplesPerPixel);
+    }
+
+    const AdaptiveConfig& adaptive = sceneConfig.render.adaptive;
+    CounterBuffer adaptiveStats;
+    adaptiveStats.bind(7);
+    FrameConstantsBuffer frameConstants;
+    GLuint activePixels = static_cast<GLuint>(renderWidth * renderHeight);
+
+    if (options.progress) printf("Rendering %dx%d, %d samples\n", renderWidth, renderHeight, maxSamples);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto lastCheckpoint = start;
+    while (static_cast<int>(camera_params.frameCount) * samplesPerFrame < maxSamples && activePixels > 0) {
+        adaptiveStats.reset();
+        const GPUFrameConstants frame = makeFrameConstants(
+            {renderWidth, renderHeight},
+            camera_params, sky_params,
+            {adaptive.enabled, adaptive.threshold, adaptive.minSamples, adaptive.maxBoost},
+            {static_cast<int>(sceneConfig.render.sampler), sceneConfig.render.seed},
+            sceneData.objects.size(),
+            static_cast<int>(sceneData.lightIndices.size()),
+            static_cast<int>(sceneData.planeIndices.size()),
+            static_cast<int>(sceneData.bvhNodes.size()),
+            static_cast<int>(sceneData.lightTable.size()),
+            sceneConfig.render.lightSamples,
+            samplesPerFrame, maxSamples, maxBounces);
+        frameConstants.update(frame);
+        if (wavefront) {
+            wavefront->dispatch(accumTexture.id, outputTexture.id,
+                                accumBloom.id, outputBloom.id,
+                                momentTexture.id, frame);
+        } else {
+            dispatchComputeShader(computeProgram,
+                                  accumTexture.id, outputTexture.id,
+                                  accumBloom.id, outputBloom.id,
+                                  momentTexture.id, frame);
+        }
+        camera_params.frameCount += 1;
+
+        if (!options.checkpointPath.empty()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - lastCheckpoint).count() >= options.checkpointInterval) {
+                saveCheckpoint(options.checkpointPath,
+                               makeCheckpointHeader(renderWidth, renderHeight, camera_params.frameCount,
+                                                    samplesPerFrame, sceneHash),
+                               checkpointTextures);
+                lastCheckpoint = now;
+            }
+        }
+
+        // Keep the driver queue short so progress and timings reflect finished work
+        glFinish();
+        activePixels = adaptiveStats.read().activePixels;
+        if (options.progress) {
+            const int done = std::min(static_cast<int>(camera_params.frameCount) * samplesPerFrame, maxSamples);
+            if (adaptive.enabled) printf("\r  %d / %d samples, %u pixels active   ", done, maxSamples, activePixels);
+            else printf("\r  %d / %d samples", done, maxSamples);
+            fflush(stdout);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (options.progress) printf("\nDone in %.2f s\n", seconds);
+
+    if (stats) {
+        stats->width = renderWidth;
+        stats->height = renderHeight;
+        stats->frames = static_cast<int>(camera_params.frameCount);
+        stats->samplesPerPixel = std::min(stats->frames * samplesPerFrame, maxSamples);
+        stats->seconds = seconds;
+        if (options.keepImage) {
+            stats->image.resize(static_cast<size_t>(renderWidth) * renderHeight);
+            glBindTexture(GL_TEXTURE_2D, outputTexture.id);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, stats->image.data());
+        }
+    }
+
+    if (!options.outPath.empty()) {
+        saveToEXR(outputTexture.id, outputTexture.width, outputTexture.height, options.outPath.c_str());
+    }
+
+    destroyTexture(accumTexture);
+    destroyTexture(outputTexture);
+    destroyTexture(accumBloom);
+    destroyTexture(outputBloom);
+    destroyTexture(momentTexture);
+    wavefront.reset();
+    glDeleteProgram(computeProgram);
+    return true;
+}
+
+int runHeadlessRender(const HeadlessOptions& options) {
+    SceneConfig sceneConfig;
+    SceneData sceneData;
+    if (!SceneCache::loadScene(options.scenePath, sceneConfig, sceneData)) return -1;
+
+    if (!openHeadlessContext()) return -1;
+
+    HeadlessOptions renderOptions = options;
+    if (renderOptions.outPath.empty()) {
+        renderOptions.outPath = generateTimestampedFilename("raypulse", ".exr");
+    }
+    const bool ok = renderHeadless(sceneConfig, sceneData, renderOptions, nullptr);
+    closeHeadlessContext();
+    return ok ? 0 : -1;
+}
@@ -2,6 +2,8 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
+#include <iomanip>
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -12,6 +14,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <memory>
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -19,42 +22,24 @@
 #include "shader.h"
 #include "texture.h"
 #include "renderer.h"
+#include "wavefront.h"
+#include "tiles.h"
+#include "bloom.h"
+#include "profiler.h"
+#include "autotune.h"
+#include "sampler.h"
 #include "export.h"
 #include "MaterialFactory.h"
 #include "paths.h"
 #include "SceneBuilder.h"
-#include "SceneLoader.h"
+#include "SceneEditor.h"
+#include "SceneWatcher.h"
+#include "SceneCache.h"
+#include "headless.h"
 
 #define INIT_WINDOW_WIDTH 1600
 #define INIT_WINDOW_HEIGHT 900
 
-#define DEG_TO_RAD(deg) ((deg) * 3.14159265359f / 180.0f)
-
-void calculateBasisFromEuler(const float pitch, const float yaw, const float roll,
-                             glm::vec3& forward, glm::vec3& right, glm::vec3& up) {
-    const float pitchRad = DEG_TO_RAD(pitch);
-    const float yawRad = -DEG_TO_RAD(yaw);
-    const float rollRad = -DEG_TO_RAD(roll);
-
-    forward.x = cos(pitchRad) * sin(yawRad);
-    forward.y = sin(pitchRad);
-    forward.z = -cos(pitchRad) * cos(yawRad);
-    forward = glm::normalize(forward);
-
-    constexpr auto worldUp = glm::vec3(0.0f, 1.0f, 0.0f);
-    right = glm::normalize(glm::cross(worldUp, forward));
-    up = glm::normalize(glm::cross(forward, right));
-
-    if (abs(rollRad) > 0.001f) {
-        const float cosRoll = cos(rollRad);
-        const float sinRoll = sin(rollRad);
-        const glm::vec3 newRight = cosRoll * right + sinRoll * up;
-        const glm::vec3 newUp = -sinRoll * right + cosRoll * up;
-        right = newRight;
-        up = newUp;
-    }
-}
-
 void processInput(GLFWwindow* window);
 
 struct UIResolution{
@@ -63,146 +48,22 @@ struct UIResolution{
 };
 
 void createUIFramebuffer(const int width, const int height, GLuint* fbo, GLuint* tex);
-
-struct BloomPipeline {
-    GLuint extractProgram = 0;
-    GLuint blurHProgram = 0;
-    GLuint blurVProgram = 0;
-    RayTexture ping;
-    RayTexture pong;
-};
-
-void destroyBloomPipeline(BloomPipeline& pipeline) {
-    if (pipeline.extractProgram) glDeleteProgram(pipeline.extractProgram);
-    if (pipeline.blurHProgram) glDeleteProgram(pipeline.blurHProgram);
-    if (pipeline.blurVProgram) glDeleteProgram(pipeline.blurVProgram);
-    if (pipeline.ping.id) destroyTexture(pipeline.ping);
-    if (pipeline.pong.id) destroyTexture(pipeline.pong);
-    pipeline = {};
-}
-
-GLuint loadBloomShader(const char* fragPath) {
-    GLuint vertexShader = compileShaderFromFile(GL_VERTEX_SHADER, "shaders/vertex.glsl");
-    GLuint fragmentShader = compileShaderFromFile(GL_FRAGMENT_SHADER, fragPath);
-    if (vertexShader == 0 || fragmentShader == 0) {
-        if (vertexShader) glDeleteShader(vertexShader);
-        if (fragmentShader) glDeleteShader(fragmentShader);
-        return 0;
-    }
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
-        printf("Bloom shader link failed: %s\n", infoLog);
-    }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    return program;
-}
-
-void ensureBloomTextures(BloomPipeline& pipeline, int width, int height) {
-    if (pipeline.ping.id == 0) pipeline.ping = createTexture(width, height, GL_RGBA16F);
-    if (pipeline.pong.id == 0) pipeline.pong = createTexture(width, height, GL_RGBA16F);
-    if (pipeline.ping.width != width || pipeline.ping.height != height)
-        resizeTexture(pipeline.ping, width, height, GL_RGBA16F);
-    if (pipeline.pong.width != width || pipeline.pong.height != height)
-        resizeTexture(pipeline.pong, width, height, GL_RGBA16F);
-}
-
-void initBloomPipeline(BloomPipeline& pipeline) {
-    pipeline.extractProgram = loadBloomShader("shaders/bloom_extract.glsl");
-    pipeline.blurHProgram = loadBloomShader("shaders/bloom_blur_h.glsl");
-    pipeline.blurVProgram = loadBloomShader("shaders/bloom_blur_v.glsl");
-}
-
-struct BloomFrameResult {
-    GLuint textureId = 0;
-    int width = 0;
-    int height = 0;
-};
-
-std::array<float, 5> buildGaussianWeights(float sigma) {
-    std::array<float, 5> weights{};
-    float sum = 0.0f;
-    for (int i = 0; i < 5; ++i) {
-        float x = static_cast<float>(i);
-        float weight = std::exp(-(x * x) / (2.0f * sigma * sigma));
-        weights[i] = weight;
-        sum += (i == 0) ? weight : 2.0f * weight;
-    }
-    for (float& weight : weights) {
-        weight /= sum;
-    }
-    return weights;
-}
-
-BloomFrameResult applyBloom(const BloomConfig& config, BloomPipeline& pipeline, GLuint& bloomFBO,
-                             GLuint sourceTexture, int sourceWidth, int sourceHeight,
-                             const QuadRenderer& quadRenderer) {
-    BloomFrameResult result{};
-    if (!config.enabled || sourceTexture == 0) return result;
-    if (pipeline.extractProgram == 0 || pipeline.blurHProgram == 0 || pipeline.blurVProgram == 0) return result;
-
-    const float downscale = std::clamp(config.downscale, 0.1f, 1.0f);
-    const int targetWidth = std::max(1, static_cast<int>(sourceWidth * downscale));
-    const int targetHeight = std::max(1, static_cast<int>(sourceHeight * downscale));
-    ensureBloomTextures(pipeline, targetWidth, targetHeight);
-
-    if (bloomFBO == 0) {
-        glGenFramebuffers(1, &bloomFBO);
-    }
-
-    glDisable(GL_BLEND);
-    glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
-    glViewport(0, 0, targetWidth, targetHeight);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pipeline.ping.id, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    glUseProgram(pipeline.extractProgram);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, sourceTexture);
-    glUniform1i(glGetUniformLocation(pipeline.extractProgram, "sourceTexture"), 0);
-    glUniform1f(glGetUniformLocation(pipeline.extractProgram, "bloomThreshold"), std::max(config.threshold, 0.0f));
-    glUniform1f(glGetUniformLocation(pipeline.extractProgram, "bloomKnee"), std::clamp(config.knee, 0.0f, 1.0f));
-    quadRenderer.render();
-
-    const auto weights = buildGaussianWeights(2.5f);
-    const int passes = std::max(1, config.iterations);
-    for (int i = 0; i < passes; ++i) {
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pipeline.pong.id, 0);
-        glUseProgram(pipeline.blurHProgram);
-        glUniform2f(glGetUniformLocation(pipeline.blurHProgram, "texelSize"), 1.0f / targetWidth, 1.0f / targetHeight);
-        glUniform1fv(glGetUniformLocation(pipeline.blurHProgram, "weights"), static_cast<GLsizei>(weights.size()), weights.data());
-        glUniform1i(glGetUniformLocation(pipeline.blurHProgram, "sourceTexture"), 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pipeline.ping.id);
-        quadRenderer.render();
-
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pipeline.ping.id, 0);
-        glUseProgram(pipeline.blurVProgram);
-        glUniform2f(glGetUniformLocation(pipeline.blurVProgram, "texelSize"), 1.0f / targetWidth, 1.0f / targetHeight);
-        glUniform1fv(glGetUniformLocation(pipeline.blurVProgram, "weights"), static_cast<GLsizei>(weights.size()), weights.data());
-        glUniform1i(glGetUniformLocation(pipeline.blurVProgram, "sourceTexture"), 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pipeline.pong.id);
-        quadRenderer.render();
+bool cursorRenderPixel(GLFWwindow* window, int renderWidth, int renderHeight, glm::ivec2& pixel);
+
+// Usage:
+//   raypulse [scene.json]                 interactive viewer
+//   raypulse render <scene.json> [...]    headless batch render, see headless.h
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "render") == 0) {
+        HeadlessOptions options;
+        if (!parseHeadlessArgs(argc - 2, argv + 2, options)) {
+            printHeadlessUsage(argv[0]);
+            return 1;
+        }
+        return runHeadlessRender(options);
     }
+    const char* scenePath = argc >= 2 ? argv[1] : "./scenes/candles.json";
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    result.textureId = pipeline.ping.id;
-    result.width = targetWidth;
-    result.height = targetHeight;
-    return result;
-}
-
-int main() {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
@@ -239,23 +100,23 @@ int main() {
     std::string shaderPath = getResourcePath("main.spv");
     GLuint computeProgram = createComputeProgramFromBinary(shaderPath.c_str());
 
-    auto sceneConfigOpt = SceneLoader::loadFromFile("./scenes/candles.json");
-    if (!sceneConfigOpt.has_value()) {
-        printf("ERROR: Failed to load scene: %s\n", SceneLoader::getLastError().c_str());
-        glfwTerminate();
-        return -1;
-    }
-
-    SceneConfig sceneConfig = sceneConfigOpt.value();
-    std::string validationError;
-    if (!SceneBuilder::validate(sceneConfig, validationError)) {
-        printf("ERROR: Scene validation failed: %s\n", validationError.c_str());
+    // Present pass: the sampler units never change, the rest is set per draw
+    const GLint renderResolutionLoc = glGetUniformLocation(renderProgram, "renderResolution");
+    const GLint windowResolutionLoc = glGetUniformLocation(renderProgram, "windowResolution");
+    const GLint bloomEnabledLoc = glGetUniformLocation(renderProgram, "bloomEnabled");
+    const GLint bloomIntensityLoc = glGetUniformLocation(renderProgram, "bloomIntensity");
+    glUseProgram(renderProgram);
+    glUniform1i(glGetUniformLocation(renderProgram, "rayTexture"), 0);
+    glUniform1i(glGetUniformLocation(renderProgram, "bloomTexture"), 1);
+    glUseProgram(0);
+
+    SceneConfig sceneConfig;
+    SceneData sceneData;
+    if (!SceneCache::loadScene(scenePath, sceneConfig, sceneData)) {
         glfwTerminate();
         return -1;
     }
 
-    SceneData sceneData = SceneBuilder::buildScene(sceneConfig);
-
     std::cout << "\n=== RAW MEMORY DUMP OF MATERIAL 5 ===" << std::endl;
     if (sceneData.materials.size() > 5) {
         const GPUMaterial& mat = sceneData.materials[5];
@@ -289,18 +150,68 @@ int main() {
     }
     std::cout << "======================================\n" << std::endl;
 
-    SceneBuffer sceneBuffer;
+    Vec4Buffer objectGeometryBuffer;
+    IndexBuffer objectTypeBuffer;
+    IndexBuffer objectMaterialBuffer;
     MaterialBuffer materialBuffer;
     LightBuffer lightBuffer;
+    BVHBuffer bvhBuffer;
+    IndexBuffer primIndexBuffer;
+    IndexBuffer planeIndexBuffer;
+    LightTableBuffer lightTableBuffer;
+    TransformBuffer transformBuffer;
+    Vec4Buffer convexPlaneBuffer;
+    InstanceBuffer instanceBuffer;
+    Vec3Buffer meshVertexBuffer;
+    IndexBuffer meshIndexBuffer;
+    BVHBuffer meshNodeBuffer;
+    // The blue-noise mask is built on first use
+    IndexBuffer blueNoiseBuffer;
+    bool blueNoiseLoaded = false;
+
+    auto uploadScene = [&]() {
+        objectGeometryBuffer.update(sceneData.objectGeometry);
+        objectTypeBuffer.update(sceneData.objectTypes);
+        objectMaterialBuffer.update(sceneData.objectMaterials);
+        materialBuffer.update(sceneData.materials);
+        lightBuffer.update(sceneData.lightIndices);
+        bvhBuffer.update(sceneData.bvhNodes);
+        primIndexBuffer.update(sceneData.bvhPrimIndices);
+        planeIndexBuffer.update(sceneData.planeIndices);
+        lightTableBuffer.update(sceneData.lightTable);
+        transformBuffer.update(sceneData.objectTransforms);
+        convexPlaneBuffer.update(sceneData.convexPlanes);
+        instanceBuffer.update(sceneData.instanceTransforms);
+        meshVertexBuffer.update(sceneData.meshVertices);
+        meshIndexBuffer.update(sceneData.meshIndices);
+        meshNodeBuffer.update(sceneData.meshNodes);
+    };
+    uploadScene();
 
-    sceneBuffer.update(sceneData.objects);
-    sceneBuffer.bind(1);
-    materialBuffer.update(sceneData.materials);
+    objectGeometryBuffer.bind(1);
+    objectTypeBuffer.bind(15);
+    objectMaterialBuffer.bind(16);
     materialBuffer.bind(2);
-    lightBuffer.update(sceneData.lightIndices);
     lightBuffer.bind(3);
-
-    auto cameraRot = glm::vec3{0.0f, 0.0f, 0.0f};
+    bvhBuffer.bind(4);
+    primIndexBuffer.bind(5);
+    planeIndexBuffer.bind(6);
+    lightTableBuffer.bind(8);
+    transformBuffer.bind(9);
+    convexPlaneBuffer.bind(10);
+    instanceBuffer.bind(17);
+    meshVertexBuffer.bind(18);
+    meshIndexBuffer.bind(19);
+    meshNodeBuffer.bind(20);
+
+    // Edits from the UI patch these buffers in place (see uploadEdits);
+    // recreated when a reload rebuilds the scene
+    auto sceneEditor = std::make_unique<SceneEditor>(sceneData);
+    // Saves of the scene file are applied while rendering (see applySceneReload)
+    SceneWatcher sceneWatcher(scenePath, sceneData);
+    SceneConfig fileConfig = sceneConfig;
+
+    auto cameraRot = sceneConfig.camera.rotation;
     CameraParams camera_params = {
         sceneConfig.camera.position,
         glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f),
@@ -326,11 +237,145 @@ int main() {
     RayTexture accumBloom = createTexture(targetRenderWidth, targetRenderHeight, GL_RGBA32F);
     RayTexture outputBloom = createTexture(targetRenderWidth, targetRenderHeight, GL_RGBA32F);
 
+    RayTexture momentTexture = createTexture(targetRenderWidth, targetRenderHeight, GL_RGBA32F);
+    CounterBuffer adaptiveStats;
+    FrameConstantsBuffer frameConstants;
+    GLuint activePixels = static_cast<GLuint>(targetRenderWidth * targetRenderHeight);
+    // Tags active-pixel readbacks; counts from before the last reset are stale
+    uint64_t accumulationEpoch = 0;
+    // samplesPerFrame varies with autoSamples, so frames are not a sample count
+    int accumulatedSamples = 0;
+
+    // Megakernel frames skip converged tiles; without the list kernel every
+    // frame dispatches the whole grid
+    auto tileScheduler = std::make_unique<TileScheduler>();
+    if (!tileScheduler->isValid()) {
+        printf("WARNING: Tile scheduling unavailable, dispatching every tile\n");
+        tileScheduler.reset();
+    }
+
     auto resetAccumulation = [&]() {
         float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
         glClearTexImage(accumTexture.id, 0, GL_RGBA, GL_FLOAT, clearColor);
         glClearTexImage(accumBloom.id, 0, GL_RGBA, GL_FLOAT, clearColor);
+        glClearTexImage(momentTexture.id, 0, GL_RGBA, GL_FLOAT, clearColor);
         camera_params.frameCount = 0;
+        accumulatedSamples = 0;
+        activePixels = static_cast<GLuint>(accumTexture.width * accumTexture.height);
+        accumulationEpoch++;
+        if (tileScheduler) tileScheduler->invalidate();
+    };
+    resetAccumulation();
+
+    // Uploads only the entries SceneEditor::commit reports as changed
+    auto uploadEdits = [&](const SceneEdits& edits) {
+        if (!edits.objects.empty()) {
+            objectGeometryBuffer.updateRange(sceneData.objectGeometry, edits.objects.first, edits.objects.count());
+            objectMaterialBuffer.updateRange(sceneData.objectMaterials, edits.objects.first, edits.objects.count());
+        }
+        if (!edits.objectTransforms.empty()) {
+            transformBuffer.updateRange(sceneData.objectTransforms, edits.objectTransforms.first, edits.objectTransforms.count());
+        }
+        if (!edits.convexPlanes.empty()) {
+            convexPlaneBuffer.updateRange(sceneData.convexPlanes, edits.convexPlanes.first, edits.convexPlanes.count());
+        }
+        if (!edits.materials.empty()) {
+            materialBuffer.updateRange(sceneData.materials, edits.materials.first, edits.materials.count());
+        }
+        if (!edits.instanceTransforms.empty()) {
+            instanceBuffer.updateRange(sceneData.instanceTransforms, edits.instanceTransforms.first, edits.instanceTransforms.count());
+        }
+        if (!edits.bvhNodes.empty()) {
+            bvhBuffer.updateRange(sceneData.bvhNodes, edits.bvhNodes.first, edits.bvhNodes.count());
+        }
+        if (edits.lightTable) {
+            lightTableBuffer.update(sceneData.lightTable);
+        }
+        if (edits.visible) {
+            resetAccumulation();
+        }
+    };
+
+    auto resizeRender = [&](const int width, const int height) {
+        resizeTexture(accumTexture, width, height, GL_RGBA32F);
+        resizeTexture(outputTexture, width, height, GL_RGBA32F);
+        resizeTexture(accumBloom, width, height, GL_RGBA32F);
+        resizeTexture(outputBloom, width, height, GL_RGBA32F);
+        resizeTexture(momentTexture, width, height, GL_RGBA32F);
+        resetAccumulation();
+    };
+
+    // Applies a saved version of the scene file. Settings are compared with
+    // the previous version of the file rather than the live values, so
+    // changes made in the UI stay unless the file changes them too.
+    auto applySceneReload = [&](SceneReload& reload) {
+        const SceneConfig& next = reload.config;
+        bool restart = false;
+
+        if (!(next.camera == fileConfig.camera)) {
+            camera_params.pos = next.camera.position;
+            cameraRot = next.camera.rotation;
+            camera_params.FOV = next.camera.fov;
+            sceneConfig.camera.aperture = camera_params.aperture = next.camera.aperture;
+            sceneConfig.camera.focusDist = camera_params.focusDist = next.camera.focusDist;
+            calculateBasisFromEuler(cameraRot[0], cameraRot[1], cameraRot[2],
+                                    camera_params.forward, camera_params.right, camera_params.up);
+            restart = true;
+        }
+        if (!(next.sky == fileConfig.sky)) {
+            sky_params = { next.sky.colorTop, next.sky.colorBottom };
+            restart = true;
+        }
+
+        const RenderConfig& render = next.render;
+        const RenderConfig& previous = fileConfig.render;
+        if ((render.width != previous.width || render.height != previous.height) &&
+            render.width > 0 && render.height > 0) {
+            targetRenderWidth = render.width;
+            targetRenderHeight = render.height;
+            resizeRender(targetRenderWidth, targetRenderHeight);
+        }
+        if (render.samplesPerFrame != previous.samplesPerFrame) samplesPerFrame = render.samplesPerFrame;
+        if (render.autoSamples != previous.autoSamples) sceneConfig.render.autoSamples = render.autoSamples;
+        if (render.targetFrameMs != previous.targetFrameMs) sceneConfig.render.targetFrameMs = render.targetFrameMs;
+        if (render.maxSamples != previous.maxSamples) maxSamples = render.maxSamples;
+        if (render.wavefront != previous.wavefront) {
+            sceneConfig.render.wavefront = render.wavefront;
+            if (tileScheduler) tileScheduler->invalidate();
+        }
+        if (!(render.bloom == previous.bloom)) sceneConfig.render.bloom = render.bloom;
+        if (render.maxBounces != previous.maxBounces) {
+            maxBounces = render.maxBounces;
+            restart = true;
+        }
+        if (render.lightSamples != previous.lightSamples) {
+            sceneConfig.render.lightSamples = render.lightSamples;
+            restart = true;
+        }
+        if (!(render.adaptive == previous.adaptive)) {
+            sceneConfig.render.adaptive = render.adaptive;
+            restart = true;
+        }
+        if (render.sampler != previous.sampler || render.seed != previous.seed) {
+            sceneConfig.render.sampler = render.sampler;
+            sceneConfig.render.seed = render.seed;
+            restart = true;
+        }
+        fileConfig = next;
+
+        if (reload.rebuilt) {
+            sceneData = std::move(reload.scene);
+            uploadScene();
+            sceneEditor = std::make_unique<SceneEditor>(sceneData);
+            restart = true;
+        } else {
+            for (const size_t m : reload.changedMaterials) sceneEditor->setMaterial(m, reload.scene.materials[m]);
+            for (const size_t i : reload.changedObjects) sceneEditor->setObject(i, reload.scene.streamObject(i));
+            for (const size_t i : reload.changedInstances) sceneEditor->setInstance(i, reload.scene.instances[i]);
+            uploadEdits(sceneEditor->commit());
+        }
+
+        if (restart) resetAccumulation();
     };
 
     QuadRenderer quadRenderer;
@@ -338,9 +383,11 @@ int main() {
     GLuint uiTexture = 0;
     UIResolution currentUIRes = {0, 0};
 
-    GLuint timeQuery;
-    glGenQueries(1, &timeQuery);
-    GLuint64 elapsedNanoseconds = 0;
+    GpuFrameTimer frameTimer;
+    // Samples per wall-clock second, including everything besides path tracing
+    double effectiveSamplesPerSecond = 0.0;
+    double effectiveWindowSamples = 0.0;
+    double effectiveWindowStart = glfwGetTime();
 
     bool isRendering = true;
     bool accumulationPaused = false;
@@ -348,11 +395,21 @@ int main() {
     double uiUpdateInterval = 1.0 / static_cast<double>(monitorRefreshRate);
     double lastUITime = 0.0;
 
-    BloomPipeline bloomPipeline;
-    initBloomPipeline(bloomPipeline);
-    GLuint bloomFBO = 0;
+    auto bloomPipeline = std::make_unique<BloomPipeline>();
+    auto profiler = std::make_unique<GpuProfiler>();
+
+    AsyncEXRExporter exrExporter;
+
+    // Created on first use so the megakernel path never loads the wf_* kernels
+    std::unique_ptr<WavefrontPipeline> wavefront;
+
+    // Tiles around the cursor get priorityBoost times the samples
+    bool cursorPriority = true;
+    int priorityRadius = 3;
+    int priorityBoost = 4;
 
     while (!glfwWindowShouldClose(window)) {
+        profiler->beginFrame();
         double currentTime = glfwGetTime();
         int winWidth, winHeight;
         glfwGetFramebufferSize(window, &winWidth, &winHeight);
@@ -363,54 +420,139 @@ int main() {
             createUIFramebuffer(winWidth, winHeight, &uiFBO, &uiTexture);
         }
 
-        int currentTotalSamples = camera_params.frameCount * samplesPerFrame;
-        bool isRenderingComplete = currentTotalSamples >= maxSamples;
+        if (std::optional<SceneReload> reload = sceneWatcher.poll()) {
+            applySceneReload(*reload);
+        }
+
+        // Results of earlier frames that the GPU has finished; nothing here waits
+        frameTimer.poll();
+        FrameCounts counts = {0, 0};
+        uint64_t countedEpoch = 0;
+        while (adaptiveStats.pollRead(counts, countedEpoch)) {
+            frameTimer.addRenderedSamples(counts.renderedSamples);
+            effectiveWindowSamples += counts.renderedSamples;
+            if (countedEpoch == accumulationEpoch) activePixels = counts.activePixels;
+        }
+
+        if (currentTime - effectiveWindowStart >= 0.5) {
+            effectiveSamplesPerSecond = effectiveWindowSamples / (currentTime - effectiveWindowStart);
+            effectiveWindowSamples = 0.0;
+            effectiveWindowStart = currentTime;
+        }
+
+        int currentTotalSamples = accumulatedSamples;
+        bool isRenderingComplete = currentTotalSamples >= maxSamples || activePixels == 0;
 
         if (isRendering && !accumulationPaused && !isRenderingComplete) {
-            sceneBuffer.bind(1);
+            ProfileScope traceZone(profiler.get(), "Path trace");
+            objectGeometryBuffer.bind(1);
+            objectTypeBuffer.bind(15);
+            objectMaterialBuffer.bind(16);
             materialBuffer.bind(2);
-            glBeginQuery(GL_TIME_ELAPSED, timeQuery);
-
-            dispatchComputeShader(computeProgram,
-                                  accumTexture.id, outputTexture.id,
-                                  accumBloom.id, outputBloom.id,
-                                  {accumTexture.width, accumTexture.height},
-                                  camera_params, sky_params,
-                                  sceneData.objects.size(),
-                                  static_cast<int>(sceneData.lightIndices.size()),
-                                  samplesPerFrame, maxSamples,
-                                  static_cast<uint32_t>(maxBounces));
-
-            glEndQuery(GL_TIME_ELAPSED);
+            bvhBuffer.bind(4);
+            primIndexBuffer.bind(5);
+            planeIndexBuffer.bind(6);
+            lightTableBuffer.bind(8);
+            transformBuffer.bind(9);
+            convexPlaneBuffer.bind(10);
+            instanceBuffer.bind(17);
+            meshVertexBuffer.bind(18);
+            meshIndexBuffer.bind(19);
+            meshNodeBuffer.bind(20);
+            if (sceneConfig.render.sampler == SamplerType::BlueNoise && !blueNoiseLoaded) {
+                blueNoiseBuffer.update(blueNoiseRanks());
+                blueNoiseLoaded = true;
+            }
+            blueNoiseBuffer.bind(BLUE_NOISE_BINDING);
+            adaptiveStats.reset();
+            adaptiveStats.bind(7);
+
+            if (sceneConfig.render.autoSamples) {
+                samplesPerFrame = tuneSamplesPerFrame(samplesPerFrame, frameTimer.msPerFrameSample(),
+                                                      sceneConfig.render.targetFrameMs);
+            }
+            // The last frame only renders what is left of maxSamples
+            const int frameSamples = std::min(samplesPerFrame, maxSamples - accumulatedSamples);
+            frameTimer.begin(frameSamples);
+
+            if (sceneConfig.render.wavefront && !wavefront) {
+                wavefront = std::make_unique<WavefrontPipeline>();
+                if (!wavefront->isValid()) {
+                    printf("WARNING: Wavefront kernels unavailable, using the megakernel\n");
+                    sceneConfig.render.wavefront = false;
+                    // Ticking the checkbox again retries the load
+                    wavefront.reset();
+                }
+            }
+
+            const AdaptiveConfig& adaptive = sceneConfig.render.adaptive;
+            const GPUFrameConstants frame = makeFrameConstants(
+                {accumTexture.width, accumTexture.height},
+                camera_params, sky_params,
+                {adaptive.enabled, adaptive.threshold, adaptive.minSamples, adaptive.maxBoost},
+                {static_cast<int>(sceneConfig.render.sampler), sceneConfig.render.seed},
+                sceneData.objects.size(),
+                static_cast<int>(sceneData.lightIndices.size()),
+                static_cast<int>(sceneData.planeIndices.size()),
+                static_cast<int>(sceneData.bvhNodes.size()),
+                static_cast<int>(sceneData.lightTable.size()),
+                sceneConfig.render.lightSamples,
+                frameSamples, maxSamples,
+                static_cast<uint32_t>(maxBounces));
+            frameConstants.update(frame);
+            if (sceneConfig.render.wavefront) {
+                wavefront->dispatch(accumTexture.id, outputTexture.id,
+                                    accumBloom.id, outputBloom.id,
+                                    momentTexture.id, frame);
+            } else if (tileScheduler) {
+                PriorityRegion priority;
+                glm::ivec2 cursorPixel;
+                if (cursorPriority && !ImGui::GetIO().WantCaptureMouse &&
+                    cursorRenderPixel(window, accumTexture.width, accumTexture.height, cursorPixel)) {
+                    const glm::ivec2 tile = cursorPixel / TILE_SIZE;
+                    priority = {tile.x - priorityRadius, tile.y - priorityRadius,
+                                tile.x + priorityRadius + 1, tile.y + priorityRadius + 1, priorityBoost};
+                }
+                tileScheduler->dispatch(computeProgram,
+                                        accumTexture.id, outputTexture.id,
+                                        accumBloom.id, outputBloom.id,
+                                        momentTexture.id, frame,
+                                        dispatchBandCount(frameSamples, frameTimer.msPerFrameSample()),
+                                        priority);
+            } else {
+                dispatchComputeShader(computeProgram,
+                                      accumTexture.id, outputTexture.id,
+                                      accumBloom.id, outputBloom.id,
+                                      momentTexture.id, frame,
+                                      dispatchBandCount(frameSamples, frameTimer.msPerFrameSample()));
+            }
+
+            frameTimer.end();
             camera_params.frameCount += 1;
-            glGetQueryObjectui64v(timeQuery, GL_QUERY_RESULT, &elapsedNanoseconds);
+            accumulatedSamples += frameSamples;
+            adaptiveStats.queueRead(accumulationEpoch);
         }
 
         BloomFrameResult bloomResult{};
         if (sceneConfig.render.bloom.enabled) {
-            bloomResult = applyBloom(sceneConfig.render.bloom, bloomPipeline, bloomFBO,
-                                     outputBloom.id,
-                                     outputBloom.width, outputBloom.height,
-                                     quadRenderer);
+            ProfileScope bloomZone(profiler.get(), "Bloom");
+            bloomResult = bloomPipeline->apply(sceneConfig.render.bloom, outputBloom.id,
+                                               outputBloom.width, outputBloom.height, profiler.get());
         }
         const bool bloomActive = sceneConfig.render.bloom.enabled && bloomResult.textureId != 0;
 
         // Render to Screen
+        const int displayZone = profiler->beginZone("Display");
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, winWidth, winHeight);
         glDisable(GL_BLEND);
         glUseProgram(renderProgram);
 
-        const GLint bloomEnabledLoc = glGetUniformLocation(renderProgram, "bloomEnabled");
-        const GLint bloomTextureLoc = glGetUniformLocation(renderProgram, "bloomTexture");
-        const GLint bloomIntensityLoc = glGetUniformLocation(renderProgram, "bloomIntensity");
-
-        glUniform2f(glGetUniformLocation(renderProgram, "renderResolution"),
+        glUniform2f(renderResolutionLoc,
                     static_cast<float>(outputTexture.width), static_cast<float>(outputTexture.height));
-        glUniform2f(glGetUniformLocation(renderProgram, "windowResolution"),
+        glUniform2f(windowResolutionLoc,
                     static_cast<float>(winWidth), static_cast<float>(winHeight));
 
-        glUniform1i(bloomTextureLoc, 1);
         glUniform1i(bloomEnabledLoc, bloomActive ? 1 : 0);
         glUniform1f(bloomIntensityLoc, sceneConfig.render.bloom.intensity);
 
@@ -419,13 +561,14 @@ int main() {
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, outputTexture.id);
-        glUniform1i(glGetUniformLocation(renderProgram, "rayTexture"), 0);
 
         quadRenderer.render();
+        profiler->endZone(displayZone);
 
         // UI
         if (currentTime - lastUITime >= uiUpdateInterval) {
             lastUITime = currentTime;
+            ProfileScope uiZone(profiler.get(), "UI");
 
             glBindFramebuffer(GL_FRAMEBUFFER, uiFBO);
             glViewport(0, 0, winWidth, winHeight);
@@ -437,8 +580,10 @@ int main() {
             ImGui::NewFrame();
 
             ImGui::Begin("Raypulse Controls");
-            float gpuTimeMs = elapsedNanoseconds / 1000000.0f;
-            ImGui::TextColored(ImVec4(0, 1, 0, 1), "Raytrace Speed: %.0f FPS", 1000.0f / (gpuTimeMs + 0.0001f));
+            ImGui::TextColored(ImVec4(0, 1, 0, 1), "Raytrace: %.2f ms/frame, %.1f Msamples/s",
+                               frameTimer.averageMs(), frameTimer.samplesPerSecond() / 1.0e6);
+            ImGui::Text("Effective: %.1f Msamples/s at %d samples/frame",
+                        effectiveSamplesPerSecond / 1.0e6, samplesPerFrame);
             ImGui::Text("Render Res: %dx%d", accumTexture.width, accumTexture.height);
 
             if (isRenderingComplete) {
@@ -467,23 +612,61 @@ int main() {
 
                 if (ImGui::Button("Set Resolution")) {
                     if (targetRenderWidth > 0 && targetRenderHeight > 0) {
-                        resizeTexture(accumTexture, targetRenderWidth, targetRenderHeight, GL_RGBA32F);
-                        resizeTexture(outputTexture, targetRenderWidth, targetRenderHeight, GL_RGBA32F);
-                        resizeTexture(accumBloom, targetRenderWidth, targetRenderHeight, GL_RGBA32F);
-                        resizeTexture(outputBloom, targetRenderWidth, targetRenderHeight, GL_RGBA32F);
-
-                        resetAccumulation();
+                        resizeRender(targetRenderWidth, targetRenderHeight);
                         createUIFramebuffer(winWidth, winHeight, &uiFBO, &uiTexture);
                     }
                 }
 
                 if (ImGui::CollapsingHeader("Progressive Rendering", ImGuiTreeNodeFlags_DefaultOpen)) {
                     ImGui::SliderInt("Max Samples", &maxSamples, 10, 100000);
-                    ImGui::SliderInt("Samples / Frame", &samplesPerFrame, 1, 16);
+                    ImGui::Checkbox("Auto Samples / Frame", &sceneConfig.render.autoSamples);
+                    if (sceneConfig.render.autoSamples) {
+                        ImGui::SliderFloat("Target GPU ms", &sceneConfig.render.targetFrameMs, 2.0f, 1000.0f, "%.0f",
+                                           ImGuiSliderFlags_Logarithmic);
+                        if (ImGui::Button("Interactive (16 ms)")) sceneConfig.render.targetFrameMs = 16.0f;
+                        ImGui::SameLine();
+                        if (ImGui::Button("Batch (250 ms)")) sceneConfig.render.targetFrameMs = 250.0f;
+                    } else {
+                        ImGui::SliderInt("Samples / Frame", &samplesPerFrame, 1, 16);
+                    }
 
                     if (ImGui::SliderInt("Max Bounces", &maxBounces, 1, 256)) {
                         resetAccumulation();
                     }
+                    if (ImGui::SliderInt("Light Samples", &sceneConfig.render.lightSamples, 1, 16)) {
+                        resetAccumulation();
+                    }
+                    // Unbiased either way, but a restart keeps the image one stratified sequence
+                    const char* samplers[] = {"PCG", "Sobol (Owen)", "Blue Noise"};
+                    int sampler = static_cast<int>(sceneConfig.render.sampler);
+                    if (ImGui::Combo("Sampler", &sampler, samplers, IM_ARRAYSIZE(samplers))) {
+                        sceneConfig.render.sampler = static_cast<SamplerType>(sampler);
+                        resetAccumulation();
+                    }
+                    // Same estimator, so the accumulation carries over
+                    if (ImGui::Checkbox("Wavefront Pipeline", &sceneConfig.render.wavefront) && tileScheduler) {
+                        tileScheduler->invalidate();
+                    }
+                    if (tileScheduler && !sceneConfig.render.wavefront) {
+                        ImGui::Checkbox("Prioritize Cursor Region", &cursorPriority);
+                        if (cursorPriority) {
+                            ImGui::SliderInt("Region Radius (tiles)", &priorityRadius, 0, 16);
+                            ImGui::SliderInt("Region Boost", &priorityBoost, 1, 16);
+                        }
+                    }
+
+                    // Converged flags are sticky, so changing the criterion restarts
+                    AdaptiveConfig& adaptive = sceneConfig.render.adaptive;
+                    bool adaptiveChanged = ImGui::Checkbox("Adaptive Sampling", &adaptive.enabled);
+                    if (adaptive.enabled) {
+                        adaptiveChanged |= ImGui::SliderFloat("Error Threshold", &adaptive.threshold, 0.001f, 0.2f, "%.3f");
+                        adaptiveChanged |= ImGui::SliderInt("Min Samples", &adaptive.minSamples, 1, 1024);
+                        adaptiveChanged |= ImGui::SliderInt("Max Boost", &adaptive.maxBoost, 1, 16);
+                        ImGui::Text("Active Pixels: %u / %d", activePixels, accumTexture.width * accumTexture.height);
+                    }
+                    if (adaptiveChanged) {
+                        resetAccumulation();
+                    }
 
                     ImGui::Separator();
                     if (ImGui::Button("Restart")) {
@@ -500,7 +683,7 @@ int main() {
                     ImGui::SliderFloat("Threshold", &sceneConfig.render.bloom.threshold, 0.0f, 20.0f, "%.2f");
                     ImGui::SliderFloat("Soft Knee", &sceneConfig.render.bloom.knee, 0.0f, 1.0f, "%.2f");
                     ImGui::SliderFloat("Intensity", &sceneConfig.render.bloom.intensity, 0.0f, 5.0f, "%.2f");
-                    ImGui::SliderInt("Blur Iterations", &sceneConfig.render.bloom.iterations, 1, 8);
+                    ImGui::SliderInt("Mip Levels", &sceneConfig.render.bloom.iterations, 1, 8);
                     ImGui::SliderFloat("Downscale", &sceneConfig.render.bloom.downscale, 0.1f, 1.0f, "%.2f");
                     sceneConfig.render.bloom.knee = std::clamp(sceneConfig.render.bloom.knee, 0.0f, 1.0f);
                     sceneConfig.render.bloom.downscale = std::clamp(sceneConfig.render.bloom.downscale, 0.1f, 1.0f);
@@ -528,10 +711,12 @@ int main() {
                 static float prevAperture = sceneConfig.camera.aperture;
                 static float prevFocusDist = sceneConfig.camera.focusDist;
 
+                // Without an aperture every distance is in focus
+                const bool focusChanged = prevFocusDist != sceneConfig.camera.focusDist &&
+                    sceneConfig.camera.aperture > 0.0f;
                 bool cameraChanged = (prevCameraPos != camera_params.pos) ||
                     (prevCameraRot != cameraRot) || (prevFOV != camera_params.FOV) ||
-                    (prevAperture != sceneConfig.camera.aperture) ||
-                    (prevFocusDist != sceneConfig.camera.focusDist);
+                    (prevAperture != sceneConfig.camera.aperture) || focusChanged;
 
                 if (cameraChanged) {
                     resetAccumulation();
@@ -562,10 +747,112 @@ int main() {
                 }
             }
 
+            // Edits are patched into the scene buffers and the BVH is refit;
+            // accumulation restarts only if the change is on screen
+            if (ImGui::CollapsingHeader("Scene Editing")) {
+                const int materialCount = static_cast<int>(sceneData.materials.size());
+
+                if (!sceneData.objects.empty()) {
+                    ImGui::PushID("object");
+                    static int objectIndex = 0;
+                    ImGui::SliderInt("Object", &objectIndex, 0, static_cast<int>(sceneData.objects.size()) - 1);
+                    objectIndex = std::clamp(objectIndex, 0, static_cast<int>(sceneData.objects.size()) - 1);
+
+                    SceneObject obj = sceneData.objects[objectIndex];
+                    if (obj.type == OBJ_PLANE) {
+                        ImGui::DragFloat3("Normal", glm::value_ptr(obj.normal), 0.01f);
+                        ImGui::DragFloat("Distance", &obj.distance, 0.05f);
+                    } else {
+                        ImGui::DragFloat3("Center", glm::value_ptr(obj.center), 0.05f);
+                        if (obj.type == OBJ_SPHERE) {
+                            ImGui::DragFloat("Radius", &obj.radius, 0.01f, 0.001f, 1000.0f);
+                        } else {
+                            ImGui::DragFloat3("Rotation", glm::value_ptr(obj.rotation), 0.5f);
+                            ImGui::DragFloat3("Scale", glm::value_ptr(obj.scale), 0.01f);
+                        }
+                    }
+                    ImGui::SliderInt("Material", &obj.materialIndex, 0, materialCount - 1);
+                    if (obj.type != OBJ_PLANE || glm::length(obj.normal) > 0.0f) {
+                        sceneEditor->setObject(objectIndex, obj);
+                    }
+                    ImGui::PopID();
+                }
+
+                if (!sceneData.instances.empty()) {
+                    ImGui::Separator();
+                    ImGui::PushID("instance");
+                    static int instanceIndex = 0;
+                    ImGui::SliderInt("Instance", &instanceIndex, 0, static_cast<int>(sceneData.instances.size()) - 1);
+                    instanceIndex = std::clamp(instanceIndex, 0, static_cast<int>(sceneData.instances.size()) - 1);
+
+                    SceneInstance inst = sceneData.instances[instanceIndex];
+                    ImGui::DragFloat3("Position", glm::value_ptr(inst.position), 0.05f);
+                    ImGui::DragFloat3("Rotation", glm::value_ptr(inst.rotation), 0.5f);
+                    ImGui::DragFloat3("Scale", glm::value_ptr(inst.scale), 0.01f);
+                    sceneEditor->setInstance(instanceIndex, inst);
+                    ImGui::PopID();
+                }
+
+                if (materialCount > 0) {
+                    ImGui::Separator();
+                    ImGui::PushID("material");
+                    static int materialIndex = 0;
+                    ImGui::SliderInt("Material", &materialIndex, 0, materialCount - 1);
+                    materialIndex = std::clamp(materialIndex, 0, materialCount - 1);
+                    for (const auto& [name, index] : sceneData.materialMap) {
+                        if (index == materialIndex) ImGui::Text("%s", name.c_str());
+                    }
+
+                    GPUMaterial mat = sceneData.materials[materialIndex];
+                    ImGui::ColorEdit3("Albedo", glm::value_ptr(mat.albedo));
+                    ImGui::ColorEdit3("Emission", glm::value_ptr(mat.emission));
+                    ImGui::DragFloat("Emission Strength", &mat.emissionStrength, 0.1f, 0.0f, 1000.0f);
+                    ImGui::SliderFloat("Roughness", &mat.roughness, 0.0f, 1.0f, "%.3f");
+                    ImGui::SliderFloat("Metallic", &mat.metallic, 0.0f, 1.0f, "%.3f");
+                    ImGui::SliderFloat("Transmission", &mat.transmission, 0.0f, 1.0f, "%.3f");
+                    ImGui::SliderFloat("IOR", &mat.ior, 1.0f, 3.0f, "%.3f");
+                    sceneEditor->setMaterial(materialIndex, mat);
+                    ImGui::PopID();
+                }
+            }
+            uploadEdits(sceneEditor->commit());
+
+            if (ImGui::CollapsingHeader("Profiler")) {
+                ImGui::Text("Frame: %.2f ms CPU, %.2f ms GPU", profiler->frameCpuMs(), profiler->frameGpuMs());
+                if (ImGui::BeginTable("profilerZones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+                    ImGui::TableSetupColumn("Stage");
+                    ImGui::TableSetupColumn("GPU ms");
+                    ImGui::TableSetupColumn("CPU ms");
+                    ImGui::TableHeadersRow();
+                    for (const ProfileSummary& zone : profiler->summary()) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%*s%s", zone.depth * 2, "", zone.name.c_str());
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", zone.gpuMs);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", zone.cpuMs);
+                    }
+                    ImGui::EndTable();
+                }
+                if (profiler->droppedFrames() > 0) {
+                    ImGui::Text("Dropped frames: %zu", profiler->droppedFrames());
+                }
+                if (ImGui::Button("Save Trace")) {
+                    profiler->saveTrace(generateTimestampedFilename("raypulse_trace", ".json"));
+                }
+                ImGui::SameLine();
+                ImGui::Text("last %zu frames", profiler->historySize());
+            }
+
             ImGui::Separator();
             if (ImGui::Button("Save .exr")) {
                 const char* filename = generateTimestampedFilename("raypulse", ".exr");
-                saveToEXR(outputTexture.id, outputTexture.width, outputTexture.height, filename);
+                exrExporter.request(outputTexture.id, outputTexture.width, outputTexture.height, filename);
+            }
+            if (exrExporter.pendingCount() > 0) {
+                ImGui::SameLine();
+                ImGui::Text("Saving (%zu)...", exrExporter.pendingCount());
             }
             ImGui::End();
 
@@ -573,38 +860,48 @@ int main() {
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         }
 
+        const int compositeZone = profiler->beginZone("UI composite");
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, winWidth, winHeight);
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glUseProgram(renderProgram);
         glUniform1i(bloomEnabledLoc, 0);
-        glUniform2f(glGetUniformLocation(renderProgram, "renderResolution"), (float)winWidth, (float)winHeight);
-        glUniform2f(glGetUniformLocation(renderProgram, "windowResolution"), (float)winWidth, (float)winHeight);
+        glUniform2f(renderResolutionLoc, (float)winWidth, (float)winHeight);
+        glUniform2f(windowResolutionLoc, (float)winWidth, (float)winHeight);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, uiTexture);
-        glUniform1i(glGetUniformLocation(renderProgram, "rayTexture"), 0);
         quadRenderer.render();
+        profiler->endZone(compositeZone);
+
+        exrExporter.poll();
 
         processInput(window);
-        glfwSwapBuffers(window);
+        {
+            ProfileScope presentZone(profiler.get(), "Present");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        profiler->endFrame();
     }
 
+    exrExporter.flush();
     glDeleteFramebuffers(1, &uiFBO);
-    if (bloomFBO) glDeleteFramebuffers(1, &bloomFBO);
     glDeleteTextures(1, &uiTexture);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-    destroyBloomPipeline(bloomPipeline);
+    bloomPipeline.reset();
+    profiler.reset();
     destroyTexture(accumTexture);
     destroyTexture(outputTexture);
     destroyTexture(accumBloom);
     destroyTexture(outputBloom);
+    destroyTexture(momentTexture);
+    wavefront.reset();
+    tileScheduler.reset();
     glDeleteProgram(renderProgram);
     glDeleteProgram(computeProgram);
-    glDeleteQueries(1, &timeQuery);
     glfwTerminate();
     return 0;
 }
@@ -629,4 +926,29 @@ void createUIFramebuffer(const int width, const int height, GLuint* fbo, GLuint*
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex, 0);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) printf("Error: UI Framebuffer is not complete!\n");
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
\ No newline at end of file
+}
+
+// Pixel of the render image under the cursor, letterboxed as in
+// fragment.glsl; false when the cursor is outside the image
+bool cursorRenderPixel(GLFWwindow* window, const int renderWidth, const int renderHeight, glm::ivec2& pixel) {
+    if (!glfwGetWindowAttrib(window, GLFW_HOVERED)) return false;
+    int windowWidth, windowHeight;
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    if (windowWidth <= 0 || windowHeight <= 0 || renderWidth <= 0 || renderHeight <= 0) return false;
+
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    // Texture coordinates of the display quad start at the bottom left
+    glm::vec2 uv(static_cast<float>(x / windowWidth), 1.0f - static_cast<float>(y / windowHeight));
+    const float renderAspect = static_cast<float>(renderWidth) / static_cast<float>(renderHeight);
+    const float windowAspect = static_cast<float>(windowWidth) / static_cast<float>(windowHeight);
+    if (renderAspect > windowAspect) {
+        uv.y = (uv.y - 0.5f) / (windowAspect / renderAspect) + 0.5f;
+    } else if (renderAspect < windowAspect) {
+        uv.x = (uv.x - 0.5f) / (renderAspect / windowAspect) + 0.5f;
+    }
+    if (uv.x < 0.0f || uv.x >= 1.0f || uv.y < 0.0f || uv.y >= 1.0f) return false;
+
+    pixel = glm::ivec2(uv * glm::vec2(static_cast<float>(renderWidth), static_cast<float>(renderHeight)));
+    return true;
+}
@@ -0,0 +1,309 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Weight of the newest frame in the averages
+constexpr double SMOOTHING = 0.1;
+// Frames a zone stays in the summary after it last ran
+constexpr uint64_t SUMMARY_LINGER = 120;
+// Frames in flight before a pool is added
+constexpr size_t INITIAL_POOLS = 3;
+
+int64_t cpuNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double toMs(const int64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1.0e6;
+}
+
+double toUs(const int64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1.0e3;
+}
+
+} // namespace
+
+GpuProfiler::GpuProfiler() : pools(INITIAL_POOLS) {
+    calibrate();
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (Pool& pool : pools) {
+        if (!pool.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(pool.queries.size()), pool.queries.data());
+        }
+    }
+}
+
+void GpuProfiler::calibrate() {
+    GLint64 gpu = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu);
+    gpuToCpu = cpuNow() - static_cast<int64_t>(gpu);
+}
+
+void GpuProfiler::beginFrame() {
+    if (inFrame) endFrame();
+    resolve();
+
+    if (pools[current].pending) {
+        // Still running pools.size() frames later; waiting would stall
+        if (pools.size() < MAX_POOLS) {
+            pools.insert(pools.begin() + static_cast<std::ptrdiff_t>(current), Pool{});
+        } else {
+            pools[current].pending = false;
+            dropped++;
+        }
+    }
+    Pool& pool = pools[current];
+    pool.frame.index = frameIndex++;
+    pool.frame.cpuBegin = cpuNow();
+    pool.frame.cpuEnd = 0;
+    pool.frame.zones.clear();
+    openZones.clear();
+    inFrame = true;
+}
+
+void GpuProfiler::endFrame() {
+    if (!inFrame) return;
+    while (!openZones.empty()) endZone(openZones.back());
+
+    Pool& pool = pools[current];
+    pool.frame.cpuEnd = cpuNow();
+    pool.pending = true;
+    current = (current + 1) % pools.size();
+    inFrame = false;
+}
+
+int GpuProfiler::beginZone(std::string name) {
+    if (!inFrame) return -1;
+
+    Pool& pool = pools[current];
+    const size_t zone = pool.frame.zones.size();
+    if (pool.queries.size() < 2 * (zone + 1)) {
+        const size_t allocated = pool.queries.size();
+        const size_t grown = std::max<size_t>(32, 2 * allocated);
+        pool.queries.resize(grown);
+        glGenQueries(static_cast<GLsizei>(grown - allocated), pool.queries.data() + allocated);
+    }
+
+    ProfileZone entry;
+    entry.name = std::move(name);
+    entry.depth = static_cast<int>(openZones.size());
+    entry.cpuBegin = cpuNow();
+    pool.frame.zones.push_back(std::move(entry));
+    glQueryCounter(pool.queries[2 * zone], GL_TIMESTAMP);
+
+    openZones.push_back(static_cast<int>(zone));
+    return static_cast<int>(zone);
+}
+
+void GpuProfiler::endZone(const int zone) {
+    if (!inFrame || zone < 0 || openZones.empty()) return;
+
+    // Zones left open inside this one end with it
+    while (!openZones.empty()) {
+        const int open = openZones.back();
+        openZones.pop_back();
+        Pool& pool = pools[current];
+        glQueryCounter(pool.queries[2 * open + 1], GL_TIMESTAMP);
+        pool.frame.zones[open].cpuEnd = cpuNow();
+        if (open == zone) break;
+    }
+}
+
+void GpuProfiler::resolve() {
+    // pools[current] is the oldest; stop at the first one still in flight so
+    // frames are recorded in order
+    for (size_t k = 0; k < pools.size(); k++) {
+        Pool& pool = pools[(current + k) % pools.size()];
+        if (!pool.pending) continue;
+        if (!tryResolve(pool)) break;
+    }
+}
+
+bool GpuProfiler::tryResolve(Pool& pool) {
+    const size_t zoneCount = pool.frame.zones.size();
+    if (zoneCount > 0) {
+        // Timestamps complete in submission order
+        GLint available = 0;
+        glGetQueryObjectiv(pool.queries[2 * zoneCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return false;
+
+        for (size_t z = 0; z < zoneCount; z++) {
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(pool.queries[2 * z], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(pool.queries[2 * z + 1], GL_QUERY_RESULT, &end);
+            pool.frame.zones[z].gpuBegin = static_cast<int64_t>(begin);
+            pool.frame.zones[z].gpuEnd = static_cast<int64_t>(end);
+        }
+    }
+
+    pool.pending = false;
+    record(pool.frame);
+    return true;
+}
+
+void GpuProfiler::record(ProfileFrame& frame) {
+    int64_t gpuBegin = 0;
+    int64_t gpuEnd = 0;
+    for (const ProfileZone& zone : frame.zones) {
+        if (zone.depth != 0) continue;
+        gpuBegin = gpuBegin == 0 ? zone.gpuBegin : std::min(gpuBegin, zone.gpuBegin);
+        gpuEnd = std::max(gpuEnd, zone.gpuEnd);
+    }
+    const auto blend = [first = history.empty()](double& average, const double value) {
+        average = first ? value : average + SMOOTHING * (value - average);
+    };
+    blend(frameCpu, toMs(frame.cpuEnd - frame.cpuBegin));
+    blend(frameGpu, toMs(gpuEnd - gpuBegin));
+
+    // Sum repeated zones, then fold them into the summary. New zones go
+    // after the zone that preceded them in this frame, keeping nesting intact.
+    std::vector<ProfileSummary> totals;
+    for (const ProfileZone& zone : frame.zones) {
+        auto it = std::find_if(totals.begin(), totals.end(),
+                               [&](const ProfileSummary& s) { return s.name == zone.name; });
+        if (it == totals.end()) {
+            totals.push_back({zone.name, zone.depth, 0.0, 0.0, frame.index});
+            it = totals.end() - 1;
+        }
+        it->gpuMs += toMs(zone.gpuEnd - zone.gpuBegin);
+        it->cpuMs += toMs(zone.cpuEnd - zone.cpuBegin);
+    }
+
+    size_t insertAt = 0;
+    for (const ProfileSummary& total : totals) {
+        auto it = std::find_if(summaries.begin(), summaries.end(),
+                               [&](const ProfileSummary& s) { return s.name == total.name; });
+        if (it == summaries.end()) {
+            it = summaries.insert(summaries.begin() + static_cast<std::ptrdiff_t>(insertAt), total);
+        } else {
+            it->depth = total.depth;
+            it->gpuMs += SMOOTHING * (total.gpuMs - it->gpuMs);
+            it->cpuMs += SMOOTHING * (total.cpuMs - it->cpuMs);
+            it->lastFrame = frame.index;
+        }
+        insertAt = static_cast<size_t>(it - summaries.begin()) + 1;
+    }
+    std::erase_if(summaries, [&](const ProfileSummary& s) { return frame.index - s.lastFrame > SUMMARY_LINGER; });
+
+    history.push_back(std::move(frame));
+    if (history.size() > HISTORY_FRAMES) history.pop_front();
+}
+
+bool GpuProfiler::saveTrace(const char* filename) {
+    if (history.empty()) {
+        printf("ERROR: No profiled frames to write\n");
+        return false;
+    }
+
+    calibrate();
+    const int64_t origin = history.front().cpuBegin;
+    const auto event = [&](const std::string& name, const char* category, const int thread,
+                           const int64_t begin, const int64_t end) {
+        return json{
+            {"name", name}, {"cat", category}, {"ph", "X"}, {"pid", 1}, {"tid", thread},
+            {"ts", toUs(begin - origin)}, {"dur", toUs(std::max<int64_t>(end - begin, 0))}
+        };
+    };
+
+    json events = json::array();
+    events.push_back({{"name", "process_name"}, {"ph", "M"}, {"pid", 1}, {"args", {{"name", "raypulse"}}}});
+    events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", 1}, {"args", {{"name", "CPU"}}}});
+    events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", 2}, {"args", {{"name", "GPU"}}}});
+    for (const ProfileFrame& frame : history) {
+        events.push_back(event("Frame " + std::to_string(frame.index), "frame", 1, frame.cpuBegin, frame.cpuEnd));
+        for (const ProfileZone& zone : frame.zones) {
+            events.push_back(event(zone.name, "cpu", 1, zone.cpuBegin, zone.cpuEnd));
+            events.push_back(event(zone.name, "gpu", 2, zone.gpuBegin + gpuToCpu, zone.gpuEnd + gpuToCpu));
+        }
+    }
+
+    std::ofstream file(filename);
+    if (!file) {
+        printf("ERROR: Could not write %s\n", filename);
+        return false;
+    }
+    file << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump() << "\n";
+    printf("Trace of %zu frames written to %s\n", history.size(), filename);
+    return true;
+}
+
+GpuFrameTimer::GpuFrameTimer() {
+    glGenQueries(QUERY_COUNT, queries);
+}
+
+GpuFrameTimer::~GpuFrameTimer() {
+    glDeleteQueries(QUERY_COUNT, queries);
+}
+
+void GpuFrameTimer::begin(const int frameSamples) {
+    if (timing || inFlight == QUERY_COUNT) return;
+
+    const size_t next = (oldest + inFlight) % QUERY_COUNT;
+    queryFrameSamples[next] = frameSamples;
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    timing = true;
+}
+
+void GpuFrameTimer::end() {
+    if (!timing) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    inFlight++;
+    timing = false;
+}
+
+void GpuFrameTimer::poll() {
+    while (inFlight > 0) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &elapsed);
+        const Timing finished{toMs(static_cast<int64_t>(elapsed)), queryFrameSamples[oldest]};
+        window.push_back(finished);
+        windowMs += finished.ms;
+        windowFrameSamples += finished.frameSamples;
+        if (window.size() > WINDOW) {
+            windowMs -= window.front().ms;
+            windowFrameSamples -= window.front().frameSamples;
+            window.pop_front();
+        }
+
+        oldest = (oldest + 1) % QUERY_COUNT;
+        inFlight--;
+    }
+}
+
+void GpuFrameTimer::addRenderedSamples(const double samples) {
+    counted.push_back(samples);
+    countedSamples += samples;
+    if (counted.size() > WINDOW) {
+        countedSamples -= counted.front();
+        counted.pop_front();
+    }
+}
+
+double GpuFrameTimer::averageMs() const {
+    return window.empty() ? 0.0 : windowMs / static_cast<double>(window.size());
+}
+
+double GpuFrameTimer::msPerFrameSample() const {
+    return windowFrameSamples > 0.0 ? windowMs / windowFrameSamples : 0.0;
+}
+
+double GpuFrameTimer::samplesPerSecond() const {
+    const double ms = averageMs();
+    if (ms <= 0.0 || counted.empty()) return 0.0;
+    return countedSamples / static_cast<double>(counted.size()) / (ms / 1000.0);
+}
@@ -1,4 +1,45 @@
 #include "renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define DEG_TO_RAD(deg) ((deg) * 3.14159265359f / 180.0f)
+
+void calculateBasisFromEuler(const float pitch, const float yaw, const float roll,
+                             glm::vec3& forward, glm::vec3& right, glm::vec3& up) {
+    const float pitchRad = DEG_TO_RAD(pitch);
+    const float yawRad = -DEG_TO_RAD(yaw);
+    const float rollRad = -DEG_TO_RAD(roll);
+
+    forward.x = cos(pitchRad) * sin(yawRad);
+    forward.y = sin(pitchRad);
+    forward.z = -cos(pitchRad) * cos(yawRad);
+    forward = glm::normalize(forward);
+
+    constexpr auto worldUp = glm::vec3(0.0f, 1.0f, 0.0f);
+    right = glm::normalize(glm::cross(worldUp, forward));
+    up = glm::normalize(glm::cross(forward, right));
+
+    if (abs(rollRad) > 0.001f) {
+        const float cosRoll = cos(rollRad);
+        const float sinRoll = sin(rollRad);
+        const glm::vec3 newRight = cosRoll * right + sinRoll * up;
+        const glm::vec3 newUp = -sinRoll * right + cosRoll * up;
+        right = newRight;
+        up = newUp;
+    }
+}
+
+glm::mat3 buildRotationMatrix(const glm::vec3& rotEuler) {
+    const glm::vec3 rad = glm::radians(rotEuler);
+    const float cx = cos(rad.x), sx = sin(rad.x);
+    const float cy = cos(rad.y), sy = sin(rad.y);
+    const float cz = cos(rad.z), sz = sin(rad.z);
+    const glm::mat3 rx(1, 0, 0, 0, cx, sx, 0, -sx, cx);
+    const glm::mat3 ry(cy, 0, -sy, 0, 1, 0, sy, 0, cy);
+    const glm::mat3 rz(cz, sz, 0, -sz, cz, 0, 0, 0, 1);
+    return rz * ry * rx;
+}
 
 QuadRenderer::QuadRenderer() {
     QuadVertex quadVertices[] = {
@@ -40,83 +81,448 @@ void QuadRenderer::render() const {
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-SceneBuffer::SceneBuffer() {
+MaterialBuffer::MaterialBuffer() {
     glGenBuffers(1, &ssbo);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-    // Initialize with null data
     glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-SceneBuffer::~SceneBuffer() {
+MaterialBuffer::~MaterialBuffer() {
     glDeleteBuffers(1, &ssbo);
 }
 
-void SceneBuffer::update(const std::vector<GPUObject>& objects) const {
+void MaterialBuffer::update(const std::vector<GPUMaterial>& materials) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 materials.size() * sizeof(GPUMaterial),
+                 materials.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MaterialBuffer::updateRange(const std::vector<GPUMaterial>& materials, const size_t first, const size_t count) const {
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-    // Re-allocate buffer to fit the vector size
-    glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(GPUObject), objects.data(), GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(GPUMaterial)),
+                    static_cast<GLsizeiptr>(count * sizeof(GPUMaterial)),
+                    materials.data() + first);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void SceneBuffer::bind(GLuint bindingPoint) const {
+void MaterialBuffer::bind(GLuint bindingPoint) const {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
 }
 
-MaterialBuffer::MaterialBuffer() {
+LightBuffer::LightBuffer() {
     glGenBuffers(1, &ssbo);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
     glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-MaterialBuffer::~MaterialBuffer() {
+LightBuffer::~LightBuffer() {
     glDeleteBuffers(1, &ssbo);
 }
 
-void MaterialBuffer::update(const std::vector<GPUMaterial>& materials) const {
+void LightBuffer::update(const std::vector<int>& lightIndices) const {
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
     glBufferData(GL_SHADER_STORAGE_BUFFER,
-                 materials.size() * sizeof(GPUMaterial),
-                 materials.data(),
+                 lightIndices.size() * sizeof(int),
+                 lightIndices.data(),
                  GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void MaterialBuffer::bind(GLuint bindingPoint) const {
+void LightBuffer::bind(GLuint bindingPoint) const {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
 }
 
-LightBuffer::LightBuffer() {
+BVHBuffer::BVHBuffer() {
     glGenBuffers(1, &ssbo);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
     glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-LightBuffer::~LightBuffer() {
+BVHBuffer::~BVHBuffer() {
     glDeleteBuffers(1, &ssbo);
 }
 
-void LightBuffer::update(const std::vector<int>& lightIndices) const {
+void BVHBuffer::update(const std::vector<GPUBVHNode>& nodes) const {
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
     glBufferData(GL_SHADER_STORAGE_BUFFER,
-                 lightIndices.size() * sizeof(int),
-                 lightIndices.data(),
+                 nodes.size() * sizeof(GPUBVHNode),
+                 nodes.data(),
                  GL_DYNAMIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void LightBuffer::bind(GLuint bindingPoint) const {
+void BVHBuffer::updateRange(const std::vector<GPUBVHNode>& nodes, const size_t first, const size_t count) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(GPUBVHNode)),
+                    static_cast<GLsizeiptr>(count * sizeof(GPUBVHNode)),
+                    nodes.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void BVHBuffer::bind(GLuint bindingPoint) const {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
 }
 
+TransformBuffer::TransformBuffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+TransformBuffer::~TransformBuffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void TransformBuffer::update(const std::vector<GPUObjectTransform>& transforms) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 transforms.size() * sizeof(GPUObjectTransform),
+                 transforms.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TransformBuffer::updateRange(const std::vector<GPUObjectTransform>& transforms, const size_t first, const size_t count) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(GPUObjectTransform)),
+                    static_cast<GLsizeiptr>(count * sizeof(GPUObjectTransform)),
+                    transforms.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TransformBuffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+InstanceBuffer::InstanceBuffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void InstanceBuffer::update(const std::vector<GPUInstance>& instances) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 instances.size() * sizeof(GPUInstance),
+                 instances.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstanceBuffer::updateRange(const std::vector<GPUInstance>& instances, const size_t first, const size_t count) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(GPUInstance)),
+                    static_cast<GLsizeiptr>(count * sizeof(GPUInstance)),
+                    instances.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstanceBuffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+Vec4Buffer::Vec4Buffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+Vec4Buffer::~Vec4Buffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void Vec4Buffer::update(const std::vector<glm::vec4>& values) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 values.size() * sizeof(glm::vec4),
+                 values.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Vec4Buffer::updateRange(const std::vector<glm::vec4>& values, const size_t first, const size_t count) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(glm::vec4)),
+                    static_cast<GLsizeiptr>(count * sizeof(glm::vec4)),
+                    values.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Vec4Buffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+Vec3Buffer::Vec3Buffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+Vec3Buffer::~Vec3Buffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void Vec3Buffer::update(const std::vector<glm::vec3>& values) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 values.size() * sizeof(glm::vec3),
+                 values.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Vec3Buffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+LightTableBuffer::LightTableBuffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+LightTableBuffer::~LightTableBuffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void LightTableBuffer::update(const std::vector<GPULight>& lights) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 lights.size() * sizeof(GPULight),
+                 lights.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightTableBuffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+CounterBuffer::CounterBuffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(FrameCounts), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    reset();
+}
+
+CounterBuffer::~CounterBuffer() {
+    for (const GLsync fence : readbackFences) {
+        if (fence) glDeleteSync(fence);
+    }
+    if (readback != 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &readback);
+    }
+    glDeleteBuffers(1, &ssbo);
+}
+
+void CounterBuffer::reset() const {
+    const FrameCounts zero = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(FrameCounts), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+FrameCounts CounterBuffer::read() const {
+    FrameCounts counts = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(FrameCounts), &counts);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return counts;
+}
+
+void CounterBuffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+void CounterBuffer::queueRead(const uint64_t tag) {
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    if (readback == 0) {
+        glGenBuffers(1, &readback);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, READBACK_SLOTS * sizeof(FrameCounts), nullptr, flags);
+        readbackValues = static_cast<const FrameCounts*>(
+            glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, READBACK_SLOTS * sizeof(FrameCounts), flags));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    const int slot = nextReadback;
+    if (readbackFences[slot]) glDeleteSync(readbackFences[slot]);
+
+    // The copy reads what the kernel's atomics wrote
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, ssbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readback);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, slot * sizeof(FrameCounts),
+                        sizeof(FrameCounts));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackTags[slot] = tag;
+    nextReadback = (slot + 1) % READBACK_SLOTS;
+}
+
+bool CounterBuffer::pollRead(FrameCounts& counts, uint64_t& tag) {
+    // Oldest first; copies complete in order, so a pending one ends the search
+    for (int k = 0; k < READBACK_SLOTS; k++) {
+        const int slot = (nextReadback + k) % READBACK_SLOTS;
+        if (!readbackFences[slot]) continue;
+        const GLenum status = glClientWaitSync(readbackFences[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        glDeleteSync(readbackFences[slot]);
+        readbackFences[slot] = nullptr;
+        counts = readbackValues[slot];
+        tag = readbackTags[slot];
+        return true;
+    }
+    return false;
+}
+
+IndexBuffer::IndexBuffer() {
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+IndexBuffer::~IndexBuffer() {
+    glDeleteBuffers(1, &ssbo);
+}
+
+void IndexBuffer::update(const std::vector<int>& indices) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 indices.size() * sizeof(int),
+                 indices.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void IndexBuffer::updateRange(const std::vector<int>& indices, const size_t first, const size_t count) const {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<GLintptr>(first * sizeof(int)),
+                    static_cast<GLsizeiptr>(count * sizeof(int)),
+                    indices.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void IndexBuffer::bind(GLuint bindingPoint) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
+}
+
+FrameConstantsBuffer::FrameConstantsBuffer() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotStride = (static_cast<GLsizeiptr>(sizeof(GPUFrameConstants)) + alignment - 1) / alignment * alignment;
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferStorage(GL_UNIFORM_BUFFER, slotStride * SLOTS, nullptr, flags);
+    mapped = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, slotStride * SLOTS, flags));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+FrameConstantsBuffer::~FrameConstantsBuffer() {
+    for (const GLsync fence : fences) {
+        if (fence) glDeleteSync(fence);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glDeleteBuffers(1, &ubo);
+}
+
+void FrameConstantsBuffer::update(const GPUFrameConstants& constants) {
+    // Everything issued so far is the last use of the previous slot
+    const int previous = (slot + SLOTS - 1) % SLOTS;
+    if (fences[previous]) glDeleteSync(fences[previous]);
+    fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    if (fences[slot]) {
+        while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+
+    std::memcpy(mapped + slot * slotStride, &constants, sizeof(GPUFrameConstants));
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, ubo, slot * slotStride, sizeof(GPUFrameConstants));
+    slot = (slot + 1) % SLOTS;
+}
+
+GPUFrameConstants makeFrameConstants(
+    const RaytracerDimensions raytracer_dimensions, const CameraParams& camera_params, const SkyParams& sky_params,
+    const AdaptiveParams adaptive_params, const SamplerParams sampler_params,
+    const size_t objectCount, const int lightCount,
+    const int planeCount, const int bvhNodeCount,
+    const int lightTableSize, const int lightSamples,
+    const int samplesPerFrame, const int maxTotalSamples, const uint32_t maxBounces) {
+
+    GPUFrameConstants frame{};
+    frame.cameraOrigin = camera_params.pos;
+    frame.cameraFOV = camera_params.FOV;
+    frame.cameraForward = camera_params.forward;
+    frame.aperture = camera_params.aperture;
+    frame.cameraRight = camera_params.right;
+    frame.focusDist = camera_params.focusDist;
+    frame.cameraUp = camera_params.up;
+    frame.frameCount = camera_params.frameCount;
+
+    frame.skyColorTop = sky_params.colorTop;
+    frame.skyColorBottom = sky_params.colorBottom;
+
+    frame.resolution = glm::vec2(static_cast<float>(raytracer_dimensions.width),
+                                 static_cast<float>(raytracer_dimensions.height));
+    frame.samplesPerFrame = samplesPerFrame;
+    frame.maxTotalSamples = maxTotalSamples;
+    frame.maxBounces = maxBounces;
+
+    frame.lightCount = lightCount;
+    frame.lightTableSize = lightTableSize;
+    frame.lightSamples = lightSamples;
+    frame.objectCount = static_cast<int>(objectCount);
+    frame.planeCount = planeCount;
+    frame.bvhNodeCount = bvhNodeCount;
+
+    frame.adaptiveEnabled = adaptive_params.enabled ? 1 : 0;
+    frame.adaptiveThreshold = adaptive_params.threshold;
+    frame.adaptiveMinSamples = adaptive_params.minSamples;
+    frame.adaptiveMaxBoost = adaptive_params.maxBoost;
+    frame.samplerType = sampler_params.type;
+    frame.samplerSeed = sampler_params.seed;
+    return frame;
+}
+
 void dispatchComputeShader(const GLuint program,
     const GLuint accumTexture, const GLuint outputTexture,
     const GLuint accumBloom, const GLuint outputBloom, // <--- NEW
-    const RaytracerDimensions raytracer_dimensions, CameraParams camera_params, SkyParams sky_params,
-    const size_t objectCount, const int lightCount,
-    const int samplesPerFrame, const int maxTotalSamples, const uint32_t maxBounces) {
+    const GLuint momentTexture,
+    const GPUFrameConstants& frame, const int bands) {
 
     glUseProgram(program);
 
@@ -127,36 +533,29 @@ void dispatchComputeShader(const GLuint program,
     glBindImageTexture(4, outputBloom, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
     glBindImageTexture(5, accumBloom, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 
-    // Set uniforms
-    glUniform2f(glGetUniformLocation(program, "resolution"), 
-                static_cast<GLfloat>(raytracer_dimensions.width), static_cast<GLfloat>(raytracer_dimensions.height));
-
-    glUniform3fv(glGetUniformLocation(program, "cameraOrigin"), 1, &camera_params.pos[0]);
-    glUniform3fv(glGetUniformLocation(program, "cameraForward"), 1, &camera_params.forward[0]);
-    glUniform3fv(glGetUniformLocation(program, "cameraRight"), 1, &camera_params.right[0]);
-    glUniform3fv(glGetUniformLocation(program, "cameraUp"), 1, &camera_params.up[0]);
-    glUniform1f(glGetUniformLocation(program, "cameraFOV"), camera_params.FOV);
-
-    glUniform1f(glGetUniformLocation(program, "aperture"), camera_params.aperture);
-    glUniform1f(glGetUniformLocation(program, "focusDist"), camera_params.focusDist);
-
-    glUniform3fv(glGetUniformLocation(program, "skyColorTop"), 1, &sky_params.colorTop[0]);
-    glUniform3fv(glGetUniformLocation(program, "skyColorBottom"), 1, &sky_params.colorBottom[0]);
-
-    glUniform1i(glGetUniformLocation(program, "objectCount"), static_cast<GLint>(objectCount));
-    glUniform1ui(glGetUniformLocation(program, "frameCount"), camera_params.frameCount);
-
-    glUniform1i(glGetUniformLocation(program, "samplesPerFrame"), samplesPerFrame);
-    glUniform1i(glGetUniformLocation(program, "maxTotalSamples"), maxTotalSamples);
-
-    glUniform1ui(glGetUniformLocation(program, "maxBounces"), maxBounces);
-
-    glUniform1i(glGetUniformLocation(program, "lightCount"), lightCount);
+    // Second-moment buffer for adaptive sampling (slot 2)
+    glBindImageTexture(2, momentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 
     // Dispatch compute shader
     // Calculate number of work groups needed: ceil to next multiple of 16
-    glDispatchCompute((raytracer_dimensions.width + 15) / 16, (raytracer_dimensions.height + 15) / 16, 1);
+    const int width = static_cast<int>(frame.resolution.x);
+    const int height = static_cast<int>(frame.resolution.y);
+    // Every tile, no tile lists (TILES_OFF) and no priority region
+    glUniform4i(TILE_SCHEDULE_LOCATION, 0, 0, 0, 0);
+    glUniform4i(PRIORITY_TILES_LOCATION, 0, 0, 0, 0);
+    dispatchTileRows(0, 0, (width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE, bands);
     
     // Ensure compute shader has finished
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void dispatchTileRows(const int firstX, const int firstY, const int tilesX, const int tilesY, const int bands) {
+    const int bandCount = std::clamp(bands, 1, std::max(tilesY, 1));
+    const int bandRows = (tilesY + bandCount - 1) / bandCount;
+    // Bands cover disjoint pixels, so they need no barrier between them
+    for (int row = 0; row < tilesY; row += bandRows) {
+        glUniform2i(DISPATCH_OFFSET_LOCATION, firstX, firstY + row);
+        glDispatchCompute(tilesX, std::min(bandRows, tilesY - row), 1);
+        if (row + bandRows < tilesY) glFlush();
+    }
 }
\ No newline at end of file
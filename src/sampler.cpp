@@ -0,0 +1,131 @@
+#include "sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace {
+
+// Gaussian width of the energy filter, in texels (Ulichney's choice)
+constexpr double ENERGY_SIGMA = 1.5;
+// Share of texels set in the initial binary pattern
+constexpr double INITIAL_DENSITY = 0.1;
+
+class VoidAndCluster {
+public:
+    explicit VoidAndCluster(const int size)
+        : size(size), texels(size * size), kernel(texels), energy(texels, 0.0), points(texels, false) {
+        for (int dy = 0; dy < size; dy++) {
+            for (int dx = 0; dx < size; dx++) {
+                // Toroidal distance, so the mask tiles
+                const int x = std::min(dx, size - dx);
+                const int y = std::min(dy, size - dy);
+                kernel[dy * size + dx] = std::exp(-(x * x + y * y) / (2.0 * ENERGY_SIGMA * ENERGY_SIGMA));
+            }
+        }
+    }
+
+    std::vector<int> build() {
+        std::mt19937 rng(1);
+        const int initial = std::max(1, static_cast<int>(texels * INITIAL_DENSITY));
+        for (int placed = 0; placed < initial;) {
+            const int texel = static_cast<int>(rng() % static_cast<uint32_t>(texels));
+            if (points[texel]) continue;
+            set(texel, true);
+            placed++;
+        }
+
+        // Move points from the tightest cluster to the largest void until
+        // that stops changing anything
+        while (true) {
+            const int cluster = tightestCluster();
+            set(cluster, false);
+            const int largestVoid = largestVoidTexel();
+            set(largestVoid, true);
+            if (largestVoid == cluster) break;
+        }
+
+        std::vector<int> ranks(texels, 0);
+        const std::vector<bool> prototype = points;
+        const std::vector<double> prototypeEnergy = energy;
+
+        // Ranks below the initial count: remove clusters
+        for (int rank = initial - 1; rank >= 0; rank--) {
+            const int cluster = tightestCluster();
+            set(cluster, false);
+            ranks[cluster] = rank;
+        }
+
+        // Ranks above it: fill voids
+        points = prototype;
+        energy = prototypeEnergy;
+        for (int rank = initial; rank < texels; rank++) {
+            const int largestVoid = largestVoidTexel();
+            set(largestVoid, true);
+            ranks[largestVoid] = rank;
+        }
+        return ranks;
+    }
+
+private:
+    int size;
+    int texels;
+    std::vector<double> kernel;
+    std::vector<double> energy;
+    std::vector<bool> points;
+
+    void set(const int texel, const bool value) {
+        points[texel] = value;
+        const double sign = value ? 1.0 : -1.0;
+        const int tx = texel % size;
+        const int ty = texel / size;
+        for (int y = 0; y < size; y++) {
+            const int dy = (y - ty + size) % size;
+            for (int x = 0; x < size; x++) {
+                const int dx = (x - tx + size) % size;
+                energy[y * size + x] += sign * kernel[dy * size + dx];
+            }
+        }
+    }
+
+    int tightestCluster() const {
+        int best = -1;
+        for (int i = 0; i < texels; i++) {
+            if (points[i] && (best < 0 || energy[i] > energy[best])) best = i;
+        }
+        return best;
+    }
+
+    int largestVoidTexel() const {
+        int best = -1;
+        for (int i = 0; i < texels; i++) {
+            if (!points[i] && (best < 0 || energy[i] < energy[best])) best = i;
+        }
+        return best;
+    }
+};
+
+} // namespace
+
+const char* samplerTypeName(const SamplerType type) {
+    switch (type) {
+        case SamplerType::Sobol: return "sobol";
+        case SamplerType::BlueNoise: return "bluenoise";
+        default: return "pcg";
+    }
+}
+
+bool parseSamplerType(const std::string& name, SamplerType& type) {
+    for (const SamplerType candidate : {SamplerType::Pcg, SamplerType::Sobol, SamplerType::BlueNoise}) {
+        if (name == samplerTypeName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<int>& blueNoiseRanks() {
+    static const std::vector<int> ranks = VoidAndCluster(BLUE_NOISE_SIZE).build();
+    return ranks;
+}
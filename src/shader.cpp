@@ -138,4 +138,25 @@ GLuint createComputeProgramFromBinary(const char* binaryPath) {
 
     glDeleteShader(shader);
     return program;
-}
\ No newline at end of file
+}
+
+GLuint createComputeProgramFromFile(const char* sourcePath) {
+    GLuint shader = compileShaderFromFile(GL_COMPUTE_SHADER, sourcePath);
+    if (shader == 0) return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
@@ -0,0 +1,138 @@
+#include "tiles.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "shader.h"
+#include "paths.h"
+
+namespace {
+
+// std430 layout of TileSchedule in tiles.glsl: band arguments, the two list
+// lengths, the capacity, then both lists
+constexpr GLsizeiptr BAND_ARGS_SIZE = 16;
+constexpr GLintptr TILE_CAPACITY_OFFSET = TileScheduler::MAX_BANDS * BAND_ARGS_SIZE + 2 * sizeof(GLuint);
+constexpr GLsizeiptr TILE_HEADER_SIZE = TILE_CAPACITY_OFFSET + 2 * sizeof(GLuint);
+
+constexpr GLuint TILE_SCHEDULE_BINDING = 21;
+
+// Matches the TILES_* values in main.glsl
+enum TileMode {
+    TILES_GRID = 1,
+    TILES_LIST = 2,
+    TILES_PRIORITY = 3
+};
+
+} // namespace
+
+TileScheduler::TileScheduler() {
+    const std::string path = getResourcePath("tile_prepare.spv");
+    prepareProgram = createComputeProgramFromBinary(path.c_str());
+    if (prepareProgram == 0) {
+        printf("ERROR: Failed to load tile kernel %s\n", path.c_str());
+        return;
+    }
+    readListLocation = glGetUniformLocation(prepareProgram, "readList");
+    bandCountLocation = glGetUniformLocation(prepareProgram, "bandCount");
+    glGenBuffers(1, &scheduleBuffer);
+    valid = true;
+}
+
+TileScheduler::~TileScheduler() {
+    if (prepareProgram != 0) glDeleteProgram(prepareProgram);
+    if (scheduleBuffer != 0) glDeleteBuffers(1, &scheduleBuffer);
+}
+
+void TileScheduler::ensureCapacity(const int tileCount) {
+    if (tileCount == tileCapacity) return;
+
+    std::vector<GLuint> header(TILE_HEADER_SIZE / sizeof(GLuint), 0);
+    header[TILE_CAPACITY_OFFSET / sizeof(GLuint)] = static_cast<GLuint>(tileCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scheduleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, TILE_HEADER_SIZE + 2 * sizeof(GLuint) * tileCount, nullptr, GL_DYNAMIC_COPY);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, TILE_HEADER_SIZE, header.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    tileCapacity = tileCount;
+    rebuild = true;
+}
+
+bool TileScheduler::criteriaChanged(const GPUFrameConstants& frame) {
+    const bool changed = frame.maxTotalSamples != maxTotalSamples || frame.adaptiveEnabled != adaptiveEnabled ||
+                         frame.adaptiveThreshold != adaptiveThreshold ||
+                         frame.adaptiveMinSamples != adaptiveMinSamples;
+    maxTotalSamples = frame.maxTotalSamples;
+    adaptiveEnabled = frame.adaptiveEnabled;
+    adaptiveThreshold = frame.adaptiveThreshold;
+    adaptiveMinSamples = frame.adaptiveMinSamples;
+    return changed;
+}
+
+void TileScheduler::dispatch(const GLuint program,
+    const GLuint accumTexture, const GLuint outputTexture,
+    const GLuint accumBloom, const GLuint outputBloom,
+    const GLuint momentTexture,
+    const GPUFrameConstants& frame, const int bands,
+    const PriorityRegion& priority) {
+
+    if (!valid) return;
+
+    const int tilesX = (static_cast<int>(frame.resolution.x) + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (static_cast<int>(frame.resolution.y) + TILE_SIZE - 1) / TILE_SIZE;
+    ensureCapacity(tilesX * tilesY);
+    if (criteriaChanged(frame)) rebuild = true;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_SCHEDULE_BINDING, scheduleBuffer);
+
+    glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, accumTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(2, momentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(4, outputBloom, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(5, accumBloom, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+    // Band arguments for the list read now; empties the other one
+    const int bandCount = std::clamp(bands, 1, MAX_BANDS);
+    glProgramUniform1ui(prepareProgram, readListLocation, readList);
+    glProgramUniform1ui(prepareProgram, bandCountLocation, static_cast<GLuint>(bandCount));
+    glUseProgram(prepareProgram);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    PriorityRegion region = priority;
+    region.minX = std::clamp(region.minX, 0, tilesX);
+    region.maxX = std::clamp(region.maxX, 0, tilesX);
+    region.minY = std::clamp(region.minY, 0, tilesY);
+    region.maxY = std::clamp(region.maxY, 0, tilesY);
+    if (region.empty()) region = PriorityRegion{};
+
+    glUseProgram(program);
+    glUniform4i(PRIORITY_TILES_LOCATION, region.minX, region.minY, region.maxX, region.maxY);
+    glUniform1i(PRIORITY_BOOST_LOCATION, region.boost);
+
+    if (!region.empty()) {
+        glUniform4i(TILE_SCHEDULE_LOCATION, TILES_PRIORITY, static_cast<GLint>(readList), 0, 0);
+        dispatchTileRows(region.minX, region.minY, region.maxX - region.minX, region.maxY - region.minY, 1);
+        glFlush();
+    }
+
+    if (rebuild) {
+        glUniform4i(TILE_SCHEDULE_LOCATION, TILES_GRID, static_cast<GLint>(readList), 0, 0);
+        dispatchTileRows(0, 0, tilesX, tilesY, bands);
+    } else {
+        // Bands past the end of the list have zero groups
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, scheduleBuffer);
+        for (int band = 0; band < bandCount; band++) {
+            glUniform4i(TILE_SCHEDULE_LOCATION, TILES_LIST, static_cast<GLint>(readList), band, 0);
+            glDispatchComputeIndirect(band * BAND_ARGS_SIZE);
+            if (band + 1 < bandCount) glFlush();
+        }
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    }
+
+    readList ^= 1u;
+    rebuild = false;
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT |
+                    GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
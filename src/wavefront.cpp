@@ -0,0 +1,199 @@
+#include "wavefront.h"
+#include <algorithm>
+#include <cstdio>
+
+#include "shader.h"
+#include "paths.h"
+
+namespace {
+
+// std430 sizes of PathState and ShadowRay in wf_common.glsl
+constexpr GLsizeiptr PATH_STATE_SIZE = 160;
+constexpr GLsizeiptr SHADOW_RAY_SIZE = 48;
+
+// Queue lengths followed by four indirect dispatch argument blocks
+constexpr GLsizeiptr COUNTER_BUFFER_SIZE = 96;
+constexpr GLintptr EXTEND_ARGS_OFFSET = 32;
+constexpr GLintptr SURFACE_ARGS_OFFSET = 48;
+constexpr GLintptr MEDIUM_ARGS_OFFSET = 64;
+constexpr GLintptr SHADOW_ARGS_OFFSET = 80;
+
+// Path queues: two extension queues plus surface, medium and shadow
+constexpr GLsizeiptr QUEUES_PER_PATH = 5;
+
+// Upper bound for path state + queues + shadow rays; larger images are
+// rendered in several chunks per frame
+constexpr GLsizeiptr PATH_MEMORY_BUDGET = 128ll * 1024 * 1024;
+
+constexpr GLuint GROUP_SIZE = 64;
+
+// Matches the STAGE_* values in wf_prepare.glsl
+enum PrepareStage {
+    STAGE_RESET = 0,
+    STAGE_EXTEND = 1,
+    STAGE_SHADE = 2,
+    STAGE_SHADOW = 3
+};
+
+constexpr GLbitfield STAGE_BARRIER_BITS = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+
+GLuint loadKernel(const char* name) {
+    const std::string path = getResourcePath(name);
+    const GLuint program = createComputeProgramFromBinary(path.c_str());
+    if (program == 0) {
+        printf("ERROR: Failed to load wavefront kernel %s\n", path.c_str());
+    }
+    return program;
+}
+
+void setUniform(const GLuint program, const GLint location, const GLuint value) {
+    if (location >= 0) glProgramUniform1ui(program, location, value);
+}
+
+void allocateBuffer(GLuint& buffer, const GLsizeiptr size) {
+    if (buffer == 0) glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+} // namespace
+
+WavefrontPipeline::WavefrontPipeline() {
+    generate.program = loadKernel("wf_generate.spv");
+    extend.program = loadKernel("wf_extend.spv");
+    shade.program = loadKernel("wf_shade.spv");
+    medium.program = loadKernel("wf_medium.spv");
+    shadow.program = loadKernel("wf_shadow.spv");
+    accumulate.program = loadKernel("wf_accumulate.spv");
+    prepare.program = loadKernel("wf_prepare.spv");
+
+    valid = generate.program != 0 && extend.program != 0 && shade.program != 0 && medium.program != 0 &&
+            shadow.program != 0 && accumulate.program != 0 && prepare.program != 0;
+
+    for (Kernel* kernel : {&generate, &extend, &shade, &medium, &shadow, &accumulate, &prepare}) {
+        if (kernel->program == 0) continue;
+        const GLuint program = kernel->program;
+        kernel->uniforms.pathCapacity = glGetUniformLocation(program, "pathCapacity");
+        kernel->uniforms.chunkOffset = glGetUniformLocation(program, "chunkOffset");
+        kernel->uniforms.chunkSize = glGetUniformLocation(program, "chunkSize");
+        kernel->uniforms.queueParity = glGetUniformLocation(program, "queueParity");
+        kernel->uniforms.bounceIndex = glGetUniformLocation(program, "bounceIndex");
+        kernel->uniforms.sampleIndex = glGetUniformLocation(program, "sampleIndex");
+        kernel->uniforms.prepareStage = glGetUniformLocation(program, "prepareStage");
+    }
+
+    allocateBuffer(counterBuffer, COUNTER_BUFFER_SIZE);
+}
+
+WavefrontPipeline::~WavefrontPipeline() {
+    for (const Kernel* kernel : {&generate, &extend, &shade, &medium, &shadow, &accumulate, &prepare}) {
+        if (kernel->program != 0) glDeleteProgram(kernel->program);
+    }
+    for (const GLuint buffer : {pathBuffer, queueBuffer, counterBuffer, shadowRayBuffer}) {
+        if (buffer != 0) glDeleteBuffers(1, &buffer);
+    }
+}
+
+void WavefrontPipeline::ensureCapacity(const int pixelCount, const int neeSamples) {
+    if (pixelCount == allocatedPixels && neeSamples == shadowRaysPerPath) return;
+
+    const GLsizeiptr bytesPerPath = PATH_STATE_SIZE + QUEUES_PER_PATH * sizeof(GLuint) + SHADOW_RAY_SIZE * neeSamples;
+    const GLsizeiptr budgetPaths = std::max<GLsizeiptr>(PATH_MEMORY_BUDGET / bytesPerPath, GROUP_SIZE);
+    pathCapacity = static_cast<int>(std::min<GLsizeiptr>(pixelCount, budgetPaths));
+    shadowRaysPerPath = neeSamples;
+    allocatedPixels = pixelCount;
+
+    allocateBuffer(pathBuffer, PATH_STATE_SIZE * pathCapacity);
+    allocateBuffer(queueBuffer, QUEUES_PER_PATH * sizeof(GLuint) * pathCapacity);
+    allocateBuffer(shadowRayBuffer, SHADOW_RAY_SIZE * neeSamples * pathCapacity);
+}
+
+void WavefrontPipeline::runPrepare(const int stage, const GLuint queueParity) const {
+    if (prepare.uniforms.prepareStage >= 0) glProgramUniform1i(prepare.program, prepare.uniforms.prepareStage, stage);
+    setUniform(prepare.program, prepare.uniforms.queueParity, queueParity);
+    glUseProgram(prepare.program);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(STAGE_BARRIER_BITS);
+}
+
+void WavefrontPipeline::dispatch(const GLuint accumTexture, const GLuint outputTexture,
+    const GLuint accumBloom, const GLuint outputBloom,
+    const GLuint momentTexture,
+    const GPUFrameConstants& frame) {
+
+    if (!valid) return;
+
+    const int pixelCount = static_cast<int>(frame.resolution.x) * static_cast<int>(frame.resolution.y);
+    ensureCapacity(pixelCount, std::max(frame.lightSamples, 1));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, pathBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, queueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, shadowRayBuffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+
+    glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, accumTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(2, momentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(4, outputBloom, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(5, accumBloom, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+    const Kernel* const stages[] = {&generate, &extend, &shade, &medium, &shadow, &accumulate, &prepare};
+    for (const Kernel* kernel : stages) {
+        setUniform(kernel->program, kernel->uniforms.pathCapacity, static_cast<GLuint>(pathCapacity));
+    }
+
+    for (int chunkOffset = 0; chunkOffset < pixelCount; chunkOffset += pathCapacity) {
+        const auto chunkSize = static_cast<GLuint>(std::min(pathCapacity, pixelCount - chunkOffset));
+        const GLuint chunkGroups = (chunkSize + GROUP_SIZE - 1) / GROUP_SIZE;
+        for (const Kernel* kernel : stages) {
+            setUniform(kernel->program, kernel->uniforms.chunkOffset, static_cast<GLuint>(chunkOffset));
+            setUniform(kernel->program, kernel->uniforms.chunkSize, chunkSize);
+        }
+
+        for (int sample = 0; sample < frame.samplesPerFrame; ++sample) {
+            runPrepare(STAGE_RESET, 0);
+
+            setUniform(generate.program, generate.uniforms.sampleIndex, static_cast<GLuint>(sample));
+            glUseProgram(generate.program);
+            glDispatchCompute(chunkGroups, 1, 1);
+            glMemoryBarrier(STAGE_BARRIER_BITS);
+
+            // Every surviving path advances one bounce per iteration, as in
+            // the megakernel loop; paths still queued afterwards are dropped
+            for (uint32_t bounce = 0; bounce < frame.maxBounces; ++bounce) {
+                const GLuint parity = bounce & 1u;
+                for (const Kernel* kernel : {&extend, &shade, &medium, &shadow}) {
+                    setUniform(kernel->program, kernel->uniforms.queueParity, parity);
+                    setUniform(kernel->program, kernel->uniforms.bounceIndex, bounce);
+                }
+
+                runPrepare(STAGE_EXTEND, parity);
+                glUseProgram(extend.program);
+                glDispatchComputeIndirect(EXTEND_ARGS_OFFSET);
+                glMemoryBarrier(STAGE_BARRIER_BITS);
+
+                runPrepare(STAGE_SHADE, parity);
+                glUseProgram(shade.program);
+                glDispatchComputeIndirect(SURFACE_ARGS_OFFSET);
+                glUseProgram(medium.program);
+                glDispatchComputeIndirect(MEDIUM_ARGS_OFFSET);
+                glMemoryBarrier(STAGE_BARRIER_BITS);
+
+                runPrepare(STAGE_SHADOW, parity);
+                glUseProgram(shadow.program);
+                glDispatchComputeIndirect(SHADOW_ARGS_OFFSET);
+                glMemoryBarrier(STAGE_BARRIER_BITS);
+            }
+
+            setUniform(accumulate.program, accumulate.uniforms.sampleIndex, static_cast<GLuint>(sample));
+            glUseProgram(accumulate.program);
+            glDispatchCompute(chunkGroups, 1, 1);
+            glMemoryBarrier(STAGE_BARRIER_BITS);
+        }
+    }
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}